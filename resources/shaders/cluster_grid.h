@@ -0,0 +1,29 @@
+#ifndef VK_GRAPHICS_BASIC_CLUSTER_GRID_H
+#define VK_GRAPHICS_BASIC_CLUSTER_GRID_H
+
+// cluster grid layout shared by cluster_assign.comp and the shading, x is the fastest index
+
+#define CLUSTERS_NUM (CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z)
+
+uvec3 ClusterCell(uint a_clusterId)
+{
+  return uvec3(a_clusterId % CLUSTER_GRID_X, (a_clusterId / CLUSTER_GRID_X) % CLUSTER_GRID_Y,
+               a_clusterId / (CLUSTER_GRID_X * CLUSTER_GRID_Y));
+}
+
+// view depth of the near boundary of slice a_slice, slices are exponential so cells stay roughly cubic
+float SliceDepth(float a_zNear, float a_zFar, uint a_slice)
+{
+  return a_zNear * pow(a_zFar / a_zNear, float(a_slice) / float(CLUSTER_GRID_Z));
+}
+
+uint ClusterIndex(vec2 a_fragCoord, vec2 a_screenSize, float a_viewDepth, float a_zNear, float a_zFar)
+{
+  const uvec2 xy    = min(uvec2(a_fragCoord / a_screenSize * vec2(CLUSTER_GRID_X, CLUSTER_GRID_Y)),
+                          uvec2(CLUSTER_GRID_X - 1, CLUSTER_GRID_Y - 1));
+  const float slice = log(max(a_viewDepth, a_zNear) / a_zNear) / log(a_zFar / a_zNear) * float(CLUSTER_GRID_Z);
+  const uint  z     = min(uint(slice), uint(CLUSTER_GRID_Z - 1));
+  return (z * CLUSTER_GRID_Y + xy.y) * CLUSTER_GRID_X + xy.x;
+}
+
+#endif// VK_GRAPHICS_BASIC_CLUSTER_GRID_H
@@ -25,7 +25,88 @@ struct UniformParams
   vec3  lightPos;
   float time;
   vec3  baseColor;
-  bool animateLightColor;
+  float shadowFilterRadius; // Poisson and rotated grid kernel radius in shadow map texels
+  float lightSize;          // PCSS light source size in shadow map uv units
+  float shadowBias;         // subtracted from light space depth before comparison
+  float lightBleedReduction; // VSM/EVSM: visibility below this value is cut to 0, hides light bleeding of overlapping occluders
+  uint  pad0;
+};
+
+// specialization constant ids (layout(constant_id = ...)), features are selected per pipeline, not per fragment
+#define SPEC_ANIMATE_LIGHT_COLOR 0
+#define SPEC_SHADOWS             1
+#define SPEC_PCF_RADIUS          2 // 0 - single depth compare, N - (2N+1)^2 taps
+#define SPEC_TEXTURING           3
+#define SPEC_SHADOW_FILTER       4 // one of SHADOW_FILTER_*
+#define SPEC_CLUSTERED_LIGHTS    5 // point lights from the cluster grid in simple.frag
+
+#define SHADOW_FILTER_HARD         0 // single hardware compare (2x2 bilinear PCF where supported)
+#define SHADOW_FILTER_PCF_GRID     1 // (2*SPEC_PCF_RADIUS+1)^2 hardware compares one texel apart
+#define SHADOW_FILTER_POISSON      2 // 16 taps of a Poisson disk rotated per pixel
+#define SHADOW_FILTER_ROTATED_GRID 3 // 4x4 grid rotated by atan(1/2), no regular stair pattern
+#define SHADOW_FILTER_PCSS         4 // blocker search, then Poisson filter sized by the estimated penumbra
+#define SHADOW_FILTER_VSM          5 // variance shadow map, (z, z^2) blurred and mipped, Chebyshev upper bound
+#define SHADOW_FILTER_EVSM         6 // exponential variance shadow map, moments of exp(c+ z) and -exp(-c- z)
+#define SHADOW_FILTER_COUNT        7
+
+// EVSM warp exponents for depth mapped to [-1, 1], exp(2*5) stays far from RGBA16F max
+#define EVSM_EXPONENT_POS 5.0f
+#define EVSM_EXPONENT_NEG 5.0f
+
+// deferred renderer, tiled light culling in deferred_tiled.comp
+#define DEFERRED_TILE_SIZE  16   // one workgroup per DEFERRED_TILE_SIZE x DEFERRED_TILE_SIZE pixels
+#define MAX_LIGHTS_PER_TILE 256  // lights beyond this are dropped for the tile
+
+// clustered forward shading, lights are assigned to a grid of view frustum cells in cluster_assign.comp
+#define CLUSTER_GRID_X         16
+#define CLUSTER_GRID_Y         16
+#define CLUSTER_GRID_Z         24   // slices are exponential in view depth between zNear and zFar
+#define MAX_LIGHTS_PER_CLUSTER 128  // lights beyond this are dropped for the cluster
+#define CLUSTER_ASSIGN_GROUP   64   // clusters per workgroup, also the size of the shared light batch
+
+// size of the light buffer shared by deferred and clustered forward shading
+#define MAX_POINT_LIGHTS 1024
+
+struct PointLight
+{
+  vec4 posRadius; // xyz - position (view space in the light buffer of the renderers), w - distance where the light fades to zero
+  vec4 color;     // rgb - intensity, a - unused
+};
+
+struct ClusterParams
+{
+  mat4  view;       // world space surface to view space lights in simple.frag
+  mat4  invProj;    // view space bounds of cluster tiles
+  vec2  screenSize;
+  float zNear;
+  float zFar;
+  uint  lightsNum;
+  float exposure;   // clustered lights are tonemapped before adding to the rest of the shading
+  uint  pad0;
+  uint  pad1;
+};
+
+struct DeferredParams
+{
+  mat4  invProj;         // view space position from G-buffer depth
+  mat4  view;            // world space G-buffer normals to view space
+  uvec2 screenSize;
+  uint  lightsNum;
+  uint  showTileHeatmap; // output lights per tile instead of shading
+  vec4  ambient;         // rgb - ambient color, a - exposure
+};
+
+// size of the scene texture table, unused slots point to a 1x1 white texture
+#define MAX_SCENE_TEXTURES 64
+#define NO_TEXTURE 0xFFFFFFFFu
+
+struct MaterialData
+{
+  vec4 baseColor;
+  uint diffuseTexId; // index in the scene texture table or NO_TEXTURE
+  uint pad0;
+  uint pad1;
+  uint pad2;
 };
 
 #endif //VK_GRAPHICS_BASIC_COMMON_H
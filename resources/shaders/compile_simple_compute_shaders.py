@@ -10,3 +10,10 @@ if __name__ == '__main__':
     for shader in shader_list:
         subprocess.run([glslang_cmd, "-V", shader, "-o", "{}.spv".format(shader)])
 
+    # compute primitives: subgroup arithmetic variant and shared memory fallback (*.nosg.spv)
+    prim_list = ["prim_reduce.comp", "prim_scan.comp", "prim_scan_add.comp", "prim_compact.comp",
+                 "prim_radix_count.comp", "prim_radix_scatter.comp"]
+
+    for shader in prim_list:
+        subprocess.run([glslang_cmd, "-V", "--target-env", "vulkan1.1", "-DUSE_SUBGROUPS", shader, "-o", "{}.spv".format(shader)])
+        subprocess.run([glslang_cmd, "-V", shader, "-o", "{}.nosg.spv".format(shader)])
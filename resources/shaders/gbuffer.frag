@@ -0,0 +1,27 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#include "common.h"
+#include "gbuffer_pack.h"
+
+// x - albedo in RGBA8, y - octahedral world space normal in 2 x snorm16, decoded in deferred_tiled.comp
+layout(location = 0) out uvec2 out_gbuffer;
+
+layout (location = 0 ) in VS_OUT
+{
+    vec3 wPos;
+    vec3 wNorm;
+    vec3 wTangent;
+    vec2 texCoord;
+} surf;
+
+layout(binding = 0, set = 0) uniform AppData
+{
+    UniformParams Params;
+};
+
+void main()
+{
+    out_gbuffer = uvec2(packUnorm4x8(vec4(Params.baseColor, 1.0f)), packSnorm2x16(EncodeOctahedral(normalize(surf.wNorm))));
+}
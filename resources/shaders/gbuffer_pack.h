@@ -0,0 +1,25 @@
+#ifndef VK_GRAPHICS_BASIC_GBUFFER_PACK_H
+#define VK_GRAPHICS_BASIC_GBUFFER_PACK_H
+
+// octahedral mapping of unit vectors to [-1, 1]^2, keeps normals accurate in 2 x snorm16
+
+vec2 SignNotZero(vec2 a_v)
+{
+  return vec2(a_v.x >= 0.0f ? 1.0f : -1.0f, a_v.y >= 0.0f ? 1.0f : -1.0f);
+}
+
+vec2 EncodeOctahedral(vec3 a_n)
+{
+  const vec2 p = a_n.xy * (1.0f / (abs(a_n.x) + abs(a_n.y) + abs(a_n.z)));
+  return a_n.z <= 0.0f ? (1.0f - abs(p.yx)) * SignNotZero(p) : p;
+}
+
+vec3 DecodeOctahedral(vec2 a_e)
+{
+  vec3 n = vec3(a_e.xy, 1.0f - abs(a_e.x) - abs(a_e.y));
+  if(n.z < 0.0f)
+    n.xy = (1.0f - abs(n.yx)) * SignNotZero(n.xy);
+  return normalize(n);
+}
+
+#endif// VK_GRAPHICS_BASIC_GBUFFER_PACK_H
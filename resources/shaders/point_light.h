@@ -0,0 +1,16 @@
+#ifndef VK_GRAPHICS_BASIC_POINT_LIGHT_H
+#define VK_GRAPHICS_BASIC_POINT_LIGHT_H
+
+// diffuse radiance of a PointLight (common.h) at a_pos with normal a_normal, both in the space of the light
+// inverse square falloff is windowed to reach exactly zero at posRadius.w, so lights can be culled by that radius
+vec3 PointLightDiffuse(PointLight a_light, vec3 a_pos, vec3 a_normal)
+{
+  const vec3  L      = a_light.posRadius.xyz - a_pos;
+  const float dist2  = max(dot(L, L), 1e-8f);
+  const float ratio  = dist2 / (a_light.posRadius.w * a_light.posRadius.w);
+  const float window = clamp(1.0f - ratio * ratio, 0.0f, 1.0f);
+  const float atten  = window * window / (dist2 + 1.0f);
+  return a_light.color.rgb * (max(dot(a_normal, L * inversesqrt(dist2)), 0.0f) * atten);
+}
+
+#endif// VK_GRAPHICS_BASIC_POINT_LIGHT_H
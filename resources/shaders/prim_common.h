@@ -0,0 +1,118 @@
+#ifndef VK_GRAPHICS_BASIC_PRIM_COMMON_H
+#define VK_GRAPHICS_BASIC_PRIM_COMMON_H
+
+// shared by all compute primitives, every workgroup processes PRIM_TILE consecutive elements
+#define PRIM_WG_SIZE 256
+#define PRIM_ITEMS   4
+#define PRIM_TILE    (PRIM_WG_SIZE * PRIM_ITEMS)
+
+#ifndef __cplusplus
+
+layout(local_size_x = PRIM_WG_SIZE) in;
+
+layout(push_constant) uniform PrimParams
+{
+  uint n;
+  uint shift;     // radix sort: first bit of the current digit
+  uint numGroups; // radix sort: workgroups in the whole dispatch
+  uint flags;     // radix sort: 1 if values are sorted along with keys
+} params;
+
+shared uint s_scratch[PRIM_WG_SIZE];
+
+// workgroup-wide scan/reduce of one uint per invocation, all invocations must call them (contain barriers)
+// (shaders enable GL_KHR_shader_subgroup_arithmetic themselves, extensions must precede any code)
+#ifdef USE_SUBGROUPS
+
+// kept apart from s_scratch: with subgroups of one invocation all PRIM_WG_SIZE slots hold subgroup prefixes
+shared uint s_wgTotal;
+
+uint workgroupExclusiveScan(uint a_val, out uint a_total)
+{
+  const uint sgScan  = subgroupExclusiveAdd(a_val);
+  const uint sgTotal = subgroupAdd(a_val);
+  if(subgroupElect())
+    s_scratch[gl_SubgroupID] = sgTotal;
+  barrier();
+
+  // subgroup totals are few (PRIM_WG_SIZE / gl_SubgroupSize), scan them in the first subgroup if they fit
+  if(gl_NumSubgroups <= gl_SubgroupSize)
+  {
+    if(gl_SubgroupID == 0)
+    {
+      const uint total = gl_SubgroupInvocationID < gl_NumSubgroups ? s_scratch[gl_SubgroupInvocationID] : 0;
+      const uint scan  = subgroupExclusiveAdd(total);
+      if(gl_SubgroupInvocationID < gl_NumSubgroups)
+        s_scratch[gl_SubgroupInvocationID] = scan;
+      if(gl_SubgroupInvocationID == gl_NumSubgroups - 1)
+        s_wgTotal = scan + total;
+    }
+  }
+  else if(gl_LocalInvocationIndex == 0)
+  {
+    uint sum = 0;
+    for(uint i = 0; i < gl_NumSubgroups; ++i)
+    {
+      const uint total = s_scratch[i];
+      s_scratch[i] = sum;
+      sum += total;
+    }
+    s_wgTotal = sum;
+  }
+  barrier();
+
+  const uint res = s_scratch[gl_SubgroupID] + sgScan;
+  a_total = s_wgTotal;
+  barrier(); // s_scratch may be reused right after return
+  return res;
+}
+
+uint workgroupReduce(uint a_val)
+{
+  const uint sgSum = subgroupAdd(a_val);
+  if(subgroupElect())
+    s_scratch[gl_SubgroupID] = sgSum;
+  barrier();
+
+  uint res = 0;
+  for(uint i = 0; i < gl_NumSubgroups; ++i)
+    res += s_scratch[i];
+  barrier();
+  return res;
+}
+
+#else
+
+// Hillis-Steele scan in shared memory, used when subgroup arithmetic is not supported for compute
+uint workgroupExclusiveScan(uint a_val, out uint a_total)
+{
+  const uint tid = gl_LocalInvocationIndex;
+  s_scratch[tid] = a_val;
+  barrier();
+
+  for(uint offset = 1; offset < PRIM_WG_SIZE; offset <<= 1)
+  {
+    const uint other = tid >= offset ? s_scratch[tid - offset] : 0;
+    barrier();
+    s_scratch[tid] += other;
+    barrier();
+  }
+
+  const uint inclusive = s_scratch[tid];
+  a_total = s_scratch[PRIM_WG_SIZE - 1];
+  barrier();
+  return inclusive - a_val;
+}
+
+uint workgroupReduce(uint a_val)
+{
+  uint total;
+  workgroupExclusiveScan(a_val, total);
+  return total;
+}
+
+#endif
+
+#endif // __cplusplus
+
+#endif //VK_GRAPHICS_BASIC_PRIM_COMMON_H
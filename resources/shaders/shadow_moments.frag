@@ -0,0 +1,28 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#include "common.h"
+
+// SHADOW_FILTER_VSM or SHADOW_FILTER_EVSM, must match the format of MomentShadowMap
+layout(constant_id = SPEC_SHADOW_FILTER) const int SHADOW_FILTER = SHADOW_FILTER_VSM;
+
+layout(location = 0) out vec4 out_moments;
+
+void main()
+{
+  const float z = gl_FragCoord.z;
+  if(SHADOW_FILTER == SHADOW_FILTER_EVSM)
+  {
+    const float pos = exp( EVSM_EXPONENT_POS*(2.0f*z - 1.0f));
+    const float neg = -exp(-EVSM_EXPONENT_NEG*(2.0f*z - 1.0f));
+    out_moments = vec4(pos, pos*pos, neg, neg*neg);
+  }
+  else
+  {
+    // derivative term keeps variance of sloped surfaces above zero, see GPU Gems 3, chapter 8
+    const float dx = dFdx(z);
+    const float dy = dFdy(z);
+    out_moments = vec4(z, z*z + 0.25f*(dx*dx + dy*dy), 0.0f, 0.0f);
+  }
+}
@@ -3,6 +3,11 @@
 #extension GL_GOOGLE_include_directive : require
 
 #include "common.h"
+#include "cluster_grid.h"
+#include "point_light.h"
+
+layout(constant_id = SPEC_ANIMATE_LIGHT_COLOR) const bool ANIMATE_LIGHT_COLOR = true;
+layout(constant_id = SPEC_CLUSTERED_LIGHTS)    const bool CLUSTERED_LIGHTS    = false;
 
 layout(location = 0) out vec4 out_fragColor;
 
@@ -19,6 +24,39 @@ layout(binding = 0, set = 0) uniform AppData
     UniformParams Params;
 };
 
+layout(binding = 1, set = 0) uniform ClusterData
+{
+    ClusterParams clusters;
+};
+
+layout(binding = 2, set = 0) readonly buffer Lights
+{
+    PointLight lights[]; // view space
+};
+
+layout(binding = 3, set = 0) readonly buffer ClusterCounts
+{
+    uint clusterCounts[];
+};
+
+layout(binding = 4, set = 0) readonly buffer ClusterLights
+{
+    uint clusterLightIds[];
+};
+
+// lights assigned to the cluster of this fragment by cluster_assign.comp
+vec3 ClusteredLights(vec3 N)
+{
+    const vec3  vPos      = (clusters.view * vec4(surf.wPos, 1.0f)).xyz;
+    const vec3  vNorm     = normalize(mat3(clusters.view) * N);
+    const uint  clusterId = ClusterIndex(gl_FragCoord.xy, clusters.screenSize, -vPos.z, clusters.zNear, clusters.zFar);
+    const uint  count     = min(clusterCounts[clusterId], uint(MAX_LIGHTS_PER_CLUSTER));
+
+    vec3 radiance = vec3(0.0f);
+    for(uint i = 0; i < count; ++i)
+        radiance += PointLightDiffuse(lights[clusterLightIds[clusterId * MAX_LIGHTS_PER_CLUSTER + i]], vPos, vNorm);
+    return 1.0f - exp(-radiance * clusters.exposure);
+}
 
 void main()
 {
@@ -28,17 +66,18 @@ void main()
     const vec4 dark_violet = vec4(0.59f, 0.0f, 0.82f, 1.0f);
     const vec4 chartreuse  = vec4(0.5f, 1.0f, 0.0f, 1.0f);
 
-    vec4 lightColor1 = mix(dark_violet, chartreuse, 0.5f);
-    if(Params.animateLightColor)
-        lightColor1 = mix(dark_violet, chartreuse, abs(sin(Params.time)));
+    const vec4 lightColor1 = mix(dark_violet, chartreuse, ANIMATE_LIGHT_COLOR ? abs(sin(Params.time)) : 0.5f);
 
     vec4 lightColor2 = vec4(1.0f, 1.0f, 1.0f, 1.0f);
 
-    vec3 N = surf.wNorm; 
+    vec3 N = surf.wNorm;
 
     vec4 color1 = max(dot(N, lightDir1), 0.0f) * lightColor1;
     vec4 color2 = max(dot(N, lightDir2), 0.0f) * lightColor2;
     vec4 color_lights = mix(color1, color2, 0.2f);
 
+    if(CLUSTERED_LIGHTS)
+        color_lights.rgb += ClusteredLights(normalize(N));
+
     out_fragColor = color_lights * vec4(Params.baseColor, 1.0f);
-}
\ No newline at end of file
+}
@@ -4,6 +4,11 @@
 
 #include "common.h"
 
+layout(constant_id = SPEC_ANIMATE_LIGHT_COLOR) const bool ANIMATE_LIGHT_COLOR = true;
+layout(constant_id = SPEC_SHADOWS)             const bool SHADOWS             = true;
+layout(constant_id = SPEC_PCF_RADIUS)          const int  PCF_RADIUS          = 0;
+layout(constant_id = SPEC_SHADOW_FILTER)       const int  SHADOW_FILTER       = SHADOW_FILTER_HARD;
+
 layout(location = 0) out vec4 out_fragColor;
 
 layout (location = 0 ) in VS_OUT
@@ -19,21 +24,149 @@ layout(binding = 0, set = 0) uniform AppData
   UniformParams Params;
 };
 
-layout (binding = 1) uniform sampler2D shadowMap;
+layout (binding = 1) uniform sampler2D       shadowMap;    // raw depth, used by PCSS blocker search only
+layout (binding = 2) uniform sampler2DShadow shadowMapCmp; // depth compare in the sampler
+layout (binding = 3) uniform sampler2D       shadowMoments; // blurred and mipped moments for VSM and EVSM
 
-void main()
+const vec2 POISSON_DISK[16] = vec2[](
+  vec2(-0.94201624f, -0.39906216f), vec2( 0.94558609f, -0.76890725f), vec2(-0.09418410f, -0.92938870f), vec2( 0.34495938f,  0.29387760f),
+  vec2(-0.91588581f,  0.45771432f), vec2(-0.81544232f, -0.87912464f), vec2(-0.38277543f,  0.27676845f), vec2( 0.97484398f,  0.75648379f),
+  vec2( 0.44323325f, -0.97511554f), vec2( 0.53742981f, -0.47373420f), vec2(-0.26496911f, -0.41893023f), vec2( 0.79197514f,  0.19090188f),
+  vec2(-0.24188840f,  0.99706507f), vec2(-0.81409955f,  0.91437590f), vec2( 0.19984126f,  0.78641367f), vec2( 0.14383161f, -0.14100790f));
+
+float shadowCompare(vec2 uv, float depth)
+{
+  return textureLod(shadowMapCmp, vec3(uv, depth - Params.shadowBias), 0);
+}
+
+float interleavedGradientNoise(vec2 pixel)
+{
+  return fract(52.9829189f * fract(dot(pixel, vec2(0.06711056f, 0.00583715f))));
+}
+
+float filterPCFGrid(vec2 uv, float depth, vec2 texelSize)
+{
+  // loop bounds are constant after specialization, so the driver unrolls it
+  float lit = 0.0f;
+  for(int y = -PCF_RADIUS; y <= PCF_RADIUS; ++y)
+  {
+    for(int x = -PCF_RADIUS; x <= PCF_RADIUS; ++x)
+      lit += shadowCompare(uv + vec2(x, y)*texelSize, depth);
+  }
+  return lit / float((2*PCF_RADIUS + 1)*(2*PCF_RADIUS + 1));
+}
+
+float filterPoisson(vec2 uv, float depth, vec2 radius)
+{
+  // per pixel rotation turns banding into noise
+  const float angle = 6.2831853f * interleavedGradientNoise(gl_FragCoord.xy);
+  const mat2  rot   = mat2(cos(angle), sin(angle), -sin(angle), cos(angle));
+
+  float lit = 0.0f;
+  for(int i = 0; i < 16; ++i)
+    lit += shadowCompare(uv + (rot*POISSON_DISK[i])*radius, depth);
+  return lit / 16.0f;
+}
+
+float filterRotatedGrid(vec2 uv, float depth, vec2 radius)
+{
+  const mat2 rot = mat2(0.89442719f, 0.44721360f, -0.44721360f, 0.89442719f); // atan(1/2)
+
+  float lit = 0.0f;
+  for(int y = 0; y < 4; ++y)
+  {
+    for(int x = 0; x < 4; ++x)
+      lit += shadowCompare(uv + (rot*((vec2(x, y) - 1.5f)/1.5f))*radius, depth);
+  }
+  return lit / 16.0f;
+}
+
+// depths are compared as they are stored, which is exact for orthographic light projection
+// and an approximation of the similar triangles estimate for perspective one
+float filterPCSS(vec2 uv, float depth, vec2 texelSize)
+{
+  const vec2 searchRadius = vec2(Params.lightSize);
+
+  float blockerSum = 0.0f;
+  float blockers   = 0.0f;
+  for(int i = 0; i < 16; ++i)
+  {
+    const float d = textureLod(shadowMap, uv + POISSON_DISK[i]*searchRadius, 0).x;
+    if(d < depth - Params.shadowBias)
+    {
+      blockerSum += d;
+      blockers   += 1.0f;
+    }
+  }
+  if(blockers == 0.0f)
+    return 1.0f;
+
+  const float blockerDepth = blockerSum / blockers;
+  const float penumbra     = Params.lightSize * (depth - blockerDepth) / max(blockerDepth, 1e-4f);
+  return filterPoisson(uv, depth, max(vec2(penumbra), texelSize));
+}
+
+// upper bound of the fraction of lit occluders from mean and variance
+float chebyshev(vec2 moments, float depth, float minVariance)
+{
+  if(depth <= moments.x)
+    return 1.0f;
+
+  const float variance = max(moments.y - moments.x*moments.x, minVariance);
+  const float d        = depth - moments.x;
+  const float pMax     = variance / (variance + d*d);
+  return clamp((pMax - Params.lightBleedReduction) / (1.0f - Params.lightBleedReduction), 0.0f, 1.0f);
+}
+
+float filterMoments(vec2 uv, vec2 uvDx, vec2 uvDy, float depth)
+{
+  // trilinear filtering of moments is what makes them soft, gradients are taken in uniform control flow by the caller
+  const vec4 moments = textureGrad(shadowMoments, uv, uvDx, uvDy);
+  if(SHADOW_FILTER == SHADOW_FILTER_VSM)
+    return chebyshev(moments.xy, depth - Params.shadowBias, 1e-6f);
+
+  const float w   = 2.0f*(depth - Params.shadowBias) - 1.0f;
+  const float pos = exp( EVSM_EXPONENT_POS*w);
+  const float neg = -exp(-EVSM_EXPONENT_NEG*w);
+  const float posBound = chebyshev(moments.xy, pos, 1e-4f*EVSM_EXPONENT_POS*EVSM_EXPONENT_POS*pos*pos);
+  const float negBound = chebyshev(moments.zw, neg, 1e-4f*EVSM_EXPONENT_NEG*EVSM_EXPONENT_NEG*neg*neg);
+  return min(posBound, negBound);
+}
+
+float shadowFactor()
 {
   const vec4 posLightClipSpace = Params.lightMatrix*vec4(surf.wPos, 1.0f); // 
   const vec3 posLightSpaceNDC  = posLightClipSpace.xyz/posLightClipSpace.w;    // for orto matrix, we don't need perspective division, you can remove it if you want; this is general case;
   const vec2 shadowTexCoord    = posLightSpaceNDC.xy*0.5f + vec2(0.5f, 0.5f);  // just shift coords from [-1,1] to [0,1]               
+  const vec2 shadowTexCoordDx  = dFdx(shadowTexCoord);
+  const vec2 shadowTexCoordDy  = dFdy(shadowTexCoord);
     
-  const bool  outOfView = (shadowTexCoord.x < 0.0001f || shadowTexCoord.x > 0.9999f || shadowTexCoord.y < 0.0091f || shadowTexCoord.y > 0.9999f);
-  const float shadow    = ((posLightSpaceNDC.z < textureLod(shadowMap, shadowTexCoord, 0).x + 0.001f) || outOfView) ? 1.0f : 0.0f;
+  const bool outOfView = (shadowTexCoord.x < 0.0001f || shadowTexCoord.x > 0.9999f || shadowTexCoord.y < 0.0091f || shadowTexCoord.y > 0.9999f);
+  if(outOfView)
+    return 1.0f;
+
+  const vec2 texelSize = 1.0f / vec2(textureSize(shadowMapCmp, 0));
+  const vec2 radius    = Params.shadowFilterRadius*texelSize;
+  switch(SHADOW_FILTER) // constant after specialization, only one case is left in the pipeline
+  {
+    case SHADOW_FILTER_PCF_GRID:     return filterPCFGrid(shadowTexCoord, posLightSpaceNDC.z, texelSize);
+    case SHADOW_FILTER_POISSON:      return filterPoisson(shadowTexCoord, posLightSpaceNDC.z, radius);
+    case SHADOW_FILTER_ROTATED_GRID: return filterRotatedGrid(shadowTexCoord, posLightSpaceNDC.z, radius);
+    case SHADOW_FILTER_PCSS:         return filterPCSS(shadowTexCoord, posLightSpaceNDC.z, texelSize);
+    case SHADOW_FILTER_VSM:
+    case SHADOW_FILTER_EVSM:         return filterMoments(shadowTexCoord, shadowTexCoordDx, shadowTexCoordDy, posLightSpaceNDC.z);
+    default:                         return shadowCompare(shadowTexCoord, posLightSpaceNDC.z);
+  }
+}
+
+void main()
+{
+  const float shadow = SHADOWS ? shadowFactor() : 1.0f;
 
   const vec4 dark_violet = vec4(0.59f, 0.0f, 0.82f, 1.0f);
   const vec4 chartreuse  = vec4(0.5f, 1.0f, 0.0f, 1.0f);
 
-  vec4 lightColor1 = mix(dark_violet, chartreuse, abs(sin(Params.time)));
+  vec4 lightColor1 = mix(dark_violet, chartreuse, ANIMATE_LIGHT_COLOR ? abs(sin(Params.time)) : 0.5f);
   vec4 lightColor2 = vec4(1.0f, 1.0f, 1.0f, 1.0f);
    
   vec3 lightDir   = normalize(Params.lightPos - surf.wPos);
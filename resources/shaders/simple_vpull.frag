@@ -0,0 +1,60 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#include "common.h"
+
+layout(constant_id = SPEC_ANIMATE_LIGHT_COLOR) const bool ANIMATE_LIGHT_COLOR = true;
+layout(constant_id = SPEC_TEXTURING)           const bool TEXTURING           = true;
+
+layout(location = 0) out vec4 out_fragColor;
+
+layout (location = 0 ) in VS_OUT
+{
+    vec3 wPos;
+    vec3 wNorm;
+    vec3 wTangent;
+    vec2 texCoord;
+} surf;
+
+layout (location = 4) flat in uint materialId;
+
+layout(binding = 0, set = 0) uniform AppData
+{
+    UniformParams Params;
+};
+
+layout(std430, binding = 0, set = 1) readonly buffer Materials
+{
+    MaterialData materials[];
+};
+
+layout(binding = 2, set = 1) uniform sampler2D sceneTextures[MAX_SCENE_TEXTURES];
+
+
+void main()
+{
+    const MaterialData mat = materials[materialId];
+
+    vec4 albedo = mat.baseColor;
+    if(TEXTURING && mat.diffuseTexId != NO_TEXTURE)
+        albedo *= texture(sceneTextures[mat.diffuseTexId], surf.texCoord);
+
+    vec3 lightDir1 = normalize(Params.lightPos - surf.wPos);
+    vec3 lightDir2 = vec3(0.0f, 0.0f, 1.0f);
+
+    const vec4 dark_violet = vec4(0.59f, 0.0f, 0.82f, 1.0f);
+    const vec4 chartreuse  = vec4(0.5f, 1.0f, 0.0f, 1.0f);
+
+    const vec4 lightColor1 = mix(dark_violet, chartreuse, ANIMATE_LIGHT_COLOR ? abs(sin(Params.time)) : 0.5f);
+
+    vec4 lightColor2 = vec4(1.0f, 1.0f, 1.0f, 1.0f);
+
+    vec3 N = surf.wNorm;
+
+    vec4 color1 = max(dot(N, lightDir1), 0.0f) * lightColor1;
+    vec4 color2 = max(dot(N, lightDir2), 0.0f) * lightColor2;
+    vec4 color_lights = mix(color1, color2, 0.2f);
+
+    out_fragColor = color_lights * albedo;
+}
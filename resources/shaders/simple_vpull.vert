@@ -0,0 +1,70 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#include "unpack_attributes.h"
+
+// same layout as Mesh8F vertex: position + packed normal, texcoord + packed tangent
+struct Vertex
+{
+    vec4 posNorm;
+    vec4 texCoordAndTang;
+};
+
+layout(std430, binding = 1, set = 0) readonly buffer VertexBuffer
+{
+    Vertex vertices[];
+};
+
+layout(std430, binding = 2, set = 0) readonly buffer InstanceMatrices
+{
+    mat4 instanceMatrices[];
+};
+
+layout(std430, binding = 3, set = 0) readonly buffer InstanceIds
+{
+    uint instanceIds[];
+};
+
+layout(std430, binding = 1, set = 1) readonly buffer InstanceMaterials
+{
+    uint instanceMaterialIds[];
+};
+
+layout(push_constant) uniform params_t
+{
+    mat4 mProjView;
+} params;
+
+
+layout (location = 0 ) out VS_OUT
+{
+    vec3 wPos;
+    vec3 wNorm;
+    vec3 wTangent;
+    vec2 texCoord;
+
+} vOut;
+
+layout (location = 4) flat out uint materialId;
+
+out gl_PerVertex { vec4 gl_Position; };
+void main(void)
+{
+    // gl_VertexIndex already includes vertexOffset of the draw,
+    // gl_InstanceIndex includes firstInstance, which points to the instances of current mesh
+    const Vertex v      = vertices[gl_VertexIndex];
+    const uint   instId = instanceIds[gl_InstanceIndex];
+    const mat4   mModel = instanceMatrices[instId];
+
+    const vec4 wNorm = vec4(DecodeNormal(floatBitsToInt(v.posNorm.w)),         0.0f);
+    const vec4 wTang = vec4(DecodeNormal(floatBitsToInt(v.texCoordAndTang.z)), 0.0f);
+
+    vOut.wPos     = (mModel * vec4(v.posNorm.xyz, 1.0f)).xyz;
+    vOut.wNorm    = normalize(mat3(transpose(inverse(mModel))) * wNorm.xyz);
+    vOut.wTangent = normalize(mat3(transpose(inverse(mModel))) * wTang.xyz);
+    vOut.texCoord = v.texCoordAndTang.xy;
+    materialId    = instanceMaterialIds[instId];
+
+    gl_Position   = params.mProjView * vec4(vOut.wPos, 1.0);
+}
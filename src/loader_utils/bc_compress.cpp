@@ -0,0 +1,308 @@
+#include "bc_compress.h"
+#include "images.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+namespace
+{
+  constexpr uint32_t BC_CACHE_MAGIC   = 0x58544342; // "BCTX"
+  constexpr uint32_t BC_CACHE_VERSION = 1;
+
+  struct BCCacheHeader
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;
+    uint64_t dataSize;
+  };
+
+  inline uint16_t packRGB565(const float c[3])
+  {
+    const int r = std::clamp(int(c[0] * 31.0f / 255.0f + 0.5f), 0, 31);
+    const int g = std::clamp(int(c[1] * 63.0f / 255.0f + 0.5f), 0, 63);
+    const int b = std::clamp(int(c[2] * 31.0f / 255.0f + 0.5f), 0, 31);
+    return uint16_t((r << 11) | (g << 5) | b);
+  }
+
+  inline void unpackRGB565(uint16_t a_color, int c[3])
+  {
+    const int r = (a_color >> 11) & 31;
+    const int g = (a_color >> 5)  & 63;
+    const int b = a_color & 31;
+    c[0] = (r << 3) | (r >> 2);
+    c[1] = (g << 2) | (g >> 4);
+    c[2] = (b << 3) | (b >> 2);
+  }
+
+  // gathers 4x4 block, pixels outside of the image are clamped to the border
+  void fetchBlock(const unsigned char* a_pixels, int w, int h, int bx, int by, unsigned char a_block[16 * 4])
+  {
+    for(int y = 0; y < 4; ++y)
+    {
+      const int sy = std::min(by * 4 + y, h - 1);
+      for(int x = 0; x < 4; ++x)
+      {
+        const int sx = std::min(bx * 4 + x, w - 1);
+        memcpy(a_block + (y * 4 + x) * 4, a_pixels + (size_t(sy) * w + sx) * 4, 4);
+      }
+    }
+  }
+
+  // endpoints are the extreme projections on the principal axis of the block colors
+  void encodeColorBlock(const unsigned char a_block[16 * 4], unsigned char* a_out)
+  {
+    float mean[3] = {0.0f, 0.0f, 0.0f};
+    for(int i = 0; i < 16; ++i)
+      for(int c = 0; c < 3; ++c)
+        mean[c] += a_block[i * 4 + c];
+    for(int c = 0; c < 3; ++c)
+      mean[c] /= 16.0f;
+
+    float cov[6] = {0, 0, 0, 0, 0, 0}; // rr rg rb gg gb bb
+    for(int i = 0; i < 16; ++i)
+    {
+      const float r = a_block[i * 4 + 0] - mean[0];
+      const float g = a_block[i * 4 + 1] - mean[1];
+      const float b = a_block[i * 4 + 2] - mean[2];
+      cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+      cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+    }
+
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for(int iter = 0; iter < 4; ++iter)
+    {
+      const float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+      const float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+      const float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+      const float len = std::max(std::max(std::fabs(x), std::fabs(y)), std::fabs(z));
+      if(len < 1e-6f)
+        break;
+      axis[0] = x / len; axis[1] = y / len; axis[2] = z / len;
+    }
+
+    float minProj = 1e30f, maxProj = -1e30f;
+    int   minIdx  = 0,     maxIdx  = 0;
+    for(int i = 0; i < 16; ++i)
+    {
+      const float proj = (a_block[i * 4 + 0] - mean[0]) * axis[0] + (a_block[i * 4 + 1] - mean[1]) * axis[1] +
+                         (a_block[i * 4 + 2] - mean[2]) * axis[2];
+      if(proj < minProj) { minProj = proj; minIdx = i; }
+      if(proj > maxProj) { maxProj = proj; maxIdx = i; }
+    }
+
+    const float maxColor[3] = {float(a_block[maxIdx * 4 + 0]), float(a_block[maxIdx * 4 + 1]), float(a_block[maxIdx * 4 + 2])};
+    const float minColor[3] = {float(a_block[minIdx * 4 + 0]), float(a_block[minIdx * 4 + 1]), float(a_block[minIdx * 4 + 2])};
+
+    uint16_t c0 = packRGB565(maxColor);
+    uint16_t c1 = packRGB565(minColor);
+    if(c0 < c1)
+      std::swap(c0, c1); // c0 > c1 selects 4 color mode in BC1
+
+    int palette[4][3];
+    unpackRGB565(c0, palette[0]);
+    unpackRGB565(c1, palette[1]);
+    for(int c = 0; c < 3; ++c)
+    {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    uint32_t indices = 0;
+    if(c0 != c1)
+    {
+      for(int i = 0; i < 16; ++i)
+      {
+        int bestIdx = 0, bestDist = INT32_MAX;
+        for(int p = 0; p < 4; ++p)
+        {
+          const int dr = a_block[i * 4 + 0] - palette[p][0];
+          const int dg = a_block[i * 4 + 1] - palette[p][1];
+          const int db = a_block[i * 4 + 2] - palette[p][2];
+          const int dist = dr * dr + dg * dg + db * db;
+          if(dist < bestDist) { bestDist = dist; bestIdx = p; }
+        }
+        indices |= uint32_t(bestIdx) << (2 * i);
+      }
+    }
+
+    memcpy(a_out + 0, &c0, 2);
+    memcpy(a_out + 2, &c1, 2);
+    memcpy(a_out + 4, &indices, 4);
+  }
+
+  // a0 > a1 selects 8 alpha values mode
+  void encodeAlphaBlock(const unsigned char a_block[16 * 4], unsigned char* a_out)
+  {
+    int a0 = 0, a1 = 255;
+    for(int i = 0; i < 16; ++i)
+    {
+      a0 = std::max(a0, int(a_block[i * 4 + 3]));
+      a1 = std::min(a1, int(a_block[i * 4 + 3]));
+    }
+
+    uint64_t indices = 0;
+    if(a0 != a1)
+    {
+      int palette[8];
+      palette[0] = a0;
+      palette[1] = a1;
+      for(int p = 1; p < 7; ++p)
+        palette[p + 1] = ((7 - p) * a0 + p * a1) / 7;
+
+      for(int i = 0; i < 16; ++i)
+      {
+        int bestIdx = 0, bestDist = INT32_MAX;
+        for(int p = 0; p < 8; ++p)
+        {
+          const int dist = std::abs(int(a_block[i * 4 + 3]) - palette[p]);
+          if(dist < bestDist) { bestDist = dist; bestIdx = p; }
+        }
+        indices |= uint64_t(bestIdx) << (3 * i);
+      }
+    }
+
+    a_out[0] = (unsigned char)a0;
+    a_out[1] = (unsigned char)a1;
+    for(int i = 0; i < 6; ++i)
+      a_out[2 + i] = (unsigned char)((indices >> (8 * i)) & 0xFF);
+  }
+}
+
+std::vector<unsigned char> compressBC(const unsigned char* a_pixels, int w, int h, BCFormat a_format, uint32_t a_numThreads)
+{
+  const int blocksX = (w + 3) / 4;
+  const int blocksY = (h + 3) / 4;
+  const uint32_t blockBytes = bcBlockBytes(a_format);
+
+  std::vector<unsigned char> res(size_t(blocksX) * blocksY * blockBytes);
+
+  auto compressRows = [&](int a_rowBegin, int a_rowEnd)
+  {
+    unsigned char block[16 * 4];
+    for(int by = a_rowBegin; by < a_rowEnd; ++by)
+    {
+      for(int bx = 0; bx < blocksX; ++bx)
+      {
+        fetchBlock(a_pixels, w, h, bx, by, block);
+        unsigned char* out = res.data() + (size_t(by) * blocksX + bx) * blockBytes;
+        if(a_format == BCFormat::BC3)
+        {
+          encodeAlphaBlock(block, out);
+          encodeColorBlock(block, out + 8);
+        }
+        else
+          encodeColorBlock(block, out);
+      }
+    }
+  };
+
+  if(a_numThreads == 0)
+    a_numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+  a_numThreads = std::min(a_numThreads, uint32_t(blocksY));
+
+  if(a_numThreads <= 1)
+  {
+    compressRows(0, blocksY);
+    return res;
+  }
+
+  std::vector<std::thread> threads;
+  threads.reserve(a_numThreads);
+  const int rowsPerThread = (blocksY + int(a_numThreads) - 1) / int(a_numThreads);
+  for(uint32_t t = 0; t < a_numThreads; ++t)
+  {
+    const int rowBegin = int(t) * rowsPerThread;
+    const int rowEnd   = std::min(rowBegin + rowsPerThread, blocksY);
+    if(rowBegin < rowEnd)
+      threads.emplace_back(compressRows, rowBegin, rowEnd);
+  }
+  for(auto& thread : threads)
+    thread.join();
+
+  return res;
+}
+
+CompressedImage compressMipChainBC(const unsigned char* a_mipChain, int w, int h, uint32_t a_mipLevels, BCFormat a_format)
+{
+  CompressedImage res;
+  res.format    = a_format;
+  res.width     = uint32_t(w);
+  res.height    = uint32_t(h);
+  res.mipLevels = a_mipLevels;
+
+  size_t srcOffset = 0;
+  for(uint32_t level = 0; level < a_mipLevels; ++level)
+  {
+    const int levelW = std::max(w >> level, 1);
+    const int levelH = std::max(h >> level, 1);
+
+    auto levelData = compressBC(a_mipChain + srcOffset, levelW, levelH, a_format);
+    res.data.insert(res.data.end(), levelData.begin(), levelData.end());
+    srcOffset += size_t(levelW) * levelH * 4;
+  }
+
+  return res;
+}
+
+bool loadOrCompressBC(const std::string &a_srcPath, BCFormat a_format, CompressedImage &a_result)
+{
+  namespace fs = std::filesystem;
+  const std::string cachePath = a_srcPath + (a_format == BCFormat::BC1 ? ".bc1" : ".bc3");
+
+  std::error_code ec;
+  const bool haveSource = fs::exists(a_srcPath, ec);
+  const bool haveCache  = fs::exists(cachePath, ec);
+  const bool cacheIsUpToDate = haveCache && (!haveSource || fs::last_write_time(cachePath, ec) >= fs::last_write_time(a_srcPath, ec));
+
+  if(cacheIsUpToDate)
+  {
+    std::ifstream fin(cachePath, std::ios::binary);
+    BCCacheHeader header = {};
+    fin.read((char*)&header, sizeof(header));
+    if(fin && header.magic == BC_CACHE_MAGIC && header.version == BC_CACHE_VERSION && header.format == uint32_t(a_format))
+    {
+      a_result.format    = a_format;
+      a_result.width     = header.width;
+      a_result.height    = header.height;
+      a_result.mipLevels = header.mipLevels;
+      a_result.data.resize(header.dataSize);
+      fin.read((char*)a_result.data.data(), std::streamsize(header.dataSize));
+      if(fin)
+        return true;
+    }
+    std::cout << "bc_compress: ignoring broken cache file " << cachePath << std::endl;
+  }
+
+  int w, h, channels;
+  auto pixels = loadImageLDR(a_srcPath.c_str(), w, h, channels);
+  if(pixels == nullptr)
+    return false;
+
+  const uint32_t mipLevels = getMipLevelsCount(w, h);
+  auto mipChain = buildMipChainLDR(pixels, w, h, mipLevels);
+  freeImageMemLDR(pixels);
+
+  a_result = compressMipChainBC(mipChain.data(), w, h, mipLevels, a_format);
+
+  std::ofstream fout(cachePath, std::ios::binary);
+  if(fout)
+  {
+    BCCacheHeader header = {BC_CACHE_MAGIC, BC_CACHE_VERSION, uint32_t(a_format), a_result.width, a_result.height,
+                            a_result.mipLevels, uint64_t(a_result.data.size())};
+    fout.write((const char*)&header, sizeof(header));
+    fout.write((const char*)a_result.data.data(), std::streamsize(a_result.data.size()));
+  }
+  else
+    std::cout << "bc_compress: can't write cache file " << cachePath << std::endl;
+
+  return true;
+}
@@ -0,0 +1,46 @@
+#ifndef VK_GRAPHICS_BASIC_BC_COMPRESS_H
+#define VK_GRAPHICS_BASIC_BC_COMPRESS_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+enum class BCFormat : uint32_t
+{
+  BC1 = 1, ///!< 8 bytes per 4x4 block, RGB
+  BC3 = 3, ///!< 16 bytes per 4x4 block, RGB + interpolated alpha
+};
+
+inline uint32_t bcBlockBytes(BCFormat a_format) { return a_format == BCFormat::BC1 ? 8u : 16u; }
+
+/**
+\brief block compressed image with all mip levels packed one after another
+*/
+struct CompressedImage
+{
+  BCFormat format    = BCFormat::BC1;
+  uint32_t width     = 0;
+  uint32_t height    = 0;
+  uint32_t mipLevels = 0;
+  std::vector<unsigned char> data;
+};
+
+/**
+\brief compress RGBA8 image to BC1 or BC3, rows of blocks are distributed between a_numThreads threads
+\param a_numThreads - 0 means std::thread::hardware_concurrency()
+*/
+std::vector<unsigned char> compressBC(const unsigned char* a_pixels, int w, int h, BCFormat a_format, uint32_t a_numThreads = 0);
+
+/**
+\brief compress every level of a mip chain laid out as buildMipChainLDR() returns it
+*/
+CompressedImage compressMipChainBC(const unsigned char* a_mipChain, int w, int h, uint32_t a_mipLevels, BCFormat a_format);
+
+/**
+\brief load compressed image from cache file next to a_srcPath (a_srcPath + ".bc1"/".bc3"),
+       source image is decoded and compressed when cache is missing or older than the source
+\return false if neither cache nor source can be read
+*/
+bool loadOrCompressBC(const std::string &a_srcPath, BCFormat a_format, CompressedImage &a_result);
+
+#endif// VK_GRAPHICS_BASIC_BC_COMPRESS_H
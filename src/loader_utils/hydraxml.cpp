@@ -132,13 +132,44 @@ namespace hydra_xml
   }
 #endif
 
+  int HydraScene::LoadChange(const std::string &path)
+  {
+    auto loaded = m_xmlDoc.load_file(path.c_str());
+
+    if(!loaded)
+    {
+      std::string  str(loaded.description());
+      std::wstring errorMsg(str.begin(), str.end());
+
+      LogError("Error loading change from: " + path);
+      LogError(ws2s(errorMsg));
+
+      return -1;
+    }
+
+    auto pos = path.find_last_of(L'/');
+    m_libraryRootDir = path.substr(0, pos);
+
+    m_texturesLib  = m_xmlDoc.child(L"textures_lib");
+    m_materialsLib = m_xmlDoc.child(L"materials_lib");
+    m_geometryLib  = m_xmlDoc.child(L"geometry_lib");
+    m_lightsLib    = m_xmlDoc.child(L"lights_lib");
+
+    m_cameraLib    = m_xmlDoc.child(L"cam_lib");
+    m_settingsNode = m_xmlDoc.child(L"render_lib");
+    m_sceneNode    = m_xmlDoc.child(L"scenes");
+
+    return 0;
+  }
+
   void HydraScene::parseInstancedMeshes(pugi::xml_node a_scenelib, pugi::xml_node a_geomlib)
   {
     auto scene = a_scenelib.first_child();
     for (pugi::xml_node inst = scene.first_child(); inst != nullptr; inst = inst.next_sibling())
     {
-      if (std::wstring(inst.name()) == L"instance_light")
-        break;
+      // meshes of area lights are not drawn, ApplyChangeXML in scene_mgr.cpp skips the same instances
+      if (std::wstring(inst.name()) != L"instance" || inst.attribute(L"light_id") != nullptr)
+        continue;
 
       auto mesh_id = inst.attribute(L"mesh_id").as_string();
       auto matrix = std::wstring(inst.attribute(L"matrix").as_string());
@@ -179,6 +210,7 @@ namespace hydra_xml
           std::vector<LiteMath::float4x4> tmp = { float4x4FromString(matrix) };
           m_instancesPerMeshLoc[meshLoc] = tmp;
         }
+        m_instanceIdsPerMeshLoc[meshLoc].push_back(inst.attribute(L"id").as_uint());
       }
     }
 
@@ -265,10 +297,59 @@ namespace hydra_xml
       inst.instId    = instNode.attribute(L"id").as_uint();
       inst.lightId   = instNode.attribute(L"light_id").as_uint(); 
       inst.lightNode = lights[inst.lightId];
+      inst.matrix    = float4x4FromString(instNode.attribute(L"matrix").as_string());
       result.push_back(inst);
     }
     return result;
   }
 
-}
+  std::vector<TextureInfo> HydraScene::TexturesLDR()
+  {
+    std::vector<TextureInfo> result;
+    for(auto texNode : m_texturesLib.children(L"texture"))
+    {
+      auto loc = ws2s(std::wstring(texNode.attribute(L"loc").as_string()));
+      const std::string ext = ".image4ub";
+      if(loc.size() < ext.size() || loc.compare(loc.size() - ext.size(), ext.size(), ext) != 0)
+        continue;
 
+      TextureInfo info;
+      info.id       = texNode.attribute(L"id").as_uint();
+      info.path     = m_libraryRootDir + "/" + loc;
+      info.offset   = texNode.attribute(L"offset").as_ullong();
+      info.bytesize = texNode.attribute(L"bytesize").as_ullong();
+      info.width    = texNode.attribute(L"width").as_uint();
+      info.height   = texNode.attribute(L"height").as_uint();
+
+      if(info.bytesize < uint64_t(info.width) * info.height * 4)
+      {
+        LogError("texture " + std::to_string(info.id) + " (" + loc + ") is smaller than width*height*4, skipped");
+        continue;
+      }
+      result.push_back(info);
+    }
+    return result;
+  }
+
+  std::vector<MaterialInfo> HydraScene::Materials()
+  {
+    std::vector<MaterialInfo> result;
+    for(auto matNode : m_materialsLib.children(L"material"))
+    {
+      MaterialInfo info;
+      info.id = matNode.attribute(L"id").as_uint();
+
+      auto colorNode = matNode.child(L"diffuse").child(L"color");
+      if(colorNode != nullptr)
+      {
+        info.diffuseColor = readval3f(colorNode);
+        auto texNode = colorNode.child(L"texture");
+        if(texNode != nullptr)
+          info.diffuseTexId = texNode.attribute(L"id").as_uint();
+      }
+      result.push_back(info);
+    }
+    return result;
+  }
+
+}
@@ -31,9 +31,11 @@ namespace hydra_xml
   
   struct Instance
   {
-    uint32_t           geomId = uint32_t(-1); ///< geom id
-    uint32_t           rmapId = uint32_t(-1); ///< remap list id, todo: add function to get real remap list by id
-    LiteMath::float4x4 matrix;                ///< transform matrix
+    uint32_t           id      = uint32_t(-1); ///< instance id, the same instance has the same id in change files
+    uint32_t           geomId  = uint32_t(-1); ///< geom id
+    uint32_t           rmapId  = uint32_t(-1); ///< remap list id, todo: add function to get real remap list by id
+    uint32_t           lightId = uint32_t(-1); ///< only for meshes of area lights
+    LiteMath::float4x4 matrix;                 ///< transform matrix
   };
 
   struct LightInstance
@@ -45,8 +47,26 @@ namespace hydra_xml
     LiteMath::float4x4 matrix;
   };
 
+  struct TextureInfo
+  {
+    uint32_t    id       = uint32_t(-1);
+    std::string path;                     ///< chunk file, m_libraryRootDir + "/" + loc
+    uint64_t    offset   = 0;             ///< first byte of RGBA8 pixels inside the chunk file
+    uint64_t    bytesize = 0;
+    uint32_t    width    = 0;
+    uint32_t    height   = 0;
+  };
+
+  struct MaterialInfo
+  {
+    uint32_t         id           = uint32_t(-1);
+    LiteMath::float3 diffuseColor = LiteMath::float3(0.5f, 0.5f, 0.5f);
+    uint32_t         diffuseTexId = uint32_t(-1); ///< id in textures_lib or -1 if diffuse is not textured
+  };
+
   struct Camera
   {
+    uint32_t id;
     float pos[3];
     float lookAt[3];
     float up[3];
@@ -109,8 +129,10 @@ namespace hydra_xml
     Instance operator*() const 
     { 
       Instance inst;
-      inst.geomId = m_iter->attribute(L"mesh_id").as_uint();
-      inst.rmapId = m_iter->attribute(L"rmap_id").as_uint();
+      inst.id      = m_iter->attribute(L"id").as_uint();
+      inst.geomId  = m_iter->attribute(L"mesh_id").as_uint();
+      inst.rmapId  = m_iter->attribute(L"rmap_id").as_uint();
+      inst.lightId = m_iter->attribute(L"light_id").as_uint(uint32_t(-1));
       inst.matrix = float4x4FromString(m_iter->attribute(L"matrix").as_string());
       return inst;
     }
@@ -144,6 +166,7 @@ namespace hydra_xml
     Camera operator*() const 
     { 
       Camera cam = {};
+      cam.id        = m_iter->attribute(L"id").as_uint();
       cam.fov       = m_iter->child(L"fov").text().as_float(); 
       cam.nearPlane = m_iter->child(L"nearClipPlane").text().as_float();
       cam.farPlane  = m_iter->child(L"farClipPlane").text().as_float();  
@@ -187,6 +210,20 @@ namespace hydra_xml
     int LoadState(const std::string &path);
     #endif  
 
+    /**
+    \brief load change_*.xml, a delta between two states: only changed objects are listed and any library may be missing,
+           so nothing is grouped by mesh location here, use GeomNodes(), InstancesGeom() and Cameras() directly
+    */
+    int LoadChange(const std::string &path);
+
+    /// the scene node lists all its instances (discard="1"), instances not listed in a change are removed
+    bool DiscardsInstances() const { return m_sceneNode.child(L"scene").attribute(L"discard").as_int() == 1; }
+
+    std::string MeshLoc(pugi::xml_node a_meshNode) const
+    {
+      return m_libraryRootDir + "/" + ws2s(std::wstring(a_meshNode.attribute(L"loc").as_string()));
+    }
+
     //// use this functions with C++11 range for 
     //
     pugi::xml_object_range<pugi::xml_node_iterator> TextureNodes()  { return m_texturesLib.children();  } 
@@ -208,6 +245,12 @@ namespace hydra_xml
     
     std::vector<LightInstance> InstancesLights(uint32_t a_sceneId = 0);
 
+    /**
+    \brief raw 8 bit RGBA textures (image4ub chunks), procedural and other textures are skipped
+    */
+    std::vector<TextureInfo>  TexturesLDR();
+    std::vector<MaterialInfo> Materials();
+
     pugi::xml_object_range<CamIterator> Cameras() { return {CamIterator(m_cameraLib.begin()),
                                                             CamIterator(m_cameraLib.end())}; }
 
@@ -219,6 +262,16 @@ namespace hydra_xml
       else
         return pFound->second; 
     }
+
+    /// ids of instances returned by GetAllInstancesOfMeshLoc, in the same order
+    std::vector<uint32_t> GetAllInstanceIdsOfMeshLoc(const std::string& a_loc) const
+    {
+      auto pFound = m_instanceIdsPerMeshLoc.find(a_loc);
+      if(pFound == m_instanceIdsPerMeshLoc.end())
+        return {};
+      else
+        return pFound->second;
+    }
     
   private:
     void parseInstancedMeshes(pugi::xml_node a_scenelib, pugi::xml_node a_geomlib);
@@ -236,6 +289,7 @@ namespace hydra_xml
     pugi::xml_document m_xmlDoc;
 
     std::unordered_map<std::string, std::vector<LiteMath::float4x4> > m_instancesPerMeshLoc;
+    std::unordered_map<std::string, std::vector<uint32_t> > m_instanceIdsPerMeshLoc;
   };
 
   
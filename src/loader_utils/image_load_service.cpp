@@ -0,0 +1,144 @@
+#include "image_load_service.h"
+#include "images.h"
+#include "../utils/cpu_profiler.h"
+
+#include <algorithm>
+
+ImageLoadService::ImageLoadService(uint32_t a_numThreads)
+{
+  if(a_numThreads == 0)
+    a_numThreads = std::max(std::thread::hardware_concurrency(), 2u) - 1; // leave one core to the render thread
+
+  m_workers.reserve(a_numThreads);
+  for(uint32_t i = 0; i < a_numThreads; ++i)
+    m_workers.emplace_back(&ImageLoadService::WorkerLoop, this);
+}
+
+ImageLoadService::~ImageLoadService()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+    m_jobs.clear();
+  }
+  m_jobsCV.notify_all();
+
+  for(auto& worker : m_workers)
+    worker.join();
+
+  for(auto& done : m_done)
+  {
+    if(done.ownsPixels)
+      freeImageMemLDR((unsigned char*)done.result.pixels);
+  }
+}
+
+uint32_t ImageLoadService::Request(const std::string &a_path, CompletionFn a_onDone, bool a_buildMips)
+{
+  uint32_t requestId;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    requestId = m_nextReqId++;
+    m_jobs.push_back({requestId, a_path, std::move(a_onDone), a_buildMips});
+    m_inFlight++;
+  }
+  m_jobsCV.notify_one();
+
+  return requestId;
+}
+
+void ImageLoadService::WorkerLoop()
+{
+  CPU_PROFILE_THREAD_NAME("image loader");
+  while(true)
+  {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_jobsCV.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+      if(m_stop)
+        return;
+      job = std::move(m_jobs.front());
+      m_jobs.pop_front();
+    }
+
+    Done done;
+    done.onDone           = std::move(job.onDone);
+    done.result.requestId = job.requestId;
+    done.result.path      = job.path;
+
+    CPU_PROFILE_SCOPE("decode image");
+    auto pixels = loadImageLDR(job.path.c_str(), done.result.width, done.result.height, done.result.channels);
+    if(pixels != nullptr)
+    {
+      if(job.buildMips)
+      {
+        CPU_PROFILE_SCOPE("build mips");
+        done.result.mipLevels = getMipLevelsCount(done.result.width, done.result.height);
+        done.mipChain         = buildMipChainLDR(pixels, done.result.width, done.result.height, done.result.mipLevels);
+        done.result.pixels    = done.mipChain.data(); // the vector's storage doesn't move with Done
+        freeImageMemLDR(pixels);
+      }
+      else
+      {
+        done.result.pixels = pixels;
+        done.ownsPixels    = true;
+      }
+      done.result.ok = true;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_done.push_back(std::move(done));
+    }
+    m_doneCV.notify_all();
+  }
+}
+
+uint32_t ImageLoadService::Poll(uint32_t a_maxCompletions)
+{
+  uint32_t completed = 0;
+  while(completed < a_maxCompletions)
+  {
+    Done done;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if(m_done.empty())
+        break;
+      done = std::move(m_done.front());
+      m_done.pop_front();
+    }
+
+    if(done.onDone)
+      done.onDone(done.result);
+    if(done.ownsPixels)
+      freeImageMemLDR((unsigned char*)done.result.pixels);
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_inFlight--;
+    }
+    completed++;
+  }
+
+  return completed;
+}
+
+void ImageLoadService::WaitIdle()
+{
+  while(true)
+  {
+    Poll();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if(m_inFlight == 0)
+      return;
+    m_doneCV.wait(lock, [this]() { return !m_done.empty(); });
+  }
+}
+
+uint32_t ImageLoadService::Pending() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_inFlight;
+}
@@ -0,0 +1,89 @@
+#ifndef VK_GRAPHICS_BASIC_IMAGE_LOAD_SERVICE_H
+#define VK_GRAPHICS_BASIC_IMAGE_LOAD_SERVICE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct ImageLoadResult
+{
+  uint32_t    requestId = 0;
+  std::string path;
+  int         width     = 0;
+  int         height    = 0;
+  int         channels  = 0;     ///!< channels stored in the file, pixels are always RGBA8
+  uint32_t    mipLevels = 1;     ///!< levels in pixels, packed one after another as buildMipChainLDR() returns them
+  void*       pixels    = nullptr;
+  bool        ok        = false;
+};
+
+/**
+\brief decodes images on a pool of worker threads, completions are delivered on the thread that calls Poll()
+
+Decoded pixels are owned by the service and are valid only inside the completion callback.
+If a_buildMips is set, the full mip chain is filtered on the worker thread as well, so the completion
+only has to hand the result to the upload.
+*/
+class ImageLoadService
+{
+public:
+  using CompletionFn = std::function<void(const ImageLoadResult &a_result)>;
+
+  explicit ImageLoadService(uint32_t a_numThreads = 0);
+  ~ImageLoadService();
+
+  ImageLoadService(const ImageLoadService&) = delete;
+  ImageLoadService& operator=(const ImageLoadService&) = delete;
+
+  uint32_t Request(const std::string &a_path, CompletionFn a_onDone, bool a_buildMips = false);
+
+  /**
+  \brief runs completion callbacks of finished requests
+  \return number of callbacks that were run
+  */
+  uint32_t Poll(uint32_t a_maxCompletions = UINT32_MAX);
+
+  /**
+  \brief blocks until every request is decoded and runs all completions
+  */
+  void WaitIdle();
+
+  uint32_t Pending() const;
+
+private:
+  struct Job
+  {
+    uint32_t     requestId = 0;
+    std::string  path;
+    CompletionFn onDone;
+    bool         buildMips = false;
+  };
+
+  struct Done
+  {
+    ImageLoadResult result;
+    CompletionFn    onDone;
+    bool            ownsPixels = false;   // pixels come from loadImageLDR
+    std::vector<unsigned char> mipChain;  // or point here
+  };
+
+  void WorkerLoop();
+
+  std::vector<std::thread> m_workers;
+  std::deque<Job>  m_jobs;
+  std::deque<Done> m_done;
+  uint32_t m_inFlight  = 0;  // requested, but completion not yet run
+  uint32_t m_nextReqId = 0;
+  bool     m_stop      = false;
+
+  mutable std::mutex      m_mutex;
+  std::condition_variable m_jobsCV;
+  std::condition_variable m_doneCV;
+};
+
+#endif// VK_GRAPHICS_BASIC_IMAGE_LOAD_SERVICE_H
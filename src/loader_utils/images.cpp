@@ -1,5 +1,9 @@
 #define STB_IMAGE_IMPLEMENTATION
+#define STBI_NO_FAILURE_STRINGS // failure reason is a global in this stb version, images are decoded from several threads
 #include "stb_image.h"
+#include "images.h"
+
+#include <algorithm>
 
 unsigned char* loadImageLDR(const char* a_filename, int &w, int &h, int &channels)
 {
@@ -16,4 +20,67 @@ unsigned char* loadImageLDR(const char* a_filename, int &w, int &h, int &channel
 void freeImageMemLDR(unsigned char* pixels)
 {
   stbi_image_free(pixels);
-}
\ No newline at end of file
+}
+
+bool getImageInfo(const char* a_filename, int &w, int &h, int &channels)
+{
+  return stbi_info(a_filename, &w, &h, &channels) != 0;
+}
+uint32_t getMipLevelsCount(int w, int h)
+{
+  uint32_t levels = 1;
+  int maxSize = w > h ? w : h;
+  while(maxSize > 1)
+  {
+    maxSize >>= 1;
+    ++levels;
+  }
+  return levels;
+}
+
+std::vector<unsigned char> buildMipChainLDR(const unsigned char* a_pixels, int w, int h, uint32_t a_mipLevels)
+{
+  size_t totalSize = 0;
+  for(uint32_t level = 0; level < a_mipLevels; ++level)
+  {
+    const size_t levelW = w >> level > 0 ? w >> level : 1;
+    const size_t levelH = h >> level > 0 ? h >> level : 1;
+    totalSize += levelW * levelH * 4;
+  }
+
+  std::vector<unsigned char> res(totalSize);
+  std::copy(a_pixels, a_pixels + size_t(w) * h * 4, res.begin());
+
+  size_t srcOffset = 0;
+  size_t dstOffset = size_t(w) * h * 4;
+  int srcW = w;
+  int srcH = h;
+  for(uint32_t level = 1; level < a_mipLevels; ++level)
+  {
+    const int dstW = srcW > 1 ? srcW / 2 : 1;
+    const int dstH = srcH > 1 ? srcH / 2 : 1;
+
+    const unsigned char* src = res.data() + srcOffset;
+    unsigned char* dst       = res.data() + dstOffset;
+    for(int y = 0; y < dstH; ++y)
+    {
+      const unsigned char* row0 = src + size_t(std::min(2 * y,     srcH - 1)) * srcW * 4;
+      const unsigned char* row1 = src + size_t(std::min(2 * y + 1, srcH - 1)) * srcW * 4;
+      unsigned char* dstRow     = dst + size_t(y) * dstW * 4;
+      for(int x = 0; x < dstW; ++x)
+      {
+        const int x0 = std::min(2 * x,     srcW - 1) * 4;
+        const int x1 = std::min(2 * x + 1, srcW - 1) * 4;
+        for(int c = 0; c < 4; ++c)
+          dstRow[x * 4 + c] = (unsigned char)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+      }
+    }
+
+    srcOffset = dstOffset;
+    dstOffset += size_t(dstW) * dstH * 4;
+    srcW = dstW;
+    srcH = dstH;
+  }
+
+  return res;
+}
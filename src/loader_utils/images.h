@@ -1,8 +1,27 @@
 #ifndef VK_GRAPHICS_BASIC_IMAGES_H
 #define VK_GRAPHICS_BASIC_IMAGES_H
 
+#include <vector>
+#include <cstdint>
+
 unsigned char* loadImageLDR(const char* a_filename, int &w, int &h, int &channels);
 
 void freeImageMemLDR(unsigned char* pixels);
 
+/**
+\brief reads only the header, channels is the number of channels stored in the file
+*/
+bool getImageInfo(const char* a_filename, int &w, int &h, int &channels);
+
+/**
+\brief number of levels in a full mip chain down to 1x1
+*/
+uint32_t getMipLevelsCount(int w, int h);
+
+/**
+\brief builds mip chain for RGBA8 image with 2x2 box filter, odd sizes are handled by clamping to the last row/column
+\return all levels packed one after another, level i has size max(1, w >> i) x max(1, h >> i)
+*/
+std::vector<unsigned char> buildMipChainLDR(const unsigned char* a_pixels, int w, int h, uint32_t a_mipLevels);
+
 #endif// VK_GRAPHICS_BASIC_IMAGES_H
@@ -0,0 +1,392 @@
+#include "compute_primitives.h"
+
+#include <vk_buffers.h>
+#include <vk_pipeline.h>
+
+#include <algorithm>
+#include <cassert>
+
+static const char* KERNEL_NAMES[] = {"prim_reduce.comp", "prim_scan.comp", "prim_scan_add.comp", "prim_compact.comp",
+                                     "prim_radix_count.comp", "prim_radix_scatter.comp"};
+
+// descriptor sets are cached per combination of buffers, this bounds the number of combinations alive at once
+static constexpr uint32_t MAX_CACHED_SETS = 256;
+
+ComputePrimitives::ComputePrimitives(VkDevice a_device, VkPhysicalDevice a_physDevice,
+                                     std::shared_ptr<DeviceMemoryAllocator> a_pAllocator, const std::string &a_shadersDir) :
+                                     m_device(a_device), m_physDevice(a_physDevice), m_pAllocator(a_pAllocator)
+{
+  VkPhysicalDeviceSubgroupProperties subgroupProps = {};
+  subgroupProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+  VkPhysicalDeviceProperties2 props2 = {};
+  props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  props2.pNext = &subgroupProps;
+  vkGetPhysicalDeviceProperties2(m_physDevice, &props2);
+
+  const VkSubgroupFeatureFlags required = VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_ARITHMETIC_BIT;
+  m_useSubgroups = (subgroupProps.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) != 0 &&
+                   (subgroupProps.supportedOperations & required) == required;
+
+  std::array<VkDescriptorSetLayoutBinding, BINDINGS_NUM> bindings {};
+  for(uint32_t i = 0; i < BINDINGS_NUM; ++i)
+  {
+    bindings[i].binding         = i;
+    bindings[i].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[i].descriptorCount = 1;
+    bindings[i].stageFlags      = VK_SHADER_STAGE_COMPUTE_BIT;
+  }
+  VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+  layoutInfo.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = BINDINGS_NUM;
+  layoutInfo.pBindings    = bindings.data();
+  VK_CHECK_RESULT(vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_dSetLayout));
+
+  // sets of forgotten and destroyed buffers are freed back to the pool
+  VkDescriptorPoolSize poolSize = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, BINDINGS_NUM * MAX_CACHED_SETS};
+  VkDescriptorPoolCreateInfo poolInfo = {};
+  poolInfo.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.flags         = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+  poolInfo.maxSets       = MAX_CACHED_SETS;
+  poolInfo.poolSizeCount = 1;
+  poolInfo.pPoolSizes    = &poolSize;
+  VK_CHECK_RESULT(vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_dSetPool));
+
+  m_dummy = CreateScratch(PRIM_TILE * sizeof(uint32_t));
+
+  CreatePipelines(a_shadersDir);
+}
+
+ComputePrimitives::~ComputePrimitives()
+{
+  for(auto& pipeline : m_pipelines)
+  {
+    if(pipeline != VK_NULL_HANDLE)
+      vkDestroyPipeline(m_device, pipeline, nullptr);
+  }
+  if(m_pipelineLayout != VK_NULL_HANDLE)
+    vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+
+  for(auto& level : m_scanLevels)
+    DestroyScratch(level);
+  for(auto pScratch : {&m_dummy, &m_offsets, &m_keysTmp, &m_valsTmp, &m_hist})
+    DestroyScratch(*pScratch);
+
+  m_setsCache.clear();
+  vkDestroyDescriptorPool(m_device, m_dSetPool, nullptr);
+  vkDestroyDescriptorSetLayout(m_device, m_dSetLayout, nullptr);
+}
+
+void ComputePrimitives::CreatePipelines(const std::string &a_shadersDir)
+{
+  VkPushConstantRange pcRange = {};
+  pcRange.offset     = 0;
+  pcRange.size       = sizeof(PushConst);
+  pcRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+  pipelineLayoutInfo.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount         = 1;
+  pipelineLayoutInfo.pSetLayouts            = &m_dSetLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges    = &pcRange;
+  VK_CHECK_RESULT(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout));
+
+  for(uint32_t kernel = 0; kernel < KERNELS_NUM; ++kernel)
+  {
+    const std::string path = a_shadersDir + KERNEL_NAMES[kernel] + (m_useSubgroups ? ".spv" : ".nosg.spv");
+    std::vector<uint32_t> code = vk_utils::readSPVFile(path.c_str());
+
+    VkShaderModuleCreateInfo createInfo = {};
+    createInfo.sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.pCode    = code.data();
+    createInfo.codeSize = code.size() * sizeof(uint32_t);
+
+    VkShaderModule shaderModule;
+    VK_CHECK_RESULT(vkCreateShaderModule(m_device, &createInfo, nullptr, &shaderModule));
+
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType        = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage  = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName  = "main";
+    pipelineInfo.layout       = m_pipelineLayout;
+    VK_CHECK_RESULT(vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pipelines[kernel]));
+
+    vkDestroyShaderModule(m_device, shaderModule, nullptr);
+  }
+}
+
+ComputePrimitives::ScratchBuffer ComputePrimitives::CreateScratch(VkDeviceSize a_size)
+{
+  ScratchBuffer res;
+  res.buf   = vk_utils::createBuffer(m_device, a_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                                       VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+  res.alloc = m_pAllocator->AllocateAndBind(res.buf, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  return res;
+}
+
+void ComputePrimitives::DestroyScratch(ScratchBuffer &a_scratch)
+{
+  if(a_scratch.buf == VK_NULL_HANDLE)
+    return;
+
+  ForgetBuffer(a_scratch.buf);
+  vkDestroyBuffer(m_device, a_scratch.buf, nullptr);
+  m_pAllocator->Free(a_scratch.alloc);
+  a_scratch = ScratchBuffer();
+}
+
+void ComputePrimitives::Reserve(uint32_t a_maxElements)
+{
+  if(a_maxElements <= m_reserved)
+    return;
+
+  for(auto& level : m_scanLevels)
+    DestroyScratch(level);
+  m_scanLevels.clear();
+  for(auto pScratch : {&m_offsets, &m_keysTmp, &m_valsTmp, &m_hist})
+    DestroyScratch(*pScratch);
+
+  const VkDeviceSize bytes = VkDeviceSize(a_maxElements) * sizeof(uint32_t);
+  m_offsets = CreateScratch(bytes);
+  m_keysTmp = CreateScratch(bytes);
+  m_valsTmp = CreateScratch(bytes);
+
+  const uint32_t histSize = 16 * GroupsNum(a_maxElements);
+  m_hist = CreateScratch(VkDeviceSize(histSize) * sizeof(uint32_t));
+
+  // histogram is scanned with the same levels, so they are sized for the longer of the two arrays
+  uint32_t levelSize = GroupsNum(std::max(a_maxElements, histSize));
+  while(true)
+  {
+    m_scanLevels.push_back(CreateScratch(VkDeviceSize(levelSize) * sizeof(uint32_t)));
+    if(levelSize <= 1)
+      break;
+    levelSize = GroupsNum(levelSize);
+  }
+
+  m_reserved = a_maxElements;
+}
+
+void ComputePrimitives::ForgetBuffer(VkBuffer a_buffer)
+{
+  std::vector<VkDescriptorSet> sets;
+  for(auto it = m_setsCache.begin(); it != m_setsCache.end(); )
+  {
+    if(std::find(it->first.begin(), it->first.end(), a_buffer) != it->first.end())
+    {
+      sets.push_back(it->second);
+      it = m_setsCache.erase(it);
+    }
+    else
+      ++it;
+  }
+
+  if(!sets.empty())
+    VK_CHECK_RESULT(vkFreeDescriptorSets(m_device, m_dSetPool, uint32_t(sets.size()), sets.data()));
+}
+
+VkDescriptorSet ComputePrimitives::GetSet(const BindingBuffers &a_buffers)
+{
+  auto pFound = m_setsCache.find(a_buffers);
+  if(pFound != m_setsCache.end())
+    return pFound->second;
+
+  if(m_setsCache.size() >= MAX_CACHED_SETS)
+    RUN_TIME_ERROR("[ComputePrimitives::GetSet] too many distinct buffer combinations, ForgetBuffer() is not called?");
+
+  VkDescriptorSetAllocateInfo allocInfo = {};
+  allocInfo.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool     = m_dSetPool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts        = &m_dSetLayout;
+  VkDescriptorSet set = VK_NULL_HANDLE;
+  VK_CHECK_RESULT(vkAllocateDescriptorSets(m_device, &allocInfo, &set));
+
+  std::array<VkDescriptorBufferInfo, BINDINGS_NUM> bufferInfos {};
+  std::array<VkWriteDescriptorSet, BINDINGS_NUM>   writes {};
+  for(uint32_t i = 0; i < BINDINGS_NUM; ++i)
+  {
+    bufferInfos[i].buffer = a_buffers[i];
+    bufferInfos[i].offset = 0;
+    bufferInfos[i].range  = VK_WHOLE_SIZE;
+
+    writes[i].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[i].dstSet          = set;
+    writes[i].dstBinding      = i;
+    writes[i].descriptorCount = 1;
+    writes[i].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writes[i].pBufferInfo     = &bufferInfos[i];
+  }
+  vkUpdateDescriptorSets(m_device, BINDINGS_NUM, writes.data(), 0, nullptr);
+
+  m_setsCache[a_buffers] = set;
+  return set;
+}
+
+void ComputePrimitives::ComputeBarrier(VkCommandBuffer a_cmdBuff)
+{
+  VkMemoryBarrier barrier = {};
+  barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+  vkCmdPipelineBarrier(a_cmdBuff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                       1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void ComputePrimitives::Dispatch(VkCommandBuffer a_cmdBuff, Kernel a_kernel, const BindingBuffers &a_buffers, uint32_t a_groups,
+                                 const PushConst &a_params)
+{
+  VkDescriptorSet set = GetSet(a_buffers);
+  vkCmdBindPipeline(a_cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelines[a_kernel]);
+  vkCmdBindDescriptorSets(a_cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &set, 0, nullptr);
+  vkCmdPushConstants(a_cmdBuff, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(a_params), &a_params);
+  vkCmdDispatch(a_cmdBuff, a_groups, 1, 1);
+}
+
+void ComputePrimitives::RecordReduce(VkCommandBuffer a_cmdBuff, VkBuffer a_in, uint32_t a_n, VkBuffer a_result)
+{
+  vkCmdFillBuffer(a_cmdBuff, a_result, 0, sizeof(uint32_t), 0);
+  ComputeBarrier(a_cmdBuff);
+  if(a_n == 0)
+    return;
+
+  PushConst params;
+  params.n = a_n;
+  Dispatch(a_cmdBuff, KERNEL_REDUCE, {a_in, a_result, m_dummy.buf, m_dummy.buf, m_dummy.buf}, GroupsNum(a_n), params);
+  ComputeBarrier(a_cmdBuff);
+}
+
+// scans every tile, then scans tile totals in place with the next level and adds them back
+void ComputePrimitives::RecordScanLevel(VkCommandBuffer a_cmdBuff, VkBuffer a_in, VkBuffer a_out, uint32_t a_n, uint32_t a_level)
+{
+  assert(a_level < m_scanLevels.size());
+  const uint32_t groups = GroupsNum(a_n);
+  VkBuffer blockSums = m_scanLevels[a_level].buf;
+
+  PushConst params;
+  params.n = a_n;
+  Dispatch(a_cmdBuff, KERNEL_SCAN, {a_in, a_out, blockSums, m_dummy.buf, m_dummy.buf}, groups, params);
+  ComputeBarrier(a_cmdBuff);
+
+  if(groups > 1)
+  {
+    RecordScanLevel(a_cmdBuff, blockSums, blockSums, groups, a_level + 1);
+    Dispatch(a_cmdBuff, KERNEL_SCAN_ADD, {m_dummy.buf, a_out, blockSums, m_dummy.buf, m_dummy.buf}, groups, params);
+    ComputeBarrier(a_cmdBuff);
+  }
+}
+
+void ComputePrimitives::RecordExclusiveScan(VkCommandBuffer a_cmdBuff, VkBuffer a_in, VkBuffer a_out, uint32_t a_n)
+{
+  if(a_n == 0)
+    return;
+  Reserve(a_n);
+  RecordScanLevel(a_cmdBuff, a_in, a_out, a_n, 0);
+}
+
+void ComputePrimitives::RecordCompact(VkCommandBuffer a_cmdBuff, VkBuffer a_in, VkBuffer a_flags, uint32_t a_n, VkBuffer a_out,
+                                      VkBuffer a_count)
+{
+  if(a_n == 0)
+  {
+    vkCmdFillBuffer(a_cmdBuff, a_count, 0, sizeof(uint32_t), 0);
+    ComputeBarrier(a_cmdBuff);
+    return;
+  }
+
+  Reserve(a_n);
+  RecordScanLevel(a_cmdBuff, a_flags, m_offsets.buf, a_n, 0);
+
+  PushConst params;
+  params.n = a_n;
+  Dispatch(a_cmdBuff, KERNEL_COMPACT, {a_in, a_out, a_flags, m_offsets.buf, a_count}, GroupsNum(a_n), params);
+  ComputeBarrier(a_cmdBuff);
+}
+
+void ComputePrimitives::RecordRadixSort(VkCommandBuffer a_cmdBuff, VkBuffer a_keys, uint32_t a_n, VkBuffer a_values)
+{
+  if(a_n <= 1)
+    return;
+  Reserve(a_n);
+
+  const bool     hasValues = a_values != VK_NULL_HANDLE;
+  const uint32_t groups    = GroupsNum(a_n);
+  const uint32_t histSize  = 16 * groups;
+
+  VkBuffer keys[2] = {a_keys, m_keysTmp.buf};
+  VkBuffer vals[2] = {hasValues ? a_values : m_dummy.buf, hasValues ? m_valsTmp.buf : m_dummy.buf};
+
+  // 8 passes, so the result ends up in the original buffers
+  for(uint32_t pass = 0; pass < 8; ++pass)
+  {
+    const uint32_t src = pass & 1;
+    const uint32_t dst = src ^ 1;
+
+    PushConst params;
+    params.n         = a_n;
+    params.shift     = pass * 4;
+    params.numGroups = groups;
+    params.flags     = hasValues ? 1 : 0;
+
+    Dispatch(a_cmdBuff, KERNEL_RADIX_COUNT, {keys[src], m_dummy.buf, m_hist.buf, m_dummy.buf, m_dummy.buf}, groups, params);
+    ComputeBarrier(a_cmdBuff);
+
+    RecordScanLevel(a_cmdBuff, m_hist.buf, m_hist.buf, histSize, 0);
+
+    Dispatch(a_cmdBuff, KERNEL_RADIX_SCATTER, {keys[src], keys[dst], m_hist.buf, vals[src], vals[dst]}, groups, params);
+    ComputeBarrier(a_cmdBuff);
+  }
+}
+
+uint32_t ComputePrimitives::ReduceCPU(const std::vector<uint32_t> &a_in)
+{
+  uint32_t sum = 0;
+  for(auto v : a_in)
+    sum += v;
+  return sum;
+}
+
+std::vector<uint32_t> ComputePrimitives::ExclusiveScanCPU(const std::vector<uint32_t> &a_in)
+{
+  std::vector<uint32_t> res(a_in.size());
+  uint32_t sum = 0;
+  for(size_t i = 0; i < a_in.size(); ++i)
+  {
+    res[i] = sum;
+    sum   += a_in[i];
+  }
+  return res;
+}
+
+std::vector<uint32_t> ComputePrimitives::CompactCPU(const std::vector<uint32_t> &a_in, const std::vector<uint32_t> &a_flags)
+{
+  std::vector<uint32_t> res;
+  res.reserve(a_in.size());
+  for(size_t i = 0; i < a_in.size(); ++i)
+  {
+    if(a_flags[i] != 0)
+      res.push_back(a_in[i]);
+  }
+  return res;
+}
+
+void ComputePrimitives::RadixSortCPU(std::vector<uint32_t> &a_keys, std::vector<uint32_t> &a_values)
+{
+  std::vector<uint32_t> order(a_keys.size());
+  for(size_t i = 0; i < order.size(); ++i)
+    order[i] = uint32_t(i);
+  std::stable_sort(order.begin(), order.end(), [&a_keys](uint32_t a, uint32_t b) { return a_keys[a] < a_keys[b]; });
+
+  std::vector<uint32_t> keys(a_keys.size()), values(a_values.size());
+  for(size_t i = 0; i < order.size(); ++i)
+  {
+    keys[i] = a_keys[order[i]];
+    if(!a_values.empty())
+      values[i] = a_values[order[i]];
+  }
+  a_keys   = std::move(keys);
+  a_values = std::move(values);
+}
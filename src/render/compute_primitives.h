@@ -0,0 +1,135 @@
+#ifndef VK_GRAPHICS_BASIC_COMPUTE_PRIMITIVES_H
+#define VK_GRAPHICS_BASIC_COMPUTE_PRIMITIVES_H
+
+#include "compute_common.h"
+#include "mem_allocator.h"
+#include "../../resources/shaders/prim_common.h"
+
+#include <array>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+\brief parallel building blocks over uint32 arrays: reduction, exclusive scan, stream compaction and LSD radix sort
+
+Record*() functions only record dispatches and barriers into a caller's command buffer, so primitives can be
+chained with other work in one submit. Input is expected to be visible to compute shaders when recording starts,
+results are visible to compute shaders and transfers when the recorded commands finish.
+All buffers must be created with VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, reduction result and compaction count are
+also cleared with vkCmdFillBuffer and need VK_BUFFER_USAGE_TRANSFER_DST_BIT. Scratch memory is owned by the object and
+sized by Reserve(), so the same ComputePrimitives must not be used by two command buffers executing at once.
+Descriptor sets are cached per combination of buffers, so a caller's buffer must be passed to ForgetBuffer()
+before it is destroyed, otherwise its sets stay allocated and may be reused for a new buffer with the same handle.
+
+When the device supports subgroup arithmetic in compute shaders, workgroup scans are done with subgroup
+operations (*.comp.spv), otherwise with shared memory (*.comp.nosg.spv).
+*/
+class ComputePrimitives
+{
+public:
+  ComputePrimitives(VkDevice a_device, VkPhysicalDevice a_physDevice, std::shared_ptr<DeviceMemoryAllocator> a_pAllocator,
+                    const std::string &a_shadersDir = "../resources/shaders/");
+  ~ComputePrimitives();
+
+  ComputePrimitives(const ComputePrimitives&) = delete;
+  ComputePrimitives& operator=(const ComputePrimitives&) = delete;
+
+  /**
+  \brief allocate scratch buffers for arrays of up to a_maxElements, called implicitly by Record*() if needed
+  */
+  void Reserve(uint32_t a_maxElements);
+
+  /// a_result[0] = sum of a_in[0..n), wraps around on overflow like uint32 arithmetic
+  void RecordReduce(VkCommandBuffer a_cmdBuff, VkBuffer a_in, uint32_t a_n, VkBuffer a_result);
+
+  /// a_out[i] = a_in[0] + ... + a_in[i-1], a_out may be the same buffer as a_in
+  void RecordExclusiveScan(VkCommandBuffer a_cmdBuff, VkBuffer a_in, VkBuffer a_out, uint32_t a_n);
+
+  /**
+  \brief a_out receives a_in[i] for every i with a_flags[i] == 1 in the original order, a_count[0] is their number
+  \param a_flags - must contain only 0 and 1
+  */
+  void RecordCompact(VkCommandBuffer a_cmdBuff, VkBuffer a_in, VkBuffer a_flags, uint32_t a_n, VkBuffer a_out, VkBuffer a_count);
+
+  /**
+  \brief stable ascending sort of a_keys in place with 8 passes of 4 bit digits, a_values (if given) are moved with keys
+  */
+  void RecordRadixSort(VkCommandBuffer a_cmdBuff, VkBuffer a_keys, uint32_t a_n, VkBuffer a_values = VK_NULL_HANDLE);
+
+  /// frees cached descriptor sets that reference a_buffer, call before destroying a buffer passed to Record*()
+  void ForgetBuffer(VkBuffer a_buffer);
+
+  bool UsesSubgroups() const { return m_useSubgroups; }
+
+  // CPU references for validation and benchmarks
+  //
+  static uint32_t ReduceCPU(const std::vector<uint32_t> &a_in);
+  static std::vector<uint32_t> ExclusiveScanCPU(const std::vector<uint32_t> &a_in);
+  static std::vector<uint32_t> CompactCPU(const std::vector<uint32_t> &a_in, const std::vector<uint32_t> &a_flags);
+  static void RadixSortCPU(std::vector<uint32_t> &a_keys, std::vector<uint32_t> &a_values);
+
+private:
+  enum Kernel
+  {
+    KERNEL_REDUCE = 0,
+    KERNEL_SCAN,
+    KERNEL_SCAN_ADD,
+    KERNEL_COMPACT,
+    KERNEL_RADIX_COUNT,
+    KERNEL_RADIX_SCATTER,
+    KERNELS_NUM
+  };
+
+  struct PushConst
+  {
+    uint32_t n         = 0;
+    uint32_t shift     = 0;
+    uint32_t numGroups = 0;
+    uint32_t flags     = 0;
+  };
+
+  static constexpr uint32_t BINDINGS_NUM = 5; // every kernel uses the same layout, unused bindings get a dummy buffer
+  using BindingBuffers = std::array<VkBuffer, BINDINGS_NUM>;
+
+  struct ScratchBuffer
+  {
+    VkBuffer      buf = VK_NULL_HANDLE;
+    MemAllocation alloc {};
+  };
+
+  void CreatePipelines(const std::string &a_shadersDir);
+  ScratchBuffer CreateScratch(VkDeviceSize a_size);
+  void DestroyScratch(ScratchBuffer &a_scratch);
+
+  VkDescriptorSet GetSet(const BindingBuffers &a_buffers);
+  void Dispatch(VkCommandBuffer a_cmdBuff, Kernel a_kernel, const BindingBuffers &a_buffers, uint32_t a_groups,
+                const PushConst &a_params);
+  void RecordScanLevel(VkCommandBuffer a_cmdBuff, VkBuffer a_in, VkBuffer a_out, uint32_t a_n, uint32_t a_level);
+
+  static uint32_t GroupsNum(uint32_t a_n) { return (a_n + PRIM_TILE - 1) / PRIM_TILE; }
+  static void ComputeBarrier(VkCommandBuffer a_cmdBuff);
+
+  VkDevice m_device = VK_NULL_HANDLE;
+  VkPhysicalDevice m_physDevice = VK_NULL_HANDLE;
+  std::shared_ptr<DeviceMemoryAllocator> m_pAllocator;
+  bool m_useSubgroups = false;
+
+  VkDescriptorPool      m_dSetPool   = VK_NULL_HANDLE; // created with FREE_DESCRIPTOR_SET_BIT, see ForgetBuffer()
+  VkDescriptorSetLayout m_dSetLayout = VK_NULL_HANDLE;
+  std::map<BindingBuffers, VkDescriptorSet> m_setsCache;
+
+  VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+  std::array<VkPipeline, KERNELS_NUM> m_pipelines {};
+
+  uint32_t m_reserved = 0;
+  ScratchBuffer m_dummy;
+  ScratchBuffer m_offsets;               // compaction: scanned flags
+  ScratchBuffer m_keysTmp;               // radix sort ping-pong
+  ScratchBuffer m_valsTmp;
+  ScratchBuffer m_hist;                  // radix sort: 16 counters per workgroup
+  std::vector<ScratchBuffer> m_scanLevels; // tile totals of every scan level
+};
+
+#endif// VK_GRAPHICS_BASIC_COMPUTE_PRIMITIVES_H
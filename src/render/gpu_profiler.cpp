@@ -0,0 +1,255 @@
+#include "gpu_profiler.h"
+#include <vk_utils.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+GpuProfiler::GpuProfiler(VkDevice a_device, VkPhysicalDevice a_physDevice, uint32_t a_queueFamilyIdx, uint32_t a_framesInFlight,
+                         uint32_t a_maxScopes, uint32_t a_historySize) : m_device(a_device), m_maxQueries(2 * a_maxScopes),
+                                                                         m_historySize(std::max(a_historySize, 1u))
+{
+  VkPhysicalDeviceProperties props = {};
+  vkGetPhysicalDeviceProperties(a_physDevice, &props);
+  m_timestampPeriod = props.limits.timestampPeriod;
+
+  uint32_t familiesNum = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(a_physDevice, &familiesNum, nullptr);
+  std::vector<VkQueueFamilyProperties> families(familiesNum);
+  vkGetPhysicalDeviceQueueFamilyProperties(a_physDevice, &familiesNum, families.data());
+
+  const uint32_t validBits = a_queueFamilyIdx < familiesNum ? families[a_queueFamilyIdx].timestampValidBits : 0;
+  m_enabled       = validBits > 0;
+  m_timestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+  if(!m_enabled)
+  {
+    vk_utils::logWarning("[GpuProfiler] queue family doesn't support timestamps, GPU profiling is disabled");
+    return;
+  }
+
+  m_slots.resize(a_framesInFlight);
+  for(auto& slot : m_slots)
+  {
+    VkQueryPoolCreateInfo poolInfo = {};
+    poolInfo.sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = m_maxQueries;
+    VK_CHECK_RESULT(vkCreateQueryPool(m_device, &poolInfo, nullptr, &slot.pool));
+    slot.scopes.reserve(a_maxScopes);
+  }
+}
+
+GpuProfiler::~GpuProfiler()
+{
+  for(auto& slot : m_slots)
+    vkDestroyQueryPool(m_device, slot.pool, nullptr);
+}
+
+uint32_t GpuProfiler::NameId(const char* a_name)
+{
+  auto pFound = m_nameIds.find(a_name);
+  if(pFound != m_nameIds.end())
+    return pFound->second;
+
+  const uint32_t id = uint32_t(m_names.size());
+  m_names.emplace_back(a_name);
+  m_depths.push_back(0);
+  m_nameIds[a_name] = id;
+  return id;
+}
+
+void GpuProfiler::BeginFrame(VkCommandBuffer a_cmdBuff, uint32_t a_frameSlot)
+{
+  if(!m_enabled)
+    return;
+
+  FrameSlot &slot = m_slots[a_frameSlot % m_slots.size()];
+  if(slot.submitted)
+    CollectResults(slot);
+
+  slot.scopes.clear();
+  slot.openScopes.clear();
+  slot.nextQuery   = 0;
+  slot.pendingEnds = 0;
+  slot.submitted   = false;
+  m_pCurrent     = &slot;
+
+  vkCmdResetQueryPool(a_cmdBuff, slot.pool, 0, m_maxQueries);
+}
+
+void GpuProfiler::BeginScope(VkCommandBuffer a_cmdBuff, const char* a_name, VkPipelineStageFlagBits a_stage)
+{
+  if(!m_enabled || m_pCurrent == nullptr)
+    return;
+
+  FrameSlot &slot = *m_pCurrent;
+  // the end queries of all enclosing scopes must still fit after this scope's pair
+  if(slot.nextQuery + slot.pendingEnds + 2 > m_maxQueries)
+  {
+    // keep begin/end balanced, the scope is just not measured
+    slot.openScopes.push_back(UINT32_MAX);
+    return;
+  }
+
+  ScopeRecord scope {NameId(a_name), uint32_t(slot.openScopes.size()), slot.nextQuery++};
+  vkCmdWriteTimestamp(a_cmdBuff, a_stage, slot.pool, scope.beginQuery);
+
+  slot.openScopes.push_back(uint32_t(slot.scopes.size()));
+  slot.scopes.push_back(scope);
+  slot.pendingEnds++;
+}
+
+void GpuProfiler::EndScope(VkCommandBuffer a_cmdBuff, VkPipelineStageFlagBits a_stage)
+{
+  if(!m_enabled || m_pCurrent == nullptr || m_pCurrent->openScopes.empty())
+    return;
+
+  FrameSlot &slot = *m_pCurrent;
+  const uint32_t scopeId = slot.openScopes.back();
+  slot.openScopes.pop_back();
+  if(scopeId == UINT32_MAX)
+    return;
+
+  auto &scope = slot.scopes[scopeId];
+  scope.endQuery = slot.nextQuery++;
+  slot.pendingEnds--;
+  vkCmdWriteTimestamp(a_cmdBuff, a_stage, slot.pool, scope.endQuery);
+}
+
+void GpuProfiler::FrameSubmitted(uint32_t a_frameSlot)
+{
+  if(!m_enabled)
+    return;
+
+  FrameSlot &slot = m_slots[a_frameSlot % m_slots.size()];
+  if(!slot.openScopes.empty())
+    vk_utils::logWarning("[GpuProfiler::FrameSubmitted] some scopes were not closed");
+  slot.submitted = slot.nextQuery > 0;
+  if(m_pCurrent == &slot)
+    m_pCurrent = nullptr;
+}
+
+void GpuProfiler::CollectResults(FrameSlot &a_slot)
+{
+  // value and availability for every query, the frame fence was already waited so this normally never misses
+  std::vector<uint64_t> data(size_t(a_slot.nextQuery) * 2);
+  const VkResult res = vkGetQueryPoolResults(m_device, a_slot.pool, 0, a_slot.nextQuery, data.size() * sizeof(uint64_t),
+                                             data.data(), 2 * sizeof(uint64_t),
+                                             VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+  if(res != VK_SUCCESS && res != VK_NOT_READY)
+    VK_CHECK_RESULT(res);
+
+  FrameTimes frame;
+  frame.frameIdx = m_framesProfiled;
+  frame.ms.assign(m_names.size(), -1.0f);
+
+  uint64_t first = ~0ull, last = 0;
+  for(const auto& scope : a_slot.scopes)
+  {
+    if(scope.endQuery == UINT32_MAX)
+      continue;
+    const uint64_t* pBegin = &data[size_t(scope.beginQuery) * 2];
+    const uint64_t* pEnd   = &data[size_t(scope.endQuery) * 2];
+    if(pBegin[1] == 0 || pEnd[1] == 0)
+      continue;
+
+    const uint64_t begin = pBegin[0] & m_timestampMask;
+    const uint64_t end   = pEnd[0] & m_timestampMask;
+    const uint64_t ticks = (end - begin) & m_timestampMask;
+    const float ms = float(double(ticks) * double(m_timestampPeriod) * 1e-6);
+
+    // a scope name used several times in a frame is accumulated
+    float &dst = frame.ms[scope.nameId];
+    dst = dst < 0.0f ? ms : dst + ms;
+    m_depths[scope.nameId] = scope.depth;
+
+    first = std::min(first, begin);
+    last  = std::max(last, end);
+  }
+
+  if(first == ~0ull)
+    return;
+
+  m_lastFrameMs = float(double(last - first) * double(m_timestampPeriod) * 1e-6);
+  m_history.push_back(std::move(frame));
+  if(m_history.size() > m_historySize)
+    m_history.pop_front();
+  m_framesProfiled++;
+}
+
+static float percentile(const std::vector<float> &a_sorted, float a_p)
+{
+  const size_t rank = size_t(std::ceil(a_p * float(a_sorted.size())));
+  return a_sorted[std::min(std::max(rank, size_t(1)), a_sorted.size()) - 1];
+}
+
+std::vector<GpuProfiler::ScopeStats> GpuProfiler::GetStats() const
+{
+  std::vector<ScopeStats> res;
+  res.reserve(m_names.size());
+
+  std::vector<float> values;
+  values.reserve(m_history.size());
+  for(uint32_t nameId = 0; nameId < m_names.size(); ++nameId)
+  {
+    ScopeStats stats;
+    stats.name  = m_names[nameId];
+    stats.depth = m_depths[nameId];
+
+    values.clear();
+    double sum = 0.0;
+    for(const auto& frame : m_history)
+    {
+      if(nameId < frame.ms.size() && frame.ms[nameId] >= 0.0f)
+      {
+        values.push_back(frame.ms[nameId]);
+        sum += frame.ms[nameId];
+      }
+    }
+    if(values.empty())
+      continue;
+
+    stats.samples = uint32_t(values.size());
+    stats.lastMs  = values.back();
+    stats.avgMs   = float(sum / double(values.size()));
+
+    std::sort(values.begin(), values.end());
+    stats.minMs = values.front();
+    stats.maxMs = values.back();
+    stats.p50Ms = percentile(values, 0.50f);
+    stats.p95Ms = percentile(values, 0.95f);
+    stats.p99Ms = percentile(values, 0.99f);
+    res.push_back(stats);
+  }
+
+  return res;
+}
+
+bool GpuProfiler::ExportCSV(const std::string &a_path) const
+{
+  std::ofstream out(a_path);
+  if(!out.is_open())
+  {
+    vk_utils::logWarning("[GpuProfiler::ExportCSV] can't open " + a_path);
+    return false;
+  }
+
+  out << "frame";
+  for(const auto& name : m_names)
+    out << "," << name << "_ms";
+  out << "\n";
+
+  for(const auto& frame : m_history)
+  {
+    out << frame.frameIdx;
+    for(uint32_t nameId = 0; nameId < m_names.size(); ++nameId)
+    {
+      out << ",";
+      if(nameId < frame.ms.size() && frame.ms[nameId] >= 0.0f)
+        out << frame.ms[nameId];
+    }
+    out << "\n";
+  }
+
+  return true;
+}
@@ -0,0 +1,110 @@
+#ifndef VK_GRAPHICS_BASIC_GPU_PROFILER_H
+#define VK_GRAPHICS_BASIC_GPU_PROFILER_H
+
+#include "volk.h"
+
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+\brief per pass GPU times from vkCmdWriteTimestamp
+
+Every frame in flight has its own query pool. Queries of a frame are read back when the same frame slot is
+recorded again (after its fence was waited), so results are a_framesInFlight frames late and reading never stalls.
+Usage per frame:
+
+  BeginFrame(cmd, frameSlot);                  // before any scope, outside of render passes
+  BeginScope(cmd, "shadow"); ... EndScope(cmd); // scopes may be nested and may be in other command buffers of the frame
+  FrameSubmitted(frameSlot);                   // after vkQueueSubmit, frames recorded but never submitted are ignored
+*/
+class GpuProfiler
+{
+public:
+  GpuProfiler(VkDevice a_device, VkPhysicalDevice a_physDevice, uint32_t a_queueFamilyIdx, uint32_t a_framesInFlight,
+              uint32_t a_maxScopes = 64, uint32_t a_historySize = 256);
+  ~GpuProfiler();
+
+  GpuProfiler(const GpuProfiler&) = delete;
+  GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+  void BeginFrame(VkCommandBuffer a_cmdBuff, uint32_t a_frameSlot);
+  void BeginScope(VkCommandBuffer a_cmdBuff, const char* a_name, VkPipelineStageFlagBits a_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+  void EndScope(VkCommandBuffer a_cmdBuff, VkPipelineStageFlagBits a_stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+  void FrameSubmitted(uint32_t a_frameSlot);
+
+  struct ScopeStats
+  {
+    std::string name;
+    uint32_t depth   = 0;     ///!< nesting level of the scope when it was last seen
+    uint32_t samples = 0;     ///!< frames in history that contain the scope
+    float    lastMs  = 0.0f;
+    float    avgMs   = 0.0f;
+    float    minMs   = 0.0f;
+    float    maxMs   = 0.0f;
+    float    p50Ms   = 0.0f;
+    float    p95Ms   = 0.0f;
+    float    p99Ms   = 0.0f;
+  };
+
+  /// statistics over the last a_historySize profiled frames, in order of first appearance of scopes
+  std::vector<ScopeStats> GetStats() const;
+
+  /// GPU time from the first to the last timestamp of the latest profiled frame
+  float LastFrameMs() const { return m_lastFrameMs; }
+
+  /// one row per profiled frame in history, one column per scope (empty if the scope was not recorded in the frame)
+  bool ExportCSV(const std::string &a_path) const;
+
+  bool Enabled() const { return m_enabled; }
+  uint64_t FramesProfiled() const { return m_framesProfiled; }
+
+private:
+  struct ScopeRecord
+  {
+    uint32_t nameId;
+    uint32_t depth;
+    uint32_t beginQuery;
+    uint32_t endQuery = UINT32_MAX;
+  };
+
+  struct FrameSlot
+  {
+    VkQueryPool pool = VK_NULL_HANDLE;
+    std::vector<ScopeRecord> scopes;
+    std::vector<uint32_t>    openScopes;   // indices of scopes without EndScope yet
+    uint32_t nextQuery   = 0;
+    uint32_t pendingEnds = 0;              // end queries reserved for measured open scopes
+    bool     submitted = false;
+  };
+
+  struct FrameTimes
+  {
+    uint64_t frameIdx = 0;
+    std::vector<float> ms;                 // per scope name id, negative if absent
+  };
+
+  void CollectResults(FrameSlot &a_slot);
+  uint32_t NameId(const char* a_name);
+
+  VkDevice m_device = VK_NULL_HANDLE;
+  bool     m_enabled = false;
+  float    m_timestampPeriod = 1.0f;       // nanoseconds per tick
+  uint64_t m_timestampMask = ~0ull;
+  uint32_t m_maxQueries = 0;
+  uint32_t m_historySize = 0;
+
+  std::vector<FrameSlot> m_slots;
+  FrameSlot* m_pCurrent = nullptr;
+
+  std::vector<std::string> m_names;
+  std::vector<uint32_t>    m_depths;
+  std::unordered_map<std::string, uint32_t> m_nameIds;
+
+  std::deque<FrameTimes> m_history;
+  uint64_t m_framesProfiled = 0;
+  float    m_lastFrameMs = 0.0f;
+};
+
+#endif// VK_GRAPHICS_BASIC_GPU_PROFILER_H
@@ -0,0 +1,444 @@
+#include "mem_allocator.h"
+#include <vk_utils.h>
+
+#include <cassert>
+#include <algorithm>
+
+static uint32_t bitScanReverse64(uint64_t a_val)
+{
+  uint32_t res = 0;
+  while (a_val >>= 1)
+    ++res;
+  return res;
+}
+
+static uint32_t bitScanForward64(uint64_t a_val)
+{
+  assert(a_val != 0);
+  uint32_t res = 0;
+  while ((a_val & 1u) == 0)
+  {
+    a_val >>= 1;
+    ++res;
+  }
+  return res;
+}
+
+static VkDeviceSize alignUp(VkDeviceSize a_val, VkDeviceSize a_alignment)
+{
+  return (a_val + a_alignment - 1) / a_alignment * a_alignment;
+}
+
+DeviceMemoryAllocator::DeviceMemoryAllocator(VkDevice a_device, VkPhysicalDevice a_physDevice, VkDeviceSize a_blockSize) :
+  m_device(a_device), m_physDevice(a_physDevice), m_blockSize(a_blockSize)
+{
+  vkGetPhysicalDeviceMemoryProperties(m_physDevice, &m_memProps);
+}
+
+DeviceMemoryAllocator::~DeviceMemoryAllocator()
+{
+  for(auto& pool : m_pools)
+  {
+    for(uint32_t i = 0; i < pool.blocks.size(); ++i)
+    {
+      if(pool.blocks[i] != nullptr)
+        DestroyBlock(pool, i);
+    }
+  }
+  m_pools.clear();
+}
+
+void DeviceMemoryAllocator::MappingInsert(VkDeviceSize a_size, uint32_t &fl, uint32_t &sl)
+{
+  fl = bitScanReverse64(a_size);
+  sl = uint32_t(a_size >> (fl - SL_LOG2)) & (SL_COUNT - 1);
+}
+
+uint32_t DeviceMemoryAllocator::FindPool(uint32_t a_memTypeIdx, bool a_isImage)
+{
+  for(uint32_t i = 0; i < m_pools.size(); ++i)
+  {
+    if(m_pools[i].memTypeIdx == a_memTypeIdx && m_pools[i].isImage == a_isImage)
+      return i;
+  }
+
+  Pool pool;
+  pool.memTypeIdx = a_memTypeIdx;
+  pool.isImage    = a_isImage;
+  pool.isMapped   = (m_memProps.memoryTypes[a_memTypeIdx].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+  m_pools.push_back(std::move(pool));
+
+  return uint32_t(m_pools.size() - 1);
+}
+
+uint32_t DeviceMemoryAllocator::CreateBlock(Pool &a_pool, VkDeviceSize a_size, bool a_dedicated)
+{
+  auto pBlock = std::make_unique<Block>();
+  pBlock->size      = a_size;
+  pBlock->dedicated = a_dedicated;
+
+  VkMemoryAllocateInfo allocateInfo = {};
+  allocateInfo.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocateInfo.pNext           = nullptr;
+  allocateInfo.allocationSize  = a_size;
+  allocateInfo.memoryTypeIndex = a_pool.memTypeIdx;
+  VK_CHECK_RESULT(vkAllocateMemory(m_device, &allocateInfo, nullptr, &pBlock->memory));
+  m_totalAllocateCalls++;
+
+  if(a_pool.isMapped)
+    VK_CHECK_RESULT(vkMapMemory(m_device, pBlock->memory, 0, VK_WHOLE_SIZE, 0, &pBlock->mapped));
+
+  for(uint32_t fl = 0; fl < FL_COUNT; ++fl)
+    for(uint32_t sl = 0; sl < SL_COUNT; ++sl)
+      pBlock->freeHeads[fl][sl] = UINT32_MAX;
+
+  if(!a_dedicated)
+  {
+    uint32_t rangeId = NewRange(*pBlock);
+    pBlock->ranges[rangeId].offset = 0;
+    pBlock->ranges[rangeId].size   = a_size;
+    InsertFree(*pBlock, rangeId);
+  }
+
+  for(uint32_t i = 0; i < a_pool.blocks.size(); ++i)
+  {
+    if(a_pool.blocks[i] == nullptr)
+    {
+      a_pool.blocks[i] = std::move(pBlock);
+      return i;
+    }
+  }
+  a_pool.blocks.push_back(std::move(pBlock));
+  return uint32_t(a_pool.blocks.size() - 1);
+}
+
+void DeviceMemoryAllocator::DestroyBlock(Pool &a_pool, uint32_t a_blockId)
+{
+  auto& pBlock = a_pool.blocks[a_blockId];
+  if(pBlock->mapped != nullptr)
+    vkUnmapMemory(m_device, pBlock->memory);
+  vkFreeMemory(m_device, pBlock->memory, nullptr);
+  pBlock = nullptr;
+}
+
+uint32_t DeviceMemoryAllocator::NewRange(Block &a_block)
+{
+  if(!a_block.unusedRanges.empty())
+  {
+    uint32_t id = a_block.unusedRanges.back();
+    a_block.unusedRanges.pop_back();
+    a_block.ranges[id] = Range{};
+    return id;
+  }
+  a_block.ranges.emplace_back();
+  return uint32_t(a_block.ranges.size() - 1);
+}
+
+void DeviceMemoryAllocator::InsertFree(Block &a_block, uint32_t a_rangeId)
+{
+  uint32_t fl, sl;
+  MappingInsert(a_block.ranges[a_rangeId].size, fl, sl);
+
+  Range &range   = a_block.ranges[a_rangeId];
+  range.isFree   = true;
+  range.prevFree = UINT32_MAX;
+  range.nextFree = a_block.freeHeads[fl][sl];
+  if(range.nextFree != UINT32_MAX)
+    a_block.ranges[range.nextFree].prevFree = a_rangeId;
+
+  a_block.freeHeads[fl][sl] = a_rangeId;
+  a_block.slMap[fl] |= (1u << sl);
+  a_block.flMap     |= (uint64_t(1) << fl);
+}
+
+void DeviceMemoryAllocator::RemoveFree(Block &a_block, uint32_t a_rangeId)
+{
+  uint32_t fl, sl;
+  MappingInsert(a_block.ranges[a_rangeId].size, fl, sl);
+
+  Range &range = a_block.ranges[a_rangeId];
+  if(range.prevFree != UINT32_MAX)
+    a_block.ranges[range.prevFree].nextFree = range.nextFree;
+  if(range.nextFree != UINT32_MAX)
+    a_block.ranges[range.nextFree].prevFree = range.prevFree;
+
+  if(a_block.freeHeads[fl][sl] == a_rangeId)
+  {
+    a_block.freeHeads[fl][sl] = range.nextFree;
+    if(range.nextFree == UINT32_MAX)
+    {
+      a_block.slMap[fl] &= ~(1u << sl);
+      if(a_block.slMap[fl] == 0)
+        a_block.flMap &= ~(uint64_t(1) << fl);
+    }
+  }
+
+  range.isFree   = false;
+  range.prevFree = UINT32_MAX;
+  range.nextFree = UINT32_MAX;
+}
+
+uint32_t DeviceMemoryAllocator::FindFree(Block &a_block, VkDeviceSize a_size)
+{
+  // round size up to the next list boundary, so that any range in the found list is big enough
+  a_size += (VkDeviceSize(1) << (bitScanReverse64(a_size) - SL_LOG2)) - 1;
+
+  uint32_t fl, sl;
+  MappingInsert(a_size, fl, sl);
+  if(fl >= FL_COUNT)
+    return UINT32_MAX;
+
+  uint32_t slBits = a_block.slMap[fl] & (~0u << sl);
+  if(slBits == 0)
+  {
+    const uint64_t flBits = (fl + 1 < 64) ? (a_block.flMap & (~uint64_t(0) << (fl + 1))) : 0;
+    if(flBits == 0)
+      return UINT32_MAX;
+
+    fl     = bitScanForward64(flBits);
+    slBits = a_block.slMap[fl];
+  }
+  sl = bitScanForward64(slBits);
+
+  return a_block.freeHeads[fl][sl];
+}
+
+bool DeviceMemoryAllocator::AllocateFromBlock(Block &a_block, VkDeviceSize a_size, VkDeviceSize a_alignment, uint32_t &a_rangeId)
+{
+  // all ranges start at multiples of MIN_RANGE, so only bigger alignments need extra space
+  const VkDeviceSize request = alignUp(a_size, MIN_RANGE);
+  const VkDeviceSize search  = a_alignment > MIN_RANGE ? request + a_alignment - MIN_RANGE : request;
+
+  uint32_t rangeId = FindFree(a_block, search);
+  if(rangeId == UINT32_MAX)
+    return false;
+
+  RemoveFree(a_block, rangeId);
+
+  const VkDeviceSize alignedOffset = alignUp(a_block.ranges[rangeId].offset, std::max(a_alignment, MIN_RANGE));
+  const VkDeviceSize pad           = alignedOffset - a_block.ranges[rangeId].offset;
+  if(pad > 0)
+  {
+    uint32_t padId  = NewRange(a_block);
+    Range &padRange = a_block.ranges[padId];
+    Range &range    = a_block.ranges[rangeId];
+
+    padRange.offset   = range.offset;
+    padRange.size     = pad;
+    padRange.prevPhys = range.prevPhys;
+    padRange.nextPhys = rangeId;
+    if(range.prevPhys != UINT32_MAX)
+      a_block.ranges[range.prevPhys].nextPhys = padId;
+
+    range.prevPhys = padId;
+    range.offset  += pad;
+    range.size    -= pad;
+    InsertFree(a_block, padId);
+  }
+
+  if(a_block.ranges[rangeId].size - request >= MIN_RANGE)
+  {
+    uint32_t tailId  = NewRange(a_block);
+    Range &tailRange = a_block.ranges[tailId];
+    Range &range     = a_block.ranges[rangeId];
+
+    tailRange.offset   = range.offset + request;
+    tailRange.size     = range.size - request;
+    tailRange.prevPhys = rangeId;
+    tailRange.nextPhys = range.nextPhys;
+    if(range.nextPhys != UINT32_MAX)
+      a_block.ranges[range.nextPhys].prevPhys = tailId;
+
+    range.nextPhys = tailId;
+    range.size     = request;
+    InsertFree(a_block, tailId);
+  }
+
+  a_block.used += a_block.ranges[rangeId].size;
+  a_block.liveAllocs++;
+  a_rangeId = rangeId;
+  return true;
+}
+
+void DeviceMemoryAllocator::FreeInBlock(Block &a_block, uint32_t a_rangeId)
+{
+  a_block.used -= a_block.ranges[a_rangeId].size;
+  a_block.liveAllocs--;
+
+  // merge with next neighbour
+  uint32_t nextId = a_block.ranges[a_rangeId].nextPhys;
+  if(nextId != UINT32_MAX && a_block.ranges[nextId].isFree)
+  {
+    RemoveFree(a_block, nextId);
+    Range &range = a_block.ranges[a_rangeId];
+    Range &next  = a_block.ranges[nextId];
+    range.size    += next.size;
+    range.nextPhys = next.nextPhys;
+    if(next.nextPhys != UINT32_MAX)
+      a_block.ranges[next.nextPhys].prevPhys = a_rangeId;
+    next = Range{};
+    a_block.unusedRanges.push_back(nextId);
+  }
+
+  // merge with previous neighbour
+  uint32_t prevId = a_block.ranges[a_rangeId].prevPhys;
+  if(prevId != UINT32_MAX && a_block.ranges[prevId].isFree)
+  {
+    RemoveFree(a_block, prevId);
+    Range &range = a_block.ranges[a_rangeId];
+    Range &prev  = a_block.ranges[prevId];
+    prev.size    += range.size;
+    prev.nextPhys = range.nextPhys;
+    if(range.nextPhys != UINT32_MAX)
+      a_block.ranges[range.nextPhys].prevPhys = prevId;
+    range = Range{};
+    a_block.unusedRanges.push_back(a_rangeId);
+    a_rangeId = prevId;
+  }
+
+  InsertFree(a_block, a_rangeId);
+}
+
+MemAllocation DeviceMemoryAllocator::Allocate(const VkMemoryRequirements &a_memReq, VkMemoryPropertyFlags a_props, bool a_isImage)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  const uint32_t memTypeIdx = vk_utils::findMemoryType(a_memReq.memoryTypeBits, a_props, m_physDevice);
+  const uint32_t poolId     = FindPool(memTypeIdx, a_isImage);
+  Pool &pool = m_pools[poolId];
+
+  MemAllocation res;
+  res.poolId = poolId;
+  res.size   = a_memReq.size;
+
+  if(a_memReq.size > m_blockSize / 2)
+  {
+    res.blockId = CreateBlock(pool, a_memReq.size, true);
+    res.memory  = pool.blocks[res.blockId]->memory;
+    res.offset  = 0;
+    res.mapped  = pool.blocks[res.blockId]->mapped;
+    pool.blocks[res.blockId]->used       = a_memReq.size;
+    pool.blocks[res.blockId]->liveAllocs = 1;
+    return res;
+  }
+
+  uint32_t rangeId = UINT32_MAX;
+  for(uint32_t i = 0; i < pool.blocks.size() && rangeId == UINT32_MAX; ++i)
+  {
+    if(pool.blocks[i] == nullptr || pool.blocks[i]->dedicated)
+      continue;
+    if(AllocateFromBlock(*pool.blocks[i], a_memReq.size, a_memReq.alignment, rangeId))
+      res.blockId = i;
+  }
+
+  if(rangeId == UINT32_MAX)
+  {
+    res.blockId = CreateBlock(pool, m_blockSize, false);
+    bool allocated = AllocateFromBlock(*pool.blocks[res.blockId], a_memReq.size, a_memReq.alignment, rangeId);
+    if(!allocated)
+      RUN_TIME_ERROR("[DeviceMemoryAllocator::Allocate] can't allocate from a new block");
+  }
+
+  const Block &block = *pool.blocks[res.blockId];
+  res.rangeId = rangeId;
+  res.memory  = block.memory;
+  res.offset  = block.ranges[rangeId].offset;
+  res.mapped  = block.mapped != nullptr ? (char*)block.mapped + res.offset : nullptr;
+
+  return res;
+}
+
+MemAllocation DeviceMemoryAllocator::AllocateAndBind(VkBuffer a_buffer, VkMemoryPropertyFlags a_props)
+{
+  VkMemoryRequirements memReq;
+  vkGetBufferMemoryRequirements(m_device, a_buffer, &memReq);
+
+  auto alloc = Allocate(memReq, a_props, false);
+  VK_CHECK_RESULT(vkBindBufferMemory(m_device, a_buffer, alloc.memory, alloc.offset));
+
+  return alloc;
+}
+
+MemAllocation DeviceMemoryAllocator::AllocateAndBind(VkImage a_image, VkMemoryPropertyFlags a_props)
+{
+  VkMemoryRequirements memReq;
+  vkGetImageMemoryRequirements(m_device, a_image, &memReq);
+
+  auto alloc = Allocate(memReq, a_props, true);
+  VK_CHECK_RESULT(vkBindImageMemory(m_device, a_image, alloc.memory, alloc.offset));
+
+  return alloc;
+}
+
+void DeviceMemoryAllocator::Free(MemAllocation &a_alloc)
+{
+  if(a_alloc.memory == VK_NULL_HANDLE)
+    return;
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  assert(a_alloc.poolId < m_pools.size());
+  Pool &pool = m_pools[a_alloc.poolId];
+  assert(a_alloc.blockId < pool.blocks.size() && pool.blocks[a_alloc.blockId] != nullptr);
+
+  Block &block = *pool.blocks[a_alloc.blockId];
+  if(block.dedicated)
+  {
+    DestroyBlock(pool, a_alloc.blockId);
+  }
+  else
+  {
+    FreeInBlock(block, a_alloc.rangeId);
+
+    // keep one empty block around, so that reloading resources doesn't churn vkAllocateMemory
+    if(block.liveAllocs == 0)
+    {
+      for(uint32_t i = 0; i < pool.blocks.size(); ++i)
+      {
+        if(i != a_alloc.blockId && pool.blocks[i] != nullptr && !pool.blocks[i]->dedicated && pool.blocks[i]->liveAllocs == 0)
+        {
+          DestroyBlock(pool, a_alloc.blockId);
+          break;
+        }
+      }
+    }
+  }
+
+  a_alloc = MemAllocation{};
+}
+
+MemAllocatorStats DeviceMemoryAllocator::GetStats() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  MemAllocatorStats stats;
+  stats.totalAllocateCalls = m_totalAllocateCalls;
+
+  VkDeviceSize freeBytes = 0;
+  for(const auto& pool : m_pools)
+  {
+    for(const auto& pBlock : pool.blocks)
+    {
+      if(pBlock == nullptr)
+        continue;
+
+      stats.deviceAllocations++;
+      stats.subAllocations += pBlock->liveAllocs;
+      stats.reservedBytes  += pBlock->size;
+      stats.usedBytes      += pBlock->used;
+
+      for(const auto& range : pBlock->ranges)
+      {
+        if(!range.isFree)
+          continue;
+        freeBytes += range.size;
+        stats.largestFreeRange = std::max(stats.largestFreeRange, range.size);
+      }
+    }
+  }
+
+  if(freeBytes > 0)
+    stats.fragmentation = 1.0f - float(double(stats.largestFreeRange) / double(freeBytes));
+
+  return stats;
+}
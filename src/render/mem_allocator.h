@@ -0,0 +1,125 @@
+#ifndef VK_GRAPHICS_BASIC_MEM_ALLOCATOR_H
+#define VK_GRAPHICS_BASIC_MEM_ALLOCATOR_H
+
+#include "volk.h"
+#include <vector>
+#include <memory>
+#include <mutex>
+
+/**
+\brief sub-allocated piece of device memory, bind resources with (memory, offset)
+*/
+struct MemAllocation
+{
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize   offset = 0;
+  VkDeviceSize   size   = 0;
+  void*          mapped = nullptr;      ///!< persistently mapped pointer for host visible memory, nullptr otherwise
+
+  uint32_t       poolId  = UINT32_MAX;
+  uint32_t       blockId = UINT32_MAX;
+  uint32_t       rangeId = UINT32_MAX;  ///!< UINT32_MAX for dedicated allocations
+};
+
+struct MemAllocatorStats
+{
+  uint32_t     deviceAllocations = 0;   ///!< live vkAllocateMemory calls
+  uint32_t     subAllocations    = 0;   ///!< live sub-allocations (including dedicated ones)
+  uint32_t     totalAllocateCalls = 0;  ///!< vkAllocateMemory calls since creation
+  VkDeviceSize reservedBytes     = 0;   ///!< total size of device memory blocks
+  VkDeviceSize usedBytes         = 0;
+  VkDeviceSize largestFreeRange  = 0;
+  float        fragmentation     = 0.0f; ///!< 1 - largestFreeRange/freeBytes, 0 means all free space is contiguous
+};
+
+/**
+\brief pooled device memory allocator
+
+Memory is requested from the driver in big blocks (one list of blocks per memory type, buffers and optimal
+images are kept in separate pools so bufferImageGranularity never matters). Blocks are sub-allocated with
+two-level segregated fit (TLSF): O(1) allocation and free with immediate coalescing of neighbour ranges.
+Requests bigger than half of a block get their own dedicated vkAllocateMemory.
+Host visible blocks are mapped once on creation.
+*/
+class DeviceMemoryAllocator
+{
+public:
+  DeviceMemoryAllocator(VkDevice a_device, VkPhysicalDevice a_physDevice, VkDeviceSize a_blockSize = 64 * 1024 * 1024);
+  ~DeviceMemoryAllocator();
+
+  DeviceMemoryAllocator(const DeviceMemoryAllocator&) = delete;
+  DeviceMemoryAllocator& operator=(const DeviceMemoryAllocator&) = delete;
+
+  MemAllocation Allocate(const VkMemoryRequirements &a_memReq, VkMemoryPropertyFlags a_props, bool a_isImage);
+  MemAllocation AllocateAndBind(VkBuffer a_buffer, VkMemoryPropertyFlags a_props);
+  MemAllocation AllocateAndBind(VkImage a_image, VkMemoryPropertyFlags a_props);
+  void Free(MemAllocation &a_alloc);
+
+  MemAllocatorStats GetStats() const;
+
+private:
+  static constexpr uint32_t SL_LOG2  = 2;          // 4 second level lists per power of two
+  static constexpr uint32_t SL_COUNT = 1u << SL_LOG2;
+  static constexpr uint32_t FL_COUNT = 48;
+  static constexpr VkDeviceSize MIN_RANGE = 256;
+
+  struct Range
+  {
+    VkDeviceSize offset   = 0;
+    VkDeviceSize size     = 0;
+    uint32_t     prevPhys = UINT32_MAX;
+    uint32_t     nextPhys = UINT32_MAX;
+    uint32_t     prevFree = UINT32_MAX;
+    uint32_t     nextFree = UINT32_MAX;
+    bool         isFree   = false;
+  };
+
+  struct Block
+  {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize   size   = 0;
+    VkDeviceSize   used   = 0;
+    void*          mapped = nullptr;
+    bool           dedicated = false;
+
+    std::vector<Range>    ranges;
+    std::vector<uint32_t> unusedRanges;  // recycled slots in 'ranges'
+    uint32_t              liveAllocs = 0;
+
+    uint64_t flMap = 0;
+    uint32_t slMap[FL_COUNT] = {};
+    uint32_t freeHeads[FL_COUNT][SL_COUNT];
+  };
+
+  struct Pool
+  {
+    uint32_t memTypeIdx = UINT32_MAX;
+    bool     isImage    = false;
+    bool     isMapped   = false;
+    std::vector<std::unique_ptr<Block>> blocks;
+  };
+
+  uint32_t FindPool(uint32_t a_memTypeIdx, bool a_isImage);
+  uint32_t CreateBlock(Pool &a_pool, VkDeviceSize a_size, bool a_dedicated);
+  void     DestroyBlock(Pool &a_pool, uint32_t a_blockId);
+  bool     AllocateFromBlock(Block &a_block, VkDeviceSize a_size, VkDeviceSize a_alignment, uint32_t &a_rangeId);
+  void     FreeInBlock(Block &a_block, uint32_t a_rangeId);
+
+  uint32_t NewRange(Block &a_block);
+  void     InsertFree(Block &a_block, uint32_t a_rangeId);
+  void     RemoveFree(Block &a_block, uint32_t a_rangeId);
+  uint32_t FindFree(Block &a_block, VkDeviceSize a_size);
+
+  static void MappingInsert(VkDeviceSize a_size, uint32_t &fl, uint32_t &sl);
+
+  VkDevice         m_device     = VK_NULL_HANDLE;
+  VkPhysicalDevice m_physDevice = VK_NULL_HANDLE;
+  VkDeviceSize     m_blockSize  = 0;
+  VkPhysicalDeviceMemoryProperties m_memProps = {};
+
+  std::vector<Pool> m_pools;
+  uint32_t m_totalAllocateCalls = 0;
+  mutable std::mutex m_mutex;
+};
+
+#endif// VK_GRAPHICS_BASIC_MEM_ALLOCATOR_H
@@ -0,0 +1,435 @@
+#include "moment_shadow_map.h"
+#include "../../resources/shaders/common.h"
+#include <vk_utils.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+  constexpr uint32_t BLUR_GROUP_SIZE = 128; // must match shadow_blur.comp
+
+  struct BlurPushConst
+  {
+    int32_t horizontal;
+    int32_t radius;
+    float   sigma;
+    int32_t pad;
+  };
+
+  bool hasFeatures(VkPhysicalDevice a_physDevice, VkFormat a_format, VkFormatFeatureFlags a_features)
+  {
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(a_physDevice, a_format, &props);
+    return (props.optimalTilingFeatures & a_features) == a_features;
+  }
+
+  VkImageMemoryBarrier imageBarrier(VkImage a_image, uint32_t a_baseMip, uint32_t a_mipCount,
+                                    VkAccessFlags a_srcAccess, VkAccessFlags a_dstAccess,
+                                    VkImageLayout a_oldLayout, VkImageLayout a_newLayout)
+  {
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask       = a_srcAccess;
+    barrier.dstAccessMask       = a_dstAccess;
+    barrier.oldLayout           = a_oldLayout;
+    barrier.newLayout           = a_newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image               = a_image;
+    barrier.subresourceRange    = {VK_IMAGE_ASPECT_COLOR_BIT, a_baseMip, a_mipCount, 0, 1};
+    return barrier;
+  }
+}
+
+MomentShadowMap::MomentShadowMap(VkDevice a_device, VkPhysicalDevice a_physDevice, std::shared_ptr<DeviceMemoryAllocator> a_pAllocator,
+                                 ShaderManager &a_shaderMgr, uint32_t a_resolution, Mode a_mode, bool a_storageExtendedFormats,
+                                 VkQueue a_queue, VkCommandPool a_cmdPool) :
+                                 m_device(a_device), m_physDevice(a_physDevice), m_pAllocator(a_pAllocator), m_mode(a_mode),
+                                 m_resolution(a_resolution)
+{
+  ChooseFormat(a_storageExtendedFormats);
+  m_mipLevels = uint32_t(std::floor(std::log2(float(m_resolution)))) + 1;
+
+  const VkImageUsageFlags momentsUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
+                                         VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  CreateImage(m_moments, m_format, m_mipLevels, momentsUsage, VK_IMAGE_ASPECT_COLOR_BIT);
+  CreateImage(m_blurTmp, m_format, 1, VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+  CreateImage(m_depth, VK_FORMAT_D16_UNORM, 1, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+  CreateRenderPass();
+
+  VkImageView attachments[2] = {m_moments.viewMip0, m_depth.viewMip0};
+  VkFramebufferCreateInfo fbInfo = {};
+  fbInfo.sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+  fbInfo.renderPass      = m_renderPass;
+  fbInfo.attachmentCount = 2;
+  fbInfo.pAttachments    = attachments;
+  fbInfo.width           = m_resolution;
+  fbInfo.height          = m_resolution;
+  fbInfo.layers          = 1;
+  VK_CHECK_RESULT(vkCreateFramebuffer(m_device, &fbInfo, nullptr, &m_framebuffer));
+
+  VkSamplerCreateInfo samplerInfo = {};
+  samplerInfo.sType        = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter    = VK_FILTER_LINEAR;
+  samplerInfo.minFilter    = VK_FILTER_LINEAR;
+  samplerInfo.mipmapMode   = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.minLod       = 0.0f;
+  samplerInfo.maxLod       = float(m_mipLevels);
+  samplerInfo.borderColor  = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+  VK_CHECK_RESULT(vkCreateSampler(m_device, &samplerInfo, nullptr, &m_sampler));
+
+  // moments of the far plane (z = 1)
+  if(m_mode == Mode::VSM)
+    m_clearValues[0].color = {{1.0f, 1.0f, 0.0f, 0.0f}};
+  else
+  {
+    const float pos = std::exp(EVSM_EXPONENT_POS);
+    const float neg = -std::exp(-EVSM_EXPONENT_NEG);
+    m_clearValues[0].color = {{pos, pos * pos, neg, neg * neg}};
+  }
+  m_clearValues[1].depthStencil = {1.0f, 0};
+
+  CreateBlurPipeline(a_shaderMgr);
+  CreateDescriptorSets();
+  InitLayout(a_queue, a_cmdPool);
+}
+
+void MomentShadowMap::InitLayout(VkQueue a_queue, VkCommandPool a_cmdPool)
+{
+  // forward pipelines use the moments binding statically, even with depth map filters that never render moments
+  VkCommandBuffer cmdBuf = vk_utils::createCommandBuffer(m_device, a_cmdPool);
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuf, &beginInfo));
+
+  VkImageMemoryBarrier toClear = imageBarrier(m_moments.image, 0, m_mipLevels, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                                              VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       0, 0, nullptr, 0, nullptr, 1, &toClear);
+
+  VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, m_mipLevels, 0, 1};
+  vkCmdClearColorImage(cmdBuf, m_moments.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &m_clearValues[0].color, 1, &range);
+
+  VkImageMemoryBarrier toSample = imageBarrier(m_moments.image, 0, m_mipLevels, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       0, 0, nullptr, 0, nullptr, 1, &toSample);
+
+  VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuf));
+  vk_utils::executeCommandBufferNow(cmdBuf, a_queue, m_device);
+  vkFreeCommandBuffers(m_device, a_cmdPool, 1, &cmdBuf);
+}
+
+MomentShadowMap::~MomentShadowMap()
+{
+  if(m_blurPipeline != VK_NULL_HANDLE)
+    vkDestroyPipeline(m_device, m_blurPipeline, nullptr);
+  if(m_blurLayout != VK_NULL_HANDLE)
+    vkDestroyPipelineLayout(m_device, m_blurLayout, nullptr);
+  if(m_blurDSPool != VK_NULL_HANDLE)
+    vkDestroyDescriptorPool(m_device, m_blurDSPool, nullptr);
+  if(m_blurDSLayout != VK_NULL_HANDLE)
+    vkDestroyDescriptorSetLayout(m_device, m_blurDSLayout, nullptr);
+
+  if(m_sampler != VK_NULL_HANDLE)
+    vkDestroySampler(m_device, m_sampler, nullptr);
+  if(m_framebuffer != VK_NULL_HANDLE)
+    vkDestroyFramebuffer(m_device, m_framebuffer, nullptr);
+  if(m_renderPass != VK_NULL_HANDLE)
+    vkDestroyRenderPass(m_device, m_renderPass, nullptr);
+
+  DestroyImage(m_moments);
+  DestroyImage(m_blurTmp);
+  DestroyImage(m_depth);
+}
+
+void MomentShadowMap::ChooseFormat(bool a_storageExtendedFormats)
+{
+  const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT |
+                                        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT |
+                                        VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+
+  m_format = VK_FORMAT_R16G16B16A16_SFLOAT;
+  if(m_mode == Mode::VSM)
+  {
+    if(a_storageExtendedFormats && hasFeatures(m_physDevice, VK_FORMAT_R32G32_SFLOAT, required))
+      m_format = VK_FORMAT_R32G32_SFLOAT;
+    else
+      vk_utils::logWarning("[MomentShadowMap] RG32F can't be used for VSM on this device, falling back to RGBA16F");
+  }
+
+  if(!hasFeatures(m_physDevice, m_format, required))
+    RUN_TIME_ERROR("[MomentShadowMap] RGBA16F doesn't support storage, filtering or blits on this device");
+}
+
+void MomentShadowMap::CreateImage(Image &a_img, VkFormat a_format, uint32_t a_mipLevels, VkImageUsageFlags a_usage,
+                                  VkImageAspectFlags a_aspect)
+{
+  VkImageCreateInfo imgCreateInfo = {};
+  imgCreateInfo.sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imgCreateInfo.imageType     = VK_IMAGE_TYPE_2D;
+  imgCreateInfo.format        = a_format;
+  imgCreateInfo.extent        = VkExtent3D{m_resolution, m_resolution, 1};
+  imgCreateInfo.mipLevels     = a_mipLevels;
+  imgCreateInfo.arrayLayers   = 1;
+  imgCreateInfo.samples       = VK_SAMPLE_COUNT_1_BIT;
+  imgCreateInfo.tiling        = VK_IMAGE_TILING_OPTIMAL;
+  imgCreateInfo.usage         = a_usage;
+  imgCreateInfo.sharingMode   = VK_SHARING_MODE_EXCLUSIVE;
+  imgCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  VK_CHECK_RESULT(vkCreateImage(m_device, &imgCreateInfo, nullptr, &a_img.image));
+  a_img.alloc = m_pAllocator->AllocateAndBind(a_img.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  VkImageViewCreateInfo viewInfo = {};
+  viewInfo.sType            = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image            = a_img.image;
+  viewInfo.viewType         = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format           = a_format;
+  viewInfo.subresourceRange = {a_aspect, 0, 1, 0, 1};
+  VK_CHECK_RESULT(vkCreateImageView(m_device, &viewInfo, nullptr, &a_img.viewMip0));
+
+  viewInfo.subresourceRange.levelCount = a_mipLevels;
+  VK_CHECK_RESULT(vkCreateImageView(m_device, &viewInfo, nullptr, &a_img.viewAllMips));
+}
+
+void MomentShadowMap::DestroyImage(Image &a_img)
+{
+  if(a_img.viewAllMips != VK_NULL_HANDLE)
+    vkDestroyImageView(m_device, a_img.viewAllMips, nullptr);
+  if(a_img.viewMip0 != VK_NULL_HANDLE)
+    vkDestroyImageView(m_device, a_img.viewMip0, nullptr);
+  if(a_img.image != VK_NULL_HANDLE)
+    vkDestroyImage(m_device, a_img.image, nullptr);
+  m_pAllocator->Free(a_img.alloc);
+  a_img = Image{};
+}
+
+void MomentShadowMap::CreateRenderPass()
+{
+  VkAttachmentDescription attachments[2] = {};
+  attachments[0].format         = m_format;
+  attachments[0].samples        = VK_SAMPLE_COUNT_1_BIT;
+  attachments[0].loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  attachments[0].storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
+  attachments[0].stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  attachments[0].initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
+  attachments[0].finalLayout    = VK_IMAGE_LAYOUT_GENERAL;   // read by the blur as a storage image
+
+  attachments[1].format         = VK_FORMAT_D16_UNORM;
+  attachments[1].samples        = VK_SAMPLE_COUNT_1_BIT;
+  attachments[1].loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  attachments[1].storeOp        = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  attachments[1].stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  attachments[1].initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
+  attachments[1].finalLayout    = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  VkAttachmentReference colorRef = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+  VkAttachmentReference depthRef = {1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+  VkSubpassDescription subpass = {};
+  subpass.pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount    = 1;
+  subpass.pColorAttachments       = &colorRef;
+  subpass.pDepthStencilAttachment = &depthRef;
+
+  // previous frame sampled the moments in the fragment shader
+  VkSubpassDependency dependency = {};
+  dependency.srcSubpass    = VK_SUBPASS_EXTERNAL;
+  dependency.dstSubpass    = 0;
+  dependency.srcStageMask  = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  dependency.dstStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+  dependency.srcAccessMask = 0;
+  dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+  VkRenderPassCreateInfo renderPassInfo = {};
+  renderPassInfo.sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassInfo.attachmentCount = 2;
+  renderPassInfo.pAttachments    = attachments;
+  renderPassInfo.subpassCount    = 1;
+  renderPassInfo.pSubpasses      = &subpass;
+  renderPassInfo.dependencyCount = 1;
+  renderPassInfo.pDependencies   = &dependency;
+  VK_CHECK_RESULT(vkCreateRenderPass(m_device, &renderPassInfo, nullptr, &m_renderPass));
+}
+
+void MomentShadowMap::CreateBlurPipeline(ShaderManager &a_shaderMgr)
+{
+  VkDescriptorSetLayoutBinding bindings[2] = {};
+  for(uint32_t i = 0; i < 2; ++i)
+  {
+    bindings[i].binding         = i;
+    bindings[i].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[i].descriptorCount = 1;
+    bindings[i].stageFlags      = VK_SHADER_STAGE_COMPUTE_BIT;
+  }
+  VkDescriptorSetLayoutCreateInfo dsLayoutInfo = {};
+  dsLayoutInfo.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  dsLayoutInfo.bindingCount = 2;
+  dsLayoutInfo.pBindings    = bindings;
+  VK_CHECK_RESULT(vkCreateDescriptorSetLayout(m_device, &dsLayoutInfo, nullptr, &m_blurDSLayout));
+
+  VkPushConstantRange pcRange = {};
+  pcRange.offset     = 0;
+  pcRange.size       = sizeof(BlurPushConst);
+  pcRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+  pipelineLayoutInfo.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount         = 1;
+  pipelineLayoutInfo.pSetLayouts            = &m_blurDSLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges    = &pcRange;
+  VK_CHECK_RESULT(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_blurLayout));
+
+  // storage image format qualifier must match the image
+  const std::string formatDefine = std::string("MOMENTS_FORMAT=") + (m_format == VK_FORMAT_R32G32_SFLOAT ? "rg32f" : "rgba16f");
+  std::vector<uint32_t> code = a_shaderMgr.GetSPV("../resources/shaders/shadow_blur.comp", {formatDefine});
+
+  VkShaderModuleCreateInfo createInfo = {};
+  createInfo.sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  createInfo.pCode    = code.data();
+  createInfo.codeSize = code.size() * sizeof(uint32_t);
+
+  VkShaderModule shaderModule;
+  VK_CHECK_RESULT(vkCreateShaderModule(m_device, &createInfo, nullptr, &shaderModule));
+
+  VkComputePipelineCreateInfo pipelineInfo = {};
+  pipelineInfo.sType        = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage  = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = shaderModule;
+  pipelineInfo.stage.pName  = "main";
+  pipelineInfo.layout       = m_blurLayout;
+  VK_CHECK_RESULT(vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_blurPipeline));
+
+  vkDestroyShaderModule(m_device, shaderModule, nullptr);
+}
+
+void MomentShadowMap::CreateDescriptorSets()
+{
+  VkDescriptorPoolSize poolSize = {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 4};
+  VkDescriptorPoolCreateInfo poolInfo = {};
+  poolInfo.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.maxSets       = 2;
+  poolInfo.poolSizeCount = 1;
+  poolInfo.pPoolSizes    = &poolSize;
+  VK_CHECK_RESULT(vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_blurDSPool));
+
+  VkDescriptorSetLayout layouts[2] = {m_blurDSLayout, m_blurDSLayout};
+  VkDescriptorSetAllocateInfo allocInfo = {};
+  allocInfo.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool     = m_blurDSPool;
+  allocInfo.descriptorSetCount = 2;
+  allocInfo.pSetLayouts        = layouts;
+  VK_CHECK_RESULT(vkAllocateDescriptorSets(m_device, &allocInfo, m_blurDS));
+
+  VkDescriptorImageInfo imageInfos[4] = {};
+  imageInfos[0] = {VK_NULL_HANDLE, m_moments.viewMip0, VK_IMAGE_LAYOUT_GENERAL};
+  imageInfos[1] = {VK_NULL_HANDLE, m_blurTmp.viewMip0, VK_IMAGE_LAYOUT_GENERAL};
+  imageInfos[2] = imageInfos[1];
+  imageInfos[3] = imageInfos[0];
+
+  VkWriteDescriptorSet writes[4] = {};
+  for(uint32_t i = 0; i < 4; ++i)
+  {
+    writes[i].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[i].dstSet          = m_blurDS[i / 2];
+    writes[i].dstBinding      = i % 2;
+    writes[i].descriptorCount = 1;
+    writes[i].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    writes[i].pImageInfo      = &imageInfos[i];
+  }
+  vkUpdateDescriptorSets(m_device, 4, writes, 0, nullptr);
+}
+
+VkRenderPassBeginInfo MomentShadowMap::GetRenderPassBeginInfo()
+{
+  VkRenderPassBeginInfo beginInfo = {};
+  beginInfo.sType             = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  beginInfo.renderPass        = m_renderPass;
+  beginInfo.framebuffer       = m_framebuffer;
+  beginInfo.renderArea.offset = {0, 0};
+  beginInfo.renderArea.extent = {m_resolution, m_resolution};
+  beginInfo.clearValueCount   = 2;
+  beginInfo.pClearValues      = m_clearValues;
+  return beginInfo;
+}
+
+void MomentShadowMap::RecordFilter(VkCommandBuffer a_cmdBuff, uint32_t a_blurRadius)
+{
+  const uint32_t radius = std::min(a_blurRadius, MAX_BLUR_RADIUS);
+  if(radius > 0)
+  {
+    VkImageMemoryBarrier toBlur[2] = {
+      imageBarrier(m_moments.image, 0, 1, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                   VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL),
+      imageBarrier(m_blurTmp.image, 0, 1, 0, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL)};
+    vkCmdPipelineBarrier(a_cmdBuff, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 2, toBlur);
+
+    vkCmdBindPipeline(a_cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, m_blurPipeline);
+
+    // one workgroup per BLUR_GROUP_SIZE texels of a row (or column), the same dispatch size for both passes
+    BlurPushConst pc {1, int32_t(radius), std::max(0.5f * float(radius), 0.5f), 0};
+    const uint32_t groups = (m_resolution + BLUR_GROUP_SIZE - 1) / BLUR_GROUP_SIZE;
+
+    vkCmdBindDescriptorSets(a_cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, m_blurLayout, 0, 1, &m_blurDS[0], 0, nullptr);
+    vkCmdPushConstants(a_cmdBuff, m_blurLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pc), &pc);
+    vkCmdDispatch(a_cmdBuff, groups, m_resolution, 1);
+
+    VkImageMemoryBarrier toVertical[2] = {
+      imageBarrier(m_blurTmp.image, 0, 1, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                   VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL),
+      imageBarrier(m_moments.image, 0, 1, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                   VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL)};
+    vkCmdPipelineBarrier(a_cmdBuff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 0, nullptr, 0, nullptr, 2, toVertical);
+
+    pc.horizontal = 0;
+    vkCmdBindDescriptorSets(a_cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, m_blurLayout, 0, 1, &m_blurDS[1], 0, nullptr);
+    vkCmdPushConstants(a_cmdBuff, m_blurLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pc), &pc);
+    vkCmdDispatch(a_cmdBuff, groups, m_resolution, 1);
+  }
+
+  // mip chain: level i - 1 (TRANSFER_SRC) is downsampled into level i (TRANSFER_DST)
+  VkImageMemoryBarrier toTransfer[2] = {
+    imageBarrier(m_moments.image, 0, 1, VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                 VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL),
+    imageBarrier(m_moments.image, 1, m_mipLevels - 1, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                 VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)};
+  vkCmdPipelineBarrier(a_cmdBuff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, m_mipLevels > 1 ? 2 : 1, toTransfer);
+
+  for(uint32_t level = 1; level < m_mipLevels; ++level)
+  {
+    const int32_t srcSize = int32_t(std::max(m_resolution >> (level - 1), 1u));
+    const int32_t dstSize = int32_t(std::max(m_resolution >> level, 1u));
+
+    VkImageBlit blit = {};
+    blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1};
+    blit.srcOffsets[1]  = {srcSize, srcSize, 1};
+    blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+    blit.dstOffsets[1]  = {dstSize, dstSize, 1};
+    vkCmdBlitImage(a_cmdBuff, m_moments.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_moments.image,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+    VkImageMemoryBarrier toSrc = imageBarrier(m_moments.image, level, 1, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    vkCmdPipelineBarrier(a_cmdBuff, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &toSrc);
+  }
+
+  VkImageMemoryBarrier toSample = imageBarrier(m_moments.image, 0, m_mipLevels, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                                               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  vkCmdPipelineBarrier(a_cmdBuff, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       0, 0, nullptr, 0, nullptr, 1, &toSample);
+}
@@ -0,0 +1,100 @@
+#ifndef VK_GRAPHICS_BASIC_MOMENT_SHADOW_MAP_H
+#define VK_GRAPHICS_BASIC_MOMENT_SHADOW_MAP_H
+
+#include "volk.h"
+#include "mem_allocator.h"
+#include "shader_manager.h"
+
+#include <memory>
+
+/**
+\brief render target and filtering for variance (VSM) and exponential variance (EVSM) shadow maps
+
+Moments of light space depth are rendered into the color attachment of GetRenderPass() (see shadow_moments.frag),
+then RecordFilter() blurs them with a separable Gaussian in compute shaders (rows, then columns, through
+shared memory) and builds the mip chain with blits. Unlike depth maps, moments can be filtered linearly,
+so the result is sampled with a trilinear sampler and resolved with Chebyshev's inequality (see simple_shadow.frag),
+which gives soft shadows from a low resolution map.
+
+VSM stores (z, z^2) in RG32F, EVSM stores both moments of exp(c+ z) and -exp(-c- z) in RGBA16F.
+If RG32F can't be a storage image or can't be filtered, VSM falls back to RGBA16F.
+*/
+class MomentShadowMap
+{
+public:
+  enum class Mode { VSM, EVSM };
+
+  /**
+  \param a_storageExtendedFormats - VkPhysicalDeviceFeatures::shaderStorageImageExtendedFormats is enabled, required for RG32F
+  \param a_queue, a_cmdPool - the moments are cleared to the far plane and made SHADER_READ_ONLY_OPTIMAL right away,
+         so the view may be bound (and sampled) before the first RecordFilter()
+  */
+  MomentShadowMap(VkDevice a_device, VkPhysicalDevice a_physDevice, std::shared_ptr<DeviceMemoryAllocator> a_pAllocator,
+                  ShaderManager &a_shaderMgr, uint32_t a_resolution, Mode a_mode, bool a_storageExtendedFormats,
+                  VkQueue a_queue, VkCommandPool a_cmdPool);
+  ~MomentShadowMap();
+
+  MomentShadowMap(const MomentShadowMap&) = delete;
+  MomentShadowMap& operator=(const MomentShadowMap&) = delete;
+
+  /// clear values are the moments of the far plane, so empty texels are lit
+  VkRenderPassBeginInfo GetRenderPassBeginInfo();
+
+  /**
+  \brief blur moments written by the render pass and build mips, after that the view can be sampled in fragment shaders
+  \param a_blurRadius - in texels of the top mip, clamped to MAX_BLUR_RADIUS, 0 only builds mips
+  */
+  void RecordFilter(VkCommandBuffer a_cmdBuff, uint32_t a_blurRadius);
+
+  VkRenderPass GetRenderPass() const { return m_renderPass; }
+  VkImageView  GetView()       const { return m_moments.viewAllMips; }
+  VkSampler    GetSampler()    const { return m_sampler; }
+  VkFormat     GetFormat()     const { return m_format; }
+  Mode         GetMode()       const { return m_mode; }
+  uint32_t     GetResolution() const { return m_resolution; }
+
+  static constexpr uint32_t MAX_BLUR_RADIUS = 16; // must match shadow_blur.comp
+
+private:
+  struct Image
+  {
+    VkImage       image       = VK_NULL_HANDLE;
+    VkImageView   viewAllMips = VK_NULL_HANDLE;
+    VkImageView   viewMip0    = VK_NULL_HANDLE;
+    MemAllocation alloc {};
+  };
+
+  void ChooseFormat(bool a_storageExtendedFormats);
+  void CreateImage(Image &a_img, VkFormat a_format, uint32_t a_mipLevels, VkImageUsageFlags a_usage, VkImageAspectFlags a_aspect);
+  void DestroyImage(Image &a_img);
+  void CreateRenderPass();
+  void CreateBlurPipeline(ShaderManager &a_shaderMgr);
+  void CreateDescriptorSets();
+  void InitLayout(VkQueue a_queue, VkCommandPool a_cmdPool);
+
+  VkDevice         m_device     = VK_NULL_HANDLE;
+  VkPhysicalDevice m_physDevice = VK_NULL_HANDLE;
+  std::shared_ptr<DeviceMemoryAllocator> m_pAllocator;
+
+  Mode     m_mode;
+  VkFormat m_format     = VK_FORMAT_UNDEFINED;
+  uint32_t m_resolution = 0;
+  uint32_t m_mipLevels  = 1;
+
+  Image m_moments;   // render target and final result, all mips
+  Image m_blurTmp;   // result of the horizontal pass, mip 0 only
+  Image m_depth;
+
+  VkRenderPass  m_renderPass  = VK_NULL_HANDLE;
+  VkFramebuffer m_framebuffer = VK_NULL_HANDLE;
+  VkSampler     m_sampler     = VK_NULL_HANDLE;
+  VkClearValue  m_clearValues[2] {};
+
+  VkDescriptorSetLayout m_blurDSLayout = VK_NULL_HANDLE;
+  VkDescriptorPool      m_blurDSPool   = VK_NULL_HANDLE;
+  VkDescriptorSet       m_blurDS[2]    = {VK_NULL_HANDLE, VK_NULL_HANDLE}; // moments -> tmp, tmp -> moments
+  VkPipelineLayout      m_blurLayout   = VK_NULL_HANDLE;
+  VkPipeline            m_blurPipeline = VK_NULL_HANDLE;
+};
+
+#endif// VK_GRAPHICS_BASIC_MOMENT_SHADOW_MAP_H
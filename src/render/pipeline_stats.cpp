@@ -0,0 +1,191 @@
+#include "pipeline_stats.h"
+#include <vk_utils.h>
+
+#include <algorithm>
+
+namespace
+{
+  // results are written in the order of bits, followed by the availability value
+  constexpr VkQueryPipelineStatisticFlags STATISTICS = VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+                                                       VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+                                                       VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+  constexpr uint32_t VALUES_PER_QUERY = 4;
+}
+
+PipelineStatistics::PipelineStatistics(VkDevice a_device, bool a_featureEnabled, uint32_t a_framesInFlight, uint32_t a_maxScopes)
+  : m_device(a_device), m_enabled(a_featureEnabled), m_maxQueries(a_maxScopes)
+{
+  if(!m_enabled)
+  {
+    vk_utils::logWarning("[PipelineStatistics] pipelineStatisticsQuery feature is not enabled, pipeline statistics are disabled");
+    return;
+  }
+
+  m_slots.resize(a_framesInFlight);
+  for(auto& slot : m_slots)
+  {
+    VkQueryPoolCreateInfo poolInfo = {};
+    poolInfo.sType              = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType          = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    poolInfo.queryCount         = m_maxQueries;
+    poolInfo.pipelineStatistics = STATISTICS;
+    VK_CHECK_RESULT(vkCreateQueryPool(m_device, &poolInfo, nullptr, &slot.pool));
+    slot.scopes.reserve(m_maxQueries);
+  }
+}
+
+PipelineStatistics::~PipelineStatistics()
+{
+  for(auto& slot : m_slots)
+    vkDestroyQueryPool(m_device, slot.pool, nullptr);
+}
+
+uint32_t PipelineStatistics::NameId(const char* a_name)
+{
+  auto pFound = m_nameIds.find(a_name);
+  if(pFound != m_nameIds.end())
+    return pFound->second;
+
+  const uint32_t id = uint32_t(m_names.size());
+  m_names.emplace_back(a_name);
+  m_last.emplace_back();
+  m_total.emplace_back();
+  m_frames.push_back(0);
+  m_measured.push_back(false);
+  m_nameIds[a_name] = id;
+  return id;
+}
+
+void PipelineStatistics::BeginFrame(VkCommandBuffer a_cmdBuff, uint32_t a_frameSlot)
+{
+  if(!m_enabled)
+    return;
+
+  FrameSlot &slot = m_slots[a_frameSlot % m_slots.size()];
+  if(slot.submitted)
+    CollectResults(slot);
+
+  slot.scopes.clear();
+  slot.open      = false;
+  slot.submitted = false;
+  m_pCurrent     = &slot;
+
+  vkCmdResetQueryPool(a_cmdBuff, slot.pool, 0, m_maxQueries);
+}
+
+void PipelineStatistics::BeginScope(VkCommandBuffer a_cmdBuff, const char* a_name)
+{
+  if(!m_enabled || m_pCurrent == nullptr)
+    return;
+
+  FrameSlot &slot = *m_pCurrent;
+  if(slot.open)
+  {
+    vk_utils::logWarning(std::string("[PipelineStatistics::BeginScope] scopes can't be nested, ") + a_name + " is not measured");
+    return;
+  }
+  if(slot.scopes.size() >= m_maxQueries)
+    return;
+
+  ScopeRecord scope {NameId(a_name), uint32_t(slot.scopes.size())};
+  vkCmdBeginQuery(a_cmdBuff, slot.pool, scope.query, 0);
+  slot.scopes.push_back(scope);
+  slot.open = true;
+}
+
+void PipelineStatistics::EndScope(VkCommandBuffer a_cmdBuff)
+{
+  if(!m_enabled || m_pCurrent == nullptr || !m_pCurrent->open)
+    return;
+
+  FrameSlot &slot = *m_pCurrent;
+  auto &scope = slot.scopes.back();
+  vkCmdEndQuery(a_cmdBuff, slot.pool, scope.query);
+  scope.ended = true;
+  slot.open   = false;
+}
+
+void PipelineStatistics::FrameSubmitted(uint32_t a_frameSlot)
+{
+  if(!m_enabled)
+    return;
+
+  FrameSlot &slot = m_slots[a_frameSlot % m_slots.size()];
+  if(slot.open)
+    vk_utils::logWarning("[PipelineStatistics::FrameSubmitted] the last scope was not closed");
+  slot.submitted = !slot.scopes.empty();
+  if(m_pCurrent == &slot)
+    m_pCurrent = nullptr;
+}
+
+void PipelineStatistics::CollectResults(FrameSlot &a_slot)
+{
+  // the frame fence was already waited, so this normally never misses
+  std::vector<uint64_t> data(a_slot.scopes.size() * VALUES_PER_QUERY);
+  const VkResult res = vkGetQueryPoolResults(m_device, a_slot.pool, 0, uint32_t(a_slot.scopes.size()),
+                                             data.size() * sizeof(uint64_t), data.data(), VALUES_PER_QUERY * sizeof(uint64_t),
+                                             VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+  if(res != VK_SUCCESS && res != VK_NOT_READY)
+    VK_CHECK_RESULT(res);
+
+  // a scope name used several times in a frame is accumulated
+  std::vector<bool> seen(m_names.size(), false);
+  for(const auto& scope : a_slot.scopes)
+  {
+    const uint64_t* pValues = &data[size_t(scope.query) * VALUES_PER_QUERY];
+    if(!scope.ended || pValues[3] == 0)
+      continue;
+
+    Counters &dst = m_last[scope.nameId];
+    if(!seen[scope.nameId])
+      dst = Counters{};
+    dst.vertexInvocations   += pValues[0];
+    dst.clippingPrimitives  += pValues[1];
+    dst.fragmentInvocations += pValues[2];
+    seen[scope.nameId]       = true;
+    m_measured[scope.nameId] = true;
+  }
+
+  for(size_t id = 0; id < seen.size(); ++id)
+  {
+    if(!seen[id])
+      continue;
+    m_total[id].vertexInvocations   += m_last[id].vertexInvocations;
+    m_total[id].clippingPrimitives  += m_last[id].clippingPrimitives;
+    m_total[id].fragmentInvocations += m_last[id].fragmentInvocations;
+    m_frames[id]++;
+  }
+}
+
+bool PipelineStatistics::GetLast(const std::string &a_name, Counters* a_pOut) const
+{
+  auto pFound = m_nameIds.find(a_name);
+  if(pFound == m_nameIds.end() || !m_measured[pFound->second])
+    return false;
+  *a_pOut = m_last[pFound->second];
+  return true;
+}
+
+std::vector<PipelineStatistics::ScopeStats> PipelineStatistics::GetStats() const
+{
+  std::vector<ScopeStats> res;
+  res.reserve(m_names.size());
+  for(size_t id = 0; id < m_names.size(); ++id)
+  {
+    if(!m_measured[id])
+      continue;
+    ScopeStats stats;
+    stats.name   = m_names[id];
+    stats.last   = m_last[id];
+    stats.total  = m_total[id];
+    stats.frames = m_frames[id];
+    res.push_back(stats);
+  }
+  return res;
+}
+
+void PipelineStatistics::ResetTotals()
+{
+  std::fill(m_total.begin(), m_total.end(), Counters{});
+  std::fill(m_frames.begin(), m_frames.end(), 0u);
+}
@@ -0,0 +1,102 @@
+#ifndef VK_GRAPHICS_BASIC_PIPELINE_STATS_H
+#define VK_GRAPHICS_BASIC_PIPELINE_STATS_H
+
+#include "volk.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+\brief per pass pipeline statistics: vertex shader invocations, primitives after clipping and fragment shader invocations
+
+Same frame slot scheme as GpuProfiler: every frame in flight has its own query pool, queries of a frame are read back
+when the same frame slot is recorded again, so results are a_framesInFlight frames late and reading never stalls.
+Statistics queries can't be nested, and a scope must begin and end in the same subpass (or both outside render passes).
+Usage per frame:
+
+  BeginFrame(cmd, frameSlot);                     // before any scope, outside of render passes
+  BeginScope(cmd, "forward"); ... EndScope(cmd);  // scopes may be in other command buffers of the frame
+  FrameSubmitted(frameSlot);                      // after vkQueueSubmit, frames recorded but never submitted are ignored
+
+Requires VkPhysicalDeviceFeatures::pipelineStatisticsQuery, everything is a no-op without it.
+*/
+class PipelineStatistics
+{
+public:
+  PipelineStatistics(VkDevice a_device, bool a_featureEnabled, uint32_t a_framesInFlight, uint32_t a_maxScopes = 16);
+  ~PipelineStatistics();
+
+  PipelineStatistics(const PipelineStatistics&) = delete;
+  PipelineStatistics& operator=(const PipelineStatistics&) = delete;
+
+  void BeginFrame(VkCommandBuffer a_cmdBuff, uint32_t a_frameSlot);
+  void BeginScope(VkCommandBuffer a_cmdBuff, const char* a_name);
+  void EndScope(VkCommandBuffer a_cmdBuff);
+  void FrameSubmitted(uint32_t a_frameSlot);
+
+  struct Counters
+  {
+    uint64_t vertexInvocations   = 0;
+    uint64_t clippingPrimitives  = 0; ///!< primitives that passed clipping, i.e. reached rasterization
+    uint64_t fragmentInvocations = 0;
+  };
+
+  /// counters of the latest profiled frame that contained the scope, false if the scope was never measured
+  bool GetLast(const std::string &a_name, Counters* a_pOut) const;
+
+  struct ScopeStats
+  {
+    std::string name;
+    Counters    last;
+    Counters    total;      ///!< sum over frames since the last ResetTotals()
+    uint32_t    frames = 0; ///!< frames that contained the scope since the last ResetTotals()
+
+    double AvgVertexInvocations()   const { return frames > 0 ? double(total.vertexInvocations)   / double(frames) : 0.0; }
+    double AvgClippingPrimitives()  const { return frames > 0 ? double(total.clippingPrimitives)  / double(frames) : 0.0; }
+    double AvgFragmentInvocations() const { return frames > 0 ? double(total.fragmentInvocations) / double(frames) : 0.0; }
+  };
+
+  /// all scopes measured at least once, in order of their first BeginScope
+  std::vector<ScopeStats> GetStats() const;
+
+  /// starts new totals, e.g. after benchmark warmup; results of frames still in flight go to the new totals
+  void ResetTotals();
+
+  bool Enabled() const { return m_enabled; }
+
+private:
+  struct ScopeRecord
+  {
+    uint32_t nameId;
+    uint32_t query;
+    bool     ended = false;
+  };
+
+  struct FrameSlot
+  {
+    VkQueryPool pool = VK_NULL_HANDLE;
+    std::vector<ScopeRecord> scopes;
+    bool     open      = false;         // the last scope has no EndScope yet
+    bool     submitted = false;
+  };
+
+  void CollectResults(FrameSlot &a_slot);
+  uint32_t NameId(const char* a_name);
+
+  VkDevice m_device = VK_NULL_HANDLE;
+  bool     m_enabled = false;
+  uint32_t m_maxQueries = 0;
+
+  std::vector<FrameSlot> m_slots;
+  FrameSlot* m_pCurrent = nullptr;
+
+  std::vector<std::string> m_names;
+  std::unordered_map<std::string, uint32_t> m_nameIds;
+  std::vector<Counters> m_last;             // per name id
+  std::vector<Counters> m_total;            // per name id
+  std::vector<uint32_t> m_frames;           // per name id
+  std::vector<bool>     m_measured;         // per name id
+};
+
+#endif// VK_GRAPHICS_BASIC_PIPELINE_STATS_H
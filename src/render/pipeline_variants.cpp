@@ -0,0 +1,88 @@
+#include "pipeline_variants.h"
+#include <vk_utils.h>
+
+#include <algorithm>
+
+SpecializationConstants& SpecializationConstants::Set(uint32_t a_constantId, uint32_t a_value)
+{
+  auto pos = std::lower_bound(m_entries.begin(), m_entries.end(), a_constantId,
+                              [](const VkSpecializationMapEntry &entry, uint32_t id) { return entry.constantID < id; });
+  const size_t idx = size_t(pos - m_entries.begin());
+  if(pos != m_entries.end() && pos->constantID == a_constantId)
+  {
+    m_data[idx] = a_value;
+    return *this;
+  }
+
+  m_entries.insert(pos, VkSpecializationMapEntry{a_constantId, 0, sizeof(uint32_t)});
+  m_data.insert(m_data.begin() + ptrdiff_t(idx), a_value);
+  for(size_t i = 0; i < m_entries.size(); ++i)
+    m_entries[i].offset = uint32_t(i * sizeof(uint32_t));
+  return *this;
+}
+
+const VkSpecializationInfo* SpecializationConstants::Info()
+{
+  m_info.mapEntryCount = uint32_t(m_entries.size());
+  m_info.pMapEntries   = m_entries.data();
+  m_info.dataSize      = m_data.size() * sizeof(uint32_t);
+  m_info.pData         = m_data.data();
+  return &m_info;
+}
+
+uint64_t SpecializationConstants::Key() const
+{
+  uint64_t hash = 14695981039346656037ull; // FNV-1a over (id, value) pairs
+  auto add = [&hash](uint32_t a_word) {
+    for(int i = 0; i < 4; ++i)
+    {
+      hash ^= (a_word >> (8 * i)) & 0xFFu;
+      hash *= 1099511628211ull;
+    }
+  };
+  for(size_t i = 0; i < m_entries.size(); ++i)
+  {
+    add(m_entries[i].constantID);
+    add(m_data[i]);
+  }
+  return hash;
+}
+
+void SetSpecialization(vk_utils::GraphicsPipelineMaker &a_maker, VkShaderStageFlags a_stages, const VkSpecializationInfo* a_pInfo)
+{
+  // other stages are reset, so a pointer left from a previous pipeline of the same maker is never used
+  for(auto& stageInfo : a_maker.shaderStageInfos)
+    stageInfo.pSpecializationInfo = (stageInfo.stage & a_stages) != 0 ? a_pInfo : nullptr;
+}
+
+void PipelineVariants::Reset(VkDevice a_device, MakeFunc a_make)
+{
+  Clear();
+  m_device = a_device;
+  m_make   = std::move(a_make);
+}
+
+VkPipeline PipelineVariants::Get(SpecializationConstants &a_constants)
+{
+  const uint64_t key = a_constants.Key();
+  auto pFound = m_pipelines.find(key);
+  if(pFound != m_pipelines.end())
+    return pFound->second;
+
+  if(!m_make)
+    RUN_TIME_ERROR("[PipelineVariants::Get] Reset() was not called");
+
+  VkPipeline pipeline = m_make(a_constants.Info());
+  m_pipelines[key] = pipeline;
+  return pipeline;
+}
+
+void PipelineVariants::Clear()
+{
+  for(auto& [key, pipeline] : m_pipelines)
+  {
+    if(pipeline != VK_NULL_HANDLE)
+      vkDestroyPipeline(m_device, pipeline, nullptr);
+  }
+  m_pipelines.clear();
+}
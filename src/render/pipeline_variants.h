@@ -0,0 +1,75 @@
+#ifndef VK_GRAPHICS_BASIC_PIPELINE_VARIANTS_H
+#define VK_GRAPHICS_BASIC_PIPELINE_VARIANTS_H
+
+#include "volk.h"
+#include <vk_pipeline.h>
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+/**
+\brief values of specialization constants (layout(constant_id = N) in GLSL) of one pipeline variant
+
+Every constant is stored as 4 bytes, which matches bool, int, uint and float in SPIR-V.
+Constants which are not declared by a shader stage are ignored by the driver, so the same set may be used for all stages.
+*/
+class SpecializationConstants
+{
+public:
+  SpecializationConstants& Set(uint32_t a_constantId, uint32_t a_value);
+  SpecializationConstants& Set(uint32_t a_constantId, int32_t a_value) { return Set(a_constantId, uint32_t(a_value)); }
+  SpecializationConstants& Set(uint32_t a_constantId, bool a_value)    { return Set(a_constantId, uint32_t(a_value ? 1 : 0)); }
+
+  /// valid until the next Set() call or destruction of this object
+  const VkSpecializationInfo* Info();
+
+  /// identical for equal sets of constants regardless of the order of Set() calls
+  uint64_t Key() const;
+
+private:
+  std::vector<VkSpecializationMapEntry> m_entries; // sorted by constantID, offset is 4 * index
+  std::vector<uint32_t>                 m_data;
+  VkSpecializationInfo                  m_info {};
+};
+
+/// sets a_pInfo for shader stages of a_maker that are in a_stages and no specialization for others, call after LoadShaders()
+void SetSpecialization(vk_utils::GraphicsPipelineMaker &a_maker, VkShaderStageFlags a_stages, const VkSpecializationInfo* a_pInfo);
+
+/**
+\brief pipelines of one program specialized for different sets of constants, created on first use
+
+Instead of branching on uniform flags per pixel, features are turned into specialization constants and every
+used combination gets its own pipeline, so the driver removes dead code after specialization.
+All variants share the pipeline layout, which is owned by the caller. a_make should create a pipeline with
+a_pInfo attached (see SetSpecialization) and must not keep the pointer.
+*/
+class PipelineVariants
+{
+public:
+  using MakeFunc = std::function<VkPipeline(const VkSpecializationInfo* a_pInfo)>;
+
+  PipelineVariants() = default;
+  ~PipelineVariants() { Clear(); }
+
+  PipelineVariants(const PipelineVariants&) = delete;
+  PipelineVariants& operator=(const PipelineVariants&) = delete;
+
+  /// destroys existing variants and sets a new way to make them (i.e. after shaders or render pass were changed)
+  void Reset(VkDevice a_device, MakeFunc a_make);
+
+  VkPipeline Get(SpecializationConstants &a_constants);
+
+  /// destroys all variants, the pipelines must not be in use by the GPU
+  void Clear();
+
+  size_t Size() const { return m_pipelines.size(); }
+
+private:
+  VkDevice m_device = VK_NULL_HANDLE;
+  MakeFunc m_make;
+  std::unordered_map<uint64_t, VkPipeline> m_pipelines; // by SpecializationConstants::Key()
+};
+
+#endif// VK_GRAPHICS_BASIC_PIPELINE_VARIANTS_H
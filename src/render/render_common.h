@@ -34,6 +34,8 @@ enum class DrawMode
   NO_GUI
 };
 
+class PipelineStatistics;
+
 class IRender
 {
 public:
@@ -47,7 +49,9 @@ public:
   virtual void UpdateCamera(const Camera* cams, uint32_t a_camsCount) = 0;
   virtual Camera GetCurrentCamera() { return { };};
   virtual void LoadScene(const char* path, bool transpose_inst_matrices) = 0;
+  virtual void ApplySceneChange(const char* /*path*/, bool /*transpose_inst_matrices*/) {} ///!< Hydra change_*.xml over the loaded scene
   virtual void DrawFrame(float a_time, DrawMode a_mode) = 0;
+  virtual PipelineStatistics* GetPipelineStatistics() { return nullptr; } ///!< per pass statistics for benchmarks, if the render has them
 
   virtual ~IRender() = default;
 
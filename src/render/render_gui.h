@@ -5,6 +5,8 @@
 #include "imgui/backends/imgui_impl_vulkan.h"
 #include "imgui/backends/imgui_impl_glfw.h"
 #include "GLFW/glfw3.h"
+#include "gpu_profiler.h"
+#include "pipeline_stats.h"
 
 #include <vk_swapchain.h>
 #include <memory>
@@ -14,6 +16,7 @@ class IRenderGUI
 public:
   virtual VkCommandBuffer BuildGUIRenderCommand(uint32_t a_swapchainFrameIdx, void* a_userData) = 0;
   virtual void OnSwapchainChanged(const VulkanSwapChain &a_swapchain) = 0;
+  virtual void SetProfiler(GpuProfiler* a_pProfiler) { (void)a_pProfiler; } ///!< GUI pass is measured as "gui" scope
   virtual ~IRenderGUI() = default;
 };
 
@@ -28,6 +31,7 @@ public:
 
   VkCommandBuffer BuildGUIRenderCommand(uint32_t a_swapchainFrameIdx, void* a_userData) override;
   void OnSwapchainChanged(const VulkanSwapChain &a_swapchain) override;
+  void SetProfiler(GpuProfiler* a_pProfiler) override { m_pProfiler = a_pProfiler; }
 
   ~ImGuiRender() override;
 
@@ -48,10 +52,21 @@ private:
   VkCommandPool m_commandPool = VK_NULL_HANDLE;
   std::vector<VkCommandBuffer> m_drawGUICmdBuffers;
   VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+  GpuProfiler* m_pProfiler = nullptr;
 
   void InitImGui();
   void CleanupImGui();
 
 };
 
+/**
+\brief ImGui window with a table of per scope GPU times of a_profiler and a button to save them to a_csvPath
+*/
+void DrawGpuProfilerWindow(const GpuProfiler &a_profiler, const char* a_csvPath = "gpu_profile.csv");
+
+/**
+\brief ImGui window with a table of per scope vertex, primitive and fragment invocations of a_stats, last frame and average
+*/
+void DrawPipelineStatsWindow(PipelineStatistics &a_stats);
+
 #endif// VK_GRAPHICS_BASIC_RENDER_GUI_H
@@ -96,12 +96,18 @@ VkCommandBuffer ImGuiRender::BuildGUIRenderCommand(uint32_t a_swapchainFrameIdx,
   rpassBeginInfo.renderArea.extent = m_swapchain->GetExtent();
   rpassBeginInfo.clearValueCount = 0;
   rpassBeginInfo.pClearValues = nullptr;
+  if(m_pProfiler != nullptr)
+    m_pProfiler->BeginScope(currentCmdBuf, "gui");
+
   vkCmdBeginRenderPass(currentCmdBuf, &rpassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
   ImGui_ImplVulkan_RenderDrawData(static_cast<ImDrawData*>(a_userData), currentCmdBuf);
 
   vkCmdEndRenderPass(currentCmdBuf);
 
+  if(m_pProfiler != nullptr)
+    m_pProfiler->EndScope(currentCmdBuf);
+
   vkEndCommandBuffer(currentCmdBuf);
 
   return currentCmdBuf;
@@ -154,4 +160,92 @@ void ImGuiRender::ClearFrameBuffers()
   m_framebuffers.clear();
 }
 
+void DrawGpuProfilerWindow(const GpuProfiler &a_profiler, const char* a_csvPath)
+{
+  ImGui::Begin("GPU profiler");
+  if(!a_profiler.Enabled())
+  {
+    ImGui::Text("Timestamps are not supported by the queue");
+    ImGui::End();
+    return;
+  }
+
+  ImGui::Text("GPU frame %.3f ms, %llu frames profiled", a_profiler.LastFrameMs(),
+              (unsigned long long)a_profiler.FramesProfiled());
 
+  const auto stats = a_profiler.GetStats();
+  if(ImGui::BeginTable("gpu_scopes", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+  {
+    ImGui::TableSetupColumn("pass");
+    ImGui::TableSetupColumn("last, ms");
+    ImGui::TableSetupColumn("avg, ms");
+    ImGui::TableSetupColumn("p50, ms");
+    ImGui::TableSetupColumn("p95, ms");
+    ImGui::TableSetupColumn("p99, ms");
+    ImGui::TableHeadersRow();
+
+    for(const auto& scope : stats)
+    {
+      ImGui::TableNextRow();
+      ImGui::TableNextColumn();
+      ImGui::Indent(float(scope.depth) * 10.0f + 1.0f);
+      ImGui::TextUnformatted(scope.name.c_str());
+      ImGui::Unindent(float(scope.depth) * 10.0f + 1.0f);
+      ImGui::TableNextColumn(); ImGui::Text("%.3f", scope.lastMs);
+      ImGui::TableNextColumn(); ImGui::Text("%.3f", scope.avgMs);
+      ImGui::TableNextColumn(); ImGui::Text("%.3f", scope.p50Ms);
+      ImGui::TableNextColumn(); ImGui::Text("%.3f", scope.p95Ms);
+      ImGui::TableNextColumn(); ImGui::Text("%.3f", scope.p99Ms);
+    }
+    ImGui::EndTable();
+  }
+
+  if(ImGui::Button("Export CSV"))
+    a_profiler.ExportCSV(a_csvPath);
+  ImGui::SameLine();
+  ImGui::Text("%s", a_csvPath);
+
+  ImGui::End();
+}
+
+void DrawPipelineStatsWindow(PipelineStatistics &a_stats)
+{
+  ImGui::Begin("Pipeline statistics");
+  if(!a_stats.Enabled())
+  {
+    ImGui::Text("pipelineStatisticsQuery is not supported by the device");
+    ImGui::End();
+    return;
+  }
+
+  const auto stats = a_stats.GetStats();
+  if(ImGui::BeginTable("pipeline_stats", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+  {
+    ImGui::TableSetupColumn("pass");
+    ImGui::TableSetupColumn("vertices");
+    ImGui::TableSetupColumn("primitives");
+    ImGui::TableSetupColumn("fragments");
+    ImGui::TableSetupColumn("avg vertices");
+    ImGui::TableSetupColumn("avg primitives");
+    ImGui::TableSetupColumn("avg fragments");
+    ImGui::TableHeadersRow();
+
+    for(const auto& scope : stats)
+    {
+      ImGui::TableNextRow();
+      ImGui::TableNextColumn(); ImGui::TextUnformatted(scope.name.c_str());
+      ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)scope.last.vertexInvocations);
+      ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)scope.last.clippingPrimitives);
+      ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)scope.last.fragmentInvocations);
+      ImGui::TableNextColumn(); ImGui::Text("%.0f", scope.AvgVertexInvocations());
+      ImGui::TableNextColumn(); ImGui::Text("%.0f", scope.AvgClippingPrimitives());
+      ImGui::TableNextColumn(); ImGui::Text("%.0f", scope.AvgFragmentInvocations());
+    }
+    ImGui::EndTable();
+  }
+
+  if(ImGui::Button("Reset averages"))
+    a_stats.ResetTotals();
+
+  ImGui::End();
+}
@@ -1,10 +1,109 @@
 #include <map>
 #include <array>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_set>
+#include <fstream>
 #include "scene_mgr.h"
 #include "vk_utils.h"
 #include "vk_buffers.h"
 #include "../loader_utils/hydraxml.h"
 
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+  // read-only view of [a_offset, a_offset + a_size) of a file; on POSIX the region is mmap-ed, so pixels go
+  // from the page cache straight to the staging buffer, elsewhere it is read into a temporary vector
+  struct FileRegion
+  {
+    FileRegion(const std::string &a_path, uint64_t a_offset, uint64_t a_size)
+    {
+#if !defined(_WIN32)
+      int fd = open(a_path.c_str(), O_RDONLY);
+      if(fd < 0)
+        return;
+
+      struct stat st = {};
+      if(fstat(fd, &st) != 0 || uint64_t(st.st_size) < a_offset + a_size) // reading mapped pages past EOF is SIGBUS
+      {
+        close(fd);
+        return;
+      }
+
+      const uint64_t pageSize    = uint64_t(sysconf(_SC_PAGESIZE));
+      const uint64_t alignedOffs = a_offset - a_offset % pageSize;
+      m_mapSize = size_t(a_size + (a_offset - alignedOffs));
+      void* ptr = mmap(nullptr, m_mapSize, PROT_READ, MAP_PRIVATE, fd, off_t(alignedOffs));
+      close(fd);
+      if(ptr == MAP_FAILED)
+        return;
+
+      m_mapping = ptr;
+      data = (const unsigned char*)ptr + (a_offset - alignedOffs);
+#else
+      std::ifstream fin(a_path, std::ios::binary);
+      fin.seekg(std::streamoff(a_offset));
+      m_copy.resize(size_t(a_size));
+      fin.read((char*)m_copy.data(), std::streamsize(a_size));
+      if(fin)
+        data = m_copy.data();
+#endif
+    }
+
+    ~FileRegion()
+    {
+#if !defined(_WIN32)
+      if(m_mapping != nullptr)
+        munmap(m_mapping, m_mapSize);
+#endif
+    }
+
+    FileRegion(const FileRegion&) = delete;
+    FileRegion& operator=(const FileRegion&) = delete;
+
+    const unsigned char* data = nullptr; // nullptr if file is missing or too short
+
+  private:
+    void*  m_mapping = nullptr;
+    size_t m_mapSize = 0;
+    std::vector<unsigned char> m_copy;
+  };
+
+  // scene buffers may be recreated bigger at runtime with their contents copied on GPU, so all of them are transfer sources
+  constexpr VkBufferUsageFlags GROWABLE_USAGE = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  // vertices are also fetched from shaders directly (vertex pulling), so they need storage usage as well
+  constexpr VkBufferUsageFlags VERTEX_USAGE   = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | GROWABLE_USAGE;
+  constexpr VkBufferUsageFlags POSITION_USAGE = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | GROWABLE_USAGE;
+  constexpr VkBufferUsageFlags INDEX_USAGE    = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | GROWABLE_USAGE;
+  constexpr VkBufferUsageFlags STORAGE_USAGE  = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | GROWABLE_USAGE;
+  constexpr VkBufferUsageFlags INDIRECT_USAGE = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | GROWABLE_USAGE;
+
+  // everything that reads scene buffers on the graphics queue
+  constexpr VkPipelineStageFlags SHADER_STAGES = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  constexpr VkPipelineStageFlags SCENE_READ_STAGES = SHADER_STAGES | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                                                     VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+  constexpr VkAccessFlags SCENE_READ_ACCESS = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+                                              VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+  void TransferBarrier(VkCommandBuffer a_cmdBuff, VkPipelineStageFlags a_srcStages, VkAccessFlags a_srcAccess,
+                       VkPipelineStageFlags a_dstStages, VkAccessFlags a_dstAccess)
+  {
+    VkMemoryBarrier barrier = {};
+    barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = a_srcAccess;
+    barrier.dstAccessMask = a_dstAccess;
+    vkCmdPipelineBarrier(a_cmdBuff, a_srcStages, a_dstStages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+  }
+}
+
 
 VkTransformMatrixKHR transformMatrixFromFloat4x4(const LiteMath::float4x4 &m)
 {
@@ -21,15 +120,37 @@ VkTransformMatrixKHR transformMatrixFromFloat4x4(const LiteMath::float4x4 &m)
 }
 
 SceneManager::SceneManager(VkDevice a_device, VkPhysicalDevice a_physDevice,
-  uint32_t a_transferQId, uint32_t a_graphicsQId, bool debug) : m_device(a_device), m_physDevice(a_physDevice),
-                 m_transferQId(a_transferQId), m_graphicsQId(a_graphicsQId), m_debug(debug)
+  uint32_t a_transferQId, uint32_t a_graphicsQId, bool debug, std::shared_ptr<DeviceMemoryAllocator> a_pAllocator) :
+                 m_device(a_device), m_physDevice(a_physDevice), m_transferQId(a_transferQId), m_graphicsQId(a_graphicsQId),
+                 m_pAllocator(a_pAllocator), m_debug(debug)
 {
+  if(m_pAllocator == nullptr)
+    m_pAllocator = std::make_shared<DeviceMemoryAllocator>(m_device, m_physDevice);
+
   vkGetDeviceQueue(m_device, m_transferQId, 0, &m_transferQ);
   vkGetDeviceQueue(m_device, m_graphicsQId, 0, &m_graphicsQ);
   VkDeviceSize scratchMemSize = 64 * 1024 * 1024;
   m_pCopyHelper = std::make_shared<vk_utils::PingPongCopyHelper>(m_physDevice, m_device, m_transferQ, m_transferQId, scratchMemSize);
   m_pMeshData   = std::make_shared<Mesh8F>();
 
+  VkPhysicalDeviceFeatures features = {};
+  vkGetPhysicalDeviceFeatures(m_physDevice, &features);
+  m_textureTableSupported = features.shaderSampledImageArrayDynamicIndexing == VK_TRUE;
+
+  m_posBinding.binding   = 0;
+  m_posBinding.stride    = sizeof(float) * 3;
+  m_posBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+  m_posAttribute.location = 0;
+  m_posAttribute.binding  = 0;
+  m_posAttribute.format   = VK_FORMAT_R32G32B32_SFLOAT;
+  m_posAttribute.offset   = 0;
+
+}
+
+void SceneManager::EnableAsyncUploads(bool a_useTimeline)
+{
+  if(m_pUploadQueue == nullptr)
+    m_pUploadQueue = std::make_unique<UploadQueue>(m_device, m_pAllocator, m_transferQId, m_graphicsQId, a_useTimeline);
 }
 
 bool SceneManager::LoadSceneXML(const std::string &scenePath, bool transpose)
@@ -43,16 +164,24 @@ bool SceneManager::LoadSceneXML(const std::string &scenePath, bool transpose)
     return false;
   }
 
-  for(auto loc : hscene_main->MeshFiles())
+  LoadMaterialsHydra(*hscene_main);
+
+  // Hydra ids are remembered, change files refer to meshes and instances by them
+  for(auto meshNode : hscene_main->GeomNodes())
   {
+    auto loc       = hscene_main->MeshLoc(meshNode);
     auto meshId    = AddMeshFromFile(loc);
     auto instances = hscene_main->GetAllInstancesOfMeshLoc(loc); 
+    auto instIds   = hscene_main->GetAllInstanceIdsOfMeshLoc(loc);
+    m_meshByHydraId[meshNode.attribute(L"id").as_uint()] = meshId;
     for(size_t j = 0; j < instances.size(); ++j)
     {
+      uint32_t instId;
       if(transpose)
-        InstanceMesh(meshId, LiteMath::transpose(instances[j]));
+        instId = InstanceMesh(meshId, LiteMath::transpose(instances[j]));
       else
-        InstanceMesh(meshId, instances[j]);
+        instId = InstanceMesh(meshId, instances[j]);
+      m_instanceByHydraId[instIds[j]] = instId;
     }
   }
 
@@ -61,12 +190,229 @@ bool SceneManager::LoadSceneXML(const std::string &scenePath, bool transpose)
     m_sceneCameras.push_back(cam);
   }
 
+  LoadLightsHydra(*hscene_main, transpose);
+
   LoadGeoDataOnGPU();
   hscene_main = nullptr;
 
   return true;
 }
 
+bool SceneManager::ApplyChangeXML(const std::string &changePath, bool transpose, SceneChangeInfo* a_pInfo)
+{
+  hydra_xml::HydraScene change;
+  if(change.LoadChange(changePath) < 0)
+  {
+    vk_utils::logWarning("[SceneManager::ApplyChangeXML] can't load change from " + changePath);
+    return false;
+  }
+
+  SceneChangeInfo info;
+
+  // change files list all meshes of the scene again, only ids not seen before are new
+  for(auto meshNode : change.GeomNodes())
+  {
+    const uint32_t hydraId = meshNode.attribute(L"id").as_uint();
+    if(m_meshByHydraId.find(hydraId) != m_meshByHydraId.end())
+      continue;
+    m_meshByHydraId[hydraId] = AddMeshFromFile(change.MeshLoc(meshNode));
+    info.newMeshes++;
+  }
+
+  std::unordered_set<uint32_t> listed;
+  for(const auto& inst : change.InstancesGeom())
+  {
+    // meshes of area lights are skipped by HydraScene::LoadState as well, so they are never in m_instanceByHydraId
+    // and the discard pass below doesn't touch them
+    if(inst.lightId != uint32_t(-1))
+      continue;
+
+    auto pMesh = m_meshByHydraId.find(inst.geomId);
+    if(pMesh == m_meshByHydraId.end())
+    {
+      std::stringstream ss;
+      ss << "[SceneManager::ApplyChangeXML] instance " << inst.id << " refers to unknown mesh " << inst.geomId << ", skipped";
+      vk_utils::logWarning(ss.str());
+      continue;
+    }
+    listed.insert(inst.id);
+
+    const LiteMath::float4x4 matrix = transpose ? LiteMath::transpose(inst.matrix) : inst.matrix;
+    auto pInst = m_instanceByHydraId.find(inst.id);
+    const bool alive = pInst != m_instanceByHydraId.end() && IsInstanceAlive(pInst->second);
+    if(alive && m_instanceInfos[pInst->second].mesh_id == pMesh->second)
+    {
+      // unchanged instances are listed too, they must not produce uploads
+      if(memcmp(&m_instanceMatrices[pInst->second], &matrix, sizeof(matrix)) != 0)
+      {
+        SetInstanceMatrix(pInst->second, matrix);
+        info.movedInstances++;
+      }
+      continue;
+    }
+
+    if(alive) // the instance now refers to another mesh
+    {
+      RemoveInstance(pInst->second);
+      info.removedInstances++;
+    }
+    m_instanceByHydraId[inst.id] = InstanceMesh(pMesh->second, matrix);
+    info.addedInstances++;
+  }
+
+  if(change.DiscardsInstances())
+  {
+    for(auto pInst = m_instanceByHydraId.begin(); pInst != m_instanceByHydraId.end();)
+    {
+      if(listed.count(pInst->first) != 0)
+      {
+        ++pInst;
+        continue;
+      }
+      if(IsInstanceAlive(pInst->second))
+      {
+        RemoveInstance(pInst->second);
+        info.removedInstances++;
+      }
+      pInst = m_instanceByHydraId.erase(pInst);
+    }
+  }
+
+  // camera ids are their indices, as in GetCamera()
+  for(auto cam : change.Cameras())
+  {
+    if(cam.id < m_sceneCameras.size() && memcmp(&m_sceneCameras[cam.id], &cam, sizeof(cam)) == 0)
+      continue;
+    if(cam.id >= m_sceneCameras.size())
+      m_sceneCameras.resize(cam.id + 1, hydra_xml::Camera{});
+    m_sceneCameras[cam.id] = cam;
+    info.camerasChanged = true;
+  }
+
+  if(a_pInfo != nullptr)
+    *a_pInfo = info;
+  return true;
+}
+
+void SceneManager::LoadMaterialsHydra(hydra_xml::HydraScene &a_scene)
+{
+  // image4ub chunks are already RGBA8, so they are uploaded as is without any decoding
+  std::unordered_map<uint32_t, uint32_t> textureByHydraId;
+  const auto textures = a_scene.TexturesLDR();
+  if(!m_textureTableSupported && !textures.empty())
+    vk_utils::logWarning("[SceneManager::LoadMaterialsHydra] no shaderSampledImageArrayDynamicIndexing, scene textures are skipped");
+
+  for(const auto& tex : textures)
+  {
+    if(!m_textureTableSupported)
+      break;
+
+    InitTextureTable(); // the placeholder takes slot 0
+    if(m_textureTable.size() >= MAX_SCENE_TEXTURES)
+    {
+      std::stringstream ss;
+      ss << "[SceneManager::LoadMaterialsHydra] texture table is full (" << MAX_SCENE_TEXTURES << "), texture " << tex.id << " is skipped";
+      vk_utils::logWarning(ss.str());
+      break;
+    }
+
+    FileRegion region(tex.path, tex.offset, uint64_t(tex.width) * tex.height * 4);
+    if(region.data == nullptr)
+    {
+      vk_utils::logWarning("[SceneManager::LoadMaterialsHydra] can't read texture at " + tex.path);
+      continue;
+    }
+    textureByHydraId[tex.id] = AddTextureRGBA8(region.data, tex.width, tex.height);
+  }
+
+  for(const auto& mat : a_scene.Materials())
+  {
+    MaterialData data = {};
+    data.baseColor    = LiteMath::float4(mat.diffuseColor.x, mat.diffuseColor.y, mat.diffuseColor.z, 1.0f);
+    data.diffuseTexId = NO_TEXTURE;
+
+    auto pTex = textureByHydraId.find(mat.diffuseTexId);
+    if(pTex != textureByHydraId.end())
+    {
+      data.diffuseTexId = pTex->second;
+      data.baseColor    = LiteMath::float4(1.0f, 1.0f, 1.0f, 1.0f); // texture replaces diffuse color in hydra
+    }
+
+    m_materialByHydraId[mat.id] = (uint32_t)m_materials.size();
+    m_materials.push_back(data);
+  }
+}
+
+void SceneManager::LoadLightsHydra(hydra_xml::HydraScene &a_scene, bool transpose)
+{
+  // radius is where intensity / distance^2 drops below this, lights are cut to zero there so culling is exact
+  constexpr float LIGHT_CUTOFF = 0.01f;
+
+  for(const auto& inst : a_scene.InstancesLights())
+  {
+    const std::wstring type = inst.lightNode.attribute(L"type").as_string();
+    if(type == L"sky")
+      continue;
+    if(type == L"directional")
+    {
+      std::stringstream ss;
+      ss << "[SceneManager::LoadLightsHydra] directional light " << inst.lightId << " is not supported and is skipped";
+      vk_utils::logWarning(ss.str());
+      continue;
+    }
+
+    auto intensityNode = inst.lightNode.child(L"intensity");
+    const float3 color = hydra_xml::readval3f(intensityNode.child(L"color")) *
+                         intensityNode.child(L"multiplier").attribute(L"val").as_float(1.0f);
+    const float maxIntensity = std::max(color.x, std::max(color.y, color.z));
+    if(maxIntensity <= 0.0f)
+      continue;
+
+    const auto matrix = transpose ? LiteMath::transpose(inst.matrix) : inst.matrix;
+    const float4 pos  = matrix * LiteMath::float4(0.0f, 0.0f, 0.0f, 1.0f);
+
+    PointLight light = {};
+    light.posRadius = LiteMath::float4(pos.x, pos.y, pos.z, std::sqrt(maxIntensity / LIGHT_CUTOFF));
+    light.color     = LiteMath::float4(color.x, color.y, color.z, 0.0f);
+    m_lights.push_back(light);
+  }
+}
+
+void SceneManager::InitTextureTable()
+{
+  if(m_pTexMgr != nullptr)
+    return;
+
+  m_pTexMgr = std::make_unique<TextureManager>(m_device, m_physDevice, m_pAllocator, m_transferQId, m_graphicsQId);
+
+  const uint32_t white = 0xFFFFFFFF;
+  m_textureTable.push_back(m_pTexMgr->AddTexture());
+  m_pTexMgr->UploadAsync(m_textureTable.back(), &white, 1, 1, VK_FORMAT_R8G8B8A8_UNORM, 4);
+
+  VkSamplerCreateInfo samplerInfo = {};
+  samplerInfo.sType        = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter    = VK_FILTER_LINEAR;
+  samplerInfo.minFilter    = VK_FILTER_LINEAR;
+  samplerInfo.mipmapMode   = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  samplerInfo.minLod       = 0.0f;
+  samplerInfo.maxLod       = VK_LOD_CLAMP_NONE;
+  samplerInfo.borderColor  = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+  VK_CHECK_RESULT(vkCreateSampler(m_device, &samplerInfo, nullptr, &m_textureSampler));
+}
+
+uint32_t SceneManager::AddTextureRGBA8(const void* a_pixels, uint32_t a_width, uint32_t a_height)
+{
+  InitTextureTable();
+
+  m_textureTable.push_back(m_pTexMgr->AddTexture());
+  m_pTexMgr->UploadAsync(m_textureTable.back(), a_pixels, a_width, a_height, VK_FORMAT_R8G8B8A8_UNORM, 4);
+
+  return (uint32_t)m_textureTable.size() - 1;
+}
+
 hydra_xml::Camera SceneManager::GetCamera(uint32_t camId) const
 {
   if(camId >= m_sceneCameras.size())
@@ -104,23 +450,8 @@ void SceneManager::LoadSingleTriangle()
   VkDeviceSize vertexBufSize = sizeof(Vertex) * vertices.size();
   VkDeviceSize indexBufSize  = sizeof(uint32_t) * indices.size();
   
-  VkMemoryRequirements vertMemReq, idxMemReq; 
-  m_geoVertBuf = vk_utils::createBuffer(m_device, vertexBufSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, &vertMemReq);
-  m_geoIdxBuf  = vk_utils::createBuffer(m_device, indexBufSize,  VK_BUFFER_USAGE_INDEX_BUFFER_BIT  | VK_BUFFER_USAGE_TRANSFER_DST_BIT, &idxMemReq);
-
-  size_t pad = vk_utils::getPaddedSize(vertMemReq.size, idxMemReq.alignment);
-
-  VkMemoryAllocateInfo allocateInfo = {};
-  allocateInfo.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocateInfo.pNext           = nullptr;
-  allocateInfo.allocationSize  = pad + idxMemReq.size;
-  allocateInfo.memoryTypeIndex = vk_utils::findMemoryType(vertMemReq.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_physDevice);
-
-
-  VK_CHECK_RESULT(vkAllocateMemory(m_device, &allocateInfo, nullptr, &m_geoMemAlloc));
-
-  VK_CHECK_RESULT(vkBindBufferMemory(m_device, m_geoVertBuf, m_geoMemAlloc, 0));
-  VK_CHECK_RESULT(vkBindBufferMemory(m_device, m_geoIdxBuf,  m_geoMemAlloc, pad));
+  m_geoVertBuf = CreateSceneBuffer(vertexBufSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+  m_geoIdxBuf  = CreateSceneBuffer(indexBufSize,  VK_BUFFER_USAGE_INDEX_BUFFER_BIT  | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
   m_pCopyHelper->UpdateBuffer(m_geoVertBuf, 0, vertices.data(),  vertexBufSize);
   m_pCopyHelper->UpdateBuffer(m_geoIdxBuf,  0, indices.data(), indexBufSize);
 }
@@ -144,6 +475,7 @@ uint32_t SceneManager::AddMeshFromData(cmesh::SimpleMesh &meshData)
   assert(meshData.IndicesNum() > 0);
 
   m_pMeshData->Append(meshData);
+  m_meshMaterials.push_back(meshData.matIndices.empty() ? uint32_t(-1) : meshData.matIndices[0]);
 
   MeshInfo info;
   info.m_vertNum = (uint32_t)meshData.VerticesNum();
@@ -159,6 +491,7 @@ uint32_t SceneManager::AddMeshFromData(cmesh::SimpleMesh &meshData)
   m_totalIndices  += (uint32_t)meshData.IndicesNum();
 
   m_meshInfos.push_back(info);
+  m_meshAlive.push_back(true);
   Box4f meshBox;
   for (uint32_t i = 0; i < meshData.VerticesNum(); ++i) {
     meshBox.include(reinterpret_cast<float4*>(meshData.vPos4f.data())[i]);
@@ -171,18 +504,49 @@ uint32_t SceneManager::AddMeshFromData(cmesh::SimpleMesh &meshData)
 uint32_t SceneManager::InstanceMesh(const uint32_t meshId, const LiteMath::float4x4 &matrix, bool markForRender)
 {
   assert(meshId < m_meshInfos.size());
+  assert(m_meshAlive[meshId]);
 
-  //@TODO: maybe move
-  m_instanceMatrices.push_back(matrix);
+  // slots of removed instances are reused first, so add/remove cycles don't grow instance buffers
+  uint32_t instId;
+  if(!m_freeInstances.empty())
+  {
+    instId = m_freeInstances.back();
+    m_freeInstances.pop_back();
+  }
+  else
+  {
+    instId = (uint32_t)m_instanceInfos.size();
+    m_instanceMatrices.emplace_back();
+    m_instanceInfos.emplace_back();
+    m_instanceBboxes.emplace_back();
+    if(Uploaded())
+      m_instanceMaterials.push_back(0);
+  }
 
   InstanceInfo info;
-  info.inst_id       = (uint32_t)m_instanceMatrices.size() - 1;
+  info.inst_id       = instId;
   info.mesh_id       = meshId;
   info.renderMark    = markForRender;
-  info.instBufOffset = (m_instanceMatrices.size() - 1) * sizeof(matrix);
+  info.instBufOffset = instId * sizeof(matrix);
+
+  m_instanceInfos[instId]    = info;
+  m_instanceMatrices[instId] = matrix;
+  m_instanceBboxes[instId]   = InstanceBox(meshId, matrix);
+  sceneBbox.include(m_instanceBboxes[instId]);
+
+  // before the first upload materials of all instances are resolved by LoadGeoDataOnGPU
+  if(Uploaded())
+  {
+    m_instanceMaterials[instId] = InstanceMaterial(meshId);
+    MarkInstanceDirty(instId);
+    m_drawListsDirty = true;
+  }
 
-  m_instanceInfos.push_back(info);
+  return info.inst_id;
+}
 
+LiteMath::Box4f SceneManager::InstanceBox(uint32_t meshId, const LiteMath::float4x4 &matrix) const
+{
   Box4f instBox;
   for (uint32_t i = 0; i < 8; ++i) {
     float4 corner = float4(
@@ -193,37 +557,155 @@ uint32_t SceneManager::InstanceMesh(const uint32_t meshId, const LiteMath::float
     );
     instBox.include(matrix * corner);
   }
-  sceneBbox.include(instBox);
-  m_instanceBboxes.push_back(instBox);
-
-  return info.inst_id;
+  return instBox;
 }
 
 void SceneManager::MarkInstance(const uint32_t instId)
 {
-  assert(instId < m_instanceInfos.size());
+  assert(IsInstanceAlive(instId));
+  m_drawListsDirty |= !m_instanceInfos[instId].renderMark;
   m_instanceInfos[instId].renderMark = true;
 }
 
 void SceneManager::UnmarkInstance(const uint32_t instId)
 {
   assert(instId < m_instanceInfos.size());
+  m_drawListsDirty |= m_instanceInfos[instId].renderMark;
   m_instanceInfos[instId].renderMark = false;
 }
 
+void SceneManager::RemoveInstance(const uint32_t instId)
+{
+  assert(IsInstanceAlive(instId));
+
+  // the matrix stays in the buffer, the slot just disappears from draw lists
+  m_drawListsDirty |= m_instanceInfos[instId].renderMark;
+  m_instanceInfos[instId].alive      = false;
+  m_instanceInfos[instId].renderMark = false;
+  m_freeInstances.push_back(instId);
+}
+
+void SceneManager::SetInstanceMatrix(const uint32_t instId, const LiteMath::float4x4 &matrix)
+{
+  assert(IsInstanceAlive(instId));
+
+  m_instanceMatrices[instId] = matrix;
+  m_instanceBboxes[instId]   = InstanceBox(m_instanceInfos[instId].mesh_id, matrix);
+  sceneBbox.include(m_instanceBboxes[instId]);  // the scene box only grows, it is used for camera and shadow setup
+  if(Uploaded())
+    MarkInstanceDirty(instId);
+}
+
+void SceneManager::RemoveMesh(const uint32_t meshId)
+{
+  assert(IsMeshAlive(meshId));
+
+  for(const auto& inst : m_instanceInfos)
+  {
+    if(inst.alive && inst.mesh_id == meshId)
+      RemoveInstance(inst.inst_id);
+  }
+  m_meshAlive[meshId] = false;
+}
+
+void SceneManager::MarkInstanceDirty(const uint32_t instId)
+{
+  if(m_instanceDirty.size() < m_instanceInfos.size())
+    m_instanceDirty.resize(m_instanceInfos.size(), false);
+  if(!m_instanceDirty[instId])
+  {
+    m_instanceDirty[instId] = true;
+    m_dirtyInstances.push_back(instId);
+  }
+}
+
+uint32_t SceneManager::InstanceMaterial(const uint32_t meshId)
+{
+  // meshes without a known material (or scenes without materials at all) get a default gray one
+  auto pMat = m_materialByHydraId.find(m_meshMaterials[meshId]);
+  return pMat != m_materialByHydraId.end() ? pMat->second : DefaultMaterial();
+}
+
+uint32_t SceneManager::DefaultMaterial()
+{
+  if(m_defaultMaterial == UINT32_MAX)
+  {
+    MaterialData data = {};
+    data.baseColor    = LiteMath::float4(0.5f, 0.5f, 0.5f, 1.0f);
+    data.diffuseTexId = NO_TEXTURE;
+    m_defaultMaterial = (uint32_t)m_materials.size();
+    m_materials.push_back(data);
+  }
+  return m_defaultMaterial;
+}
+
+void SceneManager::BuildIndirectDraws(std::vector<uint32_t> &a_instanceIds)
+{
+  std::vector<std::vector<uint32_t>> instancesPerMesh(m_meshInfos.size());
+  for(const auto& inst : m_instanceInfos)
+  {
+    if(inst.renderMark)
+      instancesPerMesh[inst.mesh_id].push_back(inst.inst_id);
+  }
+
+  m_indirectDraws.clear();
+  a_instanceIds.clear();
+  a_instanceIds.reserve(m_instanceInfos.size());
+  for(size_t meshId = 0; meshId < m_meshInfos.size(); ++meshId)
+  {
+    if(instancesPerMesh[meshId].empty())
+      continue;
+
+    VkDrawIndexedIndirectCommand cmd = {};
+    cmd.indexCount    = m_meshInfos[meshId].m_indNum;
+    cmd.instanceCount = (uint32_t)instancesPerMesh[meshId].size();
+    cmd.firstIndex    = m_meshInfos[meshId].m_indexOffset;
+    cmd.vertexOffset  = (int32_t)m_meshInfos[meshId].m_vertexOffset;
+    cmd.firstInstance = (uint32_t)a_instanceIds.size();
+    m_indirectDraws.push_back(cmd);
+
+    a_instanceIds.insert(a_instanceIds.end(), instancesPerMesh[meshId].begin(), instancesPerMesh[meshId].end());
+  }
+}
+
 void SceneManager::LoadGeoDataOnGPU()
 {
-  VkDeviceSize vertexBufSize = m_pMeshData->VertexDataSize();
-  VkDeviceSize indexBufSize  = m_pMeshData->IndexDataSize();
-  VkDeviceSize infoBufSize   = m_meshInfos.size() * sizeof(uint32_t) * 2;
+  std::vector<uint32_t> instanceIds;
+  BuildIndirectDraws(instanceIds);
+
+  VkDeviceSize vertexBufSize   = m_pMeshData->VertexDataSize();
+  VkDeviceSize indexBufSize    = m_pMeshData->IndexDataSize();
+  VkDeviceSize infoBufSize     = m_meshInfos.size() * sizeof(uint32_t) * 2;
+  VkDeviceSize matricesBufSize = std::max<size_t>(m_instanceMatrices.size(), 1) * sizeof(LiteMath::float4x4);
+  VkDeviceSize instIdsBufSize  = std::max<size_t>(m_instanceInfos.size(), 1) * sizeof(uint32_t);
+  VkDeviceSize indirectBufSize = std::max<size_t>(m_meshInfos.size(), 1) * sizeof(VkDrawIndexedIndirectCommand);
+
+  // the default material always exists, so instances added at runtime never change the materials buffer
+  DefaultMaterial();
+  m_instanceMaterials.resize(m_instanceInfos.size());
+  for(size_t i = 0; i < m_instanceInfos.size(); ++i)
+    m_instanceMaterials[i] = InstanceMaterial(m_instanceInfos[i].mesh_id);
+
+  VkDeviceSize materialsBufSize = std::max<size_t>(m_materials.size(), 1) * sizeof(MaterialData);
+  VkDeviceSize instMatsBufSize  = std::max<size_t>(m_instanceMaterials.size(), 1) * sizeof(uint32_t);
 
-  m_geoVertBuf  = vk_utils::createBuffer(m_device, vertexBufSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
-  m_geoIdxBuf   = vk_utils::createBuffer(m_device, indexBufSize,  VK_BUFFER_USAGE_INDEX_BUFFER_BIT  | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
-  m_meshInfoBuf = vk_utils::createBuffer(m_device, infoBufSize,   VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+  std::vector<float> positions;
+  ExtractPositions(0, m_totalVertices, positions);
+  VkDeviceSize posBufSize = std::max<size_t>(positions.size(), 3) * sizeof(float);
 
-  VkMemoryAllocateFlags allocFlags {};
+  // instance ids and indirect draws are sized for the worst case (every slot, every mesh drawn),
+  // so marking and unmarking instances at runtime never grows them
+  m_geoVertBuf  = CreateSceneBuffer(vertexBufSize, VERTEX_USAGE);
+  m_geoPosBuf   = CreateSceneBuffer(posBufSize,    POSITION_USAGE);
+  m_geoIdxBuf   = CreateSceneBuffer(indexBufSize,  INDEX_USAGE);
+  m_meshInfoBuf = CreateSceneBuffer(infoBufSize,   STORAGE_USAGE);
 
-  m_geoMemAlloc = vk_utils::allocateAndBindWithPadding(m_device, m_physDevice, {m_geoVertBuf, m_geoIdxBuf, m_meshInfoBuf}, allocFlags);
+  m_instanceMatricesBuffer = CreateSceneBuffer(matricesBufSize, STORAGE_USAGE);
+  m_instanceIdsBuf         = CreateSceneBuffer(instIdsBufSize,  STORAGE_USAGE);
+  m_indirectDrawBuf        = CreateSceneBuffer(indirectBufSize, INDIRECT_USAGE);
+
+  m_materialsBuf         = CreateSceneBuffer(materialsBufSize, STORAGE_USAGE);
+  m_instanceMaterialsBuf = CreateSceneBuffer(instMatsBufSize,  STORAGE_USAGE);
 
   std::vector<LiteMath::uint2> mesh_info_tmp;
   for(const auto& m : m_meshInfos)
@@ -231,10 +713,365 @@ void SceneManager::LoadGeoDataOnGPU()
     mesh_info_tmp.emplace_back(m.m_indexOffset, m.m_vertexOffset);
   }
 
-  m_pCopyHelper->UpdateBuffer(m_geoVertBuf, 0, m_pMeshData->VertexData(), vertexBufSize);
-  m_pCopyHelper->UpdateBuffer(m_geoIdxBuf,  0, m_pMeshData->IndexData(), indexBufSize);
-  if(!mesh_info_tmp.empty())
-    m_pCopyHelper->UpdateBuffer(m_meshInfoBuf,  0, mesh_info_tmp.data(), mesh_info_tmp.size() * sizeof(mesh_info_tmp[0]));
+  // first use on the graphics queue of every buffer, needed for queue family acquire barriers of async uploads
+  UploadBuffer(m_geoVertBuf, m_pMeshData->VertexData(), vertexBufSize, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | SHADER_STAGES,
+               VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+  UploadBuffer(m_geoIdxBuf, m_pMeshData->IndexData(), indexBufSize, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+  UploadBuffer(m_geoPosBuf, positions.data(), positions.size() * sizeof(positions[0]), VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+               VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+  UploadBuffer(m_meshInfoBuf, mesh_info_tmp.data(), mesh_info_tmp.size() * sizeof(mesh_info_tmp[0]), SHADER_STAGES,
+               VK_ACCESS_SHADER_READ_BIT);
+
+  UploadBuffer(m_instanceMatricesBuffer, m_instanceMatrices.data(), m_instanceMatrices.size() * sizeof(m_instanceMatrices[0]),
+               SHADER_STAGES, VK_ACCESS_SHADER_READ_BIT);
+  UploadBuffer(m_instanceIdsBuf, instanceIds.data(), instanceIds.size() * sizeof(instanceIds[0]), SHADER_STAGES,
+               VK_ACCESS_SHADER_READ_BIT);
+  UploadBuffer(m_indirectDrawBuf, m_indirectDraws.data(), m_indirectDraws.size() * sizeof(m_indirectDraws[0]),
+               VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+
+  UploadBuffer(m_materialsBuf, m_materials.data(), m_materials.size() * sizeof(m_materials[0]), SHADER_STAGES,
+               VK_ACCESS_SHADER_READ_BIT);
+  UploadBuffer(m_instanceMaterialsBuf, m_instanceMaterials.data(), m_instanceMaterials.size() * sizeof(m_instanceMaterials[0]),
+               SHADER_STAGES, VK_ACCESS_SHADER_READ_BIT);
+
+  if(m_pUploadQueue != nullptr)
+    m_pUploadQueue->Flush();
+
+  m_meshesOnGPU      = MeshesNum();
+  m_verticesOnGPU    = m_totalVertices;
+  m_indicesOnGPU     = m_totalIndices;
+  m_vertexCapacity   = m_totalVertices;
+  m_indexCapacity    = m_totalIndices;
+  m_meshCapacity     = std::max(MeshesNum(), 1u);
+  m_instanceCapacity = std::max(InstancesNum(), 1u);
+  m_dirtyInstances.clear();
+  m_instanceDirty.assign(m_instanceInfos.size(), false);
+  m_drawListsDirty = false;
+
+  CreateMaterialDescriptorSet();
+}
+
+void SceneManager::ExtractPositions(uint32_t firstVertex, uint32_t verticesNum, std::vector<float> &positions) const
+{
+  // positions only, 12 instead of 32 bytes per vertex for passes that don't shade
+  const uint32_t floatsPerVertex = uint32_t(m_pMeshData->SingleVertexSize() / sizeof(float));
+  const float*   pVertices       = static_cast<const float*>(m_pMeshData->VertexData()) + size_t(firstVertex) * floatsPerVertex;
+  positions.resize(size_t(verticesNum) * 3);
+  for(size_t i = 0; i < verticesNum; ++i)
+  {
+    positions[i * 3 + 0] = pVertices[i * floatsPerVertex + 0];
+    positions[i * 3 + 1] = pVertices[i * floatsPerVertex + 1];
+    positions[i * 3 + 2] = pVertices[i * floatsPerVertex + 2];
+  }
+}
+
+VkBuffer SceneManager::CreateSceneBuffer(VkDeviceSize a_size, VkBufferUsageFlags a_usage)
+{
+  VkBuffer buf = vk_utils::createBuffer(m_device, a_size, a_usage);
+  m_bufferAllocs[buf] = m_pAllocator->AllocateAndBind(buf, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  return buf;
+}
+
+bool SceneManager::RecordUpdates(VkCommandBuffer a_cmdBuff)
+{
+  m_updatesRecorded++;
+  ReleaseRetired(false);
+
+  const uint32_t meshesNum    = MeshesNum();
+  const uint32_t instancesNum = InstancesNum();
+  if(!Uploaded() || (meshesNum == m_meshesOnGPU && m_dirtyInstances.empty() && !m_drawListsDirty))
+    return false;
+
+  // every piece of data is copied to its own region of one staging buffer; destinations are pointers to members,
+  // because buffers out of capacity are replaced before the copies are recorded
+  struct Upload
+  {
+    VkBuffer*    pDst;
+    VkDeviceSize dstOffset;
+    const void*  data;
+    VkDeviceSize size;
+  };
+  std::vector<Upload> uploads;
+
+  // geometry of meshes added after loading is appended to the tails of vertex, index and mesh info buffers
+  std::vector<float> positions;
+  std::vector<LiteMath::uint2> meshInfos;
+  if(meshesNum > m_meshesOnGPU)
+  {
+    const size_t vertSize = m_pMeshData->SingleVertexSize();
+    const size_t indSize  = m_pMeshData->SingleIndexSize();
+    ExtractPositions(m_verticesOnGPU, m_totalVertices - m_verticesOnGPU, positions);
+    for(uint32_t meshId = m_meshesOnGPU; meshId < meshesNum; ++meshId)
+      meshInfos.emplace_back(m_meshInfos[meshId].m_indexOffset, m_meshInfos[meshId].m_vertexOffset);
+
+    uploads.push_back({&m_geoVertBuf, m_verticesOnGPU * vertSize,
+                       (const char*)m_pMeshData->VertexData() + m_verticesOnGPU * vertSize, (m_totalVertices - m_verticesOnGPU) * vertSize});
+    uploads.push_back({&m_geoIdxBuf, m_indicesOnGPU * indSize,
+                       (const char*)m_pMeshData->IndexData() + m_indicesOnGPU * indSize, (m_totalIndices - m_indicesOnGPU) * indSize});
+    uploads.push_back({&m_geoPosBuf, m_verticesOnGPU * 3 * sizeof(float), positions.data(), positions.size() * sizeof(float)});
+    uploads.push_back({&m_meshInfoBuf, m_meshesOnGPU * sizeof(LiteMath::uint2), meshInfos.data(),
+                       meshInfos.size() * sizeof(LiteMath::uint2)});
+  }
+
+  // changed instance slots are merged into runs of consecutive ids, so a big edit is a few copies, not thousands
+  std::sort(m_dirtyInstances.begin(), m_dirtyInstances.end());
+  for(size_t i = 0; i < m_dirtyInstances.size();)
+  {
+    const uint32_t first = m_dirtyInstances[i];
+    uint32_t count = 1;
+    while(i + count < m_dirtyInstances.size() && m_dirtyInstances[i + count] == first + count)
+      count++;
+    i += count;
+
+    uploads.push_back({&m_instanceMatricesBuffer, first * sizeof(LiteMath::float4x4), &m_instanceMatrices[first],
+                       count * sizeof(LiteMath::float4x4)});
+    uploads.push_back({&m_instanceMaterialsBuf, first * sizeof(uint32_t), &m_instanceMaterials[first], count * sizeof(uint32_t)});
+  }
+
+  std::vector<uint32_t> instanceIds;
+  if(m_drawListsDirty)
+  {
+    BuildIndirectDraws(instanceIds);
+    uploads.push_back({&m_instanceIdsBuf, 0, instanceIds.data(), instanceIds.size() * sizeof(uint32_t)});
+    uploads.push_back({&m_indirectDrawBuf, 0, m_indirectDraws.data(), m_indirectDraws.size() * sizeof(VkDrawIndexedIndirectCommand)});
+  }
+
+  // previous frames may still read what is overwritten or copied below
+  TransferBarrier(a_cmdBuff, SCENE_READ_STAGES, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, 0);
+
+  bool replaced = false;
+  if(m_totalVertices > m_vertexCapacity)
+  {
+    const uint32_t capacity = std::max(m_totalVertices, m_vertexCapacity * 2);
+    GrowBuffer(a_cmdBuff, m_geoVertBuf, VkDeviceSize(m_verticesOnGPU) * m_pMeshData->SingleVertexSize(),
+               VkDeviceSize(capacity) * m_pMeshData->SingleVertexSize(), VERTEX_USAGE);
+    GrowBuffer(a_cmdBuff, m_geoPosBuf, VkDeviceSize(m_verticesOnGPU) * 3 * sizeof(float),
+               VkDeviceSize(capacity) * 3 * sizeof(float), POSITION_USAGE);
+    m_vertexCapacity = capacity;
+    replaced = true;
+  }
+  if(m_totalIndices > m_indexCapacity)
+  {
+    const uint32_t capacity = std::max(m_totalIndices, m_indexCapacity * 2);
+    GrowBuffer(a_cmdBuff, m_geoIdxBuf, VkDeviceSize(m_indicesOnGPU) * m_pMeshData->SingleIndexSize(),
+               VkDeviceSize(capacity) * m_pMeshData->SingleIndexSize(), INDEX_USAGE);
+    m_indexCapacity = capacity;
+    replaced = true;
+  }
+  if(meshesNum > m_meshCapacity)
+  {
+    const uint32_t capacity = std::max(meshesNum, m_meshCapacity * 2);
+    GrowBuffer(a_cmdBuff, m_meshInfoBuf, VkDeviceSize(m_meshesOnGPU) * sizeof(LiteMath::uint2),
+               VkDeviceSize(capacity) * sizeof(LiteMath::uint2), STORAGE_USAGE);
+    GrowBuffer(a_cmdBuff, m_indirectDrawBuf, VkDeviceSize(m_meshCapacity) * sizeof(VkDrawIndexedIndirectCommand),
+               VkDeviceSize(capacity) * sizeof(VkDrawIndexedIndirectCommand), INDIRECT_USAGE);
+    m_meshCapacity = capacity;
+    replaced = true;
+  }
+  bool materialsReplaced = false;
+  if(instancesNum > m_instanceCapacity)
+  {
+    const uint32_t capacity = std::max(instancesNum, m_instanceCapacity * 2);
+    GrowBuffer(a_cmdBuff, m_instanceMatricesBuffer, VkDeviceSize(m_instanceCapacity) * sizeof(LiteMath::float4x4),
+               VkDeviceSize(capacity) * sizeof(LiteMath::float4x4), STORAGE_USAGE);
+    GrowBuffer(a_cmdBuff, m_instanceMaterialsBuf, VkDeviceSize(m_instanceCapacity) * sizeof(uint32_t),
+               VkDeviceSize(capacity) * sizeof(uint32_t), STORAGE_USAGE);
+    GrowBuffer(a_cmdBuff, m_instanceIdsBuf, VkDeviceSize(m_instanceCapacity) * sizeof(uint32_t),
+               VkDeviceSize(capacity) * sizeof(uint32_t), STORAGE_USAGE);
+    m_instanceCapacity = capacity;
+    replaced          = true;
+    materialsReplaced = true;
+  }
+  if(replaced) // copies from the staging buffer may overlap the ones made by growing
+    TransferBarrier(a_cmdBuff, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+  constexpr VkDeviceSize ALIGNMENT = 16;
+  VkDeviceSize stagingSize = 0;
+  for(const auto& upload : uploads)
+    stagingSize += (upload.size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+  if(stagingSize > 0)
+  {
+    VkBuffer staging = vk_utils::createBuffer(m_device, stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    MemAllocation stagingAlloc = m_pAllocator->AllocateAndBind(staging, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    std::map<VkBuffer, std::vector<VkBufferCopy>> regions;
+    VkDeviceSize srcOffset = 0;
+    for(const auto& upload : uploads)
+    {
+      if(upload.size == 0)
+        continue;
+      memcpy((char*)stagingAlloc.mapped + srcOffset, upload.data, upload.size);
+      regions[*upload.pDst].push_back({srcOffset, upload.dstOffset, upload.size});
+      srcOffset += (upload.size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+    for(const auto& [dst, dstRegions] : regions)
+      vkCmdCopyBuffer(a_cmdBuff, staging, dst, uint32_t(dstRegions.size()), dstRegions.data());
+
+    Retire(staging, stagingAlloc, VK_NULL_HANDLE);
+  }
+
+  TransferBarrier(a_cmdBuff, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, SCENE_READ_STAGES, SCENE_READ_ACCESS);
+
+  for(auto instId : m_dirtyInstances)
+    m_instanceDirty[instId] = false;
+  m_dirtyInstances.clear();
+  m_drawListsDirty = false;
+  m_meshesOnGPU    = meshesNum;
+  m_verticesOnGPU  = m_totalVertices;
+  m_indicesOnGPU   = m_totalIndices;
+
+  if(materialsReplaced)
+    CreateMaterialDescriptorSet();
+
+  return replaced;
+}
+
+void SceneManager::GrowBuffer(VkCommandBuffer a_cmdBuff, VkBuffer &a_buf, VkDeviceSize a_usedSize, VkDeviceSize a_newSize,
+                              VkBufferUsageFlags a_usage)
+{
+  VkBuffer newBuf = CreateSceneBuffer(a_newSize, a_usage);
+  if(a_usedSize > 0)
+  {
+    VkBufferCopy region = {0, 0, std::min(a_usedSize, a_newSize)};
+    vkCmdCopyBuffer(a_cmdBuff, a_buf, newBuf, 1, &region);
+  }
+
+  auto pAlloc = m_bufferAllocs.find(a_buf);
+  assert(pAlloc != m_bufferAllocs.end());
+  Retire(a_buf, pAlloc->second, VK_NULL_HANDLE);
+  m_bufferAllocs.erase(pAlloc);
+  a_buf = newBuf;
+}
+
+void SceneManager::Retire(VkBuffer a_buffer, const MemAllocation &a_alloc, VkDescriptorPool a_pool)
+{
+  RetiredObject obj;
+  obj.buffer    = a_buffer;
+  obj.alloc     = a_alloc;
+  obj.pool      = a_pool;
+  obj.releaseAt = m_updatesRecorded + RETIRE_FRAMES;
+  m_retired.push_back(obj);
+}
+
+void SceneManager::ReleaseRetired(bool a_all)
+{
+  auto pEnd = std::remove_if(m_retired.begin(), m_retired.end(), [&](const RetiredObject &obj) {
+    if(!a_all && obj.releaseAt > m_updatesRecorded)
+      return false;
+    if(obj.buffer != VK_NULL_HANDLE)
+    {
+      vkDestroyBuffer(m_device, obj.buffer, nullptr);
+      m_pAllocator->Free(obj.alloc);
+    }
+    if(obj.pool != VK_NULL_HANDLE)
+      vkDestroyDescriptorPool(m_device, obj.pool, nullptr);
+    return true;
+  });
+  m_retired.erase(pEnd, m_retired.end());
+}
+
+void SceneManager::UploadBuffer(VkBuffer a_dst, const void* a_data, VkDeviceSize a_size, VkPipelineStageFlags a_dstStages,
+                                VkAccessFlags a_dstAccess)
+{
+  if(a_size == 0)
+    return;
+
+  if(m_pUploadQueue != nullptr)
+    m_pUploadQueue->UpdateBuffer(a_dst, 0, a_data, a_size, a_dstStages, a_dstAccess);
+  else
+    m_pCopyHelper->UpdateBuffer(a_dst, 0, a_data, a_size);
+}
+
+void SceneManager::CreateMaterialDescriptorSet()
+{
+  InitTextureTable();
+  m_pTexMgr->WaitAll();
+  m_pTexMgr->Poll();
+
+  std::array<VkDescriptorSetLayoutBinding, 3> bindings = {};
+  bindings[0].binding         = 0;
+  bindings[0].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  bindings[0].descriptorCount = 1;
+  bindings[0].stageFlags      = VK_SHADER_STAGE_FRAGMENT_BIT;
+  bindings[1].binding         = 1;
+  bindings[1].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  bindings[1].descriptorCount = 1;
+  bindings[1].stageFlags      = VK_SHADER_STAGE_VERTEX_BIT;
+  bindings[2].binding         = 2;
+  bindings[2].descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  bindings[2].descriptorCount = MAX_SCENE_TEXTURES;
+  bindings[2].stageFlags      = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+  layoutInfo.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = (uint32_t)bindings.size();
+  layoutInfo.pBindings    = bindings.data();
+  if(m_materialDSetLayout == VK_NULL_HANDLE)
+    VK_CHECK_RESULT(vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_materialDSetLayout));
+
+  // the set is written again when RecordUpdates() replaces material buffers, frames in flight still use the old one
+  if(m_materialDPool != VK_NULL_HANDLE)
+    Retire(VK_NULL_HANDLE, {}, m_materialDPool);
+
+  std::array<VkDescriptorPoolSize, 2> poolSizes = {};
+  poolSizes[0] = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2};
+  poolSizes[1] = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_SCENE_TEXTURES};
+
+  VkDescriptorPoolCreateInfo poolInfo = {};
+  poolInfo.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.maxSets       = 1;
+  poolInfo.poolSizeCount = (uint32_t)poolSizes.size();
+  poolInfo.pPoolSizes    = poolSizes.data();
+  VK_CHECK_RESULT(vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_materialDPool));
+
+  VkDescriptorSetAllocateInfo allocInfo = {};
+  allocInfo.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool     = m_materialDPool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts        = &m_materialDSetLayout;
+  VK_CHECK_RESULT(vkAllocateDescriptorSets(m_device, &allocInfo, &m_materialDSet));
+
+  // whole table is always written, so shaders may index it without partially bound descriptors
+  std::array<VkDescriptorImageInfo, MAX_SCENE_TEXTURES> imageInfos = {};
+  for(uint32_t i = 0; i < MAX_SCENE_TEXTURES; ++i)
+  {
+    const uint32_t slot = i < m_textureTable.size() ? i : 0;
+    imageInfos[i].sampler     = m_textureSampler;
+    imageInfos[i].imageView   = m_pTexMgr->GetView(m_textureTable[slot]);
+    imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  }
+
+  VkDescriptorBufferInfo materialsInfo = {m_materialsBuf, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo instMatsInfo  = {m_instanceMaterialsBuf, 0, VK_WHOLE_SIZE};
+
+  std::array<VkWriteDescriptorSet, 3> writes = {};
+  for(uint32_t i = 0; i < writes.size(); ++i)
+  {
+    writes[i].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[i].dstSet          = m_materialDSet;
+    writes[i].dstBinding      = i;
+    writes[i].descriptorCount = 1;
+    writes[i].descriptorType  = bindings[i].descriptorType;
+  }
+  writes[0].pBufferInfo     = &materialsInfo;
+  writes[1].pBufferInfo     = &instMatsInfo;
+  writes[2].descriptorCount = MAX_SCENE_TEXTURES;
+  writes[2].pImageInfo      = imageInfos.data();
+
+  vkUpdateDescriptorSets(m_device, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+}
+
+VkPipelineVertexInputStateCreateInfo SceneManager::GetPositionOnlyVertexInputStateCreateInfo() const
+{
+  VkPipelineVertexInputStateCreateInfo vertexInput = {};
+  vertexInput.sType                           = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vertexInput.vertexBindingDescriptionCount   = 1;
+  vertexInput.pVertexBindingDescriptions      = &m_posBinding;
+  vertexInput.vertexAttributeDescriptionCount = 1;
+  vertexInput.pVertexAttributeDescriptions    = &m_posAttribute;
+  return vertexInput;
 }
 
 void SceneManager::DrawMarkedInstances()
@@ -244,6 +1081,10 @@ void SceneManager::DrawMarkedInstances()
 
 void SceneManager::DestroyScene()
 {
+  // transfers in flight still write the buffers below
+  m_pUploadQueue = nullptr;
+  ReleaseRetired(true);
+
   if(m_geoVertBuf != VK_NULL_HANDLE)
   {
     vkDestroyBuffer(m_device, m_geoVertBuf, nullptr);
@@ -256,6 +1097,12 @@ void SceneManager::DestroyScene()
     m_geoIdxBuf = VK_NULL_HANDLE;
   }
 
+  if(m_geoPosBuf != VK_NULL_HANDLE)
+  {
+    vkDestroyBuffer(m_device, m_geoPosBuf, nullptr);
+    m_geoPosBuf = VK_NULL_HANDLE;
+  }
+
   if(m_meshInfoBuf != VK_NULL_HANDLE)
   {
     vkDestroyBuffer(m_device, m_meshInfoBuf, nullptr);
@@ -268,16 +1115,75 @@ void SceneManager::DestroyScene()
     m_instanceMatricesBuffer = VK_NULL_HANDLE;
   }
 
-  if(m_geoMemAlloc != VK_NULL_HANDLE)
+  if(m_instanceIdsBuf != VK_NULL_HANDLE)
+  {
+    vkDestroyBuffer(m_device, m_instanceIdsBuf, nullptr);
+    m_instanceIdsBuf = VK_NULL_HANDLE;
+  }
+
+  if(m_indirectDrawBuf != VK_NULL_HANDLE)
   {
-    vkFreeMemory(m_device, m_geoMemAlloc, nullptr);
-    m_geoMemAlloc = VK_NULL_HANDLE;
+    vkDestroyBuffer(m_device, m_indirectDrawBuf, nullptr);
+    m_indirectDrawBuf = VK_NULL_HANDLE;
   }
 
+  if(m_materialsBuf != VK_NULL_HANDLE)
+  {
+    vkDestroyBuffer(m_device, m_materialsBuf, nullptr);
+    m_materialsBuf = VK_NULL_HANDLE;
+  }
+
+  if(m_instanceMaterialsBuf != VK_NULL_HANDLE)
+  {
+    vkDestroyBuffer(m_device, m_instanceMaterialsBuf, nullptr);
+    m_instanceMaterialsBuf = VK_NULL_HANDLE;
+  }
+
+  if(m_materialDPool != VK_NULL_HANDLE)
+  {
+    vkDestroyDescriptorPool(m_device, m_materialDPool, nullptr);
+    m_materialDPool = VK_NULL_HANDLE;
+    m_materialDSet  = VK_NULL_HANDLE;
+  }
+
+  if(m_materialDSetLayout != VK_NULL_HANDLE)
+  {
+    vkDestroyDescriptorSetLayout(m_device, m_materialDSetLayout, nullptr);
+    m_materialDSetLayout = VK_NULL_HANDLE;
+  }
+
+  if(m_textureSampler != VK_NULL_HANDLE)
+  {
+    vkDestroySampler(m_device, m_textureSampler, nullptr);
+    m_textureSampler = VK_NULL_HANDLE;
+  }
+  m_pTexMgr = nullptr;
+  m_textureTable.clear();
+
+  for(auto& [buf, alloc] : m_bufferAllocs)
+    m_pAllocator->Free(alloc);
+  m_bufferAllocs.clear();
+
   m_pCopyHelper = nullptr;
 
   m_meshInfos.clear();
+  m_meshMaterials.clear();
+  m_materials.clear();
+  m_materialByHydraId.clear();
   m_pMeshData = nullptr;
+  m_meshAlive.clear();
+  m_meshByHydraId.clear();
+  m_instanceByHydraId.clear();
   m_instanceInfos.clear();
   m_instanceMatrices.clear();
+  m_instanceMaterials.clear();
+  m_freeInstances.clear();
+  m_dirtyInstances.clear();
+  m_instanceDirty.clear();
+  m_indirectDraws.clear();
+  m_lights.clear();
+  m_drawListsDirty  = false;
+  m_defaultMaterial = UINT32_MAX;
+  m_meshesOnGPU = m_verticesOnGPU = m_indicesOnGPU = 0;
+  m_vertexCapacity = m_indexCapacity = m_meshCapacity = m_instanceCapacity = 0;
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define CHIMERA_SCENE_MGR_H
 
 #include <vector>
+#include <unordered_map>
 
 #include <geom/vk_mesh.h>
 #include "LiteMath.h"
@@ -9,6 +10,9 @@
 
 #include "../loader_utils/hydraxml.h"
 #include "../resources/shaders/common.h"
+#include "mem_allocator.h"
+#include "texture_mgr.h"
+#include "upload_queue.h"
 
 struct InstanceInfo
 {
@@ -16,15 +20,39 @@ struct InstanceInfo
   uint32_t mesh_id = 0u;
   VkDeviceSize instBufOffset = 0u;
   bool renderMark = false;
+  bool alive = true;     ///!< false for slots freed by RemoveInstance(), InstanceMesh() reuses them
+};
+
+struct SceneChangeInfo
+{
+  uint32_t newMeshes        = 0;
+  uint32_t addedInstances   = 0;
+  uint32_t movedInstances   = 0;
+  uint32_t removedInstances = 0;
+  bool     camerasChanged   = false;
 };
 
 struct SceneManager
 {
   SceneManager(VkDevice a_device, VkPhysicalDevice a_physDevice, uint32_t a_transferQId, uint32_t a_graphicsQId,
-    bool debug = false);
+    bool debug = false, std::shared_ptr<DeviceMemoryAllocator> a_pAllocator = nullptr);
   ~SceneManager() { DestroyScene(); }
 
+  /**
+  \brief scene buffers will be uploaded through an UploadQueue on the transfer queue instead of the blocking copy helper,
+         the render must then acquire them with GetUploadQueue()->RecordAcquire() before its first use of the scene
+  */
+  void EnableAsyncUploads(bool a_useTimeline);
+
   bool LoadSceneXML(const std::string &scenePath, bool transpose = true);
+
+  /**
+  \brief apply a Hydra change_*.xml to the scene loaded by LoadSceneXML: meshes with new ids are loaded, instances are
+         moved, added or (with discard="1") removed, cameras are replaced; GPU buffers follow with RecordUpdates().
+         Materials, textures and lights of the change are not applied, geometry of known mesh ids is not reloaded.
+  \return false if the change file can't be loaded
+  */
+  bool ApplyChangeXML(const std::string &changePath, bool transpose = true, SceneChangeInfo* a_pInfo = nullptr);
   void LoadSingleTriangle();
 
   uint32_t AddMeshFromFile(const std::string& meshPath);
@@ -35,19 +63,59 @@ struct SceneManager
   void MarkInstance(uint32_t instId);
   void UnmarkInstance(uint32_t instId);
 
+  // after loading every change, new meshes and instances included, reaches GPU buffers with the next RecordUpdates()
+  void RemoveInstance(uint32_t instId);
+  void SetInstanceMatrix(uint32_t instId, const LiteMath::float4x4 &matrix);
+  void RemoveMesh(uint32_t meshId); ///!< removes all instances of the mesh, its geometry stays in the buffers
+
+  /**
+  \brief record GPU updates of everything changed since the last call into a graphics queue command buffer, outside of render passes
+         Only dirty ranges of instance slots are copied, geometry of meshes added after loading is appended, draw lists
+         are rebuilt only when instances were added, removed, marked or unmarked. Buffers out of capacity are recreated
+         twice bigger with their contents copied on GPU; replaced buffers and staging memory are destroyed
+         RETIRE_FRAMES calls later, so frames in flight keep valid handles.
+  \return true if buffer handles or the material set changed, descriptor sets with scene buffers must be written again
+  */
+  bool RecordUpdates(VkCommandBuffer a_cmdBuff);
+  static constexpr uint32_t RETIRE_FRAMES = 4; ///!< at least the number of frames in flight of the render
+
   void DrawMarkedInstances();
 
   void DestroyScene();
 
   VkPipelineVertexInputStateCreateInfo GetPipelineVertexInputStateCreateInfo() { return m_pMeshData->VertexInputLayout();}
+  /// single vec3 attribute at location 0 read from GetPositionBuffer(), for passes that need only positions (depth prepass)
+  VkPipelineVertexInputStateCreateInfo GetPositionOnlyVertexInputStateCreateInfo() const;
 
   VkBuffer GetVertexBuffer() const { return m_geoVertBuf; }
   VkBuffer GetIndexBuffer()  const { return m_geoIdxBuf; }
+  VkBuffer GetPositionBuffer() const { return m_geoPosBuf; } ///!< float3 per vertex, same vertex order as GetVertexBuffer()
   VkBuffer GetMeshInfoBuffer()  const { return m_meshInfoBuf; }
+  VkBuffer GetInstanceMatricesBuffer() const { return m_instanceMatricesBuffer; }
+  VkBuffer GetInstanceIdsBuffer() const { return m_instanceIdsBuf; }
+  VkBuffer GetIndirectDrawBuffer() const { return m_indirectDrawBuf; }
+  VkBuffer GetMaterialsBuffer() const { return m_materialsBuf; }
+  VkBuffer GetInstanceMaterialsBuffer() const { return m_instanceMaterialsBuf; }
+
+  // set with materials (binding 0), per instance material ids (binding 1) and texture table (binding 2),
+  // see MaterialData and MAX_SCENE_TEXTURES in common.h
+  VkDescriptorSetLayout GetMaterialSetLayout() const { return m_materialDSetLayout; }
+  VkDescriptorSet GetMaterialSet() const { return m_materialDSet; }
   std::shared_ptr<vk_utils::ICopyEngine> GetCopyHelper() { return  m_pCopyHelper; }
+  UploadQueue* GetUploadQueue() { return m_pUploadQueue.get(); } ///!< nullptr until EnableAsyncUploads()
+  std::shared_ptr<DeviceMemoryAllocator> GetAllocator() { return m_pAllocator; }
 
   uint32_t MeshesNum() const {return (uint32_t)m_meshInfos.size();}
-  uint32_t InstancesNum() const {return (uint32_t)m_instanceInfos.size();}
+  uint32_t InstancesNum() const {return (uint32_t)m_instanceInfos.size();} ///!< instance slots, removed ones included
+  uint32_t LiveInstancesNum() const {return InstancesNum() - (uint32_t)m_freeInstances.size();}
+  bool IsInstanceAlive(uint32_t instId) const {return instId < m_instanceInfos.size() && m_instanceInfos[instId].alive;}
+  bool IsMeshAlive(uint32_t meshId) const {return meshId < m_meshAlive.size() && m_meshAlive[meshId];}
+  uint32_t IndirectDrawsNum() const {return (uint32_t)m_indirectDraws.size();}
+  uint32_t MaterialsNum() const {return (uint32_t)m_materials.size();}
+  uint32_t TexturesNum() const {return (uint32_t)m_textureTable.size();}
+  /// the texture table needs shaderSampledImageArrayDynamicIndexing, without it scene textures are not loaded
+  bool TextureTableSupported() const {return m_textureTableSupported;}
+  uint32_t LightsNum() const {return (uint32_t)m_lights.size();}
 
   hydra_xml::Camera GetCamera(uint32_t camId) const;
   MeshInfo GetMeshInfo(uint32_t meshId) const {assert(meshId < m_meshInfos.size()); return m_meshInfos[meshId];}
@@ -56,29 +124,104 @@ struct SceneManager
   LiteMath::Box4f GetInstanceBbox(uint32_t instId) const {assert(instId < m_instanceBboxes.size()); return m_instanceBboxes[instId];}
   LiteMath::float4x4 GetInstanceMatrix(uint32_t instId) const {assert(instId < m_instanceMatrices.size()); return m_instanceMatrices[instId];}
   LiteMath::Box4f GetSceneBbox() const {return sceneBbox;}
+  VkDrawIndexedIndirectCommand GetIndirectDraw(uint32_t drawId) const {assert(drawId < m_indirectDraws.size()); return m_indirectDraws[drawId];}
+  PointLight GetLight(uint32_t lightId) const {assert(lightId < m_lights.size()); return m_lights[lightId];}
 
 private:
   void LoadGeoDataOnGPU();
+  bool Uploaded() const { return m_geoVertBuf != VK_NULL_HANDLE; }
+  uint32_t InstanceMaterial(uint32_t meshId);
+  uint32_t DefaultMaterial();
+  LiteMath::Box4f InstanceBox(uint32_t meshId, const LiteMath::float4x4 &matrix) const;
+  void MarkInstanceDirty(uint32_t instId);
+  void ExtractPositions(uint32_t firstVertex, uint32_t verticesNum, std::vector<float> &positions) const;
+  VkBuffer CreateSceneBuffer(VkDeviceSize a_size, VkBufferUsageFlags a_usage);
+  void GrowBuffer(VkCommandBuffer a_cmdBuff, VkBuffer &a_buf, VkDeviceSize a_usedSize, VkDeviceSize a_newSize, VkBufferUsageFlags a_usage);
+  void Retire(VkBuffer a_buffer, const MemAllocation &a_alloc, VkDescriptorPool a_pool);
+  void ReleaseRetired(bool a_all);
+  void UploadBuffer(VkBuffer a_dst, const void* a_data, VkDeviceSize a_size, VkPipelineStageFlags a_dstStages, VkAccessFlags a_dstAccess);
+  void BuildIndirectDraws(std::vector<uint32_t> &a_instanceIds);
+  void LoadMaterialsHydra(hydra_xml::HydraScene &a_scene);
+  void LoadLightsHydra(hydra_xml::HydraScene &a_scene, bool transpose);
+  void InitTextureTable();
+  uint32_t AddTextureRGBA8(const void* a_pixels, uint32_t a_width, uint32_t a_height);
+  void CreateMaterialDescriptorSet();
 
   std::vector<MeshInfo> m_meshInfos = {};
   std::vector<LiteMath::Box4f> m_meshBboxes = {};
+  std::vector<bool> m_meshAlive = {};
+  std::unordered_map<uint32_t, uint32_t> m_meshByHydraId = {};     // Hydra mesh id -> mesh id
+  std::unordered_map<uint32_t, uint32_t> m_instanceByHydraId = {}; // Hydra instance id -> instance id
   std::shared_ptr<IMeshData> m_pMeshData = nullptr;
 
   std::vector<InstanceInfo> m_instanceInfos = {};
   std::vector<LiteMath::Box4f> m_instanceBboxes = {};
   std::vector<LiteMath::float4x4> m_instanceMatrices = {};
+  std::vector<uint32_t> m_instanceMaterials = {};   // index in m_materials per instance slot
+  std::vector<uint32_t> m_freeInstances = {};
+
+  // changes since the last RecordUpdates(), instance slots are deduplicated by m_instanceDirty
+  std::vector<uint32_t> m_dirtyInstances = {};
+  std::vector<bool> m_instanceDirty = {};
+  bool m_drawListsDirty = false;
+
+  // one indexed draw per mesh, instances of the mesh are addressed through m_instanceIdsBuf[firstInstance + i]
+  std::vector<VkDrawIndexedIndirectCommand> m_indirectDraws = {};
 
   std::vector<hydra_xml::Camera> m_sceneCameras = {};
+
+  // world space, area and spot lights are approximated by point lights at their instance position
+  std::vector<PointLight> m_lights = {};
+
+  // materials and textures are indexed by their position in these tables, not by hydra ids
+  std::vector<MaterialData> m_materials = {};
+  std::unordered_map<uint32_t, uint32_t> m_materialByHydraId = {};
+  std::vector<uint32_t> m_meshMaterials = {};     // hydra id of the material of the first triangle
+  std::vector<uint32_t> m_textureTable = {};      // ids in m_pTexMgr, slot 0 is a white placeholder
+  std::unique_ptr<TextureManager> m_pTexMgr = nullptr;
+  VkSampler m_textureSampler = VK_NULL_HANDLE;
   LiteMath::Box4f sceneBbox;
 
   uint32_t m_totalVertices = 0u;
   uint32_t m_totalIndices  = 0u;
 
+  // what GPU buffers already contain and what they can hold, in elements
+  uint32_t m_meshesOnGPU   = 0u;
+  uint32_t m_verticesOnGPU = 0u;
+  uint32_t m_indicesOnGPU  = 0u;
+  uint32_t m_vertexCapacity   = 0u;
+  uint32_t m_indexCapacity    = 0u;
+  uint32_t m_meshCapacity     = 0u;
+  uint32_t m_instanceCapacity = 0u;
+  uint32_t m_defaultMaterial  = UINT32_MAX;
+
   VkBuffer m_geoVertBuf = VK_NULL_HANDLE;
   VkBuffer m_geoIdxBuf  = VK_NULL_HANDLE;
+  VkBuffer m_geoPosBuf  = VK_NULL_HANDLE;
   VkBuffer m_meshInfoBuf  = VK_NULL_HANDLE;
   VkBuffer m_instanceMatricesBuffer = VK_NULL_HANDLE;
-  VkDeviceMemory m_geoMemAlloc = VK_NULL_HANDLE;
+  VkBuffer m_instanceIdsBuf = VK_NULL_HANDLE;
+  VkBuffer m_indirectDrawBuf = VK_NULL_HANDLE;
+  VkBuffer m_materialsBuf = VK_NULL_HANDLE;
+  VkBuffer m_instanceMaterialsBuf = VK_NULL_HANDLE;
+  std::unordered_map<VkBuffer, MemAllocation> m_bufferAllocs = {};
+
+  struct RetiredObject
+  {
+    VkBuffer         buffer = VK_NULL_HANDLE;
+    MemAllocation    alloc  {};
+    VkDescriptorPool pool   = VK_NULL_HANDLE;
+    uint64_t         releaseAt = 0;            // value of m_updatesRecorded
+  };
+  std::vector<RetiredObject> m_retired = {};
+  uint64_t m_updatesRecorded = 0;
+
+  VkVertexInputBindingDescription   m_posBinding   = {};
+  VkVertexInputAttributeDescription m_posAttribute = {};
+
+  VkDescriptorPool m_materialDPool = VK_NULL_HANDLE;
+  VkDescriptorSetLayout m_materialDSetLayout = VK_NULL_HANDLE;
+  VkDescriptorSet m_materialDSet = VK_NULL_HANDLE;
 
   VkDevice m_device = VK_NULL_HANDLE;
   VkPhysicalDevice m_physDevice = VK_NULL_HANDLE;
@@ -88,8 +231,11 @@ private:
   uint32_t m_graphicsQId = UINT32_MAX;
   VkQueue m_graphicsQ = VK_NULL_HANDLE;
   std::shared_ptr<vk_utils::ICopyEngine> m_pCopyHelper;
+  std::unique_ptr<UploadQueue> m_pUploadQueue;
+  std::shared_ptr<DeviceMemoryAllocator> m_pAllocator;
 
   bool m_debug = false;
+  bool m_textureTableSupported = false;
   // for debugging
   struct Vertex
   {
@@ -0,0 +1,347 @@
+#include "shader_manager.h"
+#include <vk_utils.h>
+
+#include <climits>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifdef USE_SHADERC
+#include <shaderc/shaderc.hpp>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace
+{
+#ifdef USE_SHADERC
+  constexpr const char* COMPILER_TAG = "shaderc";
+#else
+  constexpr const char* COMPILER_TAG = "glslangValidator -V";
+#endif
+
+  constexpr auto WATCH_PERIOD = std::chrono::milliseconds(300);
+
+  bool readFile(const fs::path &a_path, std::string &a_content)
+  {
+    std::ifstream in(a_path, std::ios::binary);
+    if(!in.is_open())
+      return false;
+    std::stringstream ss;
+    ss << in.rdbuf();
+    a_content = ss.str();
+    return true;
+  }
+
+  constexpr int64_t NO_FILE = INT64_MIN; // file clock epoch is implementation defined, valid times may be negative
+
+  int64_t modificationTime(const fs::path &a_path)
+  {
+    std::error_code err;
+    const auto time = fs::last_write_time(a_path, err);
+    return err ? NO_FILE : int64_t(time.time_since_epoch().count());
+  }
+
+  uint64_t fnv1a(const std::string &a_data, uint64_t a_hash = 14695981039346656037ull)
+  {
+    for(unsigned char c : a_data)
+    {
+      a_hash ^= c;
+      a_hash *= 1099511628211ull;
+    }
+    return a_hash;
+  }
+
+  // #include "file" relative to the including file, <file> includes are not followed
+  void collectIncludes(const fs::path &a_path, std::vector<std::pair<std::string, int64_t>> &a_files, std::string &a_allText)
+  {
+    for(const auto& file : a_files)
+    {
+      if(file.first == a_path.string())
+        return;
+    }
+
+    // time is taken before reading, so an edit made meanwhile is seen by the next check
+    a_files.emplace_back(a_path.string(), modificationTime(a_path));
+    std::string text;
+    if(!readFile(a_path, text))
+      return;
+    a_allText += a_path.filename().string() + "\n" + text;
+
+    std::istringstream lines(text);
+    std::string line;
+    while(std::getline(lines, line))
+    {
+      const size_t pos = line.find("#include");
+      if(pos == std::string::npos || line.find_first_not_of(" \t") != pos)
+        continue;
+      const size_t begin = line.find('"', pos);
+      const size_t end   = begin == std::string::npos ? begin : line.find('"', begin + 1);
+      if(end != std::string::npos)
+        collectIncludes(a_path.parent_path() / line.substr(begin + 1, end - begin - 1), a_files, a_allText);
+    }
+  }
+
+#ifdef USE_SHADERC
+  class FileIncluder : public shaderc::CompileOptions::IncluderInterface
+  {
+    struct Data
+    {
+      std::string name;
+      std::string content;
+      shaderc_include_result result;
+    };
+
+  public:
+    shaderc_include_result* GetInclude(const char* a_requested, shaderc_include_type, const char* a_requesting, size_t) override
+    {
+      auto* pData = new Data;
+      const fs::path path = fs::path(a_requesting).parent_path() / a_requested;
+      if(readFile(path, pData->content))
+        pData->name = path.string();
+      else
+        pData->content = "can't open include file " + path.string();
+
+      pData->result.source_name        = pData->name.c_str();
+      pData->result.source_name_length = pData->name.size();
+      pData->result.content            = pData->content.c_str();
+      pData->result.content_length     = pData->content.size();
+      pData->result.user_data          = pData;
+      return &pData->result;
+    }
+
+    void ReleaseInclude(shaderc_include_result* a_data) override { delete static_cast<Data*>(a_data->user_data); }
+  };
+
+  bool compileShaderc(const std::string &a_source, const std::vector<std::string> &a_defines, const std::string &a_outPath,
+                      std::string &a_log)
+  {
+    static const std::unordered_map<std::string, shaderc_shader_kind> kinds = {
+      {".vert", shaderc_vertex_shader},       {".frag", shaderc_fragment_shader}, {".comp", shaderc_compute_shader},
+      {".geom", shaderc_geometry_shader},     {".tesc", shaderc_tess_control_shader},
+      {".tese", shaderc_tess_evaluation_shader}};
+
+    auto pKind = kinds.find(fs::path(a_source).extension().string());
+    std::string text;
+    if(pKind == kinds.end() || !readFile(a_source, text))
+    {
+      a_log = "unknown shader stage or can't read the file";
+      return false;
+    }
+
+    shaderc::CompileOptions options;
+    options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_1);
+    options.SetIncluder(std::make_unique<FileIncluder>());
+    for(const auto& define : a_defines)
+    {
+      const size_t eq = define.find('=');
+      if(eq == std::string::npos)
+        options.AddMacroDefinition(define);
+      else
+        options.AddMacroDefinition(define.substr(0, eq), define.substr(eq + 1));
+    }
+
+    shaderc::Compiler compiler;
+    auto result = compiler.CompileGlslToSpv(text, pKind->second, a_source.c_str(), options);
+    if(result.GetCompilationStatus() != shaderc_compilation_status_success)
+    {
+      a_log = result.GetErrorMessage();
+      return false;
+    }
+
+    std::ofstream out(a_outPath, std::ios::binary);
+    out.write((const char*)result.cbegin(), std::streamsize((result.cend() - result.cbegin()) * sizeof(uint32_t)));
+    return bool(out);
+  }
+#else
+  bool compileGlslangValidator(const std::string &a_source, const std::vector<std::string> &a_defines, const std::string &a_outPath,
+                               std::string &a_log)
+  {
+    const std::string logPath = a_outPath + ".log";
+    std::string cmd = "glslangValidator -V";
+    for(const auto& define : a_defines)
+      cmd += " \"-D" + define + "\"";
+    cmd += " \"" + a_source + "\" -o \"" + a_outPath + "\" > \"" + logPath + "\" 2>&1";
+#ifdef WIN32
+    cmd = "\"" + cmd + "\""; // cmd.exe strips the outer quotes
+#endif
+
+    const int res = std::system(cmd.c_str());
+    readFile(logPath, a_log);
+    std::remove(logPath.c_str());
+    return res == 0;
+  }
+#endif
+}
+
+ShaderManager::ShaderManager(const std::string &a_cacheDir, bool a_watch) : m_cacheDir(a_cacheDir)
+{
+  std::error_code err;
+  fs::create_directories(m_cacheDir, err);
+  if(err)
+    vk_utils::logWarning("[ShaderManager] can't create cache directory " + m_cacheDir + ": " + err.message());
+
+  if(a_watch)
+    m_watcher = std::thread(&ShaderManager::WatchLoop, this);
+}
+
+ShaderManager::~ShaderManager()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_stopCV.notify_all();
+  if(m_watcher.joinable())
+    m_watcher.join();
+}
+
+bool ShaderManager::Compile(Entry &a_entry) const
+{
+  std::string allText = std::string(COMPILER_TAG) + "\n";
+  for(const auto& define : a_entry.defines)
+    allText += "-D" + define + "\n";
+
+  a_entry.files.clear();
+  collectIncludes(a_entry.source, a_entry.files, allText);
+  if(a_entry.files.front().second == NO_FILE)
+  {
+    vk_utils::logWarning("[ShaderManager] can't open " + a_entry.source);
+    return false;
+  }
+
+  char hash[17];
+  std::snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)fnv1a(allText));
+  const std::string spvPath = m_cacheDir + "/" + fs::path(a_entry.source).filename().string() + "." + hash + ".spv";
+  if(fs::exists(spvPath))
+  {
+    a_entry.spvPath = spvPath;
+    return true;
+  }
+
+  // compile next to the final file and rename, so other processes never see a partially written cache entry
+  const std::string tmpPath = spvPath + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+  std::string log;
+#ifdef USE_SHADERC
+  const bool ok = compileShaderc(a_entry.source, a_entry.defines, tmpPath, log);
+#else
+  const bool ok = compileGlslangValidator(a_entry.source, a_entry.defines, tmpPath, log);
+#endif
+
+  std::error_code err;
+  if(ok)
+    fs::rename(tmpPath, spvPath, err);
+  if(!ok || err)
+  {
+    fs::remove(tmpPath, err);
+    vk_utils::logWarning("[ShaderManager] failed to compile " + a_entry.source + ":\n" + log);
+    return false;
+  }
+
+  std::cout << "[ShaderManager] compiled " << a_entry.source << " -> " << spvPath << std::endl;
+  a_entry.spvPath = spvPath;
+  return true;
+}
+
+std::string ShaderManager::GetSPVPath(const std::string &a_sourcePath, const std::vector<std::string> &a_defines)
+{
+  std::string key = a_sourcePath;
+  for(const auto& define : a_defines)
+    key += "|" + define;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto pFound = m_entries.find(key);
+    if(pFound != m_entries.end() && !pFound->second.spvPath.empty())
+      return pFound->second.spvPath;
+  }
+
+  Entry entry;
+  entry.source  = a_sourcePath;
+  entry.defines = a_defines;
+  if(!Compile(entry))
+    RUN_TIME_ERROR(("[ShaderManager] can't compile " + key).c_str());
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_entries[key] = entry;
+  return entry.spvPath;
+}
+
+std::vector<uint32_t> ShaderManager::GetSPV(const std::string &a_sourcePath, const std::vector<std::string> &a_defines)
+{
+  return vk_utils::readSPVFile(GetSPVPath(a_sourcePath, a_defines).c_str());
+}
+
+void ShaderManager::RegisterProgram(const std::vector<std::string> &a_sources, std::function<void()> a_rebuild)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_programs.push_back({a_sources, std::move(a_rebuild)});
+}
+
+void ShaderManager::ReloadAll()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_reloadAll = true;
+}
+
+uint32_t ShaderManager::Update()
+{
+  std::unordered_set<std::string> changed;
+  std::vector<std::function<void()>> rebuilds;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(m_changed.empty() && !m_reloadAll)
+      return 0;
+    changed.swap(m_changed);
+
+    for(const auto& program : m_programs)
+    {
+      bool affected = m_reloadAll;
+      for(const auto& source : program.sources)
+        affected = affected || changed.count(source) > 0;
+      if(affected)
+        rebuilds.push_back(program.rebuild);
+    }
+    m_reloadAll = false;
+  }
+
+  // without the lock, callbacks call GetSPVPath
+  for(auto& rebuild : rebuilds)
+    rebuild();
+  return uint32_t(rebuilds.size());
+}
+
+void ShaderManager::WatchLoop()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while(!m_stopCV.wait_for(lock, WATCH_PERIOD, [this]() { return m_stop; }))
+  {
+    std::vector<std::pair<std::string, Entry>> toCheck(m_entries.begin(), m_entries.end());
+    lock.unlock();
+
+    for(auto& [key, entry] : toCheck)
+    {
+      bool modified = false;
+      for(const auto& file : entry.files)
+        modified = modified || modificationTime(file.first) != file.second;
+      if(!modified)
+        continue;
+
+      const std::string oldSpv = entry.spvPath;
+      const bool ok = Compile(entry);
+
+      std::lock_guard<std::mutex> entryLock(m_mutex);
+      auto &dst = m_entries[key];
+      dst.files = entry.files;            // failed compilation is retried only after the next edit
+      if(ok && entry.spvPath != oldSpv)
+      {
+        dst.spvPath = entry.spvPath;
+        m_changed.insert(entry.source);
+      }
+    }
+
+    lock.lock();
+  }
+}
@@ -0,0 +1,87 @@
+#ifndef VK_GRAPHICS_BASIC_SHADER_MANAGER_H
+#define VK_GRAPHICS_BASIC_SHADER_MANAGER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+\brief GLSL -> SPIR-V at run time with an on-disk cache and hot reload
+
+SPIR-V is stored in a_cacheDir under a hash of the shader source, all its #include files, stage and defines, so
+an unchanged shader is never compiled twice, even across runs. Shaders are compiled in process with shaderc when
+the project is configured with USE_SHADERC, otherwise glslangValidator from PATH is run.
+There is no fallback to the "<source>.spv" files next to the sources, they may be stale: a shader that doesn't
+compile on first use is an error. A failed hot reload keeps the last good SPIR-V.
+
+A background thread watches sources and includes of every requested shader and recompiles changed ones.
+Pipelines are rebuilt by callbacks registered with RegisterProgram, which are run from Update() on the
+thread that calls it, so the frame loop only pays for vkCreate*Pipelines and never waits for the compiler.
+*/
+class ShaderManager
+{
+public:
+  explicit ShaderManager(const std::string &a_cacheDir = "../resources/shaders/cache", bool a_watch = true);
+  ~ShaderManager();
+
+  ShaderManager(const ShaderManager&) = delete;
+  ShaderManager& operator=(const ShaderManager&) = delete;
+
+  /**
+  \brief path to up to date SPIR-V of a_sourcePath (stage from extension: .vert, .frag, .comp, ...), compiles if needed
+  \param a_defines - "NAME" or "NAME=VALUE", every set of defines is a separate cache entry
+  */
+  std::string GetSPVPath(const std::string &a_sourcePath, const std::vector<std::string> &a_defines = {});
+  std::vector<uint32_t> GetSPV(const std::string &a_sourcePath, const std::vector<std::string> &a_defines = {});
+
+  /**
+  \brief a_rebuild is called from Update() after any of a_sources (with any defines) was recompiled successfully
+         it should create its pipelines again using GetSPVPath / GetSPV, which are instant at that point
+  */
+  void RegisterProgram(const std::vector<std::string> &a_sources, std::function<void()> a_rebuild);
+
+  /// runs rebuild callbacks of changed programs, returns their number; pipelines being replaced must not be in use by the GPU
+  uint32_t Update();
+
+  /// run rebuild callbacks of all programs as if every shader has changed
+  void ReloadAll();
+
+private:
+  struct Entry
+  {
+    std::string              source;
+    std::vector<std::string> defines;
+    std::string              spvPath;
+    std::vector<std::pair<std::string, int64_t>> files; // source and includes with their modification times
+  };
+
+  struct Program
+  {
+    std::vector<std::string> sources;
+    std::function<void()>    rebuild;
+  };
+
+  bool Compile(Entry &a_entry) const;
+  void WatchLoop();
+
+  std::string m_cacheDir;
+
+  std::mutex m_mutex;
+  std::unordered_map<std::string, Entry> m_entries;  // by source path + defines
+  std::unordered_set<std::string>        m_changed;  // sources recompiled since last Update()
+  std::vector<Program>                   m_programs;
+  bool m_reloadAll = false;
+
+  std::thread             m_watcher;
+  std::condition_variable m_stopCV;
+  bool                    m_stop = false;
+};
+
+#endif// VK_GRAPHICS_BASIC_SHADER_MANAGER_H
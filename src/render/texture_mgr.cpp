@@ -0,0 +1,271 @@
+#include "texture_mgr.h"
+#include <vk_utils.h>
+#include <vk_buffers.h>
+
+#include <cstring>
+#include <algorithm>
+
+// bytes per 4x4 block for block compressed formats, 0 for uncompressed ones
+static uint32_t GetBlockBytes(VkFormat a_format)
+{
+  switch(a_format)
+  {
+  case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+  case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+  case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+  case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    return 8;
+  case VK_FORMAT_BC3_UNORM_BLOCK:
+  case VK_FORMAT_BC3_SRGB_BLOCK:
+    return 16;
+  default:
+    return 0;
+  }
+}
+
+TextureManager::TextureManager(VkDevice a_device, VkPhysicalDevice a_physDevice, std::shared_ptr<DeviceMemoryAllocator> a_pAllocator,
+                               uint32_t a_transferQId, uint32_t a_graphicsQId) :
+                               m_device(a_device), m_physDevice(a_physDevice), m_pAllocator(a_pAllocator),
+                               m_transferQId(a_transferQId), m_graphicsQId(a_graphicsQId)
+{
+  vkGetDeviceQueue(m_device, m_transferQId, 0, &m_transferQ);
+  m_cmdPool = vk_utils::createCommandPool(m_device, m_transferQId, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+}
+
+TextureManager::~TextureManager()
+{
+  WaitAll();
+  Poll();
+
+  for(auto& tex : m_textures)
+  {
+    DestroyImage(tex.front);
+    DestroyImage(tex.back);
+  }
+  m_textures.clear();
+
+  for(auto& upload : m_uploads)
+  {
+    if(upload.fence != VK_NULL_HANDLE)
+      vkDestroyFence(m_device, upload.fence, nullptr);
+  }
+  m_uploads.clear();
+
+  if(m_cmdPool != VK_NULL_HANDLE)
+  {
+    vkDestroyCommandPool(m_device, m_cmdPool, nullptr);
+    m_cmdPool = VK_NULL_HANDLE;
+  }
+}
+
+uint32_t TextureManager::AddTexture()
+{
+  m_textures.emplace_back();
+  return uint32_t(m_textures.size() - 1);
+}
+
+void TextureManager::CreateImage(Image &a_img, uint32_t a_width, uint32_t a_height, uint32_t a_mipLevels, VkFormat a_format)
+{
+  // sampled on the graphics queue, written on the transfer queue
+  uint32_t queueFamilies[2] = {m_graphicsQId, m_transferQId};
+
+  VkImageCreateInfo imgCreateInfo = {};
+  imgCreateInfo.sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imgCreateInfo.imageType     = VK_IMAGE_TYPE_2D;
+  imgCreateInfo.format        = a_format;
+  imgCreateInfo.extent        = VkExtent3D{a_width, a_height, 1};
+  imgCreateInfo.mipLevels     = a_mipLevels;
+  imgCreateInfo.arrayLayers   = 1;
+  imgCreateInfo.samples       = VK_SAMPLE_COUNT_1_BIT;
+  imgCreateInfo.tiling        = VK_IMAGE_TILING_OPTIMAL;
+  imgCreateInfo.usage         = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  imgCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  if(m_graphicsQId != m_transferQId)
+  {
+    imgCreateInfo.sharingMode           = VK_SHARING_MODE_CONCURRENT;
+    imgCreateInfo.queueFamilyIndexCount = 2;
+    imgCreateInfo.pQueueFamilyIndices   = queueFamilies;
+  }
+  else
+    imgCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  VK_CHECK_RESULT(vkCreateImage(m_device, &imgCreateInfo, nullptr, &a_img.image));
+  a_img.alloc = m_pAllocator->AllocateAndBind(a_img.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  VkImageViewCreateInfo viewInfo = {};
+  viewInfo.sType                           = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image                           = a_img.image;
+  viewInfo.viewType                        = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format                          = a_format;
+  viewInfo.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+  viewInfo.subresourceRange.baseMipLevel   = 0;
+  viewInfo.subresourceRange.levelCount     = a_mipLevels;
+  viewInfo.subresourceRange.baseArrayLayer = 0;
+  viewInfo.subresourceRange.layerCount     = 1;
+  VK_CHECK_RESULT(vkCreateImageView(m_device, &viewInfo, nullptr, &a_img.view));
+
+  a_img.width  = a_width;
+  a_img.height = a_height;
+  a_img.format = a_format;
+  a_img.mipLevels = a_mipLevels;
+  m_imagesAllocated++;
+}
+
+void TextureManager::DestroyImage(Image &a_img)
+{
+  if(a_img.view != VK_NULL_HANDLE)
+    vkDestroyImageView(m_device, a_img.view, nullptr);
+  if(a_img.image != VK_NULL_HANDLE)
+    vkDestroyImage(m_device, a_img.image, nullptr);
+  m_pAllocator->Free(a_img.alloc);
+  a_img = Image{};
+}
+
+void TextureManager::UploadAsync(uint32_t a_texId, const void* a_data, uint32_t a_width, uint32_t a_height,
+                                 VkFormat a_format, uint32_t a_bpp, uint32_t a_mipLevels)
+{
+  assert(a_texId < m_textures.size());
+
+  // only one upload per texture at a time, newer data replaces older
+  if(m_textures[a_texId].uploadId != UINT32_MAX)
+  {
+    const uint32_t prevUpload = m_textures[a_texId].uploadId;
+    vkWaitForFences(m_device, 1, &m_uploads[prevUpload].fence, VK_TRUE, UINT64_MAX);
+    FinishUpload(prevUpload);
+  }
+
+  Texture &tex = m_textures[a_texId];
+  if(tex.back.image == VK_NULL_HANDLE || tex.back.width != a_width || tex.back.height != a_height ||
+     tex.back.mipLevels != a_mipLevels || tex.back.format != a_format)
+  {
+    DestroyImage(tex.back);
+    CreateImage(tex.back, a_width, a_height, a_mipLevels, a_format);
+  }
+
+  uint32_t uploadId;
+  if(!m_freeUploads.empty())
+  {
+    uploadId = m_freeUploads.back();
+    m_freeUploads.pop_back();
+  }
+  else
+  {
+    Upload upload;
+    upload.cmdBuf = vk_utils::createCommandBuffers(m_device, m_cmdPool, 1)[0];
+
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VK_CHECK_RESULT(vkCreateFence(m_device, &fenceInfo, nullptr, &upload.fence));
+
+    m_uploads.push_back(upload);
+    uploadId = uint32_t(m_uploads.size() - 1);
+  }
+
+  Upload &upload = m_uploads[uploadId];
+  upload.texId   = a_texId;
+  tex.uploadId   = uploadId;
+
+  const uint32_t blockBytes = GetBlockBytes(a_format);
+  std::vector<VkBufferImageCopy> regions(a_mipLevels);
+  VkDeviceSize dataSize = 0;
+  for(uint32_t level = 0; level < a_mipLevels; ++level)
+  {
+    const uint32_t levelW = std::max(a_width  >> level, 1u);
+    const uint32_t levelH = std::max(a_height >> level, 1u);
+
+    regions[level] = {};
+    regions[level].bufferOffset     = dataSize;
+    regions[level].imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+    regions[level].imageOffset      = {0, 0, 0};
+    regions[level].imageExtent      = {levelW, levelH, 1};
+    if(blockBytes != 0)
+      dataSize += VkDeviceSize((levelW + 3) / 4) * ((levelH + 3) / 4) * blockBytes;
+    else
+      dataSize += VkDeviceSize(levelW) * levelH * a_bpp;
+  }
+
+  upload.staging      = vk_utils::createBuffer(m_device, dataSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+  upload.stagingAlloc = m_pAllocator->AllocateAndBind(upload.staging, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  memcpy(upload.stagingAlloc.mapped, a_data, dataSize);
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  VK_CHECK_RESULT(vkResetCommandBuffer(upload.cmdBuf, 0));
+  VK_CHECK_RESULT(vkBeginCommandBuffer(upload.cmdBuf, &beginInfo));
+
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image               = tex.back.image;
+  barrier.subresourceRange    = {VK_IMAGE_ASPECT_COLOR_BIT, 0, a_mipLevels, 0, 1};
+  barrier.srcAccessMask       = 0;
+  barrier.dstAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED; // previous contents are overwritten entirely
+  barrier.newLayout           = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  vkCmdPipelineBarrier(upload.cmdBuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                       0, nullptr, 0, nullptr, 1, &barrier);
+
+  vkCmdCopyBufferToImage(upload.cmdBuf, upload.staging, tex.back.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         uint32_t(regions.size()), regions.data());
+
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = 0;
+  barrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  vkCmdPipelineBarrier(upload.cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                       0, nullptr, 0, nullptr, 1, &barrier);
+
+  VK_CHECK_RESULT(vkEndCommandBuffer(upload.cmdBuf));
+
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers    = &upload.cmdBuf;
+  VK_CHECK_RESULT(vkQueueSubmit(m_transferQ, 1, &submitInfo, upload.fence));
+}
+
+void TextureManager::FinishUpload(uint32_t a_uploadId)
+{
+  Upload &upload = m_uploads[a_uploadId];
+  Texture &tex   = m_textures[upload.texId];
+
+  std::swap(tex.front, tex.back);
+  tex.uploadId = UINT32_MAX;
+  m_readyTextures.push_back(upload.texId);
+
+  vkDestroyBuffer(m_device, upload.staging, nullptr);
+  m_pAllocator->Free(upload.stagingAlloc);
+  VK_CHECK_RESULT(vkResetFences(m_device, 1, &upload.fence));
+
+  upload.staging = VK_NULL_HANDLE;
+  upload.texId   = UINT32_MAX;
+  m_freeUploads.push_back(a_uploadId);
+}
+
+std::vector<uint32_t> TextureManager::Poll()
+{
+  for(uint32_t i = 0; i < m_uploads.size(); ++i)
+  {
+    if(m_uploads[i].texId != UINT32_MAX && vkGetFenceStatus(m_device, m_uploads[i].fence) == VK_SUCCESS)
+      FinishUpload(i);
+  }
+
+  std::vector<uint32_t> res;
+  std::swap(res, m_readyTextures);
+  return res;
+}
+
+void TextureManager::WaitAll()
+{
+  std::vector<VkFence> fences;
+  for(const auto& upload : m_uploads)
+  {
+    if(upload.texId != UINT32_MAX)
+      fences.push_back(upload.fence);
+  }
+
+  if(!fences.empty())
+    vkWaitForFences(m_device, uint32_t(fences.size()), fences.data(), VK_TRUE, UINT64_MAX);
+}
@@ -0,0 +1,99 @@
+#ifndef VK_GRAPHICS_BASIC_TEXTURE_MGR_H
+#define VK_GRAPHICS_BASIC_TEXTURE_MGR_H
+
+#include "volk.h"
+#include "mem_allocator.h"
+
+#include <vector>
+#include <memory>
+#include <cassert>
+
+/**
+\brief owns sampled 2D textures and streams their contents through the transfer queue
+
+Every texture has a front image (the one shaders read) and a back image (upload target). UploadAsync() writes
+new pixels into the back image, reusing it when width, height and format did not change. Poll() retires finished
+uploads and swaps front and back, after that the caller should point its descriptors to the new front view.
+Before the next UploadAsync() of the same texture the previous front view must not be used by frames in flight.
+*/
+struct TextureManager
+{
+  TextureManager(VkDevice a_device, VkPhysicalDevice a_physDevice, std::shared_ptr<DeviceMemoryAllocator> a_pAllocator,
+                 uint32_t a_transferQId, uint32_t a_graphicsQId);
+  ~TextureManager();
+
+  uint32_t AddTexture();
+
+  /**
+  \brief copy pixels to a staging buffer and submit an upload to the transfer queue, doesn't wait for the GPU
+  \param a_data      - a_mipLevels levels packed one after another, level i is max(1, a_width >> i) x max(1, a_height >> i)
+  \param a_bpp       - bytes per pixel of a_data, ignored for BC1/BC3 formats which are addressed by 4x4 blocks
+  */
+  void UploadAsync(uint32_t a_texId, const void* a_data, uint32_t a_width, uint32_t a_height, VkFormat a_format, uint32_t a_bpp,
+                   uint32_t a_mipLevels = 1);
+
+  /**
+  \brief check finished uploads, returns ids of textures whose front image has changed since the last call
+  */
+  std::vector<uint32_t> Poll();
+  void WaitAll();
+
+  VkImageView GetView(uint32_t a_texId) const {assert(a_texId < m_textures.size()); return m_textures[a_texId].front.view;}
+  bool IsReady(uint32_t a_texId) const {assert(a_texId < m_textures.size()); return m_textures[a_texId].front.image != VK_NULL_HANDLE;}
+  bool IsUploading(uint32_t a_texId) const {assert(a_texId < m_textures.size()); return m_textures[a_texId].uploadId != UINT32_MAX;}
+  uint32_t TexturesNum() const {return (uint32_t)m_textures.size();}
+  uint32_t GetMipLevels(uint32_t a_texId) const {assert(a_texId < m_textures.size()); return m_textures[a_texId].front.mipLevels;}
+
+  VkDeviceSize GetMemorySize(uint32_t a_texId) const {assert(a_texId < m_textures.size()); return m_textures[a_texId].front.alloc.size;}
+  uint32_t ImagesAllocated() const { return m_imagesAllocated; } ///!< number of vkCreateImage calls, stays the same when images are reused
+
+private:
+  struct Image
+  {
+    VkImage       image  = VK_NULL_HANDLE;
+    VkImageView   view   = VK_NULL_HANDLE;
+    MemAllocation alloc  {};
+    uint32_t      width  = 0;
+    uint32_t      height = 0;
+    uint32_t      mipLevels = 1;
+    VkFormat      format = VK_FORMAT_UNDEFINED;
+  };
+
+  struct Texture
+  {
+    Image    front;
+    Image    back;
+    uint32_t uploadId = UINT32_MAX;
+  };
+
+  struct Upload
+  {
+    uint32_t        texId   = UINT32_MAX;
+    VkCommandBuffer cmdBuf  = VK_NULL_HANDLE;
+    VkFence         fence   = VK_NULL_HANDLE;
+    VkBuffer        staging = VK_NULL_HANDLE;
+    MemAllocation   stagingAlloc {};
+  };
+
+  void CreateImage(Image &a_img, uint32_t a_width, uint32_t a_height, uint32_t a_mipLevels, VkFormat a_format);
+  void DestroyImage(Image &a_img);
+  void FinishUpload(uint32_t a_uploadId);
+
+  std::vector<Texture> m_textures;
+  std::vector<Upload>  m_uploads;
+  std::vector<uint32_t> m_freeUploads;
+  std::vector<uint32_t> m_readyTextures;
+
+  VkDevice m_device = VK_NULL_HANDLE;
+  VkPhysicalDevice m_physDevice = VK_NULL_HANDLE;
+  std::shared_ptr<DeviceMemoryAllocator> m_pAllocator;
+
+  uint32_t m_transferQId = UINT32_MAX;
+  uint32_t m_graphicsQId = UINT32_MAX;
+  VkQueue  m_transferQ   = VK_NULL_HANDLE;
+  VkCommandPool m_cmdPool = VK_NULL_HANDLE;
+
+  uint32_t m_imagesAllocated = 0;
+};
+
+#endif// VK_GRAPHICS_BASIC_TEXTURE_MGR_H
@@ -0,0 +1,268 @@
+#include "upload_queue.h"
+#include <vk_utils.h>
+#include <vk_buffers.h>
+
+#include <algorithm>
+#include <cstring>
+
+UploadQueue::UploadQueue(VkDevice a_device, std::shared_ptr<DeviceMemoryAllocator> a_pAllocator, uint32_t a_transferQId,
+                         uint32_t a_graphicsQId, bool a_useTimeline) :
+                         m_device(a_device), m_pAllocator(a_pAllocator), m_transferQId(a_transferQId),
+                         m_graphicsQId(a_graphicsQId), m_useTimeline(a_useTimeline)
+{
+  vkGetDeviceQueue(m_device, m_transferQId, 0, &m_transferQ);
+  m_cmdPool = vk_utils::createCommandPool(m_device, m_transferQId, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+
+  if(m_useTimeline)
+  {
+    VkSemaphoreTypeCreateInfoKHR typeInfo = {};
+    typeInfo.sType         = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+    typeInfo.initialValue  = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+    VK_CHECK_RESULT(vkCreateSemaphore(m_device, &semaphoreInfo, nullptr, &m_timeline));
+  }
+  else
+  {
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VK_CHECK_RESULT(vkCreateFence(m_device, &fenceInfo, nullptr, &m_fence));
+  }
+}
+
+UploadQueue::~UploadQueue()
+{
+  WaitIdle();
+  for(auto& batch : m_submitted)
+    FreeStaging(batch);
+  m_submitted.clear();
+  FreeStaging(m_current);
+
+  if(m_timeline != VK_NULL_HANDLE)
+    vkDestroySemaphore(m_device, m_timeline, nullptr);
+  if(m_fence != VK_NULL_HANDLE)
+    vkDestroyFence(m_device, m_fence, nullptr);
+  vkDestroyCommandPool(m_device, m_cmdPool, nullptr); // frees all command buffers
+}
+
+void UploadQueue::BeginBatch()
+{
+  if(!m_freeCmdBufs.empty())
+  {
+    m_current.cmdBuf = m_freeCmdBufs.back();
+    m_freeCmdBufs.pop_back();
+  }
+  else
+    m_current.cmdBuf = vk_utils::createCommandBuffers(m_device, m_cmdPool, 1)[0];
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  VK_CHECK_RESULT(vkResetCommandBuffer(m_current.cmdBuf, 0));
+  VK_CHECK_RESULT(vkBeginCommandBuffer(m_current.cmdBuf, &beginInfo));
+}
+
+void UploadQueue::UpdateBuffer(VkBuffer a_dst, VkDeviceSize a_offset, const void* a_data, VkDeviceSize a_size,
+                               VkPipelineStageFlags a_dstStages, VkAccessFlags a_dstAccess)
+{
+  if(a_size == 0)
+    return;
+  if(m_current.cmdBuf == VK_NULL_HANDLE)
+    BeginBatch();
+
+  // staging memory is taken linearly from chunks of the batch, big uploads get a chunk of their own
+  constexpr VkDeviceSize ALIGNMENT = 16;
+  StagingChunk* pChunk = m_current.staging.empty() ? nullptr : &m_current.staging.back();
+  VkDeviceSize srcOffset = pChunk != nullptr ? (pChunk->used + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT : 0;
+  if(pChunk == nullptr || srcOffset + a_size > pChunk->alloc.size)
+  {
+    StagingChunk chunk;
+    chunk.buffer = vk_utils::createBuffer(m_device, std::max(a_size, STAGING_CHUNK), VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    chunk.alloc  = m_pAllocator->AllocateAndBind(chunk.buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    m_current.staging.push_back(chunk);
+    pChunk    = &m_current.staging.back();
+    srcOffset = 0;
+  }
+
+  memcpy((char*)pChunk->alloc.mapped + srcOffset, a_data, a_size);
+  pChunk->used = srcOffset + a_size;
+
+  VkBufferCopy region = {};
+  region.srcOffset = srcOffset;
+  region.dstOffset = a_offset;
+  region.size      = a_size;
+  vkCmdCopyBuffer(m_current.cmdBuf, pChunk->buffer, a_dst, 1, &region);
+
+  // inside one family the semaphore alone makes the writes visible, ownership moves only between families
+  if(m_transferQId != m_graphicsQId)
+  {
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask       = a_dstAccess;
+    barrier.srcQueueFamilyIndex = m_transferQId;
+    barrier.dstQueueFamilyIndex = m_graphicsQId;
+    barrier.buffer              = a_dst;
+    barrier.offset              = a_offset;
+    barrier.size                = a_size;
+    m_current.barriers.push_back(barrier);
+  }
+  m_current.dstStages |= a_dstStages;
+}
+
+uint64_t UploadQueue::Flush()
+{
+  if(m_current.cmdBuf == VK_NULL_HANDLE)
+    return 0;
+
+  // release half of the ownership transfers, dstAccessMask is ignored here
+  if(!m_current.barriers.empty())
+  {
+    std::vector<VkBufferMemoryBarrier> release = m_current.barriers;
+    for(auto& barrier : release)
+      barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(m_current.cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                         0, nullptr, uint32_t(release.size()), release.data(), 0, nullptr);
+  }
+  VK_CHECK_RESULT(vkEndCommandBuffer(m_current.cmdBuf));
+
+  const uint64_t ticket = ++m_lastTicket;
+
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers    = &m_current.cmdBuf;
+
+  VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+  if(m_useTimeline)
+  {
+    timelineInfo.sType                     = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues    = &ticket;
+
+    submitInfo.pNext                = &timelineInfo;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores    = &m_timeline;
+  }
+  VK_CHECK_RESULT(vkQueueSubmit(m_transferQ, 1, &submitInfo, m_fence));
+
+  if(!m_useTimeline)
+  {
+    VK_CHECK_RESULT(vkWaitForFences(m_device, 1, &m_fence, VK_TRUE, UINT64_MAX));
+    VK_CHECK_RESULT(vkResetFences(m_device, 1, &m_fence));
+    m_completedTicket = ticket;
+  }
+
+  m_current.ticket = ticket;
+  m_submitted.push_back(std::move(m_current));
+  m_current = Batch{};
+
+  Retire();
+  return ticket;
+}
+
+bool UploadQueue::HasPendingAcquires() const
+{
+  return std::any_of(m_submitted.begin(), m_submitted.end(), [](const Batch &batch) { return !batch.acquired; });
+}
+
+uint64_t UploadQueue::RecordAcquire(VkCommandBuffer a_cmdBuff, VkPipelineStageFlags* a_pWaitStages)
+{
+  std::vector<VkBufferMemoryBarrier> acquire;
+  VkPipelineStageFlags dstStages = 0;
+  uint64_t ticket = 0;
+  for(auto& batch : m_submitted)
+  {
+    if(batch.acquired)
+      continue;
+    for(auto barrier : batch.barriers)
+    {
+      barrier.srcAccessMask = 0; // ignored for the acquire half
+      acquire.push_back(barrier);
+    }
+    dstStages     |= batch.dstStages;
+    ticket         = std::max(ticket, batch.ticket);
+    batch.acquired = true;
+  }
+
+  if(!acquire.empty())
+    vkCmdPipelineBarrier(a_cmdBuff, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStages, 0,
+                         0, nullptr, uint32_t(acquire.size()), acquire.data(), 0, nullptr);
+
+  if(a_pWaitStages != nullptr)
+    *a_pWaitStages = dstStages != 0 ? dstStages : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+  Retire();
+  return ticket;
+}
+
+uint64_t UploadQueue::CompletedTicket()
+{
+  if(!m_useTimeline)
+    return m_completedTicket;
+
+  uint64_t value = 0;
+  VK_CHECK_RESULT(vkGetSemaphoreCounterValueKHR(m_device, m_timeline, &value));
+  return value;
+}
+
+bool UploadQueue::IsComplete(uint64_t a_ticket)
+{
+  return a_ticket <= CompletedTicket();
+}
+
+void UploadQueue::Wait(uint64_t a_ticket)
+{
+  if(a_ticket == 0 || a_ticket > m_lastTicket)
+    return;
+
+  if(m_useTimeline)
+  {
+    VkSemaphoreWaitInfoKHR waitInfo = {};
+    waitInfo.sType          = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores    = &m_timeline;
+    waitInfo.pValues        = &a_ticket;
+    VK_CHECK_RESULT(vkWaitSemaphoresKHR(m_device, &waitInfo, UINT64_MAX));
+  }
+  Retire();
+}
+
+void UploadQueue::WaitIdle()
+{
+  Wait(m_lastTicket);
+}
+
+void UploadQueue::FreeStaging(Batch &a_batch)
+{
+  for(auto& chunk : a_batch.staging)
+  {
+    vkDestroyBuffer(m_device, chunk.buffer, nullptr);
+    m_pAllocator->Free(chunk.alloc);
+  }
+  a_batch.staging.clear();
+}
+
+void UploadQueue::Retire()
+{
+  // staging memory and the command buffer are free as soon as the batch completes,
+  // barriers are kept until the graphics queue acquires the batch
+  const uint64_t completed = CompletedTicket();
+  for(auto& batch : m_submitted)
+  {
+    if(batch.ticket > completed)
+      break;
+    FreeStaging(batch);
+    if(batch.cmdBuf != VK_NULL_HANDLE)
+    {
+      m_freeCmdBufs.push_back(batch.cmdBuf);
+      batch.cmdBuf = VK_NULL_HANDLE;
+    }
+  }
+
+  while(!m_submitted.empty() && m_submitted.front().ticket <= completed && m_submitted.front().acquired)
+    m_submitted.pop_front();
+}
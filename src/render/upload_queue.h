@@ -0,0 +1,110 @@
+#ifndef VK_GRAPHICS_BASIC_UPLOAD_QUEUE_H
+#define VK_GRAPHICS_BASIC_UPLOAD_QUEUE_H
+
+#include "volk.h"
+#include "mem_allocator.h"
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+/**
+\brief buffer uploads through the transfer queue which block neither the host nor the graphics queue until the data is used
+
+UpdateBuffer() copies data to staging memory and records a copy into the current batch. Flush() submits the batch
+to the transfer queue: it ends with queue family release barriers and signals its ticket on a timeline semaphore.
+The graphics queue takes the buffers over with acquire barriers recorded by RecordAcquire(), the submit with them
+must wait for Timeline() to reach the returned ticket at the returned stages:
+
+  uploads.UpdateBuffer(buf, 0, data, size, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+  uploads.Flush();                                        // returns at once, frames keep rendering
+  ...
+  uint64_t ticket = uploads.RecordAcquire(cmd, &stages);  // 0 - nothing to wait for
+  // vkQueueSubmit(graphics, cmd) waiting for uploads.Timeline() >= ticket at stages
+
+Buffers are exclusive to one queue family, so only ranges that the graphics queue hasn't used yet may be written here
+(new buffers or new ranges of them), data already in use is updated on the graphics queue.
+Without timeline semaphores Flush() waits for the batch on a fence, acquire barriers are still needed.
+*/
+class UploadQueue
+{
+public:
+  UploadQueue(VkDevice a_device, std::shared_ptr<DeviceMemoryAllocator> a_pAllocator, uint32_t a_transferQId,
+              uint32_t a_graphicsQId, bool a_useTimeline);
+  ~UploadQueue();
+
+  UploadQueue(const UploadQueue&) = delete;
+  UploadQueue& operator=(const UploadQueue&) = delete;
+
+  /**
+  \brief copy a_data to staging memory and record the copy into the current batch, doesn't submit anything
+  \param a_dstStages - stages of the first use on the graphics queue, they wait for the acquire barrier
+  \param a_dstAccess - accesses of the first use on the graphics queue
+  */
+  void UpdateBuffer(VkBuffer a_dst, VkDeviceSize a_offset, const void* a_data, VkDeviceSize a_size,
+                    VkPipelineStageFlags a_dstStages, VkAccessFlags a_dstAccess);
+
+  /// submit the current batch to the transfer queue, returns its ticket (tickets grow by 1) or 0 if the batch is empty
+  uint64_t Flush();
+
+  /**
+  \brief record acquire barriers of all flushed batches which were not acquired yet into a graphics queue command buffer
+  \param a_pWaitStages - stages at which the submit of a_cmdBuff should wait for the ticket
+  \return the ticket to wait for, 0 if nothing was acquired
+  */
+  uint64_t RecordAcquire(VkCommandBuffer a_cmdBuff, VkPipelineStageFlags* a_pWaitStages);
+  bool HasPendingAcquires() const;
+
+  bool IsComplete(uint64_t a_ticket);
+  void Wait(uint64_t a_ticket);
+  void WaitIdle();
+
+  VkSemaphore Timeline() const { return m_timeline; } ///!< VK_NULL_HANDLE without timeline semaphores
+  bool UsesTimeline() const { return m_useTimeline; }
+  uint64_t LastTicket() const { return m_lastTicket; }
+
+private:
+  static constexpr VkDeviceSize STAGING_CHUNK = 16 * 1024 * 1024;
+
+  struct StagingChunk
+  {
+    VkBuffer      buffer = VK_NULL_HANDLE;
+    MemAllocation alloc  {};
+    VkDeviceSize  used   = 0;
+  };
+
+  struct Batch
+  {
+    VkCommandBuffer cmdBuf   = VK_NULL_HANDLE;
+    uint64_t        ticket   = 0;       ///!< 0 while the batch is recorded
+    bool            acquired = false;
+    VkPipelineStageFlags dstStages = 0;
+    std::vector<StagingChunk> staging;
+    std::vector<VkBufferMemoryBarrier> barriers; ///!< the same barriers release on transfer and acquire on graphics queue
+  };
+
+  void BeginBatch();
+  void FreeStaging(Batch &a_batch);
+  void Retire();
+  uint64_t CompletedTicket();
+
+  VkDevice m_device = VK_NULL_HANDLE;
+  std::shared_ptr<DeviceMemoryAllocator> m_pAllocator;
+
+  uint32_t m_transferQId = UINT32_MAX;
+  uint32_t m_graphicsQId = UINT32_MAX;
+  VkQueue  m_transferQ   = VK_NULL_HANDLE;
+  bool     m_useTimeline = false;
+
+  VkCommandPool m_cmdPool  = VK_NULL_HANDLE;
+  VkSemaphore   m_timeline = VK_NULL_HANDLE;
+  VkFence       m_fence    = VK_NULL_HANDLE; // only without timeline semaphores
+
+  Batch    m_current;
+  std::deque<Batch> m_submitted;            // in ticket order
+  std::vector<VkCommandBuffer> m_freeCmdBufs;
+  uint64_t m_lastTicket      = 0;
+  uint64_t m_completedTicket = 0;           // only without timeline semaphores
+};
+
+#endif// VK_GRAPHICS_BASIC_UPLOAD_QUEUE_H
@@ -1,11 +1,14 @@
 #include "quad2d_render.h"
 #include "utils/input_definitions.h"
+#include "loader_utils/images.h"
 
 #include <geom/vk_mesh.h>
 #include <vk_pipeline.h>
 #include <vk_buffers.h>
 #include <vk_utils.h>
 
+#include <algorithm>
+
 Quad2D_Render::Quad2D_Render(uint32_t a_width, uint32_t a_height) : m_width(a_width), m_height(a_height)
 {
 #ifdef NDEBUG
@@ -288,58 +291,133 @@ void Quad2D_Render::UpdateCamera(const Camera*, uint32_t)
 }
 
 
-static std::vector<unsigned> LoadBMP(const char* filename, unsigned* pW, unsigned* pH)
+static void GenerateMipChainCmd(VkCommandBuffer a_cmdBuff, VkImage a_image, uint32_t a_width, uint32_t a_height, uint32_t a_mipLevels)
 {
-  FILE* f = fopen(filename, "rb");
-
-  if(f == nullptr)
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image               = a_image;
+
+  // level 0 was uploaded and is ready for sampling, the rest has no data yet
+  barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  barrier.srcAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask    = VK_ACCESS_TRANSFER_READ_BIT;
+  barrier.oldLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barrier.newLayout        = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  vkCmdPipelineBarrier(a_cmdBuff, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+  barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 1, a_mipLevels - 1, 0, 1};
+  barrier.srcAccessMask    = 0;
+  barrier.dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.oldLayout        = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  vkCmdPipelineBarrier(a_cmdBuff, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+  int32_t srcW = int32_t(a_width);
+  int32_t srcH = int32_t(a_height);
+  for(uint32_t level = 1; level < a_mipLevels; ++level)
   {
-    (*pW) = 0;
-    (*pH) = 0;
-    std::cout << "can't open file" << std::endl;
-    return {};
+    const int32_t dstW = std::max(srcW / 2, 1);
+    const int32_t dstH = std::max(srcH / 2, 1);
+
+    VkImageBlit blit = {};
+    blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1};
+    blit.srcOffsets[1]  = {srcW, srcH, 1};
+    blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+    blit.dstOffsets[1]  = {dstW, dstH, 1};
+    vkCmdBlitImage(a_cmdBuff, a_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, a_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   1, &blit, VK_FILTER_LINEAR);
+
+    // this level becomes the source for the next one
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1};
+    barrier.srcAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask    = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout        = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    vkCmdPipelineBarrier(a_cmdBuff, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    srcW = dstW;
+    srcH = dstH;
   }
 
-  unsigned char info[54];
-  auto readRes = fread(info, sizeof(unsigned char), 54, f); // read the 54-byte header
-  if(readRes != 54)
+  barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, a_mipLevels, 0, 1};
+  barrier.srcAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask    = VK_ACCESS_SHADER_READ_BIT;
+  barrier.oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  barrier.newLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  vkCmdPipelineBarrier(a_cmdBuff, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void Quad2D_Render::LoadScene(const char*, bool)
+{
+  if(m_pImageLoader == nullptr)
+    m_pImageLoader = std::make_unique<ImageLoadService>();
+
+  // single texture is needed before the descriptor set can be made, so just wait for it
+  uint32_t texW = 0, texH = 0;
+  std::vector<unsigned> texData;
+  m_pImageLoader->Request("../resources/textures/texture1.bmp", [&](const ImageLoadResult &a_res)
+  {
+    if(!a_res.ok)
+    {
+      std::cout << "can't load " << a_res.path << std::endl;
+      return;
+    }
+    texW = uint32_t(a_res.width);
+    texH = uint32_t(a_res.height);
+    texData.resize(size_t(texW) * texH);
+
+    // rows are stored bottom-up, the same as the BMP file itself
+    auto pixels = (const unsigned*)a_res.pixels;
+    for(uint32_t y = 0; y < texH; ++y)
+      std::copy(pixels + size_t(texH - 1 - y) * texW, pixels + size_t(texH - y) * texW, texData.begin() + size_t(y) * texW);
+  });
+  m_pImageLoader->WaitIdle();
+
+  if(texData.empty())
   {
-    std::cout << "can't read 54 byte BMP header" << std::endl;
-    return {};
+    texW = texH = 1;
+    texData.push_back(0xFFFFFFFF);
   }
 
-  int width  = *(int*)&info[18];
-  int height = *(int*)&info[22];
-
-  int row_padded = (width*3 + 3) & (~3);
-  auto data      = new unsigned char[row_padded];
+  VkFormatProperties formatProps;
+  vkGetPhysicalDeviceFormatProperties(m_physicalDevice, VK_FORMAT_R8G8B8A8_UNORM, &formatProps);
+  const bool canBlit = (formatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) &&
+                       (formatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT) &&
+                       (formatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
 
-  std::vector<unsigned> res(width*height);
+  const uint32_t mipLevels = canBlit ? getMipLevelsCount(int(texW), int(texH)) : 1;
+  m_imageData    = vk_utils::allocateColorTextureFromDataLDR(m_device, m_physicalDevice, (const unsigned char*)texData.data(), texW, texH, mipLevels, VK_FORMAT_R8G8B8A8_UNORM,
+                                                             m_pCopyHelper, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
 
-  for(int i = 0; i < height; i++)
+  if(mipLevels > 1)
   {
-    fread(data, sizeof(unsigned char), row_padded, f);
-    for(int j = 0; j < width; j++)
-      res[i*width+j] = (uint32_t(data[j*3+0]) << 16) | (uint32_t(data[j*3+1]) << 8)  | (uint32_t(data[j*3+2]) << 0);
-  }
+    VkCommandBuffer cmdBuf = vk_utils::createCommandBuffers(m_device, m_commandPool, 1)[0];
 
-  fclose(f);
-  delete [] data;
-
-  (*pW) = unsigned(width);
-  (*pH) = unsigned(height);
-  return res;
-}
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuf, &beginInfo));
+    GenerateMipChainCmd(cmdBuf, m_imageData.image, texW, texH, mipLevels);
+    VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuf));
 
-void Quad2D_Render::LoadScene(const char*, bool)
-{
-  uint32_t texW, texH;
-  auto texData = LoadBMP("../resources/textures/texture1.bmp", &texW, &texH);
-  
-  m_imageData    = vk_utils::allocateColorTextureFromDataLDR(m_device, m_physicalDevice, (const unsigned char*)texData.data(), texW, texH, 1, VK_FORMAT_R8G8B8A8_UNORM,
-                                                             m_pCopyHelper, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+    vk_utils::executeCommandBufferNow(cmdBuf, m_graphicsQueue, m_device);
+    vkFreeCommandBuffers(m_device, m_commandPool, 1, &cmdBuf);
+  }
 
-  m_imageSampler = vk_utils::createSampler(m_device, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT);
+  VkSamplerCreateInfo samplerInfo = {};
+  samplerInfo.sType        = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter    = VK_FILTER_LINEAR;
+  samplerInfo.minFilter    = VK_FILTER_LINEAR;
+  samplerInfo.mipmapMode   = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+  samplerInfo.minLod       = 0.0f;
+  samplerInfo.maxLod       = float(mipLevels);
+  samplerInfo.borderColor  = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+  VK_CHECK_RESULT(vkCreateSampler(m_device, &samplerInfo, nullptr, &m_imageSampler));
 
   SetupSimplePipeline();
 
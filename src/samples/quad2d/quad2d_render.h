@@ -4,6 +4,7 @@
 #define VK_NO_PROTOTYPES
 #include "../../render/render_common.h"
 #include "../resources/shaders/common.h"
+#include "../../loader_utils/image_load_service.h"
 #include <vk_descriptor_sets.h>
 #include <vk_fbuf_attachment.h>
 #include <vk_images.h>
@@ -99,6 +100,7 @@ private:
   bool m_enableValidation;
   std::vector<const char*> m_validationLayers;
   std::shared_ptr<vk_utils::ICopyEngine> m_pCopyHelper;
+  std::unique_ptr<ImageLoadService>      m_pImageLoader;
 
   std::shared_ptr<vk_utils::IQuad> m_pFSQuad;
   VkDescriptorSet       m_quadDS; 
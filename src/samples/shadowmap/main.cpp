@@ -1,7 +1,8 @@
 #include "shadowmap_render.h"
 #include "utils/glfw_window.h"
+#include "utils/bench.h"
 
-void initVulkanGLFW(std::shared_ptr<IRender> &app, GLFWwindow* window, int deviceID)
+void initVulkanGLFW(std::shared_ptr<IRender> &app, GLFWwindow* window, int deviceID, bool showGUI)
 {
   uint32_t glfwExtensionCount = 0;
   const char** glfwExtensions;
@@ -18,17 +19,35 @@ void initVulkanGLFW(std::shared_ptr<IRender> &app, GLFWwindow* window, int devic
   {
     VkSurfaceKHR surface;
     VK_CHECK_RESULT(glfwCreateWindowSurface(app->GetVkInstance(), window, nullptr, &surface));
-//    setupImGuiContext(window);
-    app->InitPresentation(surface, false);
+
+    if(showGUI)
+      setupImGuiContext(window);
+
+    app->InitPresentation(surface, showGUI);
   }
 }
 
-int main()
+// usage: <renderer> [--scene path.xml] [--no-gui]
+//        <renderer> --bench [--scene path.xml] [--camera-path file] [--frames N] [--warmup N] [--out bench.json] [--gui]
+int main(int argc, const char** argv)
 {
   constexpr int WIDTH = 1024;
   constexpr int HEIGHT = 1024;
   constexpr int VULKAN_DEVICE_ID = 0;
 
+  auto params = readCommandLineParams(argc, argv);
+  const bool benchMode = params.count("bench") > 0;
+
+  std::string scenePath = "../resources/scenes/043_cornell_normals/statex_00001.xml";
+  if(params.count("scene") > 0 && !params["scene"].empty())
+    scenePath = params["scene"];
+
+  BenchParams benchParams;
+  if(benchMode)
+    benchParams = readBenchParams(params, scenePath);
+
+  bool showGUI = benchMode ? benchParams.gui : params.count("no-gui") == 0;
+
   std::shared_ptr<IRender> app = std::make_unique<SimpleShadowmapRender>(WIDTH, HEIGHT);
   if(app == nullptr)
   {
@@ -38,11 +57,14 @@ int main()
 
   auto* window = initWindow(WIDTH, HEIGHT);
 
-  initVulkanGLFW(app, window, VULKAN_DEVICE_ID);
+  initVulkanGLFW(app, window, VULKAN_DEVICE_ID, showGUI);
+
+  app->LoadScene(scenePath.c_str(), false);
 
-  app->LoadScene("../resources/scenes/043_cornell_normals/statex_00001.xml", false);
+  if(benchMode)
+    return benchLoop(app, window, benchParams) ? 0 : 1;
 
-  mainLoop(app, window);
+  mainLoop(app, window, showGUI);
 
   return 0;
 }
@@ -1,10 +1,22 @@
 #include "shadowmap_render.h"
+#include "../../utils/cpu_profiler.h"
 #include "../../utils/input_definitions.h"
 
 #include <geom/vk_mesh.h>
 #include <vk_pipeline.h>
 #include <vk_buffers.h>
 
+#include <cmath>
+
+namespace
+{
+  constexpr const char* SHADOW_FILTER_NAMES[SHADOW_FILTER_COUNT] = {"hard", "PCF grid", "PCF Poisson", "PCF rotated grid", "PCSS",
+                                                                    "VSM", "EVSM"};
+  constexpr const char* FORWARD_SCOPE_NAMES[SHADOW_FILTER_COUNT] = {"forward (hard)", "forward (PCF grid)", "forward (PCF Poisson)",
+                                                                    "forward (PCF rotated grid)", "forward (PCSS)", "forward (VSM)",
+                                                                    "forward (EVSM)"};
+}
+
 SimpleShadowmapRender::SimpleShadowmapRender(uint32_t a_width, uint32_t a_height) : m_width(a_width), m_height(a_height)
 {
 #ifdef NDEBUG
@@ -12,11 +24,20 @@ SimpleShadowmapRender::SimpleShadowmapRender(uint32_t a_width, uint32_t a_height
 #else
   m_enableValidation = true;
 #endif
+
+  m_pShaderMgr = std::make_unique<ShaderManager>();
+  m_pShaderMgr->RegisterProgram({VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH, MOMENTS_SHADER_PATH}, [this]() { SetupSimplePipeline(); });
 }
 
 void SimpleShadowmapRender::SetupDeviceFeatures()
 {
   // m_enabledDeviceFeatures.fillModeNonSolid = VK_TRUE;
+
+  // RG32F storage images for the VSM blur
+  VkPhysicalDeviceFeatures supported;
+  vkGetPhysicalDeviceFeatures(m_physicalDevice, &supported);
+  m_enabledDeviceFeatures.shaderStorageImageExtendedFormats = supported.shaderStorageImageExtendedFormats;
+  m_enabledDeviceFeatures.pipelineStatisticsQuery           = supported.pipelineStatisticsQuery;
 }
 
 void SimpleShadowmapRender::SetupDeviceExtensions()
@@ -59,10 +80,15 @@ void SimpleShadowmapRender::InitVulkan(const char** a_instanceExtensions, uint32
     VK_CHECK_RESULT(vkCreateFence(m_device, &fenceInfo, nullptr, &m_frameFences[i]));
   }
 
-  m_pScnMgr = std::make_shared<SceneManager>(m_device, m_physicalDevice, m_queueFamilyIDXs.transfer, m_queueFamilyIDXs.graphics, false);
+  m_pAllocator = std::make_shared<DeviceMemoryAllocator>(m_device, m_physicalDevice);
+  m_pScnMgr    = std::make_shared<SceneManager>(m_device, m_physicalDevice, m_queueFamilyIDXs.transfer, m_queueFamilyIDXs.graphics, false, m_pAllocator);
+
+  m_pGpuProfiler   = std::make_unique<GpuProfiler>(m_device, m_physicalDevice, m_queueFamilyIDXs.graphics, m_framesInFlight);
+  m_pPipelineStats = std::make_unique<PipelineStatistics>(m_device, m_enabledDeviceFeatures.pipelineStatisticsQuery == VK_TRUE,
+                                                          m_framesInFlight);
 }
 
-void SimpleShadowmapRender::InitPresentation(VkSurfaceKHR &a_surface, bool)
+void SimpleShadowmapRender::InitPresentation(VkSurfaceKHR &a_surface, bool initGUI)
 {
   m_surface = a_surface;
 
@@ -106,19 +132,19 @@ void SimpleShadowmapRender::InitPresentation(VkSurfaceKHR &a_surface, bool)
   auto memReq                = m_pShadowMap2->GetMemoryRequirements()[0]; // we know that we have only one texture
   
   // memory for all shadowmaps (well, if you have them more than 1 ...)
-  {
-    VkMemoryAllocateInfo allocateInfo = {};
-    allocateInfo.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocateInfo.pNext           = nullptr;
-    allocateInfo.allocationSize  = memReq.size;
-    allocateInfo.memoryTypeIndex = vk_utils::findMemoryType(memReq.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_physicalDevice);
-
-    VK_CHECK_RESULT(vkAllocateMemory(m_device, &allocateInfo, NULL, &m_memShadowMap));
-  }
+  m_shadowMapAlloc = m_pAllocator->Allocate(memReq, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true);
 
-  m_pShadowMap2->CreateViewAndBindMemory(m_memShadowMap, {0});
+  m_pShadowMap2->CreateViewAndBindMemory(m_shadowMapAlloc.memory, {m_shadowMapAlloc.offset});
   m_pShadowMap2->CreateDefaultSampler();
   m_pShadowMap2->CreateDefaultRenderPass();
+  CreateShadowCompareSampler();
+  UpdateMomentShadowMap();
+
+  if(initGUI)
+  {
+    m_pGUIRender = std::make_shared<ImGuiRender>(m_instance, m_device, m_physicalDevice, m_queueFamilyIDXs.graphics, m_graphicsQueue, m_swapchain);
+    m_pGUIRender->SetProfiler(m_pGpuProfiler.get());
+  }
 }
 
 void SimpleShadowmapRender::CreateInstance()
@@ -152,12 +178,50 @@ void SimpleShadowmapRender::CreateDevice(uint32_t a_deviceId)
   vkGetDeviceQueue(m_device, m_queueFamilyIDXs.transfer, 0, &m_transferQueue);
 }
 
+void SimpleShadowmapRender::CreateShadowCompareSampler()
+{
+  // linear filtering of a compare sampler gives 2x2 PCF for free, but it is optional for depth formats
+  VkFormatProperties formatProps;
+  vkGetPhysicalDeviceFormatProperties(m_physicalDevice, VK_FORMAT_D16_UNORM, &formatProps);
+  const bool linear = (formatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) != 0;
+
+  VkSamplerCreateInfo samplerInfo = {};
+  samplerInfo.sType         = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter     = linear ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+  samplerInfo.minFilter     = linear ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+  samplerInfo.mipmapMode    = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.addressModeU  = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+  samplerInfo.addressModeV  = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+  samplerInfo.addressModeW  = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+  samplerInfo.compareEnable = VK_TRUE;
+  samplerInfo.compareOp     = VK_COMPARE_OP_LESS;  // lit if (depth - bias) < stored depth
+  samplerInfo.minLod        = 0.0f;
+  samplerInfo.maxLod        = 0.0f;
+  samplerInfo.borderColor   = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE; // outside of the map is lit
+  VK_CHECK_RESULT(vkCreateSampler(m_device, &samplerInfo, nullptr, &m_shadowCmpSampler));
+}
+
+// (re)creates the moment map when it doesn't match the selected filter or resolution, returns true if it did
+bool SimpleShadowmapRender::UpdateMomentShadowMap()
+{
+  const auto mode = m_features.shadowFilter == SHADOW_FILTER_EVSM ? MomentShadowMap::Mode::EVSM : MomentShadowMap::Mode::VSM;
+  if(m_pMomentMap != nullptr && (!MomentFilter() || m_pMomentMap->GetMode() == mode) &&
+     m_pMomentMap->GetResolution() == uint32_t(m_features.momentResolution))
+    return false;
+
+  m_pMomentMap = nullptr;
+  m_pMomentMap = std::make_unique<MomentShadowMap>(m_device, m_physicalDevice, m_pAllocator, *m_pShaderMgr,
+                                                   uint32_t(m_features.momentResolution), mode,
+                                                   m_enabledDeviceFeatures.shaderStorageImageExtendedFormats == VK_TRUE,
+                                                   m_graphicsQueue, m_commandPool);
+  return true;
+}
 
 void SimpleShadowmapRender::SetupSimplePipeline()
 {
   std::vector<std::pair<VkDescriptorType, uint32_t> > dtypes = {
       {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,             1},
-      {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,     2}
+      {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,     4}
   };
 
   m_pBindings = std::make_shared<vk_utils::DescriptorMaker>(m_device, dtypes, 2);
@@ -167,6 +231,8 @@ void SimpleShadowmapRender::SetupSimplePipeline()
   m_pBindings->BindBegin(VK_SHADER_STAGE_FRAGMENT_BIT);
   m_pBindings->BindBuffer(0, m_ubo, VK_NULL_HANDLE, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
   m_pBindings->BindImage (1, shadowMap.view, m_pShadowMap2->m_sampler, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+  m_pBindings->BindImage (2, shadowMap.view, m_shadowCmpSampler, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+  m_pBindings->BindImage (3, m_pMomentMap->GetView(), m_pMomentMap->GetSampler(), VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
   m_pBindings->BindEnd(&m_dSet, &m_dSetLayout);
 
   //m_pBindings->BindImage(0, m_GBufTarget->m_attachments[m_GBuf_idx[GBUF_ATTACHMENT::POS_Z]].view, m_GBufTarget->m_sampler, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
@@ -177,85 +243,108 @@ void SimpleShadowmapRender::SetupSimplePipeline()
 
   // if we are recreating pipeline (for example, to reload shaders)
   // we need to cleanup old pipeline
+  m_forwardVariants.Clear();
   if(m_basicForwardPipeline.layout != VK_NULL_HANDLE)
   {
     vkDestroyPipelineLayout(m_device, m_basicForwardPipeline.layout, nullptr);
     m_basicForwardPipeline.layout = VK_NULL_HANDLE;
   }
-  if(m_basicForwardPipeline.pipeline != VK_NULL_HANDLE)
-  {
-    vkDestroyPipeline(m_device, m_basicForwardPipeline.pipeline, nullptr);
-    m_basicForwardPipeline.pipeline = VK_NULL_HANDLE;
-  }
 
   if(m_shadowPipeline.pipeline != VK_NULL_HANDLE)
   {
     vkDestroyPipeline(m_device, m_shadowPipeline.pipeline, nullptr);
     m_shadowPipeline.pipeline = VK_NULL_HANDLE;
   }
-
-  vk_utils::GraphicsPipelineMaker maker;
-  
-  // pipeline for drawing objects
-  //
-  std::unordered_map<VkShaderStageFlagBits, std::string> shader_paths;
+  if(m_momentsPipeline.pipeline != VK_NULL_HANDLE)
   {
-    shader_paths[VK_SHADER_STAGE_FRAGMENT_BIT] = "../resources/shaders/simple_shadow.frag.spv";
-    shader_paths[VK_SHADER_STAGE_VERTEX_BIT]   = "../resources/shaders/simple.vert.spv";
+    vkDestroyPipeline(m_device, m_momentsPipeline.pipeline, nullptr);
+    m_momentsPipeline.pipeline = VK_NULL_HANDLE;
   }
-  maker.LoadShaders(m_device, shader_paths);
 
-  m_basicForwardPipeline.layout = maker.MakeLayout(m_device, {m_dSetLayout}, sizeof(pushConst2M));
-  maker.SetDefaultState(m_width, m_height);
+  // the maker outlives this function, forward pipeline variants are made from it on first use
+  auto pMaker = std::make_shared<vk_utils::GraphicsPipelineMaker>();
+  m_basicForwardPipeline.layout = pMaker->MakeLayout(m_device, {m_dSetLayout}, sizeof(pushConst2M));
+  pMaker->SetDefaultState(m_width, m_height);
 
-  m_basicForwardPipeline.pipeline = maker.MakePipeline(m_device, m_pScnMgr->GetPipelineVertexInputStateCreateInfo(),
-                                                       m_screenRenderPass);
-                                                       //, {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR}
-  
   // pipeline for rendering objects to shadowmap
   //
-  // maker.SetDefaultState(m_width, m_height);
-  shader_paths.clear();
-  shader_paths[VK_SHADER_STAGE_VERTEX_BIT] = "../resources/shaders/simple.vert.spv";
-  maker.LoadShaders(m_device, shader_paths);
+  std::unordered_map<VkShaderStageFlagBits, std::string> shader_paths;
+  shader_paths[VK_SHADER_STAGE_VERTEX_BIT] = m_pShaderMgr->GetSPVPath(VERTEX_SHADER_PATH);
+  pMaker->LoadShaders(m_device, shader_paths);
 
-  maker.viewport.width  = float(m_pShadowMap2->m_resolution.width);
-  maker.viewport.height = float(m_pShadowMap2->m_resolution.height);
-  maker.scissor.extent  = VkExtent2D{ uint32_t(m_pShadowMap2->m_resolution.width), uint32_t(m_pShadowMap2->m_resolution.height) };
+  pMaker->viewport.width  = float(m_pShadowMap2->m_resolution.width);
+  pMaker->viewport.height = float(m_pShadowMap2->m_resolution.height);
+  pMaker->scissor.extent  = VkExtent2D{ uint32_t(m_pShadowMap2->m_resolution.width), uint32_t(m_pShadowMap2->m_resolution.height) };
 
   m_shadowPipeline.layout   = m_basicForwardPipeline.layout;
-  m_shadowPipeline.pipeline = maker.MakePipeline(m_device, m_pScnMgr->GetPipelineVertexInputStateCreateInfo(), 
-                                                 m_pShadowMap2->m_renderPass);                                                       
+  m_shadowPipeline.pipeline = pMaker->MakePipeline(m_device, m_pScnMgr->GetPipelineVertexInputStateCreateInfo(),
+                                                   m_pShadowMap2->m_renderPass);
+
+  // pipeline for rendering depth moments for VSM/EVSM, the format of the map depends on the mode
+  //
+  shader_paths[VK_SHADER_STAGE_FRAGMENT_BIT] = m_pShaderMgr->GetSPVPath(MOMENTS_SHADER_PATH);
+  pMaker->LoadShaders(m_device, shader_paths);
+
+  SpecializationConstants momentsMode;
+  momentsMode.Set(SPEC_SHADOW_FILTER, m_pMomentMap->GetMode() == MomentShadowMap::Mode::EVSM ? SHADOW_FILTER_EVSM : SHADOW_FILTER_VSM);
+  SetSpecialization(*pMaker, VK_SHADER_STAGE_FRAGMENT_BIT, momentsMode.Info());
+
+  const uint32_t momentRes = m_pMomentMap->GetResolution();
+  pMaker->viewport.width  = float(momentRes);
+  pMaker->viewport.height = float(momentRes);
+  pMaker->scissor.extent  = VkExtent2D{ momentRes, momentRes };
+
+  m_momentsPipeline.layout   = m_basicForwardPipeline.layout;
+  m_momentsPipeline.pipeline = pMaker->MakePipeline(m_device, m_pScnMgr->GetPipelineVertexInputStateCreateInfo(),
+                                                    m_pMomentMap->GetRenderPass());
+
+  // pipelines for drawing objects
+  //
+  shader_paths[VK_SHADER_STAGE_FRAGMENT_BIT] = m_pShaderMgr->GetSPVPath(FRAGMENT_SHADER_PATH);
+  m_forwardVariants.Reset(m_device, [this, pMaker, shader_paths](const VkSpecializationInfo* a_pInfo) {
+    pMaker->LoadShaders(m_device, shader_paths);
+    SetSpecialization(*pMaker, VK_SHADER_STAGE_FRAGMENT_BIT, a_pInfo);
+
+    pMaker->viewport.width  = float(m_width);
+    pMaker->viewport.height = float(m_height);
+    pMaker->scissor.extent  = VkExtent2D{ m_width, m_height };
+    return pMaker->MakePipeline(m_device, m_pScnMgr->GetPipelineVertexInputStateCreateInfo(), m_screenRenderPass);
+  });
+}
+
+VkPipeline SimpleShadowmapRender::ForwardPipeline()
+{
+  SpecializationConstants constants;
+  constants.Set(SPEC_SHADOWS, m_features.shadows)
+           .Set(SPEC_ANIMATE_LIGHT_COLOR, m_features.animateLightColor)
+           .Set(SPEC_PCF_RADIUS, m_features.shadowFilter == SHADOW_FILTER_PCF_GRID ? m_features.pcfRadius : 0)
+           .Set(SPEC_SHADOW_FILTER, m_features.shadowFilter);
+  return m_forwardVariants.Get(constants);
 }
 
 void SimpleShadowmapRender::CreateUniformBuffer()
 {
-  VkMemoryRequirements memReq;
-  m_ubo = vk_utils::createBuffer(m_device, sizeof(UniformParams), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &memReq);
-
-  VkMemoryAllocateInfo allocateInfo = {};
-  allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocateInfo.pNext = nullptr;
-  allocateInfo.allocationSize = memReq.size;
-  allocateInfo.memoryTypeIndex = vk_utils::findMemoryType(memReq.memoryTypeBits,
-                                                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                                          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                                                          m_physicalDevice);
-  VK_CHECK_RESULT(vkAllocateMemory(m_device, &allocateInfo, nullptr, &m_uboAlloc));
-  VK_CHECK_RESULT(vkBindBufferMemory(m_device, m_ubo, m_uboAlloc, 0));
-
-  vkMapMemory(m_device, m_uboAlloc, 0, sizeof(m_uniforms), 0, &m_uboMappedMem);
+  m_ubo = vk_utils::createBuffer(m_device, sizeof(UniformParams), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+  m_uboAlloc = m_pAllocator->AllocateAndBind(m_ubo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  m_uboMappedMem = m_uboAlloc.mapped;
 
   UpdateUniformBuffer(0.0f);
 }
 
 void SimpleShadowmapRender::UpdateUniformBuffer(float a_time)
 {
+  CPU_PROFILE_SCOPE("UpdateUniformBuffer");
   m_uniforms.lightMatrix = m_lightMatrix;
   m_uniforms.lightPos    = m_light.cam.pos; //LiteMath::float3(sinf(a_time), 1.0f, cosf(a_time));
   m_uniforms.time        = a_time;
 
   m_uniforms.baseColor = LiteMath::float3(0.9f, 0.92f, 1.0f);
+
+  m_uniforms.shadowFilterRadius = m_features.filterRadius;
+  m_uniforms.lightSize          = m_features.lightSize;
+  m_uniforms.shadowBias         = m_features.bias;
+  m_uniforms.lightBleedReduction = m_features.lightBleedReduction;
   memcpy(m_uboMappedMem, &m_uniforms, sizeof(m_uniforms));
 }
 
@@ -285,6 +374,7 @@ void SimpleShadowmapRender::DrawSceneCmd(VkCommandBuffer a_cmdBuff, const float4
 void SimpleShadowmapRender::BuildCommandBufferSimple(VkCommandBuffer a_cmdBuff, VkFramebuffer a_frameBuff,
                                                      VkImageView a_targetImageView, VkPipeline a_pipeline)
 {
+  CPU_PROFILE_SCOPE("record commands");
   vkResetCommandBuffer(a_cmdBuff, 0);
 
   VkCommandBufferBeginInfo beginInfo = {};
@@ -293,6 +383,9 @@ void SimpleShadowmapRender::BuildCommandBufferSimple(VkCommandBuffer a_cmdBuff,
 
   VK_CHECK_RESULT(vkBeginCommandBuffer(a_cmdBuff, &beginInfo));
 
+  m_pGpuProfiler->BeginFrame(a_cmdBuff, m_presentationResources.currentFrame);
+  m_pPipelineStats->BeginFrame(a_cmdBuff, m_presentationResources.currentFrame);
+
   VkViewport viewport{};
   VkRect2D scissor{};
   VkExtent2D ext;
@@ -319,12 +412,37 @@ void SimpleShadowmapRender::BuildCommandBufferSimple(VkCommandBuffer a_cmdBuff,
   clearDepth.depthStencil.stencil = 0;
   std::vector<VkClearValue> clear =  {clearDepth};
   VkRenderPassBeginInfo renderToShadowMap = m_pShadowMap2->GetRenderPassBeginInfo(0, clear);
-  vkCmdBeginRenderPass(a_cmdBuff, &renderToShadowMap, VK_SUBPASS_CONTENTS_INLINE);
+  if(m_features.shadows && MomentFilter())
+  {
+    VkRenderPassBeginInfo renderToMoments = m_pMomentMap->GetRenderPassBeginInfo();
+    m_pGpuProfiler->BeginScope(a_cmdBuff, "shadow moments");
+    vkCmdBeginRenderPass(a_cmdBuff, &renderToMoments, VK_SUBPASS_CONTENTS_INLINE);
+    {
+      m_pPipelineStats->BeginScope(a_cmdBuff, "shadow");
+      vkCmdBindPipeline(a_cmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, m_momentsPipeline.pipeline);
+      DrawSceneCmd(a_cmdBuff, m_lightMatrix);
+      m_pPipelineStats->EndScope(a_cmdBuff);
+    }
+    vkCmdEndRenderPass(a_cmdBuff);
+    m_pGpuProfiler->EndScope(a_cmdBuff);
+
+    m_pGpuProfiler->BeginScope(a_cmdBuff, "moments blur and mips");
+    m_pMomentMap->RecordFilter(a_cmdBuff, uint32_t(m_features.momentBlurRadius));
+    m_pGpuProfiler->EndScope(a_cmdBuff);
+  }
+  else if(m_features.shadows) // the forward pipeline without shadows does not read the shadow map
   {
-    vkCmdBindPipeline(a_cmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, m_shadowPipeline.pipeline);
-    DrawSceneCmd(a_cmdBuff, m_lightMatrix);
+    m_pGpuProfiler->BeginScope(a_cmdBuff, "shadow");
+    vkCmdBeginRenderPass(a_cmdBuff, &renderToShadowMap, VK_SUBPASS_CONTENTS_INLINE);
+    {
+      m_pPipelineStats->BeginScope(a_cmdBuff, "shadow");
+      vkCmdBindPipeline(a_cmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, m_shadowPipeline.pipeline);
+      DrawSceneCmd(a_cmdBuff, m_lightMatrix);
+      m_pPipelineStats->EndScope(a_cmdBuff);
+    }
+    vkCmdEndRenderPass(a_cmdBuff);
+    m_pGpuProfiler->EndScope(a_cmdBuff);
   }
-  vkCmdEndRenderPass(a_cmdBuff);
 
   //// draw final scene to screen
   //
@@ -342,21 +460,28 @@ void SimpleShadowmapRender::BuildCommandBufferSimple(VkCommandBuffer a_cmdBuff,
     renderPassInfo.clearValueCount = 2;
     renderPassInfo.pClearValues    = &clearValues[0];
 
+    // every filter is a separate scope, so their costs can be compared in the profiler window
+    m_pGpuProfiler->BeginScope(a_cmdBuff, m_features.shadows ? FORWARD_SCOPE_NAMES[m_features.shadowFilter] : "forward (no shadows)");
     vkCmdBeginRenderPass(a_cmdBuff, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    m_pPipelineStats->BeginScope(a_cmdBuff, "forward");
 
     vkCmdBindPipeline(a_cmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, a_pipeline);
     vkCmdBindDescriptorSets(a_cmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, m_basicForwardPipeline.layout, 0, 1, &m_dSet, 0, VK_NULL_HANDLE);
 
     DrawSceneCmd(a_cmdBuff, m_worldViewProj);
 
+    m_pPipelineStats->EndScope(a_cmdBuff);
     vkCmdEndRenderPass(a_cmdBuff);
+    m_pGpuProfiler->EndScope(a_cmdBuff);
   }
 
   if(m_input.drawFSQuad)
   {
     float scaleAndOffset[4] = {0.5f, 0.5f, -0.5f, +0.5f};
+    m_pGpuProfiler->BeginScope(a_cmdBuff, "debug quad");
     m_pFSQuad->SetRenderTarget(a_targetImageView);
     m_pFSQuad->DrawCmd(a_cmdBuff, m_quadDS, scaleAndOffset);
+    m_pGpuProfiler->EndScope(a_cmdBuff);
   }
 
   VK_CHECK_RESULT(vkEndCommandBuffer(a_cmdBuff));
@@ -424,27 +549,46 @@ void SimpleShadowmapRender::RecreateSwapChain()
   for (uint32_t i = 0; i < m_swapchain.GetImageCount(); ++i)
   {
     BuildCommandBufferSimple(m_cmdBuffersDrawMain[i], m_frameBuffers[i],
-                             m_swapchain.GetAttachment(i).view, m_basicForwardPipeline.pipeline);
+                             m_swapchain.GetAttachment(i).view, ForwardPipeline());
   }
 
+  if(m_pGUIRender)
+    m_pGUIRender->OnSwapchainChanged(m_swapchain);
 }
 
 void SimpleShadowmapRender::Cleanup()
 {
+  if(m_pGUIRender)
+  {
+    m_pGUIRender = nullptr;
+    ImGui::DestroyContext();
+  }
+  m_pGpuProfiler   = nullptr;
+  m_pPipelineStats = nullptr;
+
   m_pShadowMap2 = nullptr;
   m_pFSQuad     = nullptr; // smartptr delete it's resources
   
-  if(m_memShadowMap != VK_NULL_HANDLE)
+  if(m_pAllocator != nullptr)
+    m_pAllocator->Free(m_shadowMapAlloc);
+
+  if(m_shadowCmpSampler != VK_NULL_HANDLE)
   {
-    vkFreeMemory(m_device, m_memShadowMap, VK_NULL_HANDLE);
-    m_memShadowMap = VK_NULL_HANDLE;
+    vkDestroySampler(m_device, m_shadowCmpSampler, nullptr);
+    m_shadowCmpSampler = VK_NULL_HANDLE;
   }
+  m_pMomentMap = nullptr;
 
   CleanupPipelineAndSwapchain();
 
-  if (m_basicForwardPipeline.pipeline != VK_NULL_HANDLE)
+  m_forwardVariants.Clear();
+  if (m_shadowPipeline.pipeline != VK_NULL_HANDLE)
   {
-    vkDestroyPipeline(m_device, m_basicForwardPipeline.pipeline, nullptr);
+    vkDestroyPipeline(m_device, m_shadowPipeline.pipeline, nullptr);
+  }
+  if (m_momentsPipeline.pipeline != VK_NULL_HANDLE)
+  {
+    vkDestroyPipeline(m_device, m_momentsPipeline.pipeline, nullptr);
   }
   if (m_basicForwardPipeline.layout != VK_NULL_HANDLE)
   {
@@ -464,10 +608,23 @@ void SimpleShadowmapRender::Cleanup()
   {
     vkDestroyCommandPool(m_device, m_commandPool, nullptr);
   }
+
+  if(m_ubo != VK_NULL_HANDLE)
+  {
+    vkDestroyBuffer(m_device, m_ubo, nullptr);
+    m_ubo = VK_NULL_HANDLE;
+  }
+
+  if(m_pAllocator != nullptr)
+    m_pAllocator->Free(m_uboAlloc);
+
+  m_pScnMgr    = nullptr;
+  m_pAllocator = nullptr;
 }
 
 void SimpleShadowmapRender::ProcessInput(const AppInput &input)
 {
+  CPU_PROFILE_SCOPE("ProcessInput");
   // add keyboard controls here
   // camera movement is processed separately
   //
@@ -477,27 +634,14 @@ void SimpleShadowmapRender::ProcessInput(const AppInput &input)
   if(input.keyReleased[GLFW_KEY_P])
     m_light.usePerspectiveM = !m_light.usePerspectiveM;
 
-  // recreate pipeline to reload shaders
+  // changed shaders are recompiled in background and picked up automatically, B forces pipelines to be recreated
   if(input.keyPressed[GLFW_KEY_B])
-  {
-#ifdef WIN32
-    std::system("cd ../resources/shaders && python compile_shadowmap_shaders.py");
-#else
-    std::system("cd ../resources/shaders && python3 compile_shadowmap_shaders.py");
-#endif
-
-    SetupSimplePipeline();
-
-    for (uint32_t i = 0; i < m_framesInFlight; ++i)
-    {
-      BuildCommandBufferSimple(m_cmdBuffersDrawMain[i], m_frameBuffers[i],
-                               m_swapchain.GetAttachment(i).view, m_basicForwardPipeline.pipeline);
-    }
-  }
+    m_pShaderMgr->ReloadAll();
 }
 
 void SimpleShadowmapRender::UpdateCamera(const Camera* cams, uint32_t a_camsNumber)
 {
+  CPU_PROFILE_SCOPE("UpdateCamera");
   m_cam = cams[0];
   if(a_camsNumber >= 2)
     m_light.cam = cams[1];
@@ -550,17 +694,23 @@ void SimpleShadowmapRender::LoadScene(const char* path, bool transpose_inst_matr
   for (uint32_t i = 0; i < m_framesInFlight; ++i)
   {
     BuildCommandBufferSimple(m_cmdBuffersDrawMain[i], m_frameBuffers[i],
-                             m_swapchain.GetAttachment(i).view, m_basicForwardPipeline.pipeline);
+                             m_swapchain.GetAttachment(i).view, ForwardPipeline());
   }
 }
 
 void SimpleShadowmapRender::DrawFrameSimple()
 {
-  vkWaitForFences(m_device, 1, &m_frameFences[m_presentationResources.currentFrame], VK_TRUE, UINT64_MAX);
-  vkResetFences(m_device, 1, &m_frameFences[m_presentationResources.currentFrame]);
+  {
+    CPU_PROFILE_SCOPE("wait frame fence");
+    vkWaitForFences(m_device, 1, &m_frameFences[m_presentationResources.currentFrame], VK_TRUE, UINT64_MAX);
+    vkResetFences(m_device, 1, &m_frameFences[m_presentationResources.currentFrame]);
+  }
 
   uint32_t imageIdx;
-  m_swapchain.AcquireNextImage(m_presentationResources.imageAvailable, &imageIdx);
+  {
+    CPU_PROFILE_SCOPE("AcquireNextImage");
+    m_swapchain.AcquireNextImage(m_presentationResources.imageAvailable, &imageIdx);
+  }
 
   auto currentCmdBuf = m_cmdBuffersDrawMain[m_presentationResources.currentFrame];
 
@@ -568,7 +718,7 @@ void SimpleShadowmapRender::DrawFrameSimple()
   VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
 
   BuildCommandBufferSimple(currentCmdBuf, m_frameBuffers[imageIdx], m_swapchain.GetAttachment(imageIdx).view,
-                           m_basicForwardPipeline.pipeline);
+                           ForwardPipeline());
 
   VkSubmitInfo submitInfo = {};
   submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -582,10 +732,18 @@ void SimpleShadowmapRender::DrawFrameSimple()
   submitInfo.signalSemaphoreCount = 1;
   submitInfo.pSignalSemaphores = signalSemaphores;
 
-  VK_CHECK_RESULT(vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, m_frameFences[m_presentationResources.currentFrame]));
+  {
+    CPU_PROFILE_SCOPE("vkQueueSubmit");
+    VK_CHECK_RESULT(vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, m_frameFences[m_presentationResources.currentFrame]));
+  }
+  m_pGpuProfiler->FrameSubmitted(m_presentationResources.currentFrame);
+  m_pPipelineStats->FrameSubmitted(m_presentationResources.currentFrame);
 
-  VkResult presentRes = m_swapchain.QueuePresent(m_presentationResources.queue, imageIdx,
-                                                 m_presentationResources.renderingFinished);
+  VkResult presentRes;
+  {
+    CPU_PROFILE_SCOPE("QueuePresent");
+    presentRes = m_swapchain.QueuePresent(m_presentationResources.queue, imageIdx, m_presentationResources.renderingFinished);
+  }
 
   if (presentRes == VK_ERROR_OUT_OF_DATE_KHR || presentRes == VK_SUBOPTIMAL_KHR)
   {
@@ -598,17 +756,26 @@ void SimpleShadowmapRender::DrawFrameSimple()
 
   m_presentationResources.currentFrame = (m_presentationResources.currentFrame + 1) % m_framesInFlight;
 
+  CPU_PROFILE_SCOPE("vkQueueWaitIdle");
   vkQueueWaitIdle(m_presentationResources.queue);
 }
 
 void SimpleShadowmapRender::DrawFrame(float a_time, DrawMode a_mode)
 {
+  // every frame ends with vkQueueWaitIdle, so pipelines and the moment map can be replaced here
+  m_pShaderMgr->Update();
+  if(UpdateMomentShadowMap())
+    SetupSimplePipeline();
   UpdateUniformBuffer(a_time);
   switch (a_mode)
   {
     case DrawMode::WITH_GUI:
-//      DrawFrameWithGUI();
-//      break;
+      if(m_pGUIRender)
+      {
+        SetupGUIElements();
+        DrawFrameWithGUI();
+        break;
+      }
     case DrawMode::NO_GUI:
       DrawFrameSimple();
       break;
@@ -618,4 +785,123 @@ void SimpleShadowmapRender::DrawFrame(float a_time, DrawMode a_mode)
 
 }
 
+/////////////////////////////////
+
+void SimpleShadowmapRender::SetupGUIElements()
+{
+  CPU_PROFILE_SCOPE("SetupGUIElements");
+  ImGui_ImplVulkan_NewFrame();
+  ImGui_ImplGlfw_NewFrame();
+  ImGui::NewFrame();
+  {
+    ImGui::Begin("Shadowmap render settings");
+    ImGui::Checkbox("Show shadow map (Q)", &m_input.drawFSQuad);
+    ImGui::Checkbox("Perspective light projection (P)", &m_light.usePerspectiveM);
+    ImGui::Checkbox("Shadows", &m_features.shadows);
+    ImGui::Checkbox("Animate light color", &m_features.animateLightColor);
+    ImGui::Combo("Shadow filter", &m_features.shadowFilter, SHADOW_FILTER_NAMES, SHADOW_FILTER_COUNT);
+    if(m_features.shadowFilter == SHADOW_FILTER_PCF_GRID)
+      ImGui::SliderInt("PCF radius", &m_features.pcfRadius, 0, 3);
+    if(m_features.shadowFilter == SHADOW_FILTER_POISSON || m_features.shadowFilter == SHADOW_FILTER_ROTATED_GRID)
+      ImGui::SliderFloat("Filter radius (texels)", &m_features.filterRadius, 0.5f, 8.0f);
+    if(m_features.shadowFilter == SHADOW_FILTER_PCSS)
+      ImGui::SliderFloat("Light size", &m_features.lightSize, 0.001f, 0.05f);
+    if(MomentFilter())
+    {
+      ImGui::SliderInt("Moment map resolution", &m_features.momentResolution, 128, 2048);
+      m_features.momentResolution = 1 << int(std::round(std::log2(float(m_features.momentResolution))));
+      ImGui::SliderInt("Blur radius (texels)", &m_features.momentBlurRadius, 0, int(MomentShadowMap::MAX_BLUR_RADIUS));
+      ImGui::SliderFloat("Light bleeding reduction", &m_features.lightBleedReduction, 0.0f, 0.9f);
+    }
+    ImGui::SliderFloat("Depth bias", &m_features.bias, 0.0f, 0.01f, "%.4f");
+    ImGui::Text("Forward pipeline variants: %zu", m_forwardVariants.Size());
+    ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+    ImGui::End();
+
+    DrawGpuProfilerWindow(*m_pGpuProfiler);
+    DrawPipelineStatsWindow(*m_pPipelineStats);
+  }
+
+  ImGui::Render();
+}
+
+void SimpleShadowmapRender::DrawFrameWithGUI()
+{
+  {
+    CPU_PROFILE_SCOPE("wait frame fence");
+    vkWaitForFences(m_device, 1, &m_frameFences[m_presentationResources.currentFrame], VK_TRUE, UINT64_MAX);
+    vkResetFences(m_device, 1, &m_frameFences[m_presentationResources.currentFrame]);
+  }
+
+  uint32_t imageIdx;
+  VkResult result;
+  {
+    CPU_PROFILE_SCOPE("AcquireNextImage");
+    result = m_swapchain.AcquireNextImage(m_presentationResources.imageAvailable, &imageIdx);
+  }
+  if (result == VK_ERROR_OUT_OF_DATE_KHR)
+  {
+    RecreateSwapChain();
+    return;
+  }
+  else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+  {
+    RUN_TIME_ERROR("Failed to acquire the next swapchain image!");
+  }
+
+  auto currentCmdBuf = m_cmdBuffersDrawMain[m_presentationResources.currentFrame];
+
+  VkSemaphore waitSemaphores[] = {m_presentationResources.imageAvailable};
+  VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+
+  BuildCommandBufferSimple(currentCmdBuf, m_frameBuffers[imageIdx], m_swapchain.GetAttachment(imageIdx).view,
+                           ForwardPipeline());
+
+  ImDrawData* pDrawData = ImGui::GetDrawData();
+  VkCommandBuffer currentGUICmdBuf;
+  {
+    CPU_PROFILE_SCOPE("record GUI commands");
+    currentGUICmdBuf = m_pGUIRender->BuildGUIRenderCommand(imageIdx, pDrawData);
+  }
+
+  std::vector<VkCommandBuffer> submitCmdBufs = { currentCmdBuf, currentGUICmdBuf};
+
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.waitSemaphoreCount = 1;
+  submitInfo.pWaitSemaphores = waitSemaphores;
+  submitInfo.pWaitDstStageMask = waitStages;
+  submitInfo.commandBufferCount = (uint32_t)submitCmdBufs.size();
+  submitInfo.pCommandBuffers = submitCmdBufs.data();
+
+  VkSemaphore signalSemaphores[] = {m_presentationResources.renderingFinished};
+  submitInfo.signalSemaphoreCount = 1;
+  submitInfo.pSignalSemaphores = signalSemaphores;
 
+  {
+    CPU_PROFILE_SCOPE("vkQueueSubmit");
+    VK_CHECK_RESULT(vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, m_frameFences[m_presentationResources.currentFrame]));
+  }
+  m_pGpuProfiler->FrameSubmitted(m_presentationResources.currentFrame);
+  m_pPipelineStats->FrameSubmitted(m_presentationResources.currentFrame);
+
+  VkResult presentRes;
+  {
+    CPU_PROFILE_SCOPE("QueuePresent");
+    presentRes = m_swapchain.QueuePresent(m_presentationResources.queue, imageIdx, m_presentationResources.renderingFinished);
+  }
+
+  if (presentRes == VK_ERROR_OUT_OF_DATE_KHR || presentRes == VK_SUBOPTIMAL_KHR)
+  {
+    RecreateSwapChain();
+  }
+  else if (presentRes != VK_SUCCESS)
+  {
+    RUN_TIME_ERROR("Failed to present swapchain image");
+  }
+
+  m_presentationResources.currentFrame = (m_presentationResources.currentFrame + 1) % m_framesInFlight;
+
+  CPU_PROFILE_SCOPE("vkQueueWaitIdle");
+  vkQueueWaitIdle(m_presentationResources.queue);
+}
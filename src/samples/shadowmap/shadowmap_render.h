@@ -4,6 +4,12 @@
 #define VK_NO_PROTOTYPES
 #include "../../render/scene_mgr.h"
 #include "../../render/render_common.h"
+#include "../../render/render_gui.h"
+#include "../../render/gpu_profiler.h"
+#include "../../render/pipeline_stats.h"
+#include "../../render/shader_manager.h"
+#include "../../render/pipeline_variants.h"
+#include "../../render/moment_shadow_map.h"
 #include "../../../resources/shaders/common.h"
 #include <geom/vk_mesh.h>
 #include <vk_descriptor_sets.h>
@@ -18,6 +24,10 @@
 class SimpleShadowmapRender : public IRender
 {
 public:
+  const std::string VERTEX_SHADER_PATH   = "../resources/shaders/simple.vert";
+  const std::string FRAGMENT_SHADER_PATH = "../resources/shaders/simple_shadow.frag";
+  const std::string MOMENTS_SHADER_PATH  = "../resources/shaders/shadow_moments.frag";
+
   SimpleShadowmapRender(uint32_t a_width, uint32_t a_height);
   ~SimpleShadowmapRender()  { Cleanup(); };
 
@@ -35,6 +45,7 @@ public:
 
   void LoadScene(const char *path, bool transpose_inst_matrices) override;
   void DrawFrame(float a_time, DrawMode a_mode) override;
+  PipelineStatistics* GetPipelineStatistics() override { return m_pPipelineStats.get(); }
 
   //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -94,11 +105,30 @@ private:
 
   UniformParams m_uniforms {};
   VkBuffer m_ubo = VK_NULL_HANDLE;
-  VkDeviceMemory m_uboAlloc = VK_NULL_HANDLE;
+  MemAllocation m_uboAlloc {};
   void* m_uboMappedMem = nullptr;
 
-  pipeline_data_t m_basicForwardPipeline {};
-  pipeline_data_t m_shadowPipeline {};
+  pipeline_data_t  m_basicForwardPipeline {}; // only the layout, pipelines are in m_forwardVariants
+  pipeline_data_t  m_shadowPipeline {};
+  pipeline_data_t  m_momentsPipeline {};     // renders to m_pMomentMap, shares the layout too
+  PipelineVariants m_forwardVariants;
+
+  /**
+  \brief features of the forward pass, every combination is a separate specialized pipeline
+  */
+  struct ForwardFeatures
+  {
+    bool  shadows           = true;
+    bool  animateLightColor = true;
+    int   shadowFilter      = SHADOW_FILTER_HARD;
+    int   pcfRadius         = 1;      ///!< SHADOW_FILTER_PCF_GRID takes (2N+1)^2 taps
+    float filterRadius      = 2.0f;   ///!< Poisson and rotated grid kernel radius in texels
+    float lightSize         = 0.01f;  ///!< PCSS light size in shadow map uv
+    float bias              = 0.001f;
+    int   momentResolution  = 512;    ///!< VSM/EVSM map size, filtering allows it to be lower than the depth map
+    int   momentBlurRadius  = 4;      ///!< in texels, up to MomentShadowMap::MAX_BLUR_RADIUS
+    float lightBleedReduction = 0.2f;
+  } m_features;
 
   VkDescriptorSet m_dSet = VK_NULL_HANDLE;
   VkDescriptorSetLayout m_dSetLayout = VK_NULL_HANDLE;
@@ -125,6 +155,11 @@ private:
   std::vector<const char*> m_validationLayers;
 
   std::shared_ptr<SceneManager>     m_pScnMgr;
+  std::shared_ptr<DeviceMemoryAllocator> m_pAllocator;
+  std::shared_ptr<IRenderGUI>       m_pGUIRender;
+  std::unique_ptr<GpuProfiler>      m_pGpuProfiler;
+  std::unique_ptr<PipelineStatistics> m_pPipelineStats;
+  std::unique_ptr<ShaderManager>    m_pShaderMgr;
   
   // objects and data for shadow map
   //
@@ -133,7 +168,9 @@ private:
   std::shared_ptr<vk_utils::RenderTarget>        m_pShadowMap2;
   uint32_t                                       m_shadowMapId = 0;
   
-  VkDeviceMemory        m_memShadowMap = VK_NULL_HANDLE;
+  MemAllocation         m_shadowMapAlloc {};
+  VkSampler             m_shadowCmpSampler = VK_NULL_HANDLE; ///!< depth compare sampler for sampler2DShadow
+  std::unique_ptr<MomentShadowMap> m_pMomentMap;              ///!< used instead of m_pShadowMap2 by VSM and EVSM filters
   VkDescriptorSet       m_quadDS; 
   VkDescriptorSetLayout m_quadDSLayout = nullptr;
 
@@ -166,6 +203,8 @@ private:
   } m_light;
  
   void DrawFrameSimple();
+  void DrawFrameWithGUI();
+  void SetupGUIElements();
 
   void CreateInstance();
   void CreateDevice(uint32_t a_deviceId);
@@ -176,6 +215,10 @@ private:
   void DrawSceneCmd(VkCommandBuffer a_cmdBuff, const float4x4& a_wvp);
 
   void SetupSimplePipeline();
+  void CreateShadowCompareSampler();
+  bool UpdateMomentShadowMap();
+  bool MomentFilter() const { return m_features.shadowFilter == SHADOW_FILTER_VSM || m_features.shadowFilter == SHADOW_FILTER_EVSM; }
+  VkPipeline ForwardPipeline();
   void CleanupPipelineAndSwapchain();
   void RecreateSwapChain();
 
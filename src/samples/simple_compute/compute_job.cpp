@@ -0,0 +1,297 @@
+#include "compute_job.h"
+
+#include <vk_pipeline.h>
+#include <vk_buffers.h>
+#include <vk_utils.h>
+
+#include <algorithm>
+
+static VkDeviceSize alignUp(VkDeviceSize a_val, VkDeviceSize a_alignment)
+{
+  return (a_val + a_alignment - 1) / a_alignment * a_alignment;
+}
+
+SimpleComputeJob::SimpleComputeJob(VkDevice a_device, VkPhysicalDevice a_physDevice, VkQueue a_queue, uint32_t a_queueFamilyIdx,
+                                   std::shared_ptr<DeviceMemoryAllocator> a_pAllocator, uint32_t a_length, bool a_useTimeline,
+                                   uint32_t a_workGroupSize, const std::string &a_shaderPath) :
+                                   m_device(a_device), m_physDevice(a_physDevice), m_queue(a_queue), m_pAllocator(a_pAllocator),
+                                   m_length(a_length), m_workGroupSize(a_workGroupSize), m_useTimeline(a_useTimeline)
+{
+  const VkDeviceSize bytes = VkDeviceSize(std::max(m_length, 1u)) * sizeof(float);
+
+  m_A = vk_utils::createBuffer(m_device, bytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+  m_B = vk_utils::createBuffer(m_device, bytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+  m_inputAllocs[0] = m_pAllocator->AllocateAndBind(m_A, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  m_inputAllocs[1] = m_pAllocator->AllocateAndBind(m_B, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  std::vector<std::pair<VkDescriptorType, uint32_t> > dtypes = {
+      {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,             3 * SLOTS}
+  };
+  m_pBindings = std::make_shared<vk_utils::DescriptorMaker>(m_device, dtypes, SLOTS);
+
+  for(auto& slot : m_slots)
+  {
+    slot.sum      = vk_utils::createBuffer(m_device, bytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    slot.sumAlloc = m_pAllocator->AllocateAndBind(slot.sum, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    m_pBindings->BindBegin(VK_SHADER_STAGE_COMPUTE_BIT);
+    m_pBindings->BindBuffer(0, m_A);
+    m_pBindings->BindBuffer(1, m_B);
+    m_pBindings->BindBuffer(2, slot.sum);
+    m_pBindings->BindEnd(&slot.dSet, &m_dSetLayout);
+  }
+
+  CreatePipeline(a_shaderPath);
+  CreateReadback();
+
+  m_cmdPool = vk_utils::createCommandPool(m_device, a_queueFamilyIdx, 0);
+  for(uint32_t i = 0; i < SLOTS; ++i)
+  {
+    m_slots[i].cmd = vk_utils::createCommandBuffers(m_device, m_cmdPool, 1)[0];
+    RecordSlot(i);
+
+    if(!m_useTimeline)
+    {
+      VkFenceCreateInfo fenceInfo = {};
+      fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+      VK_CHECK_RESULT(vkCreateFence(m_device, &fenceInfo, nullptr, &m_slots[i].fence));
+    }
+  }
+
+  if(m_useTimeline)
+  {
+    VkSemaphoreTypeCreateInfoKHR typeInfo = {};
+    typeInfo.sType         = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+    typeInfo.initialValue  = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+    VK_CHECK_RESULT(vkCreateSemaphore(m_device, &semaphoreInfo, nullptr, &m_timeline));
+  }
+}
+
+SimpleComputeJob::~SimpleComputeJob()
+{
+  if(m_lastTicket > 0)
+    WaitTicket(m_lastTicket);
+
+  for(auto& slot : m_slots)
+  {
+    vkDestroyBuffer(m_device, slot.sum, nullptr);
+    m_pAllocator->Free(slot.sumAlloc);
+    if(slot.fence != VK_NULL_HANDLE)
+      vkDestroyFence(m_device, slot.fence, nullptr);
+  }
+  vkDestroyBuffer(m_device, m_A, nullptr);
+  vkDestroyBuffer(m_device, m_B, nullptr);
+  vkDestroyBuffer(m_device, m_readback, nullptr);
+  m_pAllocator->Free(m_inputAllocs[0]);
+  m_pAllocator->Free(m_inputAllocs[1]);
+  m_pAllocator->Free(m_readbackAlloc);
+
+  if(m_timeline != VK_NULL_HANDLE)
+    vkDestroySemaphore(m_device, m_timeline, nullptr);
+  vkDestroyCommandPool(m_device, m_cmdPool, nullptr);
+
+  vkDestroyPipeline(m_device, m_pipeline, nullptr);
+  vkDestroyPipelineLayout(m_device, m_layout, nullptr);
+  m_pBindings = nullptr;
+}
+
+void SimpleComputeJob::CreatePipeline(const std::string &a_shaderPath)
+{
+  std::vector<uint32_t> code = vk_utils::readSPVFile(a_shaderPath.c_str());
+  VkShaderModuleCreateInfo createInfo = {};
+  createInfo.sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  createInfo.pCode    = code.data();
+  createInfo.codeSize = code.size() * sizeof(uint32_t);
+
+  VkShaderModule shaderModule;
+  VK_CHECK_RESULT(vkCreateShaderModule(m_device, &createInfo, nullptr, &shaderModule));
+
+  VkPushConstantRange pcRange = {};
+  pcRange.offset     = 0;
+  pcRange.size       = sizeof(m_length);
+  pcRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+  pipelineLayoutInfo.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount         = 1;
+  pipelineLayoutInfo.pSetLayouts            = &m_dSetLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges    = &pcRange;
+  VK_CHECK_RESULT(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_layout));
+
+  VkComputePipelineCreateInfo pipelineInfo = {};
+  pipelineInfo.sType        = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage  = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = shaderModule;
+  pipelineInfo.stage.pName  = "main";
+  pipelineInfo.layout       = m_layout;
+  VK_CHECK_RESULT(vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pipeline));
+
+  vkDestroyShaderModule(m_device, shaderModule, nullptr);
+}
+
+void SimpleComputeJob::CreateReadback()
+{
+  VkPhysicalDeviceProperties props = {};
+  vkGetPhysicalDeviceProperties(m_physDevice, &props);
+  m_atomSize   = std::max<VkDeviceSize>(props.limits.nonCoherentAtomSize, 1);
+  m_slotStride = alignUp(VkDeviceSize(std::max(m_length, 1u)) * sizeof(float), m_atomSize);
+
+  // one extra atom, so invalidated ranges rounded to atoms never leave the allocation
+  m_readback = vk_utils::createBuffer(m_device, m_slotStride * SLOTS + m_atomSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+  VkMemoryRequirements memReq;
+  vkGetBufferMemoryRequirements(m_device, m_readback, &memReq);
+  VkPhysicalDeviceMemoryProperties memProps;
+  vkGetPhysicalDeviceMemoryProperties(m_physDevice, &memProps);
+
+  // cached memory makes host reads fast, but is often not coherent; fall back to coherent memory when there is none
+  VkMemoryPropertyFlags memFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  for(uint32_t i = 0; i < memProps.memoryTypeCount; ++i)
+  {
+    const VkMemoryPropertyFlags cached = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+    if((memReq.memoryTypeBits & (1u << i)) && (memProps.memoryTypes[i].propertyFlags & cached) == cached)
+    {
+      memFlags = cached;
+      break;
+    }
+  }
+
+  // the allocator picks the same memory type as findMemoryType
+  const uint32_t memTypeIdx = vk_utils::findMemoryType(memReq.memoryTypeBits, memFlags, m_physDevice);
+  m_coherent      = (memProps.memoryTypes[memTypeIdx].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+  m_readbackAlloc = m_pAllocator->AllocateAndBind(m_readback, memFlags);
+}
+
+void SimpleComputeJob::RecordSlot(uint32_t a_slotId)
+{
+  Slot &slot = m_slots[a_slotId];
+  const VkDeviceSize bytes = VkDeviceSize(std::max(m_length, 1u)) * sizeof(float);
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  VK_CHECK_RESULT(vkBeginCommandBuffer(slot.cmd, &beginInfo));
+
+  vkCmdBindPipeline      (slot.cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+  vkCmdBindDescriptorSets(slot.cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_layout, 0, 1, &slot.dSet, 0, NULL);
+  vkCmdPushConstants(slot.cmd, m_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(m_length), &m_length);
+  vkCmdDispatch(slot.cmd, (m_length + m_workGroupSize - 1) / m_workGroupSize, 1, 1);
+
+  VkMemoryBarrier barrier = {};
+  barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  vkCmdPipelineBarrier(slot.cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                       1, &barrier, 0, nullptr, 0, nullptr);
+
+  VkBufferCopy copySum = {0, m_slotStride * a_slotId, bytes};
+  vkCmdCopyBuffer(slot.cmd, slot.sum, m_readback, 1, &copySum);
+
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  vkCmdPipelineBarrier(slot.cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                       1, &barrier, 0, nullptr, 0, nullptr);
+
+  VK_CHECK_RESULT(vkEndCommandBuffer(slot.cmd));
+}
+
+void SimpleComputeJob::SetInputs(std::shared_ptr<vk_utils::ICopyEngine> a_pCopyHelper, const float* a_A, const float* a_B)
+{
+  if(m_lastTicket > 0)
+    WaitTicket(m_lastTicket);
+  if(m_length == 0)
+    return;
+
+  a_pCopyHelper->UpdateBuffer(m_A, 0, a_A, sizeof(float) * m_length);
+  a_pCopyHelper->UpdateBuffer(m_B, 0, a_B, sizeof(float) * m_length);
+}
+
+uint64_t SimpleComputeJob::Submit()
+{
+  const uint64_t ticket = m_lastTicket + 1;
+  Slot &slot = m_slots[(ticket - 1) % SLOTS];
+
+  // command buffer and readback region of the slot are reused
+  if(slot.ticket != 0)
+  {
+    WaitTicket(slot.ticket);
+    if(!m_useTimeline)
+      VK_CHECK_RESULT(vkResetFences(m_device, 1, &slot.fence));
+  }
+
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers    = &slot.cmd;
+
+  VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+  if(m_useTimeline)
+  {
+    timelineInfo.sType                     = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues    = &ticket;
+
+    submitInfo.pNext                = &timelineInfo;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores    = &m_timeline;
+  }
+  VK_CHECK_RESULT(vkQueueSubmit(m_queue, 1, &submitInfo, slot.fence));
+
+  slot.ticket      = ticket;
+  slot.invalidated = false;
+  m_lastTicket     = ticket;
+  return ticket;
+}
+
+void SimpleComputeJob::WaitTicket(uint64_t a_ticket)
+{
+  if(m_useTimeline)
+  {
+    VkSemaphoreWaitInfoKHR waitInfo = {};
+    waitInfo.sType          = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores    = &m_timeline;
+    waitInfo.pValues        = &a_ticket;
+    VK_CHECK_RESULT(vkWaitSemaphoresKHR(m_device, &waitInfo, UINT64_MAX));
+    return;
+  }
+
+  // fences complete in submission order on one queue, so waiting for later tickets is never needed
+  const Slot &slot = m_slots[(a_ticket - 1) % SLOTS];
+  if(slot.ticket == a_ticket)
+    VK_CHECK_RESULT(vkWaitForFences(m_device, 1, &slot.fence, VK_TRUE, UINT64_MAX));
+}
+
+const float* SimpleComputeJob::Wait(uint64_t a_ticket)
+{
+  if(a_ticket == 0 || a_ticket > m_lastTicket)
+    RUN_TIME_ERROR("[SimpleComputeJob::Wait] ticket was not submitted");
+  if(a_ticket + SLOTS <= m_lastTicket)
+    RUN_TIME_ERROR("[SimpleComputeJob::Wait] results of the ticket were overwritten by later submits");
+
+  WaitTicket(a_ticket);
+
+  const uint32_t slotId = uint32_t((a_ticket - 1) % SLOTS);
+  Slot &slot = m_slots[slotId];
+  if(!m_coherent && !slot.invalidated)
+  {
+    const VkDeviceSize begin = m_readbackAlloc.offset + m_slotStride * slotId;
+    const VkDeviceSize start = begin / m_atomSize * m_atomSize;
+
+    VkMappedMemoryRange range = {};
+    range.sType  = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = m_readbackAlloc.memory;
+    range.offset = start;
+    range.size   = alignUp(begin + VkDeviceSize(m_length) * sizeof(float), m_atomSize) - start;
+    VK_CHECK_RESULT(vkInvalidateMappedMemoryRanges(m_device, 1, &range));
+    slot.invalidated = true;
+  }
+
+  return (const float*)((const char*)m_readbackAlloc.mapped + m_slotStride * slotId);
+}
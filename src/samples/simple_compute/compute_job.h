@@ -0,0 +1,99 @@
+#ifndef SIMPLE_COMPUTE_JOB_H
+#define SIMPLE_COMPUTE_JOB_H
+
+#define VK_NO_PROTOTYPES
+#include "../../render/compute_common.h"
+#include "../../render/mem_allocator.h"
+#include <vk_descriptor_sets.h>
+#include <vk_copy.h>
+
+#include <memory>
+#include <string>
+
+/**
+\brief sum = A + B over arrays of fixed length, set up once and submitted any number of times
+
+Inputs, pipeline and command buffers live as long as the job. Every submit gets its own slot (result buffer, region of
+the readback buffer and a pre-recorded command buffer), so up to SLOTS submits are in flight back to back without host
+waits. Completion is tracked with a timeline semaphore (one value per submit) or with per slot fences when the device
+doesn't support VK_KHR_timeline_semaphore. Results are copied into persistently mapped host cached memory.
+*/
+class SimpleComputeJob
+{
+public:
+  static constexpr uint32_t SLOTS = 3;
+
+  SimpleComputeJob(VkDevice a_device, VkPhysicalDevice a_physDevice, VkQueue a_queue, uint32_t a_queueFamilyIdx,
+                   std::shared_ptr<DeviceMemoryAllocator> a_pAllocator, uint32_t a_length, bool a_useTimeline,
+                   uint32_t a_workGroupSize, const std::string &a_shaderPath = "../resources/shaders/simple.comp.spv");
+  ~SimpleComputeJob();
+
+  SimpleComputeJob(const SimpleComputeJob&) = delete;
+  SimpleComputeJob& operator=(const SimpleComputeJob&) = delete;
+
+  /// blocking upload, must not be called while submits are in flight
+  void SetInputs(std::shared_ptr<vk_utils::ICopyEngine> a_pCopyHelper, const float* a_A, const float* a_B);
+
+  /**
+  \brief submit one job and return its ticket (tickets start from 1 and grow by 1)
+         blocks only when all slots are busy, until the oldest submit completes
+  */
+  uint64_t Submit();
+
+  /**
+  \brief wait for a_ticket and return its m_length results,
+         pointer stays valid until the slot is reused by the submit with ticket a_ticket + SLOTS
+  */
+  const float* Wait(uint64_t a_ticket);
+
+  uint32_t Length() const { return m_length; }
+  bool UsesTimeline() const { return m_useTimeline; }
+
+private:
+  struct Slot
+  {
+    VkBuffer        sum    = VK_NULL_HANDLE;
+    MemAllocation   sumAlloc {};
+    VkDescriptorSet dSet   = VK_NULL_HANDLE;
+    VkCommandBuffer cmd    = VK_NULL_HANDLE;
+    VkFence         fence  = VK_NULL_HANDLE; ///!< only without timeline semaphores
+    uint64_t        ticket = 0;              ///!< last ticket submitted in this slot, 0 if none
+    bool            invalidated = false;     ///!< readback region was already invalidated for this ticket
+  };
+
+  void CreatePipeline(const std::string &a_shaderPath);
+  void CreateReadback();
+  void RecordSlot(uint32_t a_slotId);
+  void WaitTicket(uint64_t a_ticket);
+
+  VkDevice         m_device     = VK_NULL_HANDLE;
+  VkPhysicalDevice m_physDevice = VK_NULL_HANDLE;
+  VkQueue          m_queue      = VK_NULL_HANDLE;
+  std::shared_ptr<DeviceMemoryAllocator> m_pAllocator;
+
+  uint32_t m_length        = 0;
+  uint32_t m_workGroupSize = 0;
+  bool     m_useTimeline   = false;
+
+  VkCommandPool m_cmdPool  = VK_NULL_HANDLE;
+  VkSemaphore   m_timeline = VK_NULL_HANDLE;
+  uint64_t      m_lastTicket = 0;
+
+  std::shared_ptr<vk_utils::DescriptorMaker> m_pBindings;
+  VkDescriptorSetLayout m_dSetLayout = VK_NULL_HANDLE;
+  VkPipelineLayout      m_layout     = VK_NULL_HANDLE;
+  VkPipeline            m_pipeline   = VK_NULL_HANDLE;
+
+  VkBuffer      m_A = VK_NULL_HANDLE, m_B = VK_NULL_HANDLE;
+  MemAllocation m_inputAllocs[2] {};
+
+  VkBuffer      m_readback = VK_NULL_HANDLE;
+  MemAllocation m_readbackAlloc {};
+  VkDeviceSize  m_slotStride  = 0;     // readback region of a slot, multiple of nonCoherentAtomSize
+  VkDeviceSize  m_atomSize    = 1;
+  bool          m_coherent    = true;
+
+  Slot m_slots[SLOTS];
+};
+
+#endif //SIMPLE_COMPUTE_JOB_H
@@ -1,11 +1,48 @@
 #include "simple_compute.h"
 
-int main()
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+// usage: simple_compute [length] [--stream [tile_length]] [--primitives [length]] [--repeat count]
+// arrays that don't fit into a single dispatch are always processed in streaming mode
+int main(int argc, const char** argv)
 {
-  constexpr int LENGTH = 10;
+  uint64_t length = 10;
   constexpr int VULKAN_DEVICE_ID = 0;
 
-  std::shared_ptr<ICompute> app = std::make_unique<SimpleCompute>(LENGTH);
+  bool     streaming  = false;
+  uint32_t tileLength = 0;
+  uint32_t primitivesLength = 0;
+  uint32_t repeats    = 1;
+  for(int i = 1; i < argc; ++i)
+  {
+    if(std::strcmp(argv[i], "--stream") == 0)
+    {
+      streaming = true;
+      if(i + 1 < argc && argv[i + 1][0] != '-')
+        tileLength = uint32_t(std::strtoul(argv[++i], nullptr, 10));
+    }
+    else if(std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+      repeats = uint32_t(std::strtoul(argv[++i], nullptr, 10));
+    else if(std::strcmp(argv[i], "--primitives") == 0)
+    {
+      primitivesLength = 1u << 22;
+      if(i + 1 < argc && argv[i + 1][0] != '-')
+        primitivesLength = uint32_t(std::strtoul(argv[++i], nullptr, 10));
+    }
+    else
+      length = std::strtoull(argv[i], nullptr, 10);
+  }
+
+  auto pCompute = std::make_shared<SimpleCompute>(uint32_t(std::min<uint64_t>(length, UINT32_MAX)));
+  if(streaming || length > UINT32_MAX)
+    pCompute->SetStreamingMode(length, tileLength);
+  pCompute->SetRepeats(repeats);
+  if(primitivesLength > 0)
+    pCompute->SetPrimitivesBenchmark(primitivesLength);
+
+  std::shared_ptr<ICompute> app = pCompute;
   if(app == nullptr)
   {
     std::cout << "Can't create render of specified type" << std::endl;
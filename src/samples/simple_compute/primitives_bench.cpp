@@ -0,0 +1,223 @@
+#include "simple_compute.h"
+#include "../../render/compute_primitives.h"
+
+#include <vk_buffers.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <random>
+
+namespace
+{
+  struct BenchBuffer
+  {
+    VkBuffer      buf = VK_NULL_HANDLE;
+    MemAllocation alloc {};
+  };
+
+  constexpr uint32_t BENCH_ITERATIONS = 10;
+}
+
+void SimpleCompute::SetPrimitivesBenchmark(uint32_t a_length)
+{
+  m_primitivesLength = a_length;
+}
+
+void SimpleCompute::ExecutePrimitivesBenchmark()
+{
+  const uint32_t n = m_primitivesLength;
+  const VkDeviceSize bytes = VkDeviceSize(std::max(n, 1u)) * sizeof(uint32_t);
+
+  ComputePrimitives prims(m_device, m_physicalDevice, m_pAllocator);
+  prims.Reserve(n);
+
+  VkPhysicalDeviceProperties props = {};
+  vkGetPhysicalDeviceProperties(m_physicalDevice, &props);
+
+  std::cout << "compute primitives: " << n << " elements, workgroup scans use "
+            << (prims.UsesSubgroups() ? "subgroup arithmetic" : "shared memory") << std::endl;
+
+  // inputs
+  //
+  std::mt19937 rnd(12345);
+  std::vector<uint32_t> keys(n), values(n), flags(n), small(n);
+  for(uint32_t i = 0; i < n; ++i)
+  {
+    keys[i]   = rnd();
+    values[i] = i;
+    flags[i]  = rnd() & 1;
+    small[i]  = rnd() & 0xFF;
+  }
+
+  auto createBuffer = [&](VkDeviceSize a_size, VkMemoryPropertyFlags a_props) {
+    BenchBuffer res;
+    res.buf   = vk_utils::createBuffer(m_device, a_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                                         VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    res.alloc = m_pAllocator->AllocateAndBind(res.buf, a_props);
+    return res;
+  };
+
+  BenchBuffer staging = createBuffer(bytes, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  BenchBuffer srcKeys   = createBuffer(bytes, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  BenchBuffer srcValues = createBuffer(bytes, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  BenchBuffer srcFlags  = createBuffer(bytes, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  BenchBuffer srcSmall  = createBuffer(bytes, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  BenchBuffer work      = createBuffer(bytes, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  BenchBuffer workVals  = createBuffer(bytes, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  BenchBuffer out       = createBuffer(bytes, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  BenchBuffer count     = createBuffer(sizeof(uint32_t), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  VkCommandBuffer cmdBuf = vk_utils::createCommandBuffers(m_device, m_commandPool, 1)[0];
+  auto runNow = [&](const std::function<void(VkCommandBuffer)> &a_record) {
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkResetCommandBuffer(cmdBuf, 0);
+    VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuf, &beginInfo));
+    a_record(cmdBuf);
+    VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuf));
+    vk_utils::executeCommandBufferNow(cmdBuf, m_computeQueue, m_device);
+  };
+
+  auto upload = [&](const std::vector<uint32_t> &a_data, VkBuffer a_dst) {
+    if(a_data.empty())
+      return;
+    memcpy(staging.alloc.mapped, a_data.data(), a_data.size() * sizeof(uint32_t));
+    runNow([&](VkCommandBuffer a_cmd) {
+      VkBufferCopy region = {0, 0, a_data.size() * sizeof(uint32_t)};
+      vkCmdCopyBuffer(a_cmd, staging.buf, a_dst, 1, &region);
+    });
+  };
+
+  auto download = [&](VkBuffer a_src, uint32_t a_count) {
+    std::vector<uint32_t> res(a_count);
+    if(a_count == 0)
+      return res;
+    runNow([&](VkCommandBuffer a_cmd) {
+      VkBufferCopy region = {0, 0, a_count * sizeof(uint32_t)};
+      vkCmdCopyBuffer(a_cmd, a_src, staging.buf, 1, &region);
+    });
+    memcpy(res.data(), staging.alloc.mapped, a_count * sizeof(uint32_t));
+    return res;
+  };
+
+  upload(keys,   srcKeys.buf);
+  upload(values, srcValues.buf);
+  upload(flags,  srcFlags.buf);
+  upload(small,  srcSmall.buf);
+
+  VkQueryPool queryPool = VK_NULL_HANDLE;
+  VkQueryPoolCreateInfo queryInfo = {};
+  queryInfo.sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  queryInfo.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+  queryInfo.queryCount = 2;
+  VK_CHECK_RESULT(vkCreateQueryPool(m_device, &queryInfo, nullptr, &queryPool));
+
+  // inputs are restored from the pristine copies before every iteration, only the primitive itself is timed
+  auto copyBuf = [&](VkCommandBuffer a_cmd, VkBuffer a_src, VkBuffer a_dst) {
+    VkBufferCopy region = {0, 0, bytes};
+    vkCmdCopyBuffer(a_cmd, a_src, a_dst, 1, &region);
+  };
+  auto transferToCompute = [](VkCommandBuffer a_cmd) {
+    VkMemoryBarrier barrier = {};
+    barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(a_cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                         1, &barrier, 0, nullptr, 0, nullptr);
+  };
+
+  auto benchmark = [&](const char* a_name, double a_bytesPerElem, const std::function<void(VkCommandBuffer)> &a_prepare,
+                       const std::function<void(VkCommandBuffer)> &a_record, bool a_passed) {
+    double bestMs = 1e30, totalMs = 0.0;
+    for(uint32_t iter = 0; iter <= BENCH_ITERATIONS; ++iter) // iteration 0 is a warm-up
+    {
+      const auto hostStart = std::chrono::high_resolution_clock::now();
+      runNow([&](VkCommandBuffer a_cmd) {
+        vkCmdResetQueryPool(a_cmd, queryPool, 0, 2);
+        a_prepare(a_cmd);
+        transferToCompute(a_cmd);
+        vkCmdWriteTimestamp(a_cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+        a_record(a_cmd);
+        vkCmdWriteTimestamp(a_cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+      });
+      const auto hostEnd = std::chrono::high_resolution_clock::now();
+
+      double ms = std::chrono::duration<double, std::milli>(hostEnd - hostStart).count();
+      if(props.limits.timestampComputeAndGraphics)
+      {
+        uint64_t timestamps[2] = {};
+        VK_CHECK_RESULT(vkGetQueryPoolResults(m_device, queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+                                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+        ms = double(timestamps[1] - timestamps[0]) * props.limits.timestampPeriod * 1e-6;
+      }
+
+      if(iter == 0)
+        continue;
+      bestMs   = std::min(bestMs, ms);
+      totalMs += ms;
+    }
+
+    const double avgMs = totalMs / BENCH_ITERATIONS;
+    std::cout << "  " << a_name << ": avg " << avgMs << " ms, best " << bestMs << " ms, "
+              << double(n) / (bestMs * 1e-3) / 1e9 << " Gelem/s, "
+              << double(n) * a_bytesPerElem / (bestMs * 1e-3) / 1e9 << " GB/s, "
+              << (a_passed ? "matches CPU" : "MISMATCH") << std::endl;
+  };
+
+  auto noPrepare = [](VkCommandBuffer) {};
+
+  // reduce: reads every element once
+  {
+    runNow([&](VkCommandBuffer a_cmd) { prims.RecordReduce(a_cmd, srcSmall.buf, n, count.buf); });
+    const bool passed = download(count.buf, 1)[0] == ComputePrimitives::ReduceCPU(small);
+    benchmark("reduce", 4.0, noPrepare, [&](VkCommandBuffer a_cmd) { prims.RecordReduce(a_cmd, srcSmall.buf, n, count.buf); }, passed);
+  }
+
+  // exclusive scan: one read, one write at the first level
+  {
+    runNow([&](VkCommandBuffer a_cmd) { prims.RecordExclusiveScan(a_cmd, srcSmall.buf, out.buf, n); });
+    const bool passed = download(out.buf, n) == ComputePrimitives::ExclusiveScanCPU(small);
+    benchmark("exclusive scan", 8.0, noPrepare, [&](VkCommandBuffer a_cmd) { prims.RecordExclusiveScan(a_cmd, srcSmall.buf, out.buf, n); }, passed);
+  }
+
+  // compaction: scan of flags, then flags, offsets and values are read and survivors written
+  {
+    runNow([&](VkCommandBuffer a_cmd) { prims.RecordCompact(a_cmd, srcKeys.buf, srcFlags.buf, n, out.buf, count.buf); });
+    const auto expected = ComputePrimitives::CompactCPU(keys, flags);
+    const uint32_t gpuCount = download(count.buf, 1)[0];
+    const bool passed = gpuCount == expected.size() && download(out.buf, gpuCount) == expected;
+    benchmark("stream compaction", 20.0, noPrepare,
+              [&](VkCommandBuffer a_cmd) { prims.RecordCompact(a_cmd, srcKeys.buf, srcFlags.buf, n, out.buf, count.buf); }, passed);
+  }
+
+  // radix sort of key-value pairs: 8 passes, each reads keys for the histogram and reads/writes both arrays in scatter
+  {
+    auto prepare = [&](VkCommandBuffer a_cmd) {
+      copyBuf(a_cmd, srcKeys.buf, work.buf);
+      copyBuf(a_cmd, srcValues.buf, workVals.buf);
+    };
+    runNow([&](VkCommandBuffer a_cmd) {
+      prepare(a_cmd);
+      transferToCompute(a_cmd);
+      prims.RecordRadixSort(a_cmd, work.buf, n, workVals.buf);
+    });
+
+    auto expectedKeys = keys;
+    auto expectedVals = values;
+    ComputePrimitives::RadixSortCPU(expectedKeys, expectedVals);
+    const bool passed = download(work.buf, n) == expectedKeys && download(workVals.buf, n) == expectedVals;
+    benchmark("radix sort (key-value)", 8.0 * (4.0 + 16.0), prepare,
+              [&](VkCommandBuffer a_cmd) { prims.RecordRadixSort(a_cmd, work.buf, n, workVals.buf); }, passed);
+  }
+
+  vkDestroyQueryPool(m_device, queryPool, nullptr);
+  vkFreeCommandBuffers(m_device, m_commandPool, 1, &cmdBuf);
+  for(auto pBuf : {&staging, &srcKeys, &srcValues, &srcFlags, &srcSmall, &work, &workVals, &out, &count})
+  {
+    prims.ForgetBuffer(pBuf->buf);
+    vkDestroyBuffer(m_device, pBuf->buf, nullptr);
+    m_pAllocator->Free(pBuf->alloc);
+  }
+}
@@ -4,6 +4,34 @@
 #include <vk_buffers.h>
 #include <vk_utils.h>
 
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <cstring>
+
+// tiles are written on the transfer queue and read on the compute queue, concurrent sharing avoids ownership transfers
+static VkBuffer createSharedBuffer(VkDevice a_device, VkDeviceSize a_size, VkBufferUsageFlags a_usage,
+                                   const vk_utils::QueueFID_T &a_queueFIDs)
+{
+  uint32_t families[2] = {a_queueFIDs.transfer, a_queueFIDs.compute};
+
+  VkBufferCreateInfo bufferInfo = {};
+  bufferInfo.sType       = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size        = a_size;
+  bufferInfo.usage       = a_usage;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  if(families[0] != families[1])
+  {
+    bufferInfo.sharingMode           = VK_SHARING_MODE_CONCURRENT;
+    bufferInfo.queueFamilyIndexCount = 2;
+    bufferInfo.pQueueFamilyIndices   = families;
+  }
+
+  VkBuffer buf = VK_NULL_HANDLE;
+  VK_CHECK_RESULT(vkCreateBuffer(a_device, &bufferInfo, nullptr, &buf));
+  return buf;
+}
+
 SimpleCompute::SimpleCompute(uint32_t a_length) : m_length(a_length)
 {
 #ifdef NDEBUG
@@ -35,7 +63,7 @@ void SimpleCompute::InitVulkan(const char** a_instanceExtensions, uint32_t a_ins
 
   m_commandPool = vk_utils::createCommandPool(m_device, m_queueFamilyIDXs.compute, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 
-  m_cmdBufferCompute = vk_utils::createCommandBuffers(m_device, m_commandPool, 1)[0];
+  m_pAllocator = std::make_shared<DeviceMemoryAllocator>(m_device, m_physicalDevice);
   
   m_pCopyHelper = std::make_shared<vk_utils::SimpleCopyHelper>(m_physicalDevice, m_device, m_transferQueue, m_queueFamilyIDXs.compute, 8*1024*1024);
 }
@@ -61,84 +89,259 @@ void SimpleCompute::CreateDevice(uint32_t a_deviceId)
 {
   m_physicalDevice = vk_utils::findPhysicalDevice(m_instance, true, a_deviceId, m_deviceExtensions);
 
+  // timeline semaphores are core only since Vulkan 1.2, with 1.1 they come from the extension
+  uint32_t extensionsNum = 0;
+  vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extensionsNum, nullptr);
+  std::vector<VkExtensionProperties> extensions(extensionsNum);
+  vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extensionsNum, extensions.data());
+
+  VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+  timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+  for(const auto& ext : extensions)
+  {
+    if(std::strcmp(ext.extensionName, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) == 0)
+    {
+      VkPhysicalDeviceFeatures2 features2 = {};
+      features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+      features2.pNext = &timelineFeatures;
+      vkGetPhysicalDeviceFeatures2(m_physicalDevice, &features2);
+      break;
+    }
+  }
+  m_timelineSupported = timelineFeatures.timelineSemaphore == VK_TRUE;
+  if(m_timelineSupported)
+    m_deviceExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+
   m_device = vk_utils::createLogicalDevice(m_physicalDevice, m_validationLayers, m_deviceExtensions,
                                            m_enabledDeviceFeatures, m_queueFamilyIDXs,
-                                           VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT);
+                                           VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT,
+                                           m_timelineSupported ? &timelineFeatures : nullptr);
 
   vkGetDeviceQueue(m_device, m_queueFamilyIDXs.compute, 0, &m_computeQueue);
   vkGetDeviceQueue(m_device, m_queueFamilyIDXs.transfer, 0, &m_transferQueue);
 }
 
 
-void SimpleCompute::SetupSimplePipeline()
+void SimpleCompute::SetStreamingMode(uint64_t a_totalLength, uint32_t a_tileLength)
 {
-  std::vector<std::pair<VkDescriptorType, uint32_t> > dtypes = {
-      {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,             3}
-  };
+  m_streamLength = a_totalLength;
+  m_tileLength   = a_tileLength;
+}
 
-  // Создание и аллокация буферов
-  m_A = vk_utils::createBuffer(m_device, sizeof(float) * m_length, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
-                                                                       VK_BUFFER_USAGE_TRANSFER_DST_BIT);
-  m_B = vk_utils::createBuffer(m_device, sizeof(float) * m_length, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
-                                                                       VK_BUFFER_USAGE_TRANSFER_DST_BIT);
-  m_sum = vk_utils::createBuffer(m_device, sizeof(float) * m_length, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
-                                                                       VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
-  vk_utils::allocateAndBindWithPadding(m_device, m_physicalDevice, {m_A, m_B, m_sum}, 0);
+void SimpleCompute::SetupStreamingResources()
+{
+  VkPhysicalDeviceProperties props = {};
+  vkGetPhysicalDeviceProperties(m_physicalDevice, &props);
 
-  m_pBindings = std::make_shared<vk_utils::DescriptorMaker>(m_device, dtypes, 1);
+  // one dispatch per tile, so a tile is limited both by buffer range and by workgroup count
+  const uint64_t maxTile = std::min<uint64_t>(props.limits.maxStorageBufferRange / sizeof(float),
+                                              uint64_t(props.limits.maxComputeWorkGroupCount[0]) * WORKGROUP_SIZE);
+  if(m_tileLength == 0)
+    m_tileLength = 4 * 1024 * 1024;
+  m_tileLength = uint32_t(std::min<uint64_t>({m_tileLength, maxTile, std::max<uint64_t>(m_streamLength, 1)}));
 
-  // Создание descriptor set для передачи буферов в шейдер
-  m_pBindings->BindBegin(VK_SHADER_STAGE_COMPUTE_BIT);
-  m_pBindings->BindBuffer(0, m_A);
-  m_pBindings->BindBuffer(1, m_B);
-  m_pBindings->BindBuffer(2, m_sum);
-  m_pBindings->BindEnd(&m_sumDS, &m_sumDSLayout);
+  const VkDeviceSize tileBytes = VkDeviceSize(m_tileLength) * sizeof(float);
 
-  // Заполнение буферов
-  std::vector<float> values(m_length);
-  for (uint32_t i = 0; i < values.size(); ++i) {
-    values[i] = (float)i;
-  }
-  m_pCopyHelper->UpdateBuffer(m_A, 0, values.data(), sizeof(float) * values.size());
-  for (uint32_t i = 0; i < values.size(); ++i) {
-    values[i] = (float)i * i;
+  std::vector<std::pair<VkDescriptorType, uint32_t> > dtypes = {
+      {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,             3 * STREAM_SLOTS}
+  };
+  m_pBindings = std::make_shared<vk_utils::DescriptorMaker>(m_device, dtypes, STREAM_SLOTS);
+
+  m_transferCmdPool = vk_utils::createCommandPool(m_device, m_queueFamilyIDXs.transfer, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+
+  for(auto& slot : m_slots)
+  {
+    slot.A        = createSharedBuffer(m_device, tileBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, m_queueFamilyIDXs);
+    slot.B        = createSharedBuffer(m_device, tileBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, m_queueFamilyIDXs);
+    slot.sum      = vk_utils::createBuffer(m_device, tileBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    slot.upload   = vk_utils::createBuffer(m_device, 2 * tileBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    slot.readback = vk_utils::createBuffer(m_device, tileBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+    slot.allocs[0] = m_pAllocator->AllocateAndBind(slot.A,   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    slot.allocs[1] = m_pAllocator->AllocateAndBind(slot.B,   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    slot.allocs[2] = m_pAllocator->AllocateAndBind(slot.sum, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    slot.allocs[3] = m_pAllocator->AllocateAndBind(slot.upload,   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    slot.allocs[4] = m_pAllocator->AllocateAndBind(slot.readback, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    m_pBindings->BindBegin(VK_SHADER_STAGE_COMPUTE_BIT);
+    m_pBindings->BindBuffer(0, slot.A);
+    m_pBindings->BindBuffer(1, slot.B);
+    m_pBindings->BindBuffer(2, slot.sum);
+    m_pBindings->BindEnd(&slot.dSet, &m_sumDSLayout);
+
+    slot.uploadCmd  = vk_utils::createCommandBuffers(m_device, m_transferCmdPool, 1)[0];
+    slot.computeCmd = vk_utils::createCommandBuffers(m_device, m_commandPool, 1)[0];
+
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    VK_CHECK_RESULT(vkCreateSemaphore(m_device, &semaphoreInfo, nullptr, &slot.uploaded));
+
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VK_CHECK_RESULT(vkCreateFence(m_device, &fenceInfo, nullptr, &slot.done));
   }
-  m_pCopyHelper->UpdateBuffer(m_B, 0, values.data(), sizeof(float) * values.size());
 }
 
-void SimpleCompute::BuildCommandBufferSimple(VkCommandBuffer a_cmdBuff, VkPipeline)
+void SimpleCompute::BuildStreamingCommandBuffers(StreamSlot &a_slot)
 {
-  vkResetCommandBuffer(a_cmdBuff, 0);
+  const VkDeviceSize bytes = VkDeviceSize(a_slot.count) * sizeof(float);
 
   VkCommandBufferBeginInfo beginInfo = {};
   beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  // transfer queue: staging -> device local tiles
+  vkResetCommandBuffer(a_slot.uploadCmd, 0);
+  VK_CHECK_RESULT(vkBeginCommandBuffer(a_slot.uploadCmd, &beginInfo));
+  VkBufferCopy copyA = {0, 0, bytes};
+  VkBufferCopy copyB = {VkDeviceSize(m_tileLength) * sizeof(float), 0, bytes};
+  vkCmdCopyBuffer(a_slot.uploadCmd, a_slot.upload, a_slot.A, 1, &copyA);
+  vkCmdCopyBuffer(a_slot.uploadCmd, a_slot.upload, a_slot.B, 1, &copyB);
+  VK_CHECK_RESULT(vkEndCommandBuffer(a_slot.uploadCmd));
+
+  // compute queue: dispatch over the tile and copy result to host visible memory,
+  // waits for the upload with a semaphore, so copies of the next tile overlap with this dispatch
+  vkResetCommandBuffer(a_slot.computeCmd, 0);
+  VK_CHECK_RESULT(vkBeginCommandBuffer(a_slot.computeCmd, &beginInfo));
+
+  vkCmdBindPipeline      (a_slot.computeCmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+  vkCmdBindDescriptorSets(a_slot.computeCmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_layout, 0, 1, &a_slot.dSet, 0, NULL);
+  vkCmdPushConstants(a_slot.computeCmd, m_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(a_slot.count), &a_slot.count);
+  vkCmdDispatch(a_slot.computeCmd, (a_slot.count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+  VkMemoryBarrier barrier = {};
+  barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  vkCmdPipelineBarrier(a_slot.computeCmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                       1, &barrier, 0, nullptr, 0, nullptr);
+
+  VkBufferCopy copySum = {0, 0, bytes};
+  vkCmdCopyBuffer(a_slot.computeCmd, a_slot.sum, a_slot.readback, 1, &copySum);
+
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  vkCmdPipelineBarrier(a_slot.computeCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                       1, &barrier, 0, nullptr, 0, nullptr);
+
+  VK_CHECK_RESULT(vkEndCommandBuffer(a_slot.computeCmd));
+}
 
-  // Заполняем буфер команд
-  VK_CHECK_RESULT(vkBeginCommandBuffer(a_cmdBuff, &beginInfo));
+uint64_t SimpleCompute::SubmitTile(StreamSlot &a_slot, uint64_t a_firstElem)
+{
+  a_slot.firstElem = a_firstElem;
+  a_slot.count     = uint32_t(std::min<uint64_t>(m_tileLength, m_streamLength - a_firstElem));
+
+  // same values as in ExecuteJobs, generated here so that the whole array never exists anywhere
+  auto pA = (float*)a_slot.allocs[3].mapped;
+  auto pB = pA + m_tileLength;
+  for(uint32_t i = 0; i < a_slot.count; ++i)
+  {
+    pA[i] = (float)(a_firstElem + i);
+    pB[i] = pA[i] * pA[i];
+  }
 
-  vkCmdBindPipeline      (a_cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
-  vkCmdBindDescriptorSets(a_cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, m_layout, 0, 1, &m_sumDS, 0, NULL);
+  BuildStreamingCommandBuffers(a_slot);
+
+  VkSubmitInfo uploadSubmit = {};
+  uploadSubmit.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  uploadSubmit.commandBufferCount   = 1;
+  uploadSubmit.pCommandBuffers      = &a_slot.uploadCmd;
+  uploadSubmit.signalSemaphoreCount = 1;
+  uploadSubmit.pSignalSemaphores    = &a_slot.uploaded;
+  VK_CHECK_RESULT(vkQueueSubmit(m_transferQueue, 1, &uploadSubmit, VK_NULL_HANDLE));
+
+  VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  VkSubmitInfo computeSubmit = {};
+  computeSubmit.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  computeSubmit.waitSemaphoreCount = 1;
+  computeSubmit.pWaitSemaphores    = &a_slot.uploaded;
+  computeSubmit.pWaitDstStageMask  = &waitStage;
+  computeSubmit.commandBufferCount = 1;
+  computeSubmit.pCommandBuffers    = &a_slot.computeCmd;
+  VK_CHECK_RESULT(vkQueueSubmit(m_computeQueue, 1, &computeSubmit, a_slot.done));
+
+  a_slot.inFlight = true;
+  return a_slot.count;
+}
 
-  vkCmdPushConstants(a_cmdBuff, m_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(m_length), &m_length);
+uint64_t SimpleCompute::RetireTile(StreamSlot &a_slot)
+{
+  if(!a_slot.inFlight)
+    return 0;
 
-  vkCmdDispatch(a_cmdBuff, 1, 1, 1);
+  VK_CHECK_RESULT(vkWaitForFences(m_device, 1, &a_slot.done, VK_TRUE, UINT64_MAX));
+  VK_CHECK_RESULT(vkResetFences(m_device, 1, &a_slot.done));
+  a_slot.inFlight = false;
 
-  VK_CHECK_RESULT(vkEndCommandBuffer(a_cmdBuff));
+  uint64_t errors = 0;
+  auto pSum = (const float*)a_slot.allocs[4].mapped;
+  for(uint32_t i = 0; i < a_slot.count; ++i)
+  {
+    const float a = (float)(a_slot.firstElem + i);
+    if(pSum[i] != a + a * a)
+      errors++;
+  }
+  return errors;
 }
 
+void SimpleCompute::ExecuteStreaming()
+{
+  SetupStreamingResources();
+  CreateComputePipeline();
 
-void SimpleCompute::CleanupPipeline()
+  const auto timeStart = std::chrono::high_resolution_clock::now();
+
+  // slot is refilled as soon as its previous tile is read back, the other slot is in flight meanwhile
+  uint64_t errors    = 0;
+  uint64_t nextElem  = 0;
+  uint32_t tilesNum  = 0;
+  while(nextElem < m_streamLength)
+  {
+    auto& slot = m_slots[tilesNum % STREAM_SLOTS];
+    errors   += RetireTile(slot);
+    nextElem += SubmitTile(slot, nextElem);
+    tilesNum++;
+  }
+  for(auto& slot : m_slots)
+    errors += RetireTile(slot);
+
+  const auto timeEnd = std::chrono::high_resolution_clock::now();
+  const double seconds = std::chrono::duration<double>(timeEnd - timeStart).count();
+
+  // A and B go to the device, sum comes back
+  const double bytesMoved = double(m_streamLength) * sizeof(float) * 3.0;
+  std::cout << "streamed " << m_streamLength << " elements in " << tilesNum << " tiles of " << m_tileLength
+            << " elements: " << seconds * 1000.0 << " ms, " << bytesMoved / seconds / 1e9 << " GB/s, "
+            << errors << " errors" << std::endl;
+}
+
+void SimpleCompute::CleanupStreamingResources()
 {
-  if (m_cmdBufferCompute)
+  if(m_transferCmdPool == VK_NULL_HANDLE)
+    return;
+
+  vkDeviceWaitIdle(m_device);
+
+  for(auto& slot : m_slots)
   {
-    vkFreeCommandBuffers(m_device, m_commandPool, 1, &m_cmdBufferCompute);
+    for(auto buf : {slot.A, slot.B, slot.sum, slot.upload, slot.readback})
+      vkDestroyBuffer(m_device, buf, nullptr);
+    for(auto& alloc : slot.allocs)
+      m_pAllocator->Free(alloc);
+
+    vkFreeCommandBuffers(m_device, m_commandPool, 1, &slot.computeCmd);
+    vkDestroySemaphore(m_device, slot.uploaded, nullptr);
+    vkDestroyFence(m_device, slot.done, nullptr);
+    slot = StreamSlot();
   }
 
-  vkDestroyBuffer(m_device, m_A, nullptr);
-  vkDestroyBuffer(m_device, m_B, nullptr);
-  vkDestroyBuffer(m_device, m_sum, nullptr);
+  vkDestroyCommandPool(m_device, m_transferCmdPool, nullptr);
+  m_transferCmdPool = VK_NULL_HANDLE;
+}
 
+void SimpleCompute::CleanupPipeline()
+{
   vkDestroyPipelineLayout(m_device, m_layout, nullptr);
   vkDestroyPipeline(m_device, m_pipeline, nullptr);
 }
@@ -146,8 +349,12 @@ void SimpleCompute::CleanupPipeline()
 
 void SimpleCompute::Cleanup()
 {
+  m_pJob = nullptr;
+  CleanupStreamingResources();
   CleanupPipeline();
 
+  m_pAllocator = nullptr;
+
   if (m_commandPool != VK_NULL_HANDLE)
   {
     vkDestroyCommandPool(m_device, m_commandPool, nullptr);
@@ -202,30 +409,91 @@ void SimpleCompute::CreateComputePipeline()
 
 void SimpleCompute::Execute()
 {
-  SetupSimplePipeline();
-  CreateComputePipeline();
+  if(m_primitivesLength > 0)
+  {
+    ExecutePrimitivesBenchmark();
+    return;
+  }
 
-  BuildCommandBufferSimple(m_cmdBufferCompute, nullptr);
+  VkPhysicalDeviceProperties props = {};
+  vkGetPhysicalDeviceProperties(m_physicalDevice, &props);
+  const uint64_t maxGroups = props.limits.maxComputeWorkGroupCount[0];
+  if(m_streamLength == 0 && (uint64_t(m_length) * sizeof(float) > props.limits.maxStorageBufferRange ||
+                             (uint64_t(m_length) + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE > maxGroups))
+  {
+    std::cout << "array of " << m_length << " elements doesn't fit in one dispatch, using streaming mode" << std::endl;
+    m_streamLength = m_length;
+  }
 
-  VkSubmitInfo submitInfo = {};
-  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &m_cmdBufferCompute;
+  if(m_streamLength > 0)
+  {
+    ExecuteStreaming();
+    return;
+  }
+
+  ExecuteJobs();
+}
+
+void SimpleCompute::ExecuteJobs()
+{
+  // the job and its inputs are created on the first call only, later calls just submit
+  if(m_pJob == nullptr)
+  {
+    m_pJob = std::make_unique<SimpleComputeJob>(m_device, m_physicalDevice, m_computeQueue, m_queueFamilyIDXs.compute,
+                                                m_pAllocator, m_length, m_timelineSupported, WORKGROUP_SIZE);
+
+    std::vector<float> A(m_length), B(m_length);
+    for (uint32_t i = 0; i < m_length; ++i) {
+      A[i] = (float)i;
+      B[i] = (float)i * i;
+    }
+    m_pJob->SetInputs(m_pCopyHelper, A.data(), B.data());
+  }
 
-  VkFenceCreateInfo fenceCreateInfo = {};
-  fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-  fenceCreateInfo.flags = 0;
-  VK_CHECK_RESULT(vkCreateFence(m_device, &fenceCreateInfo, NULL, &m_fence));
+  auto checkResults = [this](const float* a_values) {
+    uint32_t errors = 0;
+    for (uint32_t i = 0; i < m_length; ++i) {
+      if (a_values[i] != (float)i + (float)i * i)
+        errors++;
+    }
+    return errors;
+  };
+
+  const auto timeStart = std::chrono::high_resolution_clock::now();
 
-  // Отправляем буфер команд на выполнение
-  VK_CHECK_RESULT(vkQueueSubmit(m_computeQueue, 1, &submitInfo, m_fence));
+  // submits go back to back, results are checked once SLOTS jobs are in flight
+  std::deque<uint64_t> inFlight;
+  uint64_t errors     = 0;
+  uint64_t lastTicket = 0;
+  for (uint32_t i = 0; i < m_repeats; ++i)
+  {
+    if (inFlight.size() == SimpleComputeJob::SLOTS)
+    {
+      errors += checkResults(m_pJob->Wait(inFlight.front()));
+      inFlight.pop_front();
+    }
+    lastTicket = m_pJob->Submit();
+    inFlight.push_back(lastTicket);
+  }
+  while (!inFlight.empty())
+  {
+    errors += checkResults(m_pJob->Wait(inFlight.front()));
+    inFlight.pop_front();
+  }
 
-  //Ждём конца выполнения команд
-  VK_CHECK_RESULT(vkWaitForFences(m_device, 1, &m_fence, VK_TRUE, 100000000000));
+  const auto timeEnd = std::chrono::high_resolution_clock::now();
+  const double ms = std::chrono::duration<double, std::milli>(timeEnd - timeStart).count();
 
-  std::vector<float> values(m_length);
-  m_pCopyHelper->ReadBuffer(m_sum, 0, values.data(), sizeof(float) * values.size());
-  for (auto v: values) {
-    std::cout << v << ' ';
+  const float* values = m_pJob->Wait(lastTicket);
+  if (m_length <= 64)
+  {
+    for (uint32_t i = 0; i < m_length; ++i) {
+      std::cout << values[i] << ' ';
+    }
+    std::cout << std::endl;
   }
+
+  std::cout << m_length << " elements, " << m_repeats << " jobs, " << errors << " errors, "
+            << ms / std::max(m_repeats, 1u) << " ms per job ("
+            << (m_pJob->UsesTimeline() ? "timeline semaphore" : "fences") << ")" << std::endl;
 }
@@ -3,10 +3,13 @@
 
 #define VK_NO_PROTOTYPES
 #include "../../render/compute_common.h"
+#include "../../render/mem_allocator.h"
+#include "compute_job.h"
 #include "../resources/shaders/common.h"
 #include <vk_descriptor_sets.h>
 #include <vk_copy.h>
 
+#include <algorithm>
 #include <string>
 #include <iostream>
 #include <memory>
@@ -17,6 +20,24 @@ public:
   SimpleCompute(uint32_t a_length);
   ~SimpleCompute()  { Cleanup(); };
 
+  static constexpr uint32_t WORKGROUP_SIZE = 32; // local_size_x in simple.comp
+
+  /**
+  \brief process a_totalLength elements in tiles of a_tileLength elements instead of one dispatch over whole arrays,
+         input tiles are generated on the fly, so arrays may be larger than device (and host) memory
+  \param a_tileLength - 0 picks a default, it is also clamped to device limits
+  */
+  void SetStreamingMode(uint64_t a_totalLength, uint32_t a_tileLength = 0);
+
+  /**
+  \brief instead of the vector sum, run reduction, scan, compaction and radix sort from ComputePrimitives over
+         a_length random elements, check them against CPU references and print timings
+  */
+  void SetPrimitivesBenchmark(uint32_t a_length);
+
+  /// submit the vector sum a_repeats times per Execute, resources are created by the first Execute and reused
+  void SetRepeats(uint32_t a_repeats) { m_repeats = std::max(a_repeats, 1u); }
+
   inline VkInstance   GetVkInstance() const override { return m_instance; }
   void InitVulkan(const char** a_instanceExtensions, uint32_t a_instanceExtensionsCount, uint32_t a_deviceId) override;
 
@@ -58,9 +79,6 @@ private:
 
   vk_utils::QueueFID_T m_queueFamilyIDXs {UINT32_MAX, UINT32_MAX, UINT32_MAX};
 
-  VkCommandBuffer m_cmdBufferCompute;
-  VkFence m_fence;
-
   std::shared_ptr<vk_utils::DescriptorMaker> m_pBindings = nullptr;
 
   uint32_t m_length  = 16u;
@@ -73,20 +91,59 @@ private:
   std::vector<const char*> m_validationLayers;
   std::shared_ptr<vk_utils::ICopyEngine> m_pCopyHelper;
 
-  VkDescriptorSet       m_sumDS; 
   VkDescriptorSetLayout m_sumDSLayout = nullptr;
   
-  VkPipeline m_pipeline;
-  VkPipelineLayout m_layout;
+  VkPipeline m_pipeline = VK_NULL_HANDLE;
+  VkPipelineLayout m_layout = VK_NULL_HANDLE;
 
-  VkBuffer m_A, m_B, m_sum;
+  std::unique_ptr<SimpleComputeJob> m_pJob;
+  uint32_t m_repeats           = 1;
+  bool     m_timelineSupported = false;
+
+  // streaming mode: while one slot is computed on the compute queue, the other one is uploaded on the transfer queue
+  struct StreamSlot
+  {
+    VkBuffer A   = VK_NULL_HANDLE;
+    VkBuffer B   = VK_NULL_HANDLE;
+    VkBuffer sum = VK_NULL_HANDLE;
+    VkBuffer upload   = VK_NULL_HANDLE; // A tile followed by B tile
+    VkBuffer readback = VK_NULL_HANDLE;
+    MemAllocation allocs[5] {};
+
+    VkDescriptorSet dSet       = VK_NULL_HANDLE;
+    VkCommandBuffer uploadCmd  = VK_NULL_HANDLE;
+    VkCommandBuffer computeCmd = VK_NULL_HANDLE;
+    VkSemaphore     uploaded   = VK_NULL_HANDLE;
+    VkFence         done       = VK_NULL_HANDLE;
+
+    uint64_t firstElem = 0;
+    uint32_t count     = 0;
+    bool     inFlight  = false;
+  };
+  static constexpr uint32_t STREAM_SLOTS = 2;
+
+  StreamSlot m_slots[STREAM_SLOTS];
+  uint64_t   m_streamLength = 0;
+  uint32_t   m_tileLength   = 0;
+  VkCommandPool m_transferCmdPool = VK_NULL_HANDLE;
+  std::shared_ptr<DeviceMemoryAllocator> m_pAllocator;
+
+  uint32_t m_primitivesLength = 0;
  
   void CreateInstance();
   void CreateDevice(uint32_t a_deviceId);
 
-  void BuildCommandBufferSimple(VkCommandBuffer a_cmdBuff, VkPipeline a_pipeline);
+  void BuildStreamingCommandBuffers(StreamSlot &a_slot);
+
+  void SetupStreamingResources();
+  void CleanupStreamingResources();
+  void ExecuteStreaming();
+  uint64_t SubmitTile(StreamSlot &a_slot, uint64_t a_firstElem);
+  uint64_t RetireTile(StreamSlot &a_slot);
+
+  void ExecutePrimitivesBenchmark();
 
-  void SetupSimplePipeline();
+  void ExecuteJobs();
   void CreateComputePipeline();
   void CleanupPipeline();
 
@@ -2,6 +2,7 @@
 #include "create_render.h"
 #include "simple_render.h"
 #include "simple_render_tex.h"
+#include "simple_deferred.h"
 
 
 std::unique_ptr<IRender> CreateRender(uint32_t w, uint32_t h, RenderEngineType type)
@@ -14,6 +15,9 @@ std::unique_ptr<IRender> CreateRender(uint32_t w, uint32_t h, RenderEngineType t
   case RenderEngineType::SIMPLE_TEXTURE:
     return std::make_unique<SimpleRenderTexture>(w, h);
 
+  case RenderEngineType::DEFERRED:
+    return std::make_unique<SimpleDeferredRender>(w, h);
+
   default:
     return nullptr;
   }
@@ -4,7 +4,8 @@
 enum class RenderEngineType
 {
   SIMPLE_FORWARD,
-  SIMPLE_TEXTURE
+  SIMPLE_TEXTURE,
+  DEFERRED
 };
 
 std::unique_ptr<IRender> CreateRender(uint32_t w, uint32_t h, RenderEngineType type);
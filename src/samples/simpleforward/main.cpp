@@ -1,6 +1,7 @@
 #include "simple_render.h"
 #include "create_render.h"
 #include "utils/glfw_window.h"
+#include "utils/bench.h"
 
 void initVulkanGLFW(std::shared_ptr<IRender> &app, GLFWwindow* window, int deviceID, bool showGUI)
 {
@@ -27,16 +28,37 @@ void initVulkanGLFW(std::shared_ptr<IRender> &app, GLFWwindow* window, int devic
   }
 }
 
-int main()
+// usage: <renderer> [--renderer forward|texture|deferred] [--scene path.xml] [--no-gui]
+//        <renderer> [--renderer ...] --bench [--scene path.xml] [--camera-path file] [--frames N] [--warmup N] [--out bench.json] [--gui]
+int main(int argc, const char** argv)
 {
   constexpr int WIDTH = 1024;
   constexpr int HEIGHT = 1024;
   constexpr int VULKAN_DEVICE_ID = 0;
 
-  bool showGUI = true;
+  auto params = readCommandLineParams(argc, argv);
+  const bool benchMode = params.count("bench") > 0;
 
-  std::shared_ptr<IRender> app = CreateRender(WIDTH, HEIGHT, RenderEngineType::SIMPLE_FORWARD);
-//  std::shared_ptr<IRender> app = CreateRender(WIDTH, HEIGHT, RenderEngineType::SIMPLE_TEXTURE);
+  std::string scenePath = "../resources/scenes/043_cornell_normals/statex_00001.xml";
+  if(params.count("scene") > 0 && !params["scene"].empty())
+    scenePath = params["scene"];
+
+  BenchParams benchParams;
+  if(benchMode)
+    benchParams = readBenchParams(params, scenePath);
+
+  bool showGUI = benchMode ? benchParams.gui : params.count("no-gui") == 0;
+
+  const std::string renderName = params.count("renderer") > 0 ? params["renderer"] : "forward";
+  RenderEngineType renderType = RenderEngineType::SIMPLE_FORWARD;
+  if(renderName == "texture")
+    renderType = RenderEngineType::SIMPLE_TEXTURE;
+  else if(renderName == "deferred")
+    renderType = RenderEngineType::DEFERRED;
+  else if(renderName != "forward")
+    std::cout << "Unknown renderer " << renderName << ", using forward" << std::endl;
+
+  std::shared_ptr<IRender> app = CreateRender(WIDTH, HEIGHT, renderType);
 
   if(app == nullptr)
   {
@@ -48,7 +70,12 @@ int main()
 
   initVulkanGLFW(app, window, VULKAN_DEVICE_ID, showGUI);
 
-  app->LoadScene("../resources/scenes/043_cornell_normals/statex_00001.xml", false);
+  app->LoadScene(scenePath.c_str(), false);
+  if(params.count("change") > 0 && !params["change"].empty())
+    app->ApplySceneChange(params["change"].c_str(), false);
+
+  if(benchMode)
+    return benchLoop(app, window, benchParams) ? 0 : 1;
 
   mainLoop(app, window, showGUI);
 
@@ -0,0 +1,477 @@
+#include "simple_deferred.h"
+#include "../../utils/cpu_profiler.h"
+
+#include <vk_pipeline.h>
+#include <vk_buffers.h>
+
+#include <cstring>
+
+namespace
+{
+  VkImageMemoryBarrier imageBarrier(VkImage a_image, VkAccessFlags a_srcAccess, VkAccessFlags a_dstAccess,
+                                    VkImageLayout a_oldLayout, VkImageLayout a_newLayout)
+  {
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask       = a_srcAccess;
+    barrier.dstAccessMask       = a_dstAccess;
+    barrier.oldLayout           = a_oldLayout;
+    barrier.newLayout           = a_newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image               = a_image;
+    barrier.subresourceRange    = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    return barrier;
+  }
+}
+
+SimpleDeferredRender::SimpleDeferredRender(uint32_t a_width, uint32_t a_height) : SimpleRender(a_width, a_height)
+{
+}
+
+std::vector<std::string> SimpleDeferredRender::ProgramSources() const
+{
+  auto sources = SimpleRender::ProgramSources();
+  sources.push_back(GBUFFER_FRAGMENT_SHADER_PATH);
+  sources.push_back(LIGHTING_SHADER_PATH);
+  return sources;
+}
+
+void SimpleDeferredRender::InitPresentation(VkSurfaceKHR &a_surface, bool initGUI)
+{
+  SimpleRender::InitPresentation(a_surface, initGUI);
+
+  CreateGBuffer();
+
+  m_deferredUbo      = vk_utils::createBuffer(m_device, sizeof(DeferredParams), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+  m_deferredUboAlloc = m_pAllocator->AllocateAndBind(m_deferredUbo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  // the lit image is stretched over the whole swapchain image, which is not read, so nothing is loaded
+  m_pResolveQuad = std::make_shared<vk_utils::QuadRenderer>(0, 0, m_width, m_height);
+  m_pResolveQuad->Create(m_device, "../resources/shaders/quad3_vert.vert.spv", "../resources/shaders/quad.frag.spv",
+                         vk_utils::RenderTargetInfo2D{ VkExtent2D{ m_width, m_height }, m_swapchain.GetFormat(),
+                                                       VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR });
+}
+
+void SimpleDeferredRender::CreateImage(Image &a_img, VkFormat a_format, VkImageUsageFlags a_usage, VkImageAspectFlags a_aspect)
+{
+  VkImageCreateInfo imgCreateInfo = {};
+  imgCreateInfo.sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imgCreateInfo.imageType     = VK_IMAGE_TYPE_2D;
+  imgCreateInfo.format        = a_format;
+  imgCreateInfo.extent        = VkExtent3D{m_width, m_height, 1};
+  imgCreateInfo.mipLevels     = 1;
+  imgCreateInfo.arrayLayers   = 1;
+  imgCreateInfo.samples       = VK_SAMPLE_COUNT_1_BIT;
+  imgCreateInfo.tiling        = VK_IMAGE_TILING_OPTIMAL;
+  imgCreateInfo.usage         = a_usage;
+  imgCreateInfo.sharingMode   = VK_SHARING_MODE_EXCLUSIVE;
+  imgCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  VK_CHECK_RESULT(vkCreateImage(m_device, &imgCreateInfo, nullptr, &a_img.image));
+  a_img.alloc = m_pAllocator->AllocateAndBind(a_img.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  VkImageViewCreateInfo viewInfo = {};
+  viewInfo.sType            = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image            = a_img.image;
+  viewInfo.viewType         = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format           = a_format;
+  viewInfo.subresourceRange = {a_aspect, 0, 1, 0, 1};
+  VK_CHECK_RESULT(vkCreateImageView(m_device, &viewInfo, nullptr, &a_img.view));
+}
+
+void SimpleDeferredRender::DestroyImage(Image &a_img)
+{
+  if(a_img.view != VK_NULL_HANDLE)
+    vkDestroyImageView(m_device, a_img.view, nullptr);
+  if(a_img.image != VK_NULL_HANDLE)
+    vkDestroyImage(m_device, a_img.image, nullptr);
+  if(m_pAllocator != nullptr)
+    m_pAllocator->Free(a_img.alloc);
+  a_img = Image{};
+}
+
+void SimpleDeferredRender::CreateGBuffer()
+{
+  // depth is sampled by the lighting pass, D16 always supports it
+  VkFormatProperties props;
+  vkGetPhysicalDeviceFormatProperties(m_physicalDevice, VK_FORMAT_D32_SFLOAT, &props);
+  const VkFormatFeatureFlags depthFeatures = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+  m_gbufferDepthFormat = (props.optimalTilingFeatures & depthFeatures) == depthFeatures ? VK_FORMAT_D32_SFLOAT : VK_FORMAT_D16_UNORM;
+
+  CreateImage(m_gbufferColor, VK_FORMAT_R32G32_UINT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+              VK_IMAGE_ASPECT_COLOR_BIT);
+  CreateImage(m_gbufferDepth, m_gbufferDepthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+              VK_IMAGE_ASPECT_DEPTH_BIT);
+  CreateImage(m_litImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+              VK_IMAGE_ASPECT_COLOR_BIT);
+
+  VkAttachmentDescription attachments[2] = {};
+  attachments[0].format         = VK_FORMAT_R32G32_UINT;
+  attachments[0].samples        = VK_SAMPLE_COUNT_1_BIT;
+  attachments[0].loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  attachments[0].storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
+  attachments[0].stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  attachments[0].initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
+  attachments[0].finalLayout    = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  attachments[1]                = attachments[0];
+  attachments[1].format         = m_gbufferDepthFormat;
+
+  VkAttachmentReference colorRef = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+  VkAttachmentReference depthRef = {1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+  VkSubpassDescription subpass = {};
+  subpass.pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount    = 1;
+  subpass.pColorAttachments       = &colorRef;
+  subpass.pDepthStencilAttachment = &depthRef;
+
+  // previous frame read the G-buffer in the lighting pass, this frame reads it there again
+  VkSubpassDependency dependencies[2] = {};
+  dependencies[0].srcSubpass    = VK_SUBPASS_EXTERNAL;
+  dependencies[0].dstSubpass    = 0;
+  dependencies[0].srcStageMask  = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  dependencies[0].dstStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+  dependencies[0].srcAccessMask = 0;
+  dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+  dependencies[1].srcSubpass    = 0;
+  dependencies[1].dstSubpass    = VK_SUBPASS_EXTERNAL;
+  dependencies[1].srcStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  dependencies[1].dstStageMask  = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+  VkRenderPassCreateInfo renderPassInfo = {};
+  renderPassInfo.sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassInfo.attachmentCount = 2;
+  renderPassInfo.pAttachments    = attachments;
+  renderPassInfo.subpassCount    = 1;
+  renderPassInfo.pSubpasses      = &subpass;
+  renderPassInfo.dependencyCount = 2;
+  renderPassInfo.pDependencies   = dependencies;
+  VK_CHECK_RESULT(vkCreateRenderPass(m_device, &renderPassInfo, nullptr, &m_gbufferRenderPass));
+
+  VkImageView fbAttachments[2] = {m_gbufferColor.view, m_gbufferDepth.view};
+  VkFramebufferCreateInfo fbInfo = {};
+  fbInfo.sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+  fbInfo.renderPass      = m_gbufferRenderPass;
+  fbInfo.attachmentCount = 2;
+  fbInfo.pAttachments    = fbAttachments;
+  fbInfo.width           = m_width;
+  fbInfo.height          = m_height;
+  fbInfo.layers          = 1;
+  VK_CHECK_RESULT(vkCreateFramebuffer(m_device, &fbInfo, nullptr, &m_gbufferFramebuffer));
+
+  // G-buffer is read with texelFetch, the lit image is stretched 1:1 over the screen
+  VkSamplerCreateInfo samplerInfo = {};
+  samplerInfo.sType        = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter    = VK_FILTER_NEAREST;
+  samplerInfo.minFilter    = VK_FILTER_NEAREST;
+  samplerInfo.mipmapMode   = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.borderColor  = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
+  VK_CHECK_RESULT(vkCreateSampler(m_device, &samplerInfo, nullptr, &m_nearestSampler));
+}
+
+void SimpleDeferredRender::CreateLightingDescriptorSet()
+{
+  const VkDescriptorType types[5] = {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                     VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                     VK_DESCRIPTOR_TYPE_STORAGE_IMAGE};
+
+  VkDescriptorSetLayoutBinding bindings[5] = {};
+  for(uint32_t i = 0; i < 5; ++i)
+  {
+    bindings[i].binding         = i;
+    bindings[i].descriptorType  = types[i];
+    bindings[i].descriptorCount = 1;
+    bindings[i].stageFlags      = VK_SHADER_STAGE_COMPUTE_BIT;
+  }
+  VkDescriptorSetLayoutCreateInfo dsLayoutInfo = {};
+  dsLayoutInfo.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  dsLayoutInfo.bindingCount = 5;
+  dsLayoutInfo.pBindings    = bindings;
+  VK_CHECK_RESULT(vkCreateDescriptorSetLayout(m_device, &dsLayoutInfo, nullptr, &m_lightingDSLayout));
+
+  VkDescriptorPoolSize poolSizes[4] = {
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         1},
+    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         1},
+    {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2},
+    {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,          1}};
+  VkDescriptorPoolCreateInfo poolInfo = {};
+  poolInfo.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.maxSets       = 1;
+  poolInfo.poolSizeCount = 4;
+  poolInfo.pPoolSizes    = poolSizes;
+  VK_CHECK_RESULT(vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_lightingDSPool));
+
+  VkDescriptorSetAllocateInfo allocInfo = {};
+  allocInfo.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool     = m_lightingDSPool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts        = &m_lightingDSLayout;
+  VK_CHECK_RESULT(vkAllocateDescriptorSets(m_device, &allocInfo, &m_lightingDS));
+
+  VkDescriptorBufferInfo bufferInfos[2] = {};
+  bufferInfos[0] = {m_deferredUbo, 0, VK_WHOLE_SIZE};
+  bufferInfos[1] = {m_lightsBuf,   0, VK_WHOLE_SIZE};
+
+  VkDescriptorImageInfo imageInfos[3] = {};
+  imageInfos[0] = {m_nearestSampler, m_gbufferColor.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+  imageInfos[1] = {m_nearestSampler, m_gbufferDepth.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+  imageInfos[2] = {VK_NULL_HANDLE,   m_litImage.view,     VK_IMAGE_LAYOUT_GENERAL};
+
+  VkWriteDescriptorSet writes[5] = {};
+  for(uint32_t i = 0; i < 5; ++i)
+  {
+    writes[i].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[i].dstSet          = m_lightingDS;
+    writes[i].dstBinding      = i;
+    writes[i].descriptorCount = 1;
+    writes[i].descriptorType  = types[i];
+    if(i < 2)
+      writes[i].pBufferInfo = &bufferInfos[i];
+    else
+      writes[i].pImageInfo  = &imageInfos[i - 2];
+  }
+  vkUpdateDescriptorSets(m_device, 5, writes, 0, nullptr);
+}
+
+void SimpleDeferredRender::CreateLightingPipeline()
+{
+  if(m_lightingPipeline.pipeline != VK_NULL_HANDLE)
+  {
+    vkDestroyPipeline(m_device, m_lightingPipeline.pipeline, nullptr);
+    m_lightingPipeline.pipeline = VK_NULL_HANDLE;
+  }
+  if(m_lightingDS == VK_NULL_HANDLE)
+    CreateLightingDescriptorSet(); // the light buffer is created with the scene
+  if(m_lightingPipeline.layout == VK_NULL_HANDLE)
+  {
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType          = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts    = &m_lightingDSLayout;
+    VK_CHECK_RESULT(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_lightingPipeline.layout));
+  }
+
+  m_lightingPipeline.pipeline = CreateComputePipeline(LIGHTING_SHADER_PATH, m_lightingPipeline.layout);
+}
+
+void SimpleDeferredRender::SetupSimplePipeline()
+{
+  std::vector<std::pair<VkDescriptorType, uint32_t> > dtypes = {
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         1},
+    {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1}
+  };
+
+  // sets don't depend on shaders, so they are created once
+  if(m_pBindings == nullptr)
+  {
+    m_pBindings = std::make_shared<vk_utils::DescriptorMaker>(m_device, dtypes, 2);
+
+    m_pBindings->BindBegin(VK_SHADER_STAGE_FRAGMENT_BIT);
+    m_pBindings->BindBuffer(0, m_ubo, VK_NULL_HANDLE, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+    m_pBindings->BindEnd(&m_dSet, &m_dSetLayout);
+
+    m_pBindings->BindBegin(VK_SHADER_STAGE_FRAGMENT_BIT);
+    m_pBindings->BindImage(0, m_litImage.view, m_nearestSampler, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    m_pBindings->BindEnd(&m_resolveDS, &m_resolveDSLayout);
+  }
+
+  m_forwardVariants.Clear();
+  if(m_basicForwardPipeline.layout != VK_NULL_HANDLE)
+  {
+    vkDestroyPipelineLayout(m_device, m_basicForwardPipeline.layout, nullptr);
+    m_basicForwardPipeline.layout = VK_NULL_HANDLE;
+  }
+
+  auto pMaker = std::make_shared<vk_utils::GraphicsPipelineMaker>();
+
+  std::unordered_map<VkShaderStageFlagBits, std::string> shader_paths;
+  shader_paths[VK_SHADER_STAGE_FRAGMENT_BIT] = m_pShaderMgr->GetSPVPath(GBUFFER_FRAGMENT_SHADER_PATH);
+  shader_paths[VK_SHADER_STAGE_VERTEX_BIT]   = m_pShaderMgr->GetSPVPath(GBUFFER_VERTEX_SHADER_PATH);
+
+  m_basicForwardPipeline.layout = pMaker->MakeLayout(m_device, {m_dSetLayout}, sizeof(pushConst2M));
+  pMaker->SetDefaultState(m_width, m_height);
+
+  // gbuffer.frag has no specialization constants, all variants are the same pipeline
+  m_forwardVariants.Reset(m_device, [this, pMaker, shader_paths](const VkSpecializationInfo* a_pInfo) {
+    pMaker->LoadShaders(m_device, shader_paths);
+    SetSpecialization(*pMaker, VK_SHADER_STAGE_FRAGMENT_BIT, a_pInfo);
+    return pMaker->MakePipeline(m_device, m_pScnMgr->GetPipelineVertexInputStateCreateInfo(),
+                                m_gbufferRenderPass, {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR});
+  });
+
+  CreateLightingPipeline();
+}
+
+void SimpleDeferredRender::UpdateLights(float a_time)
+{
+  SimpleRender::UpdateLights(a_time);
+
+  m_deferredParams.invProj         = m_clusterParams.invProj;
+  m_deferredParams.view            = m_clusterParams.view;
+  m_deferredParams.screenSize      = uint2(m_width, m_height);
+  m_deferredParams.lightsNum       = m_lightsNum;
+  m_deferredParams.showTileHeatmap = m_showTileHeatmap ? 1u : 0u;
+  m_deferredParams.ambient         = LiteMath::float4(0.03f, 0.03f, 0.03f, m_exposure);
+  memcpy(m_deferredUboAlloc.mapped, &m_deferredParams, sizeof(m_deferredParams));
+}
+
+void SimpleDeferredRender::BuildFrameCommands(VkCommandBuffer a_cmdBuff, uint32_t a_imageIdx)
+{
+  CPU_PROFILE_SCOPE("record commands");
+  vkResetCommandBuffer(a_cmdBuff, 0);
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+
+  VK_CHECK_RESULT(vkBeginCommandBuffer(a_cmdBuff, &beginInfo));
+
+  vk_utils::setDefaultViewport(a_cmdBuff, static_cast<float>(m_width), static_cast<float>(m_height));
+  vk_utils::setDefaultScissor(a_cmdBuff, m_width, m_height);
+
+  ///// G-buffer, zero albedo and depth 1 mark pixels without geometry
+  {
+    VkClearValue clearValues[2] = {};
+    clearValues[0].color        = {{0.0f, 0.0f, 0.0f, 0.0f}};
+    clearValues[1].depthStencil = {1.0f, 0};
+
+    VkRenderPassBeginInfo renderPassInfo = {};
+    renderPassInfo.sType             = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass        = m_gbufferRenderPass;
+    renderPassInfo.framebuffer       = m_gbufferFramebuffer;
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = {m_width, m_height};
+    renderPassInfo.clearValueCount   = 2;
+    renderPassInfo.pClearValues      = clearValues;
+
+    vkCmdBeginRenderPass(a_cmdBuff, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    DrawSceneCmd(a_cmdBuff, ForwardPipeline());
+    vkCmdEndRenderPass(a_cmdBuff);
+  }
+
+  ///// tiled light culling and shading, the previous frame might still sample the lit image in the resolve pass
+  {
+    VkImageMemoryBarrier toStorage = imageBarrier(m_litImage.image, 0, VK_ACCESS_SHADER_WRITE_BIT,
+                                                  VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    vkCmdPipelineBarrier(a_cmdBuff, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &toStorage);
+
+    vkCmdBindPipeline(a_cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, m_lightingPipeline.pipeline);
+    vkCmdBindDescriptorSets(a_cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, m_lightingPipeline.layout, 0, 1, &m_lightingDS, 0, nullptr);
+    vkCmdDispatch(a_cmdBuff, (m_width + DEFERRED_TILE_SIZE - 1) / DEFERRED_TILE_SIZE,
+                  (m_height + DEFERRED_TILE_SIZE - 1) / DEFERRED_TILE_SIZE, 1);
+
+    VkImageMemoryBarrier toSample = imageBarrier(m_litImage.image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                                                 VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    vkCmdPipelineBarrier(a_cmdBuff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &toSample);
+  }
+
+  ///// lit image to the swapchain image
+  {
+    float scaleAndOffset[4] = {1.0f, 1.0f, 0.0f, 0.0f};
+    m_pResolveQuad->SetRenderTarget(m_swapchain.GetAttachment(a_imageIdx).view);
+    m_pResolveQuad->DrawCmd(a_cmdBuff, m_resolveDS, scaleAndOffset);
+  }
+
+  VK_CHECK_RESULT(vkEndCommandBuffer(a_cmdBuff));
+}
+
+void SimpleDeferredRender::Cleanup()
+{
+  m_pResolveQuad = nullptr;
+
+  if(m_lightingPipeline.pipeline != VK_NULL_HANDLE)
+  {
+    vkDestroyPipeline(m_device, m_lightingPipeline.pipeline, nullptr);
+    m_lightingPipeline.pipeline = VK_NULL_HANDLE;
+  }
+  if(m_lightingPipeline.layout != VK_NULL_HANDLE)
+  {
+    vkDestroyPipelineLayout(m_device, m_lightingPipeline.layout, nullptr);
+    m_lightingPipeline.layout = VK_NULL_HANDLE;
+  }
+  if(m_lightingDSPool != VK_NULL_HANDLE)
+  {
+    vkDestroyDescriptorPool(m_device, m_lightingDSPool, nullptr);
+    m_lightingDSPool = VK_NULL_HANDLE;
+    m_lightingDS     = VK_NULL_HANDLE;
+  }
+  if(m_lightingDSLayout != VK_NULL_HANDLE)
+  {
+    vkDestroyDescriptorSetLayout(m_device, m_lightingDSLayout, nullptr);
+    m_lightingDSLayout = VK_NULL_HANDLE;
+  }
+
+  if(m_gbufferFramebuffer != VK_NULL_HANDLE)
+  {
+    vkDestroyFramebuffer(m_device, m_gbufferFramebuffer, nullptr);
+    m_gbufferFramebuffer = VK_NULL_HANDLE;
+  }
+  if(m_gbufferRenderPass != VK_NULL_HANDLE)
+  {
+    vkDestroyRenderPass(m_device, m_gbufferRenderPass, nullptr);
+    m_gbufferRenderPass = VK_NULL_HANDLE;
+  }
+  if(m_nearestSampler != VK_NULL_HANDLE)
+  {
+    vkDestroySampler(m_device, m_nearestSampler, nullptr);
+    m_nearestSampler = VK_NULL_HANDLE;
+  }
+  DestroyImage(m_gbufferColor);
+  DestroyImage(m_gbufferDepth);
+  DestroyImage(m_litImage);
+
+  if(m_deferredUbo != VK_NULL_HANDLE)
+  {
+    vkDestroyBuffer(m_device, m_deferredUbo, nullptr);
+    m_deferredUbo = VK_NULL_HANDLE;
+  }
+  if(m_pAllocator != nullptr)
+    m_pAllocator->Free(m_deferredUboAlloc);
+}
+
+/////////////////////////////////
+
+void SimpleDeferredRender::SetupGUIElements()
+{
+  CPU_PROFILE_SCOPE("SetupGUIElements");
+  ImGui_ImplVulkan_NewFrame();
+  ImGui_ImplGlfw_NewFrame();
+  ImGui::NewFrame();
+  {
+    ImGui::Begin("Deferred render settings");
+
+    ImGui::ColorEdit3("Meshes base color", m_uniforms.baseColor.M, ImGuiColorEditFlags_PickerHueWheel | ImGuiColorEditFlags_NoInputs);
+    ImGui::Text("Scene lights: %u", m_pScnMgr->LightsNum());
+    ImGui::SliderInt("Extra point lights", &m_extraLights, 0, MAX_POINT_LIGHTS);
+    ImGui::SliderFloat("Extra light radius", &m_extraLightRadius, 0.05f, 20.0f);
+    ImGui::SliderFloat("Extra light intensity", &m_extraLightIntensity, 0.0f, 20.0f);
+    ImGui::Checkbox("Animate lights", &m_animateLights);
+    ImGui::SliderFloat("Exposure", &m_exposure, 0.1f, 8.0f);
+    ImGui::Checkbox("Show lights per tile", &m_showTileHeatmap);
+    ImGui::Text("Lights: %u, culled in %ux%u tiles, at most %u per tile", m_lightsNum, DEFERRED_TILE_SIZE, DEFERRED_TILE_SIZE,
+                MAX_LIGHTS_PER_TILE);
+
+    ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+
+    ImGui::NewLine();
+
+    ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f),"Press 'B' to recompile and reload shaders");
+    ImGui::Text("Changing bindings is not supported.");
+    ImGui::Text("G-buffer fragment shader path: %s", GBUFFER_FRAGMENT_SHADER_PATH.c_str());
+    ImGui::Text("Lighting shader path: %s", LIGHTING_SHADER_PATH.c_str());
+    ImGui::End();
+  }
+
+  // Rendering
+  ImGui::Render();
+}
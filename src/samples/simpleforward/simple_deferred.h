@@ -0,0 +1,84 @@
+#ifndef SIMPLE_DEFERRED_H
+#define SIMPLE_DEFERRED_H
+
+#define VK_NO_PROTOTYPES
+
+#include "simple_render.h"
+#include <vk_quad.h>
+
+/**
+\brief deferred renderer with tiled light culling
+
+The scene is drawn once into a thin G-buffer (albedo and octahedral normal packed into one RG32_UINT target, plus depth)
+using the same SceneManager buffers and simple.vert as SimpleRender. Then deferred_tiled.comp runs one workgroup per
+DEFERRED_TILE_SIZE^2 pixels: it finds the depth range of the tile, culls all lights against the tile's view space box
+and shades every pixel with the tile's list only. The lighting cost is pixels x lights per tile and doesn't depend
+on the number of instances. The result is copied to the swapchain image with a full screen triangle.
+
+Lights are the point, area and spot lights of the scene (approximated by points, see SceneManager::LoadLightsHydra)
+and optional synthetic lights scattered over the scene bounding box to stress the culling.
+*/
+class SimpleDeferredRender : public SimpleRender
+{
+public:
+  const std::string GBUFFER_VERTEX_SHADER_PATH   = "../resources/shaders/simple.vert";
+  const std::string GBUFFER_FRAGMENT_SHADER_PATH = "../resources/shaders/gbuffer.frag";
+  const std::string LIGHTING_SHADER_PATH         = "../resources/shaders/deferred_tiled.comp";
+
+  SimpleDeferredRender(uint32_t a_width, uint32_t a_height);
+  ~SimpleDeferredRender() override { Cleanup(); };
+
+  void InitPresentation(VkSurfaceKHR& a_surface, bool initGUI) override;
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+protected:
+
+  struct Image
+  {
+    VkImage       image = VK_NULL_HANDLE;
+    VkImageView   view  = VK_NULL_HANDLE;
+    MemAllocation alloc {};
+  };
+
+  Image    m_gbufferColor;   ///!< RG32_UINT, x - albedo RGBA8, y - normal in 2 x snorm16
+  Image    m_gbufferDepth;
+  Image    m_litImage;       ///!< RGBA8 storage image written by the lighting pass
+  VkFormat m_gbufferDepthFormat = VK_FORMAT_UNDEFINED;
+
+  VkRenderPass  m_gbufferRenderPass  = VK_NULL_HANDLE;
+  VkFramebuffer m_gbufferFramebuffer = VK_NULL_HANDLE;
+  VkSampler     m_nearestSampler     = VK_NULL_HANDLE;
+
+  // G-buffer pass is the "forward" pipeline of the base class, so DrawSceneCmd and m_forwardVariants are reused
+
+  VkDescriptorSetLayout m_lightingDSLayout = VK_NULL_HANDLE;
+  VkDescriptorPool      m_lightingDSPool   = VK_NULL_HANDLE;
+  VkDescriptorSet       m_lightingDS       = VK_NULL_HANDLE;
+  pipeline_data_t       m_lightingPipeline {};
+
+  std::shared_ptr<vk_utils::IQuad> m_pResolveQuad;
+  VkDescriptorSet       m_resolveDS       = VK_NULL_HANDLE;
+  VkDescriptorSetLayout m_resolveDSLayout = VK_NULL_HANDLE;
+
+  // lights are in m_lightsBuf of the base class
+  VkBuffer       m_deferredUbo       = VK_NULL_HANDLE;
+  MemAllocation  m_deferredUboAlloc {};
+  DeferredParams m_deferredParams {};
+  bool           m_showTileHeatmap   = false;
+
+  void CreateImage(Image &a_img, VkFormat a_format, VkImageUsageFlags a_usage, VkImageAspectFlags a_aspect);
+  void DestroyImage(Image &a_img);
+  void CreateGBuffer();
+  void CreateLightingDescriptorSet();
+  void CreateLightingPipeline();
+  void UpdateLights(float a_time) override;
+
+  void SetupSimplePipeline() override;
+  std::vector<std::string> ProgramSources() const override;
+  void BuildFrameCommands(VkCommandBuffer a_cmdBuff, uint32_t a_imageIdx) override;
+  void SetupGUIElements() override;
+  void Cleanup();
+};
+
+
+#endif //SIMPLE_DEFERRED_H
@@ -1,10 +1,39 @@
 #include "simple_render.h"
+#include "../../utils/cpu_profiler.h"
 #include "../../utils/input_definitions.h"
 
 #include <geom/vk_mesh.h>
 #include <vk_pipeline.h>
 #include <vk_buffers.h>
 
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+  // deterministic [0, 1) values per light, so synthetic lights keep their places when their count changes
+  float hashToUnit(uint32_t a_index, uint32_t a_channel)
+  {
+    uint32_t h = a_index * 0x9E3779B1u ^ (a_channel + 1u) * 0x85EBCA77u;
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    h *= 0x846CA68Bu;
+    h ^= h >> 16;
+    return float(h >> 8) * (1.0f / 16777216.0f);
+  }
+
+  float3 hueToRGB(float a_hue)
+  {
+    const float r = std::abs(a_hue * 6.0f - 3.0f) - 1.0f;
+    const float g = 2.0f - std::abs(a_hue * 6.0f - 2.0f);
+    const float b = 2.0f - std::abs(a_hue * 6.0f - 4.0f);
+    return float3(LiteMath::clamp(r, 0.0f, 1.0f), LiteMath::clamp(g, 0.0f, 1.0f), LiteMath::clamp(b, 0.0f, 1.0f));
+  }
+
+  constexpr uint32_t CLUSTERS_NUM = CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+}
+
 SimpleRender::SimpleRender(uint32_t a_width, uint32_t a_height) : m_width(a_width), m_height(a_height)
 {
 #ifdef NDEBUG
@@ -12,11 +41,36 @@ SimpleRender::SimpleRender(uint32_t a_width, uint32_t a_height) : m_width(a_widt
 #else
   m_enableValidation = true;
 #endif
+
+  m_pShaderMgr = std::make_unique<ShaderManager>();
+}
+
+std::vector<std::string> SimpleRender::ProgramSources() const
+{
+  return {VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH, VPULL_VERTEX_SHADER_PATH, VPULL_FRAGMENT_SHADER_PATH,
+          CLUSTER_ASSIGN_SHADER_PATH, DEPTH_PREPASS_SHADER_PATH};
 }
 
 void SimpleRender::SetupDeviceFeatures()
 {
   // m_enabledDeviceFeatures.fillModeNonSolid = VK_TRUE;
+
+  // used by vertex pulling path, both are optional
+  VkPhysicalDeviceFeatures supportedFeatures = {};
+  vkGetPhysicalDeviceFeatures(m_physicalDevice, &supportedFeatures);
+  m_enabledDeviceFeatures.multiDrawIndirect         = supportedFeatures.multiDrawIndirect;
+  m_enabledDeviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+
+  // block compressed textures in SimpleRenderTexture
+  m_enabledDeviceFeatures.textureCompressionBC      = supportedFeatures.textureCompressionBC;
+
+  // scene texture table is indexed by material id, it is uniform within a draw, but not a constant expression
+  m_enabledDeviceFeatures.shaderSampledImageArrayDynamicIndexing = supportedFeatures.shaderSampledImageArrayDynamicIndexing;
+  if(!supportedFeatures.shaderSampledImageArrayDynamicIndexing)
+    m_texturing = false;  // SceneManager doesn't load scene textures then
+
+  // work per pass, see PipelineStatistics
+  m_enabledDeviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
 }
 
 void SimpleRender::SetupDeviceExtensions()
@@ -50,6 +104,7 @@ void SimpleRender::InitVulkan(const char** a_instanceExtensions, uint32_t a_inst
 
   m_cmdBuffersDrawMain.reserve(m_framesInFlight);
   m_cmdBuffersDrawMain = vk_utils::createCommandBuffers(m_device, m_commandPool, m_framesInFlight);
+  m_cmdBuffersSceneUpdate = vk_utils::createCommandBuffers(m_device, m_commandPool, m_framesInFlight);
 
   m_frameFences.resize(m_framesInFlight);
   VkFenceCreateInfo fenceInfo = {};
@@ -60,8 +115,16 @@ void SimpleRender::InitVulkan(const char** a_instanceExtensions, uint32_t a_inst
     VK_CHECK_RESULT(vkCreateFence(m_device, &fenceInfo, nullptr, &m_frameFences[i]));
   }
 
-  m_pScnMgr = std::make_shared<SceneManager>(m_device, m_physicalDevice, m_queueFamilyIDXs.transfer,
-                                             m_queueFamilyIDXs.graphics, false);
+  m_pAllocator = std::make_shared<DeviceMemoryAllocator>(m_device, m_physicalDevice);
+  m_pScnMgr    = std::make_shared<SceneManager>(m_device, m_physicalDevice, m_queueFamilyIDXs.transfer,
+                                                m_queueFamilyIDXs.graphics, false, m_pAllocator);
+  m_pScnMgr->EnableAsyncUploads(m_timelineSupported);
+
+  m_pPipelineStats = std::make_unique<PipelineStatistics>(m_device, m_enabledDeviceFeatures.pipelineStatisticsQuery == VK_TRUE,
+                                                          m_framesInFlight);
+
+  // registered here and not in the constructor so that ProgramSources() of the derived render is called
+  m_pShaderMgr->RegisterProgram(ProgramSources(), [this]() { SetupSimplePipeline(); });
 }
 
 void SimpleRender::InitPresentation(VkSurfaceKHR &a_surface, bool initGUI)
@@ -116,9 +179,34 @@ void SimpleRender::CreateDevice(uint32_t a_deviceId)
   m_physicalDevice = vk_utils::findPhysicalDevice(m_instance, true, a_deviceId, m_deviceExtensions);
 
   SetupDeviceFeatures();
+
+  // scene uploads signal a timeline semaphore the frame waits on, with Vulkan 1.1 it comes from the extension
+  uint32_t extensionsNum = 0;
+  vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extensionsNum, nullptr);
+  std::vector<VkExtensionProperties> extensions(extensionsNum);
+  vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extensionsNum, extensions.data());
+
+  VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+  timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+  for(const auto& ext : extensions)
+  {
+    if(std::strcmp(ext.extensionName, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) == 0)
+    {
+      VkPhysicalDeviceFeatures2 features2 = {};
+      features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+      features2.pNext = &timelineFeatures;
+      vkGetPhysicalDeviceFeatures2(m_physicalDevice, &features2);
+      break;
+    }
+  }
+  m_timelineSupported = timelineFeatures.timelineSemaphore == VK_TRUE;
+  if(m_timelineSupported)
+    m_deviceExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+
   m_device = vk_utils::createLogicalDevice(m_physicalDevice, m_validationLayers, m_deviceExtensions,
                                            m_enabledDeviceFeatures, m_queueFamilyIDXs,
-                                           VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_TRANSFER_BIT);
+                                           VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_TRANSFER_BIT,
+                                           m_timelineSupported ? &timelineFeatures : nullptr);
 
   vkGetDeviceQueue(m_device, m_queueFamilyIDXs.graphics, 0, &m_graphicsQueue);
   vkGetDeviceQueue(m_device, m_queueFamilyIDXs.transfer, 0, &m_transferQueue);
@@ -128,80 +216,345 @@ void SimpleRender::CreateDevice(uint32_t a_deviceId)
 void SimpleRender::SetupSimplePipeline()
 {
   std::vector<std::pair<VkDescriptorType, uint32_t> > dtypes = {
-      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,             1}
+      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,             4},
+      {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,             9}
   };
 
-  if(m_pBindings == nullptr)
-    m_pBindings = std::make_shared<vk_utils::DescriptorMaker>(m_device, dtypes, 1);
+  if(m_clusterUbo == VK_NULL_HANDLE)
+    CreateClusterBuffers();
 
-  m_pBindings->BindBegin(VK_SHADER_STAGE_FRAGMENT_BIT);
-  m_pBindings->BindBuffer(0, m_ubo, VK_NULL_HANDLE, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-  m_pBindings->BindEnd(&m_dSet, &m_dSetLayout);
+  // the pool holds exactly these three sets, so they are created once and shader reloads only rebuild pipelines;
+  // scene buffers of the vertex pulling set are rewritten in place (see UpdateVertexPullingDescriptors)
+  if(m_pBindings == nullptr)
+  {
+    m_pBindings = std::make_shared<vk_utils::DescriptorMaker>(m_device, dtypes, 3);
+
+    m_pBindings->BindBegin(VK_SHADER_STAGE_FRAGMENT_BIT);
+    m_pBindings->BindBuffer(0, m_ubo, VK_NULL_HANDLE, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+    m_pBindings->BindBuffer(1, m_clusterUbo, VK_NULL_HANDLE, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+    m_pBindings->BindBuffer(2, m_lightsBuf);
+    m_pBindings->BindBuffer(3, m_clusterCountsBuf);
+    m_pBindings->BindBuffer(4, m_clusterLightIdsBuf);
+    m_pBindings->BindEnd(&m_dSet, &m_dSetLayout);
+
+    m_pBindings->BindBegin(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+    m_pBindings->BindBuffer(0, m_ubo, VK_NULL_HANDLE, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+    m_pBindings->BindBuffer(1, m_pScnMgr->GetVertexBuffer());
+    m_pBindings->BindBuffer(2, m_pScnMgr->GetInstanceMatricesBuffer());
+    m_pBindings->BindBuffer(3, m_pScnMgr->GetInstanceIdsBuffer());
+    m_pBindings->BindEnd(&m_vpullDSet, &m_vpullDSetLayout);
+
+    m_pBindings->BindBegin(VK_SHADER_STAGE_COMPUTE_BIT);
+    m_pBindings->BindBuffer(0, m_clusterUbo, VK_NULL_HANDLE, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+    m_pBindings->BindBuffer(1, m_lightsBuf);
+    m_pBindings->BindBuffer(2, m_clusterCountsBuf);
+    m_pBindings->BindBuffer(3, m_clusterLightIdsBuf);
+    m_pBindings->BindEnd(&m_clusterDSet, &m_clusterDSetLayout);
+  }
 
   // if we are recreating pipeline (for example, to reload shaders)
   // we need to cleanup old pipeline
+  m_forwardVariants.Clear();
+  m_forwardEqualVariants.Clear();
   if(m_basicForwardPipeline.layout != VK_NULL_HANDLE)
   {
     vkDestroyPipelineLayout(m_device, m_basicForwardPipeline.layout, nullptr);
     m_basicForwardPipeline.layout = VK_NULL_HANDLE;
   }
-  if(m_basicForwardPipeline.pipeline != VK_NULL_HANDLE)
+  if(m_depthPrepassPipeline.pipeline != VK_NULL_HANDLE)
   {
-    vkDestroyPipeline(m_device, m_basicForwardPipeline.pipeline, nullptr);
-    m_basicForwardPipeline.pipeline = VK_NULL_HANDLE;
+    vkDestroyPipeline(m_device, m_depthPrepassPipeline.pipeline, nullptr);
+    m_depthPrepassPipeline.pipeline = VK_NULL_HANDLE;
+  }
+  if(m_depthPrepassPipeline.layout != VK_NULL_HANDLE)
+  {
+    vkDestroyPipelineLayout(m_device, m_depthPrepassPipeline.layout, nullptr);
+    m_depthPrepassPipeline.layout = VK_NULL_HANDLE;
   }
 
-  vk_utils::GraphicsPipelineMaker maker;
+  // the maker outlives this function, pipeline variants are made from it on first use
+  auto pMaker = std::make_shared<vk_utils::GraphicsPipelineMaker>();
 
   std::unordered_map<VkShaderStageFlagBits, std::string> shader_paths;
-  shader_paths[VK_SHADER_STAGE_FRAGMENT_BIT] = FRAGMENT_SHADER_PATH + ".spv";
-  shader_paths[VK_SHADER_STAGE_VERTEX_BIT]   = VERTEX_SHADER_PATH + ".spv";
+  shader_paths[VK_SHADER_STAGE_FRAGMENT_BIT] = m_pShaderMgr->GetSPVPath(FRAGMENT_SHADER_PATH);
+  shader_paths[VK_SHADER_STAGE_VERTEX_BIT]   = m_pShaderMgr->GetSPVPath(VERTEX_SHADER_PATH);
+
+  m_basicForwardPipeline.layout = pMaker->MakeLayout(m_device, {m_dSetLayout}, sizeof(pushConst2M));
+  pMaker->SetDefaultState(m_width, m_height);
+
+  m_forwardVariants.Reset(m_device, [this, pMaker, shader_paths](const VkSpecializationInfo* a_pInfo) {
+    pMaker->LoadShaders(m_device, shader_paths);
+    SetSpecialization(*pMaker, VK_SHADER_STAGE_FRAGMENT_BIT, a_pInfo);
+    return pMaker->MakePipeline(m_device, m_pScnMgr->GetPipelineVertexInputStateCreateInfo(),
+                                m_screenRenderPass, {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR});
+  });
+
+  // same shaders and layout, depth is already complete after the prepass, so only the nearest surface passes
+  m_forwardEqualVariants.Reset(m_device, [this, pMaker, shader_paths](const VkSpecializationInfo* a_pInfo) {
+    pMaker->LoadShaders(m_device, shader_paths);
+    SetSpecialization(*pMaker, VK_SHADER_STAGE_FRAGMENT_BIT, a_pInfo);
+
+    const auto defaultDepthState = pMaker->depthStencilTest;
+    pMaker->depthStencilTest.depthCompareOp   = VK_COMPARE_OP_EQUAL;
+    pMaker->depthStencilTest.depthWriteEnable = VK_FALSE;
+    VkPipeline pipeline = pMaker->MakePipeline(m_device, m_pScnMgr->GetPipelineVertexInputStateCreateInfo(),
+                                               m_screenRenderPass, {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR});
+    pMaker->depthStencilTest = defaultDepthState;
+    return pipeline;
+  });
+
+  // depth prepass: vertex shader only, color writes off, reads the position stream of the scene
+  if(m_pScnMgr->GetPositionBuffer() != VK_NULL_HANDLE)
+  {
+    vk_utils::GraphicsPipelineMaker depthMaker;
 
-  maker.LoadShaders(m_device, shader_paths);
+    std::unordered_map<VkShaderStageFlagBits, std::string> depth_shader_paths;
+    depth_shader_paths[VK_SHADER_STAGE_VERTEX_BIT] = m_pShaderMgr->GetSPVPath(DEPTH_PREPASS_SHADER_PATH);
+    depthMaker.LoadShaders(m_device, depth_shader_paths);
 
-  m_basicForwardPipeline.layout = maker.MakeLayout(m_device, {m_dSetLayout}, sizeof(pushConst2M));
-  maker.SetDefaultState(m_width, m_height);
+    m_depthPrepassPipeline.layout = depthMaker.MakeLayout(m_device, {}, sizeof(pushConst2M));
+    depthMaker.SetDefaultState(m_width, m_height);
+    depthMaker.colorBlendAttachments[0].colorWriteMask = 0;
+
+    m_depthPrepassPipeline.pipeline = depthMaker.MakePipeline(m_device, m_pScnMgr->GetPositionOnlyVertexInputStateCreateInfo(),
+                                                              m_screenRenderPass, {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR});
+  }
 
-  m_basicForwardPipeline.pipeline = maker.MakePipeline(m_device, m_pScnMgr->GetPipelineVertexInputStateCreateInfo(),
-                                                       m_screenRenderPass, {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR});
+  SetupVertexPullingPipeline();
+  SetupClusterAssignPipeline();
 }
 
-void SimpleRender::CreateUniformBuffer()
+void SimpleRender::SetupVertexPullingPipeline()
+{
+  UpdateVertexPullingDescriptors();
+
+  m_vertexPullingVariants.Clear();
+  if(m_vertexPullingPipeline.layout != VK_NULL_HANDLE)
+  {
+    vkDestroyPipelineLayout(m_device, m_vertexPullingPipeline.layout, nullptr);
+    m_vertexPullingPipeline.layout = VK_NULL_HANDLE;
+  }
+
+  // scene without material table (e.g. LoadSingleTriangle) is drawn by the basic pipeline only
+  if(m_pScnMgr->GetMaterialSetLayout() == VK_NULL_HANDLE)
+    return;
+
+  auto pMaker = std::make_shared<vk_utils::GraphicsPipelineMaker>();
+
+  std::unordered_map<VkShaderStageFlagBits, std::string> shader_paths;
+  shader_paths[VK_SHADER_STAGE_FRAGMENT_BIT] = m_pShaderMgr->GetSPVPath(VPULL_FRAGMENT_SHADER_PATH);
+  shader_paths[VK_SHADER_STAGE_VERTEX_BIT]   = m_pShaderMgr->GetSPVPath(VPULL_VERTEX_SHADER_PATH);
+
+  // only projView is used, model matrices come from instance buffer
+  m_vertexPullingPipeline.layout = pMaker->MakeLayout(m_device, {m_vpullDSetLayout, m_pScnMgr->GetMaterialSetLayout()},
+                                                      sizeof(pushConst2M));
+  pMaker->SetDefaultState(m_width, m_height);
+
+  m_vertexPullingVariants.Reset(m_device, [this, pMaker, shader_paths](const VkSpecializationInfo* a_pInfo) {
+    pMaker->LoadShaders(m_device, shader_paths);
+    SetSpecialization(*pMaker, VK_SHADER_STAGE_FRAGMENT_BIT, a_pInfo);
+
+    // no vertex attributes at all - everything is fetched in vertex shader
+    VkPipelineVertexInputStateCreateInfo emptyVertexInput = {};
+    emptyVertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+    return pMaker->MakePipeline(m_device, emptyVertexInput,
+                                m_screenRenderPass, {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR});
+  });
+}
+
+SpecializationConstants SimpleRender::FeatureConstants() const
+{
+  SpecializationConstants constants;
+  constants.Set(SPEC_ANIMATE_LIGHT_COLOR, m_animateLightColor)
+           .Set(SPEC_TEXTURING, m_texturing)
+           .Set(SPEC_CLUSTERED_LIGHTS, m_clusteredLights);
+  return constants;
+}
+
+VkPipeline SimpleRender::ForwardPipeline()
+{
+  auto constants = FeatureConstants();
+  return DepthPrepassActive() ? m_forwardEqualVariants.Get(constants) : m_forwardVariants.Get(constants);
+}
+
+bool SimpleRender::DepthPrepassActive() const
+{
+  const bool vertexPulling = m_useVertexPulling && m_vertexPullingPipeline.layout != VK_NULL_HANDLE;
+  return m_depthPrepass && !vertexPulling && m_depthPrepassPipeline.pipeline != VK_NULL_HANDLE;
+}
+
+void SimpleRender::SetupClusterAssignPipeline()
+{
+  if(m_clusterAssignPipeline.pipeline != VK_NULL_HANDLE)
+  {
+    vkDestroyPipeline(m_device, m_clusterAssignPipeline.pipeline, nullptr);
+    m_clusterAssignPipeline.pipeline = VK_NULL_HANDLE;
+  }
+  if(m_clusterAssignPipeline.layout != VK_NULL_HANDLE)
+  {
+    vkDestroyPipelineLayout(m_device, m_clusterAssignPipeline.layout, nullptr);
+    m_clusterAssignPipeline.layout = VK_NULL_HANDLE;
+  }
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+  pipelineLayoutInfo.sType          = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts    = &m_clusterDSetLayout;
+  VK_CHECK_RESULT(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_clusterAssignPipeline.layout));
+
+  m_clusterAssignPipeline.pipeline = CreateComputePipeline(CLUSTER_ASSIGN_SHADER_PATH, m_clusterAssignPipeline.layout);
+}
+
+VkPipeline SimpleRender::CreateComputePipeline(const std::string &a_shaderPath, VkPipelineLayout a_layout)
 {
-  VkMemoryRequirements memReq;
-  m_ubo = vk_utils::createBuffer(m_device, sizeof(UniformParams), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &memReq);
+  std::vector<uint32_t> code = m_pShaderMgr->GetSPV(a_shaderPath);
+
+  VkShaderModuleCreateInfo createInfo = {};
+  createInfo.sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  createInfo.pCode    = code.data();
+  createInfo.codeSize = code.size() * sizeof(uint32_t);
 
-  VkMemoryAllocateInfo allocateInfo = {};
-  allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocateInfo.pNext = nullptr;
-  allocateInfo.allocationSize = memReq.size;
-  allocateInfo.memoryTypeIndex = vk_utils::findMemoryType(memReq.memoryTypeBits,
-                                                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                                          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                                                          m_physicalDevice);
-  VK_CHECK_RESULT(vkAllocateMemory(m_device, &allocateInfo, nullptr, &m_uboAlloc));
+  VkShaderModule shaderModule;
+  VK_CHECK_RESULT(vkCreateShaderModule(m_device, &createInfo, nullptr, &shaderModule));
 
-  VK_CHECK_RESULT(vkBindBufferMemory(m_device, m_ubo, m_uboAlloc, 0));
+  VkComputePipelineCreateInfo pipelineInfo = {};
+  pipelineInfo.sType        = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage  = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = shaderModule;
+  pipelineInfo.stage.pName  = "main";
+  pipelineInfo.layout       = a_layout;
 
-  vkMapMemory(m_device, m_uboAlloc, 0, sizeof(m_uniforms), 0, &m_uboMappedMem);
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  VK_CHECK_RESULT(vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline));
+
+  vkDestroyShaderModule(m_device, shaderModule, nullptr);
+  return pipeline;
+}
+
+void SimpleRender::CreateUniformBuffer()
+{
+  m_ubo = vk_utils::createBuffer(m_device, sizeof(UniformParams), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+  m_uboAlloc = m_pAllocator->AllocateAndBind(m_ubo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  m_uboMappedMem = m_uboAlloc.mapped;
 
   m_uniforms.lightPos = LiteMath::float3(0.0f, 1.0f, 1.0f);
   m_uniforms.baseColor = LiteMath::float3(0.9f, 0.92f, 1.0f);
-  m_uniforms.animateLightColor = true;
 
   UpdateUniformBuffer(0.0f);
 }
 
 void SimpleRender::UpdateUniformBuffer(float a_time)
 {
+  CPU_PROFILE_SCOPE("UpdateUniformBuffer");
 // most uniforms are updated in GUI -> SetupGUIElements()
   m_uniforms.time = a_time;
   memcpy(m_uboMappedMem, &m_uniforms, sizeof(m_uniforms));
 }
 
+void SimpleRender::CreateLightsBuffer()
+{
+  m_lightsBuf   = vk_utils::createBuffer(m_device, sizeof(PointLight) * MAX_POINT_LIGHTS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  m_lightsAlloc = m_pAllocator->AllocateAndBind(m_lightsBuf, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
+
+void SimpleRender::CreateClusterBuffers()
+{
+  m_clusterUbo      = vk_utils::createBuffer(m_device, sizeof(ClusterParams), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+  m_clusterUboAlloc = m_pAllocator->AllocateAndBind(m_clusterUbo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  // light lists are only touched by the GPU, fixed capacity per cluster avoids a prefix sum over the counts
+  m_clusterCountsBuf   = vk_utils::createBuffer(m_device, sizeof(uint32_t) * CLUSTERS_NUM, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  m_clusterCountsAlloc = m_pAllocator->AllocateAndBind(m_clusterCountsBuf, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  m_clusterLightIdsBuf   = vk_utils::createBuffer(m_device, sizeof(uint32_t) * CLUSTERS_NUM * MAX_LIGHTS_PER_CLUSTER,
+                                                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  m_clusterLightIdsAlloc = m_pAllocator->AllocateAndBind(m_clusterLightIdsBuf, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+void SimpleRender::UpdateLights(float a_time)
+{
+  CPU_PROFILE_SCOPE("UpdateLights");
+  if(m_lightsBuf == VK_NULL_HANDLE)
+    return;
+
+  // lights are culled and shaded in view space, so they are transformed here once instead of per cluster or tile
+  const auto view = LiteMath::lookAt(m_cam.pos, m_cam.lookAt, m_cam.up);
+  auto* pLights   = static_cast<PointLight*>(m_lightsAlloc.mapped);
+  uint32_t lightsNum = 0;
+  auto addLight = [&](float3 a_pos, float a_radius, float3 a_color) {
+    if(lightsNum >= MAX_POINT_LIGHTS)
+      return;
+    const float4 viewPos = view * LiteMath::float4(a_pos.x, a_pos.y, a_pos.z, 1.0f);
+    pLights[lightsNum].posRadius = LiteMath::float4(viewPos.x, viewPos.y, viewPos.z, a_radius);
+    pLights[lightsNum].color     = LiteMath::float4(a_color.x, a_color.y, a_color.z, 0.0f);
+    ++lightsNum;
+  };
+
+  for(uint32_t i = 0; i < m_pScnMgr->LightsNum(); ++i)
+  {
+    const PointLight light = m_pScnMgr->GetLight(i);
+    addLight(LiteMath::to_float3(light.posRadius), light.posRadius.w, LiteMath::to_float3(light.color));
+  }
+
+  // synthetic lights are scattered over the scene box and orbit around its vertical axis
+  const auto   bbox   = m_pScnMgr->GetSceneBbox();
+  const float3 boxMin = LiteMath::to_float3(bbox.boxMin);
+  const float3 size   = LiteMath::to_float3(bbox.boxMax - bbox.boxMin);
+  const float3 center = boxMin + 0.5f * size;
+  for(uint32_t i = 0; i < uint32_t(m_extraLights); ++i)
+  {
+    float3 pos = boxMin + size * float3(hashToUnit(i, 0), hashToUnit(i, 1), hashToUnit(i, 2));
+    if(m_animateLights)
+    {
+      const float angle = a_time * (0.2f + 0.6f * hashToUnit(i, 3)) * (i % 2 == 0 ? 1.0f : -1.0f);
+      const float dx = pos.x - center.x;
+      const float dz = pos.z - center.z;
+      pos.x = center.x + dx * std::cos(angle) - dz * std::sin(angle);
+      pos.z = center.z + dx * std::sin(angle) + dz * std::cos(angle);
+    }
+    addLight(pos, m_extraLightRadius, hueToRGB(hashToUnit(i, 4)) * m_extraLightIntensity);
+  }
+  m_lightsNum = lightsNum;
+
+  // same projection as in UpdateView
+  const float aspect = float(m_width) / float(m_height);
+  const auto  proj   = OpenglToVulkanProjectionMatrixFix() * projectionMatrix(m_cam.fov, aspect, 0.1f, 1000.0f);
+  m_clusterParams.view       = view;
+  m_clusterParams.invProj    = LiteMath::inverse4x4(proj);
+  m_clusterParams.screenSize = float2(float(m_width), float(m_height));
+  m_clusterParams.zNear      = 0.1f;
+  m_clusterParams.zFar       = 1000.0f;
+  m_clusterParams.lightsNum  = lightsNum;
+  m_clusterParams.exposure   = m_exposure;
+  if(m_clusterUbo != VK_NULL_HANDLE)
+    memcpy(m_clusterUboAlloc.mapped, &m_clusterParams, sizeof(m_clusterParams));
+}
+
+void SimpleRender::ClusterAssignCmd(VkCommandBuffer a_cmdBuff)
+{
+  // fragments of the previous frame might still read the lists being rewritten
+  vkCmdPipelineBarrier(a_cmdBuff, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+  vkCmdBindPipeline(a_cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, m_clusterAssignPipeline.pipeline);
+  vkCmdBindDescriptorSets(a_cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, m_clusterAssignPipeline.layout, 0, 1,
+                          &m_clusterDSet, 0, nullptr);
+  vkCmdDispatch(a_cmdBuff, (CLUSTERS_NUM + CLUSTER_ASSIGN_GROUP - 1) / CLUSTER_ASSIGN_GROUP, 1, 1);
+
+  VkMemoryBarrier listsReady = {};
+  listsReady.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  listsReady.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  listsReady.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(a_cmdBuff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       0, 1, &listsReady, 0, nullptr, 0, nullptr);
+}
+
 void SimpleRender::BuildCommandBufferSimple(VkCommandBuffer a_cmdBuff, VkFramebuffer a_frameBuff,
                                             VkImageView, VkPipeline a_pipeline)
 {
+  CPU_PROFILE_SCOPE("record commands");
   vkResetCommandBuffer(a_cmdBuff, 0);
 
   VkCommandBufferBeginInfo beginInfo = {};
@@ -213,6 +566,15 @@ void SimpleRender::BuildCommandBufferSimple(VkCommandBuffer a_cmdBuff, VkFramebu
   vk_utils::setDefaultViewport(a_cmdBuff, static_cast<float>(m_width), static_cast<float>(m_height));
   vk_utils::setDefaultScissor(a_cmdBuff, m_width, m_height);
 
+  const bool vertexPulling = m_useVertexPulling && m_vertexPullingPipeline.layout != VK_NULL_HANDLE;
+  const bool depthPrepass  = DepthPrepassActive();
+
+  m_pPipelineStats->BeginFrame(a_cmdBuff, m_presentationResources.currentFrame);
+
+  ///// light lists of clusters, only the basic forward pipeline reads them
+  if(m_clusteredLights && !vertexPulling && m_clusterAssignPipeline.pipeline != VK_NULL_HANDLE)
+    ClusterAssignCmd(a_cmdBuff);
+
   ///// draw final scene to screen
   {
     VkRenderPassBeginInfo renderPassInfo = {};
@@ -229,38 +591,126 @@ void SimpleRender::BuildCommandBufferSimple(VkCommandBuffer a_cmdBuff, VkFramebu
     renderPassInfo.pClearValues = &clearValues[0];
 
     vkCmdBeginRenderPass(a_cmdBuff, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-    vkCmdBindPipeline(a_cmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, a_pipeline);
 
-    vkCmdBindDescriptorSets(a_cmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, m_basicForwardPipeline.layout, 0, 1,
-                            &m_dSet, 0, VK_NULL_HANDLE);
+    // both passes are in the same subpass, depth of the prepass is used directly
+    if(depthPrepass)
+    {
+      m_pPipelineStats->BeginScope(a_cmdBuff, "depth prepass");
+      DrawSceneDepthCmd(a_cmdBuff);
+      m_pPipelineStats->EndScope(a_cmdBuff);
+    }
 
-    VkShaderStageFlags stageFlags = (VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+    m_pPipelineStats->BeginScope(a_cmdBuff, depthPrepass ? "forward after prepass" : "forward");
+    if(vertexPulling)
+      DrawSceneVertexPullingCmd(a_cmdBuff);
+    else
+      DrawSceneCmd(a_cmdBuff, a_pipeline);
+    m_pPipelineStats->EndScope(a_cmdBuff);
 
-    VkDeviceSize zero_offset = 0u;
-    VkBuffer vertexBuf = m_pScnMgr->GetVertexBuffer();
-    VkBuffer indexBuf = m_pScnMgr->GetIndexBuffer();
+    vkCmdEndRenderPass(a_cmdBuff);
+  }
 
-    vkCmdBindVertexBuffers(a_cmdBuff, 0, 1, &vertexBuf, &zero_offset);
-    vkCmdBindIndexBuffer(a_cmdBuff, indexBuf, 0, VK_INDEX_TYPE_UINT32);
+  VK_CHECK_RESULT(vkEndCommandBuffer(a_cmdBuff));
+}
 
-    for (uint32_t i = 0; i < m_pScnMgr->InstancesNum(); ++i)
-    {
-      auto inst = m_pScnMgr->GetInstanceInfo(i);
+void SimpleRender::BuildFrameCommands(VkCommandBuffer a_cmdBuff, uint32_t a_imageIdx)
+{
+  BuildCommandBufferSimple(a_cmdBuff, m_frameBuffers[a_imageIdx], m_swapchain.GetAttachment(a_imageIdx).view, ForwardPipeline());
+}
 
-      pushConst2M.model = m_pScnMgr->GetInstanceMatrix(i);
-      vkCmdPushConstants(a_cmdBuff, m_basicForwardPipeline.layout, stageFlags, 0,
-                         sizeof(pushConst2M), &pushConst2M);
+void SimpleRender::DrawSceneCmd(VkCommandBuffer a_cmdBuff, VkPipeline a_pipeline)
+{
+  vkCmdBindPipeline(a_cmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, a_pipeline);
 
-      auto mesh_info = m_pScnMgr->GetMeshInfo(inst.mesh_id);
-      vkCmdDrawIndexed(a_cmdBuff, mesh_info.m_indNum, 1, mesh_info.m_indexOffset, mesh_info.m_vertexOffset, 0);
-    }
+  vkCmdBindDescriptorSets(a_cmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, m_basicForwardPipeline.layout, 0, 1,
+                          &m_dSet, 0, VK_NULL_HANDLE);
 
-    vkCmdEndRenderPass(a_cmdBuff);
+  VkShaderStageFlags stageFlags = (VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+
+  VkDeviceSize zero_offset = 0u;
+  VkBuffer vertexBuf = m_pScnMgr->GetVertexBuffer();
+  VkBuffer indexBuf = m_pScnMgr->GetIndexBuffer();
+
+  vkCmdBindVertexBuffers(a_cmdBuff, 0, 1, &vertexBuf, &zero_offset);
+  vkCmdBindIndexBuffer(a_cmdBuff, indexBuf, 0, VK_INDEX_TYPE_UINT32);
+
+  for (uint32_t i = 0; i < m_pScnMgr->InstancesNum(); ++i)
+  {
+    auto inst = m_pScnMgr->GetInstanceInfo(i);
+    if(!inst.alive)
+      continue;
+
+    pushConst2M.model = m_pScnMgr->GetInstanceMatrix(i);
+    vkCmdPushConstants(a_cmdBuff, m_basicForwardPipeline.layout, stageFlags, 0,
+                       sizeof(pushConst2M), &pushConst2M);
+
+    auto mesh_info = m_pScnMgr->GetMeshInfo(inst.mesh_id);
+    vkCmdDrawIndexed(a_cmdBuff, mesh_info.m_indNum, 1, mesh_info.m_indexOffset, mesh_info.m_vertexOffset, 0);
   }
+}
 
-  VK_CHECK_RESULT(vkEndCommandBuffer(a_cmdBuff));
+void SimpleRender::DrawSceneDepthCmd(VkCommandBuffer a_cmdBuff)
+{
+  vkCmdBindPipeline(a_cmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, m_depthPrepassPipeline.pipeline);
+
+  VkShaderStageFlags stageFlags = (VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+
+  VkDeviceSize zero_offset = 0u;
+  VkBuffer positionBuf = m_pScnMgr->GetPositionBuffer();
+  vkCmdBindVertexBuffers(a_cmdBuff, 0, 1, &positionBuf, &zero_offset);
+  vkCmdBindIndexBuffer(a_cmdBuff, m_pScnMgr->GetIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+
+  // vertex offsets of meshes are in vertices, so they are the same for the position stream
+  for (uint32_t i = 0; i < m_pScnMgr->InstancesNum(); ++i)
+  {
+    auto inst = m_pScnMgr->GetInstanceInfo(i);
+    if(!inst.alive)
+      continue;
+
+    pushConst2M.model = m_pScnMgr->GetInstanceMatrix(i);
+    vkCmdPushConstants(a_cmdBuff, m_depthPrepassPipeline.layout, stageFlags, 0,
+                       sizeof(pushConst2M), &pushConst2M);
+
+    auto mesh_info = m_pScnMgr->GetMeshInfo(inst.mesh_id);
+    vkCmdDrawIndexed(a_cmdBuff, mesh_info.m_indNum, 1, mesh_info.m_indexOffset, mesh_info.m_vertexOffset, 0);
+  }
 }
 
+void SimpleRender::DrawSceneVertexPullingCmd(VkCommandBuffer a_cmdBuff)
+{
+  auto constants = FeatureConstants();
+  vkCmdBindPipeline(a_cmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, m_vertexPullingVariants.Get(constants));
+  VkDescriptorSet dSets[2] = {m_vpullDSet, m_pScnMgr->GetMaterialSet()};
+  vkCmdBindDescriptorSets(a_cmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, m_vertexPullingPipeline.layout, 0, 2,
+                          dSets, 0, VK_NULL_HANDLE);
+
+  VkShaderStageFlags stageFlags = (VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+  vkCmdPushConstants(a_cmdBuff, m_vertexPullingPipeline.layout, stageFlags, 0, sizeof(pushConst2M), &pushConst2M);
+
+  // index buffer is shared by all meshes, so it is bound once and never rebound
+  vkCmdBindIndexBuffer(a_cmdBuff, m_pScnMgr->GetIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+
+  const uint32_t drawsNum = m_pScnMgr->IndirectDrawsNum();
+  const uint32_t stride   = sizeof(VkDrawIndexedIndirectCommand);
+  if(!m_enabledDeviceFeatures.drawIndirectFirstInstance)
+  {
+    // firstInstance in indirect commands must be 0 without this feature, so issue the same draws directly
+    for (uint32_t i = 0; i < drawsNum; ++i)
+    {
+      auto draw = m_pScnMgr->GetIndirectDraw(i);
+      vkCmdDrawIndexed(a_cmdBuff, draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset, draw.firstInstance);
+    }
+  }
+  else if(m_enabledDeviceFeatures.multiDrawIndirect)
+  {
+    vkCmdDrawIndexedIndirect(a_cmdBuff, m_pScnMgr->GetIndirectDrawBuffer(), 0, drawsNum, stride);
+  }
+  else
+  {
+    for (uint32_t i = 0; i < drawsNum; ++i)
+      vkCmdDrawIndexedIndirect(a_cmdBuff, m_pScnMgr->GetIndirectDrawBuffer(), i * stride, 1, stride);
+  }
+}
 
 void SimpleRender::CleanupPipelineAndSwapchain()
 {
@@ -334,8 +784,7 @@ void SimpleRender::RecreateSwapChain()
   m_cmdBuffersDrawMain = vk_utils::createCommandBuffers(m_device, m_commandPool, m_framesInFlight);
   for (uint32_t i = 0; i < m_swapchain.GetImageCount(); ++i)
   {
-    BuildCommandBufferSimple(m_cmdBuffersDrawMain[i], m_frameBuffers[i],
-                             m_swapchain.GetAttachment(i).view, m_basicForwardPipeline.pipeline);
+    BuildFrameCommands(m_cmdBuffersDrawMain[i], i);
   }
 
   m_pGUIRender->OnSwapchainChanged(m_swapchain);
@@ -355,17 +804,32 @@ void SimpleRender::Cleanup()
     m_surface = VK_NULL_HANDLE;
   }
 
-  if (m_basicForwardPipeline.pipeline != VK_NULL_HANDLE)
-  {
-    vkDestroyPipeline(m_device, m_basicForwardPipeline.pipeline, nullptr);
-    m_basicForwardPipeline.pipeline = VK_NULL_HANDLE;
-  }
+  m_forwardVariants.Clear();
+  m_forwardEqualVariants.Clear();
   if (m_basicForwardPipeline.layout != VK_NULL_HANDLE)
   {
     vkDestroyPipelineLayout(m_device, m_basicForwardPipeline.layout, nullptr);
     m_basicForwardPipeline.layout = VK_NULL_HANDLE;
   }
 
+  if (m_depthPrepassPipeline.pipeline != VK_NULL_HANDLE)
+  {
+    vkDestroyPipeline(m_device, m_depthPrepassPipeline.pipeline, nullptr);
+    m_depthPrepassPipeline.pipeline = VK_NULL_HANDLE;
+  }
+  if (m_depthPrepassPipeline.layout != VK_NULL_HANDLE)
+  {
+    vkDestroyPipelineLayout(m_device, m_depthPrepassPipeline.layout, nullptr);
+    m_depthPrepassPipeline.layout = VK_NULL_HANDLE;
+  }
+
+  m_vertexPullingVariants.Clear();
+  if (m_vertexPullingPipeline.layout != VK_NULL_HANDLE)
+  {
+    vkDestroyPipelineLayout(m_device, m_vertexPullingPipeline.layout, nullptr);
+    m_vertexPullingPipeline.layout = VK_NULL_HANDLE;
+  }
+
   if (m_presentationResources.imageAvailable != VK_NULL_HANDLE)
   {
     vkDestroySemaphore(m_device, m_presentationResources.imageAvailable, nullptr);
@@ -383,20 +847,39 @@ void SimpleRender::Cleanup()
     m_commandPool = VK_NULL_HANDLE;
   }
 
-  if(m_ubo != VK_NULL_HANDLE)
+  if(m_clusterAssignPipeline.pipeline != VK_NULL_HANDLE)
   {
-    vkDestroyBuffer(m_device, m_ubo, nullptr);
-    m_ubo = VK_NULL_HANDLE;
+    vkDestroyPipeline(m_device, m_clusterAssignPipeline.pipeline, nullptr);
+    m_clusterAssignPipeline.pipeline = VK_NULL_HANDLE;
+  }
+  if(m_clusterAssignPipeline.layout != VK_NULL_HANDLE)
+  {
+    vkDestroyPipelineLayout(m_device, m_clusterAssignPipeline.layout, nullptr);
+    m_clusterAssignPipeline.layout = VK_NULL_HANDLE;
   }
 
-  if(m_uboAlloc != VK_NULL_HANDLE)
+  for(VkBuffer* pBuf : {&m_ubo, &m_lightsBuf, &m_clusterUbo, &m_clusterCountsBuf, &m_clusterLightIdsBuf})
   {
-    vkFreeMemory(m_device, m_uboAlloc, nullptr);
-    m_uboAlloc = VK_NULL_HANDLE;
+    if(*pBuf != VK_NULL_HANDLE)
+    {
+      vkDestroyBuffer(m_device, *pBuf, nullptr);
+      *pBuf = VK_NULL_HANDLE;
+    }
   }
 
-  m_pBindings = nullptr;
-  m_pScnMgr   = nullptr;
+  if(m_pAllocator != nullptr)
+  {
+    m_pAllocator->Free(m_uboAlloc);
+    m_pAllocator->Free(m_lightsAlloc);
+    m_pAllocator->Free(m_clusterUboAlloc);
+    m_pAllocator->Free(m_clusterCountsAlloc);
+    m_pAllocator->Free(m_clusterLightIdsAlloc);
+  }
+
+  m_pBindings  = nullptr;
+  m_pScnMgr    = nullptr;
+  m_pPipelineStats = nullptr;
+  m_pAllocator = nullptr;
 
   if(m_device != VK_NULL_HANDLE)
   {
@@ -419,31 +902,19 @@ void SimpleRender::Cleanup()
 
 void SimpleRender::ProcessInput(const AppInput &input)
 {
+  CPU_PROFILE_SCOPE("ProcessInput");
   // add keyboard controls here
   // camera movement is processed separately
 
-  // recreate pipeline to reload shaders
+  // changed shaders are recompiled in background and picked up automatically, B forces pipelines to be recreated
   if(input.keyPressed[GLFW_KEY_B])
-  {
-#ifdef WIN32
-    std::system("cd ../resources/shaders && python compile_simple_render_shaders.py");
-#else
-    std::system("cd ../resources/shaders && python3 compile_simple_render_shaders.py");
-#endif
-
-    SetupSimplePipeline();
-
-    for (uint32_t i = 0; i < m_framesInFlight; ++i)
-    {
-      BuildCommandBufferSimple(m_cmdBuffersDrawMain[i], m_frameBuffers[i],
-                               m_swapchain.GetAttachment(i).view, m_basicForwardPipeline.pipeline);
-    }
-  }
+    m_pShaderMgr->ReloadAll();
 
 }
 
 void SimpleRender::UpdateCamera(const Camera* cams, uint32_t a_camsCount)
 {
+  CPU_PROFILE_SCOPE("UpdateCamera");
   assert(a_camsCount > 0);
   m_cam = cams[0];
   UpdateView();
@@ -464,9 +935,24 @@ void SimpleRender::LoadScene(const char* path, bool transpose_inst_matrices)
   m_pScnMgr->LoadSceneXML(path, transpose_inst_matrices);
 
   CreateUniformBuffer();
+  CreateLightsBuffer();
   SetupSimplePipeline();
 
-  auto loadedCam = m_pScnMgr->GetCamera(0);
+  const auto bbox = m_pScnMgr->GetSceneBbox();
+  m_extraLightRadius = 0.15f * LiteMath::length(LiteMath::to_float3(bbox.boxMax - bbox.boxMin));
+  std::cout << "[SimpleRender::LoadScene] scene lights: " << m_pScnMgr->LightsNum() << std::endl;
+
+  UseSceneCamera(0);
+
+  for (uint32_t i = 0; i < m_framesInFlight; ++i)
+  {
+    BuildFrameCommands(m_cmdBuffersDrawMain[i], i);
+  }
+}
+
+void SimpleRender::UseSceneCamera(uint32_t a_camId)
+{
+  auto loadedCam = m_pScnMgr->GetCamera(a_camId);
   m_cam.fov = loadedCam.fov;
   m_cam.pos = float3(loadedCam.pos);
   m_cam.up  = float3(loadedCam.up);
@@ -474,46 +960,148 @@ void SimpleRender::LoadScene(const char* path, bool transpose_inst_matrices)
   m_cam.tdist  = loadedCam.farPlane;
 
   UpdateView();
-
-  for (uint32_t i = 0; i < m_framesInFlight; ++i)
-  {
-    BuildCommandBufferSimple(m_cmdBuffersDrawMain[i], m_frameBuffers[i],
-                             m_swapchain.GetAttachment(i).view, m_basicForwardPipeline.pipeline);
-  }
 }
 
-void SimpleRender::DrawFrameSimple()
+void SimpleRender::ApplySceneChange(const char* path, bool transpose_inst_matrices)
 {
-  vkWaitForFences(m_device, 1, &m_frameFences[m_presentationResources.currentFrame], VK_TRUE, UINT64_MAX);
-  vkResetFences(m_device, 1, &m_frameFences[m_presentationResources.currentFrame]);
-
-  uint32_t imageIdx;
-  m_swapchain.AcquireNextImage(m_presentationResources.imageAvailable, &imageIdx);
+  // GPU buffers are updated with the next frame by RecordSceneUpdates()
+  SceneChangeInfo info;
+  if(!m_pScnMgr->ApplyChangeXML(path, transpose_inst_matrices, &info))
+    return;
 
-  auto currentCmdBuf = m_cmdBuffersDrawMain[m_presentationResources.currentFrame];
+  std::cout << "[SimpleRender::ApplySceneChange] new meshes: " << info.newMeshes << ", instances added: " << info.addedInstances
+            << ", moved: " << info.movedInstances << ", removed: " << info.removedInstances << std::endl;
 
-  VkSemaphore waitSemaphores[] = {m_presentationResources.imageAvailable};
-  VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+  if(info.camerasChanged)
+    UseSceneCamera(0);
+}
 
-  BuildCommandBufferSimple(currentCmdBuf, m_frameBuffers[imageIdx], m_swapchain.GetAttachment(imageIdx).view,
-                           m_basicForwardPipeline.pipeline);
+void SimpleRender::SubmitFrame(std::vector<VkCommandBuffer> a_cmdBufs)
+{
+  std::vector<VkSemaphore>          waitSemaphores = {m_presentationResources.imageAvailable};
+  std::vector<VkPipelineStageFlags> waitStages     = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+  std::vector<uint64_t>             waitValues     = {0}; // ignored for binary semaphores
+
+  // the frame waits only for the uploads it acquires and only at the stages that read them
+  a_cmdBufs.insert(a_cmdBufs.begin(), m_cmdBuffersSceneUpdate[m_presentationResources.currentFrame]);
+  UploadQueue* pUploads = m_pScnMgr->GetUploadQueue();
+  if(pUploads != nullptr && pUploads->UsesTimeline() && m_sceneUploadTicket != 0)
+  {
+    waitSemaphores.push_back(pUploads->Timeline());
+    waitStages.push_back(m_sceneUploadStages);
+    waitValues.push_back(m_sceneUploadTicket);
+  }
 
   VkSubmitInfo submitInfo = {};
   submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  submitInfo.waitSemaphoreCount = 1;
-  submitInfo.pWaitSemaphores = waitSemaphores;
-  submitInfo.pWaitDstStageMask = waitStages;
-  submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &currentCmdBuf;
+  submitInfo.waitSemaphoreCount = (uint32_t)waitSemaphores.size();
+  submitInfo.pWaitSemaphores = waitSemaphores.data();
+  submitInfo.pWaitDstStageMask = waitStages.data();
+  submitInfo.commandBufferCount = (uint32_t)a_cmdBufs.size();
+  submitInfo.pCommandBuffers = a_cmdBufs.data();
 
   VkSemaphore signalSemaphores[] = {m_presentationResources.renderingFinished};
   submitInfo.signalSemaphoreCount = 1;
   submitInfo.pSignalSemaphores = signalSemaphores;
 
-  VK_CHECK_RESULT(vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, m_frameFences[m_presentationResources.currentFrame]));
+  VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+  if(waitSemaphores.size() > 1)
+  {
+    timelineInfo.sType                   = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+    timelineInfo.waitSemaphoreValueCount = (uint32_t)waitValues.size();
+    timelineInfo.pWaitSemaphoreValues    = waitValues.data();
+    submitInfo.pNext = &timelineInfo;
+  }
+
+  {
+    CPU_PROFILE_SCOPE("vkQueueSubmit");
+    VK_CHECK_RESULT(vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, m_frameFences[m_presentationResources.currentFrame]));
+  }
+  m_pPipelineStats->FrameSubmitted(m_presentationResources.currentFrame);
+}
+
+void SimpleRender::RecordSceneUpdates()
+{
+  // buffers uploaded on the transfer queue are taken over first, then runtime scene edits are copied
+  // on the graphics queue, both in a small command buffer in front of the frame
+  VkCommandBuffer updateCmdBuf = m_cmdBuffersSceneUpdate[m_presentationResources.currentFrame];
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  VK_CHECK_RESULT(vkResetCommandBuffer(updateCmdBuf, 0));
+  VK_CHECK_RESULT(vkBeginCommandBuffer(updateCmdBuf, &beginInfo));
+
+  m_sceneUploadTicket = 0;
+  m_sceneUploadStages = 0;
+  UploadQueue* pUploads = m_pScnMgr->GetUploadQueue();
+  if(pUploads != nullptr && pUploads->HasPendingAcquires())
+    m_sceneUploadTicket = pUploads->RecordAcquire(updateCmdBuf, &m_sceneUploadStages);
+
+  bool buffersReplaced = false;
+  {
+    CPU_PROFILE_SCOPE("record scene updates");
+    buffersReplaced = m_pScnMgr->RecordUpdates(updateCmdBuf);
+  }
+  VK_CHECK_RESULT(vkEndCommandBuffer(updateCmdBuf));
+
+  // every frame ends with vkQueueWaitIdle, so the descriptor set can be rewritten here
+  if(buffersReplaced)
+    UpdateVertexPullingDescriptors();
+}
+
+void SimpleRender::UpdateVertexPullingDescriptors()
+{
+  if(m_vpullDSet == VK_NULL_HANDLE)
+    return;
+
+  VkDescriptorBufferInfo bufferInfos[3] = {};
+  bufferInfos[0].buffer = m_pScnMgr->GetVertexBuffer();
+  bufferInfos[1].buffer = m_pScnMgr->GetInstanceMatricesBuffer();
+  bufferInfos[2].buffer = m_pScnMgr->GetInstanceIdsBuffer();
+
+  VkWriteDescriptorSet writes[3] = {};
+  for(uint32_t i = 0; i < 3; ++i)
+  {
+    bufferInfos[i].offset = 0;
+    bufferInfos[i].range  = VK_WHOLE_SIZE;
+
+    writes[i].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[i].dstSet          = m_vpullDSet;
+    writes[i].dstBinding      = i + 1;
+    writes[i].dstArrayElement = 0;
+    writes[i].descriptorCount = 1;
+    writes[i].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writes[i].pBufferInfo     = &bufferInfos[i];
+  }
+  vkUpdateDescriptorSets(m_device, 3, writes, 0, nullptr);
+}
 
-  VkResult presentRes = m_swapchain.QueuePresent(m_presentationResources.queue, imageIdx,
-                                                 m_presentationResources.renderingFinished);
+void SimpleRender::DrawFrameSimple()
+{
+  {
+    CPU_PROFILE_SCOPE("wait frame fence");
+    vkWaitForFences(m_device, 1, &m_frameFences[m_presentationResources.currentFrame], VK_TRUE, UINT64_MAX);
+    vkResetFences(m_device, 1, &m_frameFences[m_presentationResources.currentFrame]);
+  }
+
+  uint32_t imageIdx;
+  {
+    CPU_PROFILE_SCOPE("AcquireNextImage");
+    m_swapchain.AcquireNextImage(m_presentationResources.imageAvailable, &imageIdx);
+  }
+
+  auto currentCmdBuf = m_cmdBuffersDrawMain[m_presentationResources.currentFrame];
+
+  RecordSceneUpdates();
+  BuildFrameCommands(currentCmdBuf, imageIdx);
+
+  SubmitFrame({currentCmdBuf});
+
+  VkResult presentRes;
+  {
+    CPU_PROFILE_SCOPE("QueuePresent");
+    presentRes = m_swapchain.QueuePresent(m_presentationResources.queue, imageIdx, m_presentationResources.renderingFinished);
+  }
 
   if (presentRes == VK_ERROR_OUT_OF_DATE_KHR || presentRes == VK_SUBOPTIMAL_KHR)
   {
@@ -526,12 +1114,16 @@ void SimpleRender::DrawFrameSimple()
 
   m_presentationResources.currentFrame = (m_presentationResources.currentFrame + 1) % m_framesInFlight;
 
+  CPU_PROFILE_SCOPE("vkQueueWaitIdle");
   vkQueueWaitIdle(m_presentationResources.queue);
 }
 
 void SimpleRender::DrawFrame(float a_time, DrawMode a_mode)
 {
+  // every frame ends with vkQueueWaitIdle, so pipelines can be replaced here
+  m_pShaderMgr->Update();
   UpdateUniformBuffer(a_time);
+  UpdateLights(a_time);
   switch (a_mode)
   {
   case DrawMode::WITH_GUI:
@@ -551,6 +1143,7 @@ void SimpleRender::DrawFrame(float a_time, DrawMode a_mode)
 
 void SimpleRender::SetupGUIElements()
 {
+  CPU_PROFILE_SCOPE("SetupGUIElements");
   ImGui_ImplVulkan_NewFrame();
   ImGui_ImplGlfw_NewFrame();
   ImGui::NewFrame();
@@ -559,11 +1152,52 @@ void SimpleRender::SetupGUIElements()
     ImGui::Begin("Simple render settings");
 
     ImGui::ColorEdit3("Meshes base color", m_uniforms.baseColor.M, ImGuiColorEditFlags_PickerHueWheel | ImGuiColorEditFlags_NoInputs);
-    ImGui::Checkbox("Animate light source color", &m_uniforms.animateLightColor);
+    ImGui::Checkbox("Animate light source color", &m_animateLightColor);
     ImGui::SliderFloat3("Light source position", m_uniforms.lightPos.M, -10.f, 10.f);
+    ImGui::Checkbox("Vertex pulling (single indirect draw)", &m_useVertexPulling);
+    if(m_pScnMgr->TextureTableSupported())
+      ImGui::Checkbox("Diffuse textures (vertex pulling)", &m_texturing);
+    ImGui::Checkbox("Clustered point lights", &m_clusteredLights);
+    if(m_clusteredLights)
+    {
+      ImGui::Text("Scene lights: %u", m_pScnMgr->LightsNum());
+      ImGui::SliderInt("Extra point lights", &m_extraLights, 0, MAX_POINT_LIGHTS);
+      ImGui::SliderFloat("Extra light radius", &m_extraLightRadius, 0.05f, 20.0f);
+      ImGui::SliderFloat("Extra light intensity", &m_extraLightIntensity, 0.0f, 20.0f);
+      ImGui::Checkbox("Animate lights", &m_animateLights);
+      ImGui::SliderFloat("Exposure", &m_exposure, 0.1f, 8.0f);
+      ImGui::Text("Lights: %u in %ux%ux%u clusters, at most %u per cluster", m_lightsNum, CLUSTER_GRID_X, CLUSTER_GRID_Y,
+                  CLUSTER_GRID_Z, MAX_LIGHTS_PER_CLUSTER);
+    }
+    ImGui::Checkbox("Depth prepass", &m_depthPrepass);
+    ImGui::Text("Pipeline variants: %zu forward, %zu vertex pulling", m_forwardVariants.Size() + m_forwardEqualVariants.Size(),
+                m_vertexPullingVariants.Size());
+
+    // the forward pass is measured separately with and without the prepass, so both numbers stay on screen
+    PipelineStatistics::Counters forward, prepass, afterPrepass;
+    const bool hasForward = m_pPipelineStats->GetLast("forward", &forward);
+    const bool hasPrepass = m_pPipelineStats->GetLast("depth prepass", &prepass) &&
+                            m_pPipelineStats->GetLast("forward after prepass", &afterPrepass);
+    if(hasForward)
+      ImGui::Text("Fragment shader invocations: %llu without prepass", (unsigned long long)forward.fragmentInvocations);
+    if(hasPrepass)
+      ImGui::Text("Fragment shader invocations: %llu with prepass (+%llu prepass vertices)",
+                  (unsigned long long)afterPrepass.fragmentInvocations, (unsigned long long)prepass.vertexInvocations);
+    if(hasForward && hasPrepass && forward.fragmentInvocations > 0)
+      ImGui::Text("Fragment shading saved by prepass: %.1f%%",
+                  100.0 * (1.0 - double(afterPrepass.fragmentInvocations) / double(forward.fragmentInvocations)));
 
     ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 
+    if(m_pAllocator != nullptr)
+    {
+      auto memStats = m_pAllocator->GetStats();
+      ImGui::Text("Device memory: %u blocks, %u allocations (%u vkAllocateMemory calls total)",
+                  memStats.deviceAllocations, memStats.subAllocations, memStats.totalAllocateCalls);
+      ImGui::Text("Used %.2f / %.2f MB, fragmentation %.2f", double(memStats.usedBytes) / (1024.0 * 1024.0),
+                  double(memStats.reservedBytes) / (1024.0 * 1024.0), memStats.fragmentation);
+    }
+
     ImGui::NewLine();
 
     ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f),"Press 'B' to recompile and reload shaders");
@@ -571,6 +1205,8 @@ void SimpleRender::SetupGUIElements()
     ImGui::Text("Vertex shader path: %s", VERTEX_SHADER_PATH.c_str());
     ImGui::Text("Fragment shader path: %s", FRAGMENT_SHADER_PATH.c_str());
     ImGui::End();
+
+    DrawPipelineStatsWindow(*m_pPipelineStats);
   }
 
   // Rendering
@@ -579,11 +1215,18 @@ void SimpleRender::SetupGUIElements()
 
 void SimpleRender::DrawFrameWithGUI()
 {
-  vkWaitForFences(m_device, 1, &m_frameFences[m_presentationResources.currentFrame], VK_TRUE, UINT64_MAX);
-  vkResetFences(m_device, 1, &m_frameFences[m_presentationResources.currentFrame]);
+  {
+    CPU_PROFILE_SCOPE("wait frame fence");
+    vkWaitForFences(m_device, 1, &m_frameFences[m_presentationResources.currentFrame], VK_TRUE, UINT64_MAX);
+    vkResetFences(m_device, 1, &m_frameFences[m_presentationResources.currentFrame]);
+  }
 
   uint32_t imageIdx;
-  auto result = m_swapchain.AcquireNextImage(m_presentationResources.imageAvailable, &imageIdx);
+  VkResult result;
+  {
+    CPU_PROFILE_SCOPE("AcquireNextImage");
+    result = m_swapchain.AcquireNextImage(m_presentationResources.imageAvailable, &imageIdx);
+  }
   if (result == VK_ERROR_OUT_OF_DATE_KHR)
   {
     RecreateSwapChain();
@@ -596,33 +1239,23 @@ void SimpleRender::DrawFrameWithGUI()
 
   auto currentCmdBuf = m_cmdBuffersDrawMain[m_presentationResources.currentFrame];
 
-  VkSemaphore waitSemaphores[] = {m_presentationResources.imageAvailable};
-  VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-
-  BuildCommandBufferSimple(currentCmdBuf, m_frameBuffers[imageIdx], m_swapchain.GetAttachment(imageIdx).view,
-    m_basicForwardPipeline.pipeline);
+  RecordSceneUpdates();
+  BuildFrameCommands(currentCmdBuf, imageIdx);
 
   ImDrawData* pDrawData = ImGui::GetDrawData();
-  auto currentGUICmdBuf = m_pGUIRender->BuildGUIRenderCommand(imageIdx, pDrawData);
-
-  std::vector<VkCommandBuffer> submitCmdBufs = { currentCmdBuf, currentGUICmdBuf};
-
-  VkSubmitInfo submitInfo = {};
-  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  submitInfo.waitSemaphoreCount = 1;
-  submitInfo.pWaitSemaphores = waitSemaphores;
-  submitInfo.pWaitDstStageMask = waitStages;
-  submitInfo.commandBufferCount = (uint32_t)submitCmdBufs.size();
-  submitInfo.pCommandBuffers = submitCmdBufs.data();
-
-  VkSemaphore signalSemaphores[] = {m_presentationResources.renderingFinished};
-  submitInfo.signalSemaphoreCount = 1;
-  submitInfo.pSignalSemaphores = signalSemaphores;
+  VkCommandBuffer currentGUICmdBuf;
+  {
+    CPU_PROFILE_SCOPE("record GUI commands");
+    currentGUICmdBuf = m_pGUIRender->BuildGUIRenderCommand(imageIdx, pDrawData);
+  }
 
-  VK_CHECK_RESULT(vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, m_frameFences[m_presentationResources.currentFrame]));
+  SubmitFrame({currentCmdBuf, currentGUICmdBuf});
 
-  VkResult presentRes = m_swapchain.QueuePresent(m_presentationResources.queue, imageIdx,
-    m_presentationResources.renderingFinished);
+  VkResult presentRes;
+  {
+    CPU_PROFILE_SCOPE("QueuePresent");
+    presentRes = m_swapchain.QueuePresent(m_presentationResources.queue, imageIdx, m_presentationResources.renderingFinished);
+  }
 
   if (presentRes == VK_ERROR_OUT_OF_DATE_KHR || presentRes == VK_SUBOPTIMAL_KHR)
   {
@@ -635,5 +1268,6 @@ void SimpleRender::DrawFrameWithGUI()
 
   m_presentationResources.currentFrame = (m_presentationResources.currentFrame + 1) % m_framesInFlight;
 
+  CPU_PROFILE_SCOPE("vkQueueWaitIdle");
   vkQueueWaitIdle(m_presentationResources.queue);
 }
@@ -6,6 +6,9 @@
 #include "../../render/scene_mgr.h"
 #include "../../render/render_common.h"
 #include "../../render/render_gui.h"
+#include "../../render/shader_manager.h"
+#include "../../render/pipeline_variants.h"
+#include "../../render/pipeline_stats.h"
 #include "../../../resources/shaders/common.h"
 #include <geom/vk_mesh.h>
 #include <vk_descriptor_sets.h>
@@ -20,6 +23,10 @@ class SimpleRender : public IRender
 public:
   const std::string VERTEX_SHADER_PATH = "../resources/shaders/simple.vert";
   const std::string FRAGMENT_SHADER_PATH = "../resources/shaders/simple.frag";
+  const std::string VPULL_VERTEX_SHADER_PATH = "../resources/shaders/simple_vpull.vert";
+  const std::string VPULL_FRAGMENT_SHADER_PATH = "../resources/shaders/simple_vpull.frag";
+  const std::string CLUSTER_ASSIGN_SHADER_PATH = "../resources/shaders/cluster_assign.comp";
+  const std::string DEPTH_PREPASS_SHADER_PATH = "../resources/shaders/depth_prepass.vert";
 
   SimpleRender(uint32_t a_width, uint32_t a_height);
   ~SimpleRender()  { Cleanup(); };
@@ -35,9 +42,12 @@ public:
   void UpdateCamera(const Camera* cams, uint32_t a_camsCount) override;
   Camera GetCurrentCamera() override {return m_cam;}
   void UpdateView();
+  void UseSceneCamera(uint32_t a_camId);
 
   void LoadScene(const char *path, bool transpose_inst_matrices) override;
+  void ApplySceneChange(const char *path, bool transpose_inst_matrices) override;
   void DrawFrame(float a_time, DrawMode a_mode) override;
+  PipelineStatistics* GetPipelineStatistics() override { return m_pPipelineStats.get(); }
 
   //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -85,6 +95,10 @@ protected:
 
   std::vector<VkFence> m_frameFences;
   std::vector<VkCommandBuffer> m_cmdBuffersDrawMain;
+  std::vector<VkCommandBuffer> m_cmdBuffersSceneUpdate; ///!< acquire barriers of async scene uploads and runtime scene edits
+  uint64_t             m_sceneUploadTicket = 0;           ///!< upload ticket the current frame waits for, 0 - none
+  VkPipelineStageFlags m_sceneUploadStages = 0;
+  bool m_timelineSupported = false;
 
   struct
   {
@@ -94,17 +108,60 @@ protected:
 
   UniformParams m_uniforms {};
   VkBuffer m_ubo = VK_NULL_HANDLE;
-  VkDeviceMemory m_uboAlloc = VK_NULL_HANDLE;
+  MemAllocation m_uboAlloc {};
   void* m_uboMappedMem = nullptr;
 
-  pipeline_data_t m_basicForwardPipeline {};
+  pipeline_data_t  m_basicForwardPipeline {}; // only the layout, pipelines are in m_forwardVariants
+  PipelineVariants m_forwardVariants;
 
   VkDescriptorSet m_dSet = VK_NULL_HANDLE;
   VkDescriptorSetLayout m_dSetLayout = VK_NULL_HANDLE;
+
+  // optional depth only prepass with positions only, then the forward pass shades with EQUAL depth test
+  // and without depth writes, so every pixel is shaded once regardless of the draw order
+  pipeline_data_t  m_depthPrepassPipeline {};
+  PipelineVariants m_forwardEqualVariants;
+  bool m_depthPrepass = false;
+  std::unique_ptr<PipelineStatistics> m_pPipelineStats;
+
+  // vertex pulling: vertices and instance matrices are read from storage buffers,
+  // whole scene is drawn with a single indirect multi-draw, materials and textures come from the scene set (set = 1)
+  pipeline_data_t  m_vertexPullingPipeline {}; // only the layout, pipelines are in m_vertexPullingVariants
+  PipelineVariants m_vertexPullingVariants;
+  VkDescriptorSet m_vpullDSet = VK_NULL_HANDLE;
+  VkDescriptorSetLayout m_vpullDSetLayout = VK_NULL_HANDLE;
+  bool m_useVertexPulling = false;
+
+  // shader features, turned into specialization constants (SPEC_* in common.h)
+  bool m_animateLightColor = true;
+  bool m_texturing         = true;
+  bool m_clusteredLights   = false;
   VkRenderPass m_screenRenderPass = VK_NULL_HANDLE; // main renderpass
 
   std::shared_ptr<vk_utils::DescriptorMaker> m_pBindings = nullptr;
 
+  // point lights: lights of the scene and synthetic ones, shared by clustered forward and deferred shading
+  VkBuffer      m_lightsBuf = VK_NULL_HANDLE; ///!< MAX_POINT_LIGHTS view space lights, host visible, rewritten every frame
+  MemAllocation m_lightsAlloc {};
+  uint32_t      m_lightsNum = 0;
+  int   m_extraLights         = 0;
+  float m_extraLightRadius    = 1.0f;   // reset to a fraction of the scene size on load
+  float m_extraLightIntensity = 2.0f;
+  bool  m_animateLights       = true;
+  float m_exposure            = 1.0f;
+
+  // clustered forward: cluster_assign.comp fills per cluster light lists, simple.frag reads the list of its cluster
+  ClusterParams   m_clusterParams {};
+  VkBuffer        m_clusterUbo         = VK_NULL_HANDLE;
+  MemAllocation   m_clusterUboAlloc {};
+  VkBuffer        m_clusterCountsBuf   = VK_NULL_HANDLE; ///!< light count per cluster
+  MemAllocation   m_clusterCountsAlloc {};
+  VkBuffer        m_clusterLightIdsBuf = VK_NULL_HANDLE; ///!< MAX_LIGHTS_PER_CLUSTER light indices per cluster
+  MemAllocation   m_clusterLightIdsAlloc {};
+  pipeline_data_t m_clusterAssignPipeline {};
+  VkDescriptorSet m_clusterDSet = VK_NULL_HANDLE;
+  VkDescriptorSetLayout m_clusterDSetLayout = VK_NULL_HANDLE;
+
   // *** presentation
   VkSurfaceKHR m_surface = VK_NULL_HANDLE;
   VulkanSwapChain m_swapchain;
@@ -132,22 +189,49 @@ protected:
   std::vector<const char*> m_validationLayers;
 
   std::shared_ptr<SceneManager> m_pScnMgr;
+  std::shared_ptr<DeviceMemoryAllocator> m_pAllocator;
+  std::unique_ptr<ShaderManager> m_pShaderMgr;
 
   void DrawFrameSimple();
+  /// submits a_cmdBufs of the current frame, waiting for the swapchain image and for scene uploads they use
+  void SubmitFrame(std::vector<VkCommandBuffer> a_cmdBufs);
+  /// records scene changes of the current frame into its scene update command buffer, must go before BuildFrameCommands
+  void RecordSceneUpdates();
 
   void CreateInstance();
   void CreateDevice(uint32_t a_deviceId);
 
   void BuildCommandBufferSimple(VkCommandBuffer cmdBuff, VkFramebuffer frameBuff,
                                 VkImageView a_targetImageView, VkPipeline a_pipeline);
+  /// records everything drawn into swapchain image a_imageIdx except GUI, derived renders with other passes override it
+  virtual void BuildFrameCommands(VkCommandBuffer a_cmdBuff, uint32_t a_imageIdx);
 
   virtual void SetupSimplePipeline();
+  /// shaders used by SetupSimplePipeline, it is rebuilt once when any of them changes
+  virtual std::vector<std::string> ProgramSources() const;
+  void SetupVertexPullingPipeline();
+  /// points m_vpullDSet at the current scene buffers after they were reallocated, pipelines stay as they are
+  void UpdateVertexPullingDescriptors();
+  SpecializationConstants FeatureConstants() const;
+  VkPipeline ForwardPipeline();
+  bool DepthPrepassActive() const;
+  void DrawSceneCmd(VkCommandBuffer a_cmdBuff, VkPipeline a_pipeline);
+  void DrawSceneDepthCmd(VkCommandBuffer a_cmdBuff);
+  void DrawSceneVertexPullingCmd(VkCommandBuffer a_cmdBuff);
   void CleanupPipelineAndSwapchain();
   void RecreateSwapChain();
 
   void CreateUniformBuffer();
   void UpdateUniformBuffer(float a_time);
 
+  void CreateLightsBuffer();
+  void CreateClusterBuffers();
+  void SetupClusterAssignPipeline();
+  void ClusterAssignCmd(VkCommandBuffer a_cmdBuff);
+  /// fills m_lightsBuf with view space lights and m_clusterParams, derived renders add their own per frame light data
+  virtual void UpdateLights(float a_time);
+  VkPipeline CreateComputePipeline(const std::string &a_shaderPath, VkPipelineLayout a_layout);
+
   void Cleanup();
 
   void SetupDeviceFeatures();
@@ -1,6 +1,7 @@
 #include <vk_pipeline.h>
 #include "simple_render_tex.h"
 #include "loader_utils/images.h"
+#include "loader_utils/bc_compress.h"
 #include "imgui/misc/cpp/imgui_stdlib.h"
 
 
@@ -8,13 +9,54 @@ SimpleRenderTexture::SimpleRenderTexture(uint32_t a_width, uint32_t a_height) :
 {
 }
 
+std::vector<std::string> SimpleRenderTexture::ProgramSources() const
+{
+  auto sources = SimpleRender::ProgramSources();
+  sources.push_back(FRAGMENT_SHADER_PATH);
+  return sources;
+}
+
 
 void SimpleRenderTexture::LoadScene(const char* path, bool transpose_inst_matrices)
 {
   m_pScnMgr->LoadSceneXML(path, transpose_inst_matrices);
 
   CreateUniformBuffer();
+
+  m_pTexMgr = std::make_unique<TextureManager>(m_device, m_physicalDevice, m_pAllocator,
+                                               m_queueFamilyIDXs.transfer, m_queueFamilyIDXs.graphics);
+  m_texId   = m_pTexMgr->AddTexture();
+  // trilinear sampler, LOD range is left unclamped since the level count changes with reloaded textures
+  // and the image view already limits it to the levels that exist
+  {
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType        = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter    = VK_FILTER_LINEAR;
+    samplerInfo.minFilter    = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode   = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.minLod       = 0.0f;
+    samplerInfo.maxLod       = VK_LOD_CLAMP_NONE;
+    samplerInfo.borderColor  = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+    VK_CHECK_RESULT(vkCreateSampler(m_device, &samplerInfo, nullptr, &m_textureSampler));
+  }
+
+  // the very first upload has to be finished before descriptor set is created
+  m_pImageLoader = std::make_unique<ImageLoadService>();
   LoadTexture();
+  m_pImageLoader->WaitIdle();
+  m_pTexMgr->WaitAll();
+  m_pTexMgr->Poll();
+  if(!m_pTexMgr->IsReady(m_texId))
+  {
+    const uint32_t white = 0xFFFFFFFF;
+    m_pTexMgr->UploadAsync(m_texId, &white, 1, 1, VK_FORMAT_R8G8B8A8_UNORM, 4);
+    m_pTexMgr->WaitAll();
+    m_pTexMgr->Poll();
+  }
+
   SetupSimplePipeline();
 
   auto loadedCam = m_pScnMgr->GetCamera(0);
@@ -28,94 +70,125 @@ void SimpleRenderTexture::LoadScene(const char* path, bool transpose_inst_matric
   for (uint32_t i = 0; i < m_framesInFlight; ++i)
   {
     BuildCommandBufferSimple(m_cmdBuffersDrawMain[i], m_frameBuffers[i],
-      m_swapchain.GetAttachment(i).view, m_basicForwardPipeline.pipeline);
+      m_swapchain.GetAttachment(i).view, ForwardPipeline());
   }
 }
 
 void SimpleRenderTexture::LoadTexture()
 {
-  int w, h, channels;
-  auto pixels = loadImageLDR(m_texturePath.c_str(), w, h, channels);
-
-  if(pixels == nullptr)
+  if(m_useCompressedTextures && m_enabledDeviceFeatures.textureCompressionBC)
   {
-    std::stringstream ss;
-    ss << "Failed loading texture from " << m_texturePath;
-    vk_utils::logWarning(ss.str());
-    return;
+    int w, h, channels;
+    // gray + alpha images have 2 channels, they need BC3 as well
+    const bool hasAlpha = getImageInfo(m_texturePath.c_str(), w, h, channels) && (channels == 2 || channels == 4);
+    const BCFormat bcFormat = hasAlpha ? BCFormat::BC3 : BCFormat::BC1;
+
+    CompressedImage image;
+    if(loadOrCompressBC(m_texturePath, bcFormat, image))
+    {
+      const VkFormat format = bcFormat == BCFormat::BC3 ? VK_FORMAT_BC3_UNORM_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+      m_pTexMgr->UploadAsync(m_texId, image.data.data(), image.width, image.height, format, 0, image.mipLevels);
+      return;
+    }
   }
 
-  // in this sample we simply reallocate memory every time
-  // in more practical scenario you would try to reuse the same memory
-  // or even better utilize some sort of allocator
-  vk_utils::deleteImg(m_device, &m_texture);
-  if(m_textureSampler != VK_NULL_HANDLE)
+  // decoded and mip mapped on worker threads, the completion runs in DrawFrame -> m_pImageLoader->Poll();
+  // mips are filtered on the CPU since blits are not available on a transfer-only queue
+  m_pImageLoader->Request(m_texturePath, [this](const ImageLoadResult &a_res)
   {
-    vkDestroySampler(m_device, m_textureSampler, VK_NULL_HANDLE);
-  }
+    if(!a_res.ok)
+    {
+      std::stringstream ss;
+      ss << "Failed loading texture from " << a_res.path;
+      vk_utils::logWarning(ss.str());
+      return;
+    }
 
-  int mipLevels = 1;
-  m_texture = allocateColorTextureFromDataLDR(m_device, m_physicalDevice, pixels, w, h, mipLevels,
-           VK_FORMAT_R8G8B8A8_UNORM, m_pScnMgr->GetCopyHelper());
-  m_textureSampler = vk_utils::createSampler(m_device, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT,
-    VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK);
+    // image is reused if size and format didn't change, new data becomes visible after m_pTexMgr->Poll() reports it
+    m_pTexMgr->UploadAsync(m_texId, a_res.pixels, a_res.width, a_res.height, VK_FORMAT_R8G8B8A8_UNORM, 4, a_res.mipLevels);
+  }, true);
+}
 
-  freeImageMemLDR(pixels);
+void SimpleRenderTexture::UpdateTextureDescriptor()
+{
+  // descriptor set is updated in place, so frames that might still use it have to be finished
+  vkWaitForFences(m_device, uint32_t(m_frameFences.size()), m_frameFences.data(), VK_TRUE, UINT64_MAX);
+
+  VkDescriptorImageInfo imageInfo = {};
+  imageInfo.sampler     = m_textureSampler;
+  imageInfo.imageView   = m_pTexMgr->GetView(m_texId);
+  imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  VkWriteDescriptorSet write = {};
+  write.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet          = m_dSet;
+  write.dstBinding      = 1;
+  write.dstArrayElement = 0;
+  write.descriptorCount = 1;
+  write.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  write.pImageInfo      = &imageInfo;
+  vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
 }
 
 void SimpleRenderTexture::SetupSimplePipeline()
 {
   std::vector<std::pair<VkDescriptorType, uint32_t> > dtypes = {
-    {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 128},  // overallocate descriptors to allow recreation when texture is updated
-                                                       // one alternative would be to recreate descriptor pool when we get VK_OUT_OF_POOL_MEMORY error
+    {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1},
     {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         1}
   };
 
+  // the set is created once, texture reloads only rewrite its image binding (see UpdateTextureDescriptor)
   if(m_pBindings == nullptr)
-    m_pBindings = std::make_shared<vk_utils::DescriptorMaker>(m_device, dtypes, 128); // new texture -> new set, so need to set this also to a higher value
+  {
+    m_pBindings = std::make_shared<vk_utils::DescriptorMaker>(m_device, dtypes, 1);
 
-  m_pBindings->BindBegin(VK_SHADER_STAGE_FRAGMENT_BIT);
-  m_pBindings->BindBuffer(0, m_ubo, VK_NULL_HANDLE, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-  m_pBindings->BindImage(1, m_texture.view, m_textureSampler, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-  m_pBindings->BindEnd(&m_dSet, &m_dSetLayout);
+    m_pBindings->BindBegin(VK_SHADER_STAGE_FRAGMENT_BIT);
+    m_pBindings->BindBuffer(0, m_ubo, VK_NULL_HANDLE, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+    m_pBindings->BindImage(1, m_pTexMgr->GetView(m_texId), m_textureSampler, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    m_pBindings->BindEnd(&m_dSet, &m_dSetLayout);
+  }
 
   // if we are recreating pipeline (for example, to reload shaders)
   // we need to cleanup old pipeline
+  m_forwardVariants.Clear();
   if(m_basicForwardPipeline.layout != VK_NULL_HANDLE)
   {
     vkDestroyPipelineLayout(m_device, m_basicForwardPipeline.layout, nullptr);
     m_basicForwardPipeline.layout = VK_NULL_HANDLE;
   }
-  if(m_basicForwardPipeline.pipeline != VK_NULL_HANDLE)
-  {
-    vkDestroyPipeline(m_device, m_basicForwardPipeline.pipeline, nullptr);
-    m_basicForwardPipeline.pipeline = VK_NULL_HANDLE;
-  }
 
-  vk_utils::GraphicsPipelineMaker maker;
+  auto pMaker = std::make_shared<vk_utils::GraphicsPipelineMaker>();
 
   std::unordered_map<VkShaderStageFlagBits, std::string> shader_paths;
-  shader_paths[VK_SHADER_STAGE_FRAGMENT_BIT] = FRAGMENT_SHADER_PATH + ".spv";
-  shader_paths[VK_SHADER_STAGE_VERTEX_BIT]   = VERTEX_SHADER_PATH + ".spv";
-
-  maker.LoadShaders(m_device, shader_paths);
-
-  m_basicForwardPipeline.layout = maker.MakeLayout(m_device, {m_dSetLayout}, sizeof(pushConst2M));
-  maker.SetDefaultState(m_width, m_height);
-
-  m_basicForwardPipeline.pipeline = maker.MakePipeline(m_device, m_pScnMgr->GetPipelineVertexInputStateCreateInfo(),
-    m_screenRenderPass, {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR});
+  shader_paths[VK_SHADER_STAGE_FRAGMENT_BIT] = m_pShaderMgr->GetSPVPath(FRAGMENT_SHADER_PATH);
+  shader_paths[VK_SHADER_STAGE_VERTEX_BIT]   = m_pShaderMgr->GetSPVPath(VERTEX_SHADER_PATH);
+
+  m_basicForwardPipeline.layout = pMaker->MakeLayout(m_device, {m_dSetLayout}, sizeof(pushConst2M));
+  pMaker->SetDefaultState(m_width, m_height);
+
+  // simple_tex.frag has no specialization constants, all variants are the same pipeline
+  m_forwardVariants.Reset(m_device, [this, pMaker, shader_paths](const VkSpecializationInfo* a_pInfo) {
+    pMaker->LoadShaders(m_device, shader_paths);
+    SetSpecialization(*pMaker, VK_SHADER_STAGE_FRAGMENT_BIT, a_pInfo);
+    return pMaker->MakePipeline(m_device, m_pScnMgr->GetPipelineVertexInputStateCreateInfo(),
+      m_screenRenderPass, {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR});
+  });
 }
 
 void SimpleRenderTexture::DrawFrame(float a_time, DrawMode a_mode)
 {
+  m_pShaderMgr->Update();
+
   if(m_textureNeedsReload)
   {
     LoadTexture();
-    SetupSimplePipeline();
     m_textureNeedsReload = false;
   }
 
+  m_pImageLoader->Poll();
+  if(!m_pTexMgr->Poll().empty())
+    UpdateTextureDescriptor();
+
   UpdateUniformBuffer(a_time);
   switch (a_mode)
   {
@@ -133,37 +206,20 @@ void SimpleRenderTexture::DrawFrame(float a_time, DrawMode a_mode)
 
 void SimpleRenderTexture::ProcessInput(const AppInput &input)
 {
-  // recreate pipeline to reload shaders
+  // changed shaders are recompiled in background and picked up automatically, B forces pipelines to be recreated
   if(input.keyPressed[GLFW_KEY_B])
-  {
-#ifdef WIN32
-    std::system("cd ../resources/shaders && python compile_simple_render_shaders.py");
-#else
-    std::system("cd ../resources/shaders && python3 compile_simple_texture_shaders.py");
-#endif
-
-    SetupSimplePipeline();
-
-    for (uint32_t i = 0; i < m_framesInFlight; ++i)
-    {
-      BuildCommandBufferSimple(m_cmdBuffersDrawMain[i], m_frameBuffers[i],
-        m_swapchain.GetAttachment(i).view, m_basicForwardPipeline.pipeline);
-    }
-  }
+    m_pShaderMgr->ReloadAll();
 
 }
 
 void SimpleRenderTexture::Cleanup()
 {
-  vk_utils::deleteImg(m_device, &m_texture);
+  m_pImageLoader = nullptr;
+  m_pTexMgr      = nullptr;
   if(m_textureSampler != VK_NULL_HANDLE)
   {
     vkDestroySampler(m_device, m_textureSampler, VK_NULL_HANDLE);
-  }
-  if(m_texture.mem != VK_NULL_HANDLE)
-  {
-    vkFreeMemory(m_device, m_texture.mem, nullptr);
-    m_texture.mem = VK_NULL_HANDLE;
+    m_textureSampler = VK_NULL_HANDLE;
   }
 }
 
@@ -180,6 +236,14 @@ void SimpleRenderTexture::SetupGUIElements()
     {
       m_textureNeedsReload = true;
     }
+    if(m_pImageLoader->Pending() > 0)
+      ImGui::Text("Decoding texture...");
+    if(m_pTexMgr->IsUploading(m_texId))
+      ImGui::Text("Uploading texture...");
+    if(m_enabledDeviceFeatures.textureCompressionBC)
+      ImGui::Checkbox("Block compression (BC1/BC3) on next load", &m_useCompressedTextures);
+    ImGui::Text("Texture images created: %u, mip levels: %u", m_pTexMgr->ImagesAllocated(), m_pTexMgr->GetMipLevels(m_texId));
+    ImGui::Text("Texture memory: %.2f MB", double(m_pTexMgr->GetMemorySize(m_texId)) / (1024.0 * 1024.0));
 
     ImGui::NewLine();
 
@@ -4,6 +4,8 @@
 #define VK_NO_PROTOTYPES
 
 #include "simple_render.h"
+#include "../../render/texture_mgr.h"
+#include "../../loader_utils/image_load_service.h"
 #include <vk_images.h>
 
 class SimpleRenderTexture : public SimpleRender
@@ -23,15 +25,20 @@ public:
 protected:
 
   bool m_textureNeedsReload = false;
+  bool m_useCompressedTextures = false; ///!< BC1/BC3 with cache files next to the source, if device supports it, a missing cache is compressed on the render thread
   std::string m_texturePath = "../resources/textures/test_tex_1.png";
 
-  vk_utils::VulkanImageMem m_texture {};
+  std::unique_ptr<ImageLoadService> m_pImageLoader;
+  std::unique_ptr<TextureManager> m_pTexMgr;
+  uint32_t  m_texId = 0;
   VkSampler m_textureSampler = VK_NULL_HANDLE;
 
   void LoadTexture();
+  void UpdateTextureDescriptor();
 
   void SetupGUIElements() override;
   void SetupSimplePipeline() override;
+  std::vector<std::string> ProgramSources() const override;
   void Cleanup();
 
 };
@@ -0,0 +1,43 @@
+#include "scene_generator.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// usage: scene_generator [--out dir] [--meshes N] [--instances N] [--triangles N] [--textures N] [--texture-size N]
+//                        [--materials N] [--lights N] [--extent F] [--seed N]
+int main(int argc, const char** argv)
+{
+  SceneGenParams params;
+  for(int i = 1; i < argc; ++i)
+  {
+    const bool hasValue = i + 1 < argc;
+    if(std::strcmp(argv[i], "--out") == 0 && hasValue)
+      params.outDir = argv[++i];
+    else if(std::strcmp(argv[i], "--meshes") == 0 && hasValue)
+      params.meshes = uint32_t(std::strtoul(argv[++i], nullptr, 10));
+    else if(std::strcmp(argv[i], "--instances") == 0 && hasValue)
+      params.instances = std::strtoull(argv[++i], nullptr, 10);
+    else if(std::strcmp(argv[i], "--triangles") == 0 && hasValue)
+      params.trianglesPerMesh = uint32_t(std::strtoul(argv[++i], nullptr, 10));
+    else if(std::strcmp(argv[i], "--textures") == 0 && hasValue)
+      params.textures = uint32_t(std::strtoul(argv[++i], nullptr, 10));
+    else if(std::strcmp(argv[i], "--texture-size") == 0 && hasValue)
+      params.textureSize = uint32_t(std::strtoul(argv[++i], nullptr, 10));
+    else if(std::strcmp(argv[i], "--materials") == 0 && hasValue)
+      params.materials = uint32_t(std::strtoul(argv[++i], nullptr, 10));
+    else if(std::strcmp(argv[i], "--lights") == 0 && hasValue)
+      params.lights = uint32_t(std::strtoul(argv[++i], nullptr, 10));
+    else if(std::strcmp(argv[i], "--extent") == 0 && hasValue)
+      params.extent = float(std::strtod(argv[++i], nullptr));
+    else if(std::strcmp(argv[i], "--seed") == 0 && hasValue)
+      params.seed = uint32_t(std::strtoul(argv[++i], nullptr, 10));
+    else
+    {
+      std::cout << "unknown argument " << argv[i] << std::endl;
+      return 1;
+    }
+  }
+
+  return GenerateScene(params) ? 0 : 1;
+}
@@ -0,0 +1,358 @@
+#include "scene_generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+  constexpr float PI = 3.14159265358979323846f;
+
+  // small PCG, std distributions differ between standard libraries and scenes must be the same everywhere
+  struct Random
+  {
+    explicit Random(uint64_t a_seed) : state(a_seed * 6364136223846793005ull + 1442695040888963407ull) { Next(); }
+
+    uint32_t Next()
+    {
+      const uint64_t old = state;
+      state = old * 6364136223846793005ull + 1442695040888963407ull;
+      const uint32_t xorshifted = uint32_t(((old >> 18u) ^ old) >> 27u);
+      const uint32_t rot        = uint32_t(old >> 59u);
+      return (xorshifted >> rot) | (xorshifted << ((32u - rot) & 31u));
+    }
+
+    float Uniform(float a_min, float a_max) { return a_min + (a_max - a_min) * float(Next() >> 8) * (1.0f / 16777216.0f); }
+
+    uint64_t state;
+  };
+
+  struct Float3
+  {
+    float x = 0.0f, y = 0.0f, z = 0.0f;
+  };
+
+  Float3 operator-(const Float3 &a, const Float3 &b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+  Float3 cross(const Float3 &a, const Float3 &b) { return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x}; }
+  Float3 normalize(const Float3 &a)
+  {
+    const float len = std::sqrt(a.x * a.x + a.y * a.y + a.z * a.z);
+    return len > 0.0f ? Float3{a.x / len, a.y / len, a.z / len} : Float3{0.0f, 1.0f, 0.0f};
+  }
+
+  struct VSGFHeader
+  {
+    uint64_t fileSizeInBytes;
+    uint32_t verticesNum;
+    uint32_t indicesNum;
+    uint32_t materialsNum;
+    uint32_t flags;
+  };
+  constexpr uint32_t VSGF_HAS_TANGENT = 1;
+
+  struct MeshInfo
+  {
+    uint32_t vertNum  = 0;
+    uint32_t triNum   = 0;
+    uint64_t bytesize = 0;
+    Float3   bboxMin, bboxMax;
+  };
+
+  std::string chunkName(uint32_t a_id, const char* a_ext)
+  {
+    char name[64];
+    std::snprintf(name, sizeof(name), "data/chunk_%05u.%s", a_id, a_ext);
+    return name;
+  }
+
+  // sphere tessellated into rings x segments with radius modulated by a few random waves
+  bool writeMesh(const std::string &a_path, uint32_t a_triangles, uint32_t a_materialId, Random &a_rnd, MeshInfo &a_info)
+  {
+    const uint32_t segments = std::max(3u, uint32_t(std::sqrt(float(a_triangles))));
+    const uint32_t rings    = std::max(2u, a_triangles / (2 * segments));
+
+    const float freqTheta = std::floor(a_rnd.Uniform(1.0f, 6.0f));
+    const float freqPhi   = std::floor(a_rnd.Uniform(1.0f, 6.0f));
+    const float amplitude = a_rnd.Uniform(0.0f, 0.25f);
+    const float scaleY    = a_rnd.Uniform(0.6f, 1.4f);
+
+    const uint32_t vertNum = (rings + 1) * (segments + 1);
+    std::vector<Float3>   positions(vertNum), tangents(vertNum), normals(vertNum);
+    std::vector<float>    texcoords(size_t(vertNum) * 2);
+    std::vector<uint32_t> indices;
+    indices.reserve(size_t(rings) * segments * 6);
+
+    a_info.bboxMin = { 1e30f,  1e30f,  1e30f};
+    a_info.bboxMax = {-1e30f, -1e30f, -1e30f};
+    for(uint32_t i = 0; i <= rings; ++i)
+    {
+      const float theta = PI * float(i) / float(rings);
+      for(uint32_t j = 0; j <= segments; ++j)
+      {
+        const float phi = 2.0f * PI * float(j) / float(segments);
+        const float r   = 1.0f + amplitude * std::sin(freqTheta * theta) * std::sin(freqPhi * phi);
+
+        const uint32_t v = i * (segments + 1) + j;
+        positions[v] = {r * std::sin(theta) * std::cos(phi), r * scaleY * std::cos(theta), r * std::sin(theta) * std::sin(phi)};
+        tangents[v]  = {-std::sin(phi), 0.0f, std::cos(phi)};
+        texcoords[v * 2 + 0] = float(j) / float(segments);
+        texcoords[v * 2 + 1] = float(i) / float(rings);
+
+        a_info.bboxMin = {std::min(a_info.bboxMin.x, positions[v].x), std::min(a_info.bboxMin.y, positions[v].y), std::min(a_info.bboxMin.z, positions[v].z)};
+        a_info.bboxMax = {std::max(a_info.bboxMax.x, positions[v].x), std::max(a_info.bboxMax.y, positions[v].y), std::max(a_info.bboxMax.z, positions[v].z)};
+      }
+    }
+
+    for(uint32_t i = 0; i < rings; ++i)
+    {
+      for(uint32_t j = 0; j < segments; ++j)
+      {
+        const uint32_t v00 = i * (segments + 1) + j;
+        const uint32_t v01 = v00 + 1;
+        const uint32_t v10 = v00 + segments + 1;
+        const uint32_t v11 = v10 + 1;
+        indices.insert(indices.end(), {v00, v01, v10, v01, v11, v10}); // counter clockwise seen from outside
+      }
+    }
+
+    // area weighted face normals, vertices on the seam and the poles are not welded so normals there are approximate
+    for(size_t t = 0; t < indices.size(); t += 3)
+    {
+      const Float3 n = cross(positions[indices[t + 1]] - positions[indices[t]], positions[indices[t + 2]] - positions[indices[t]]);
+      for(int k = 0; k < 3; ++k)
+      {
+        Float3 &dst = normals[indices[t + k]];
+        dst = {dst.x + n.x, dst.y + n.y, dst.z + n.z};
+      }
+    }
+
+    const uint32_t triNum = uint32_t(indices.size() / 3);
+    std::vector<float> buf4(size_t(vertNum) * 4);
+    auto writeArray4f = [&](std::ofstream &out, const std::vector<Float3> &a_data, bool a_normalize, float a_w) {
+      for(uint32_t v = 0; v < vertNum; ++v)
+      {
+        const Float3 val = a_normalize ? normalize(a_data[v]) : a_data[v];
+        buf4[v * 4 + 0] = val.x;
+        buf4[v * 4 + 1] = val.y;
+        buf4[v * 4 + 2] = val.z;
+        buf4[v * 4 + 3] = a_w;
+      }
+      out.write((const char*)buf4.data(), buf4.size() * sizeof(float));
+    };
+
+    VSGFHeader header = {};
+    header.verticesNum     = vertNum;
+    header.indicesNum      = uint32_t(indices.size());
+    header.flags           = VSGF_HAS_TANGENT;
+    header.fileSizeInBytes = sizeof(VSGFHeader) + uint64_t(vertNum) * (3 * 4 * sizeof(float) + 2 * sizeof(float)) +
+                             indices.size() * sizeof(uint32_t) + uint64_t(triNum) * sizeof(uint32_t);
+
+    std::ofstream out(a_path, std::ios::binary);
+    if(!out.is_open())
+    {
+      std::cout << "[GenerateScene] can't open " << a_path << std::endl;
+      return false;
+    }
+    out.write((const char*)&header, sizeof(header));
+    writeArray4f(out, positions, false, 1.0f);
+    writeArray4f(out, normals,   true,  0.0f);
+    writeArray4f(out, tangents,  false, 1.0f);
+    out.write((const char*)texcoords.data(), texcoords.size() * sizeof(float));
+    out.write((const char*)indices.data(), indices.size() * sizeof(uint32_t));
+    const std::vector<uint32_t> matIndices(triNum, a_materialId);
+    out.write((const char*)matIndices.data(), matIndices.size() * sizeof(uint32_t));
+
+    a_info.vertNum  = vertNum;
+    a_info.triNum   = triNum;
+    a_info.bytesize = header.fileSizeInBytes;
+    return bool(out);
+  }
+
+  // image4ub chunk: int width, int height, then RGBA8 pixels
+  bool writeTexture(const std::string &a_path, uint32_t a_size, Random &a_rnd)
+  {
+    const uint32_t color0  = a_rnd.Next() | 0xFF000000u;
+    const uint32_t color1  = a_rnd.Next() | 0xFF000000u;
+    const uint32_t checker = std::max(1u, a_size / (1u << (2 + a_rnd.Next() % 4)));
+
+    std::vector<uint32_t> pixels(size_t(a_size) * a_size);
+    for(uint32_t y = 0; y < a_size; ++y)
+      for(uint32_t x = 0; x < a_size; ++x)
+        pixels[size_t(y) * a_size + x] = ((x / checker + y / checker) & 1) ? color1 : color0;
+
+    std::ofstream out(a_path, std::ios::binary);
+    if(!out.is_open())
+    {
+      std::cout << "[GenerateScene] can't open " << a_path << std::endl;
+      return false;
+    }
+    const int32_t size[2] = {int32_t(a_size), int32_t(a_size)};
+    out.write((const char*)size, sizeof(size));
+    out.write((const char*)pixels.data(), pixels.size() * sizeof(uint32_t));
+    return bool(out);
+  }
+
+  void writeMatrix(std::ostream &a_out, float a_scale, float a_angle, const Float3 &a_pos)
+  {
+    // rotation around Y and uniform scale, row major with translation in the last column as Hydra stores it
+    const float c = std::cos(a_angle) * a_scale;
+    const float s = std::sin(a_angle) * a_scale;
+    char str[256];
+    std::snprintf(str, sizeof(str), "%g 0 %g %g 0 %g 0 %g %g 0 %g %g 0 0 0 1 ", c, s, a_pos.x, a_scale, a_pos.y, -s, c, a_pos.z);
+    a_out << str;
+  }
+}
+
+bool GenerateScene(const SceneGenParams &a_params)
+{
+  namespace fs = std::filesystem;
+  std::error_code err;
+  fs::create_directories(fs::path(a_params.outDir) / "data", err);
+  if(err)
+  {
+    std::cout << "[GenerateScene] can't create " << a_params.outDir << ": " << err.message() << std::endl;
+    return false;
+  }
+
+  Random rnd(a_params.seed);
+  const uint32_t meshesNum    = std::max(a_params.meshes, 1u);
+  const uint32_t materialsNum = std::max({a_params.materials, a_params.textures, 1u});
+  const float    extent       = a_params.extent > 0.0f ? a_params.extent : 2.5f * std::cbrt(float(std::max<uint64_t>(a_params.instances, 1)));
+
+  std::ofstream xml(a_params.outDir + "/statex_00001.xml");
+  if(!xml.is_open())
+  {
+    std::cout << "[GenerateScene] can't open " << a_params.outDir << "/statex_00001.xml" << std::endl;
+    return false;
+  }
+
+  uint32_t chunkId = 0;
+  xml << "<?xml version=\"1.0\"?>\n";
+  xml << "<textures_lib total_chunks=\"" << a_params.textures << "\">\n";
+  for(uint32_t t = 0; t < a_params.textures; ++t)
+  {
+    const std::string loc = chunkName(chunkId++, "image4ub");
+    if(!writeTexture(a_params.outDir + "/" + loc, a_params.textureSize, rnd))
+      return false;
+    xml << "  <texture id=\"" << t << "\" name=\"Map#" << t << "\" loc=\"" << loc << "\" offset=\"8\" bytesize=\""
+        << uint64_t(a_params.textureSize) * a_params.textureSize * 4 << "\" width=\"" << a_params.textureSize
+        << "\" height=\"" << a_params.textureSize << "\" dl=\"0\" />\n";
+  }
+  xml << "</textures_lib>\n";
+
+  xml << "<materials_lib>\n";
+  for(uint32_t m = 0; m < materialsNum; ++m)
+  {
+    const float r = rnd.Uniform(0.1f, 0.9f), g = rnd.Uniform(0.1f, 0.9f), b = rnd.Uniform(0.1f, 0.9f);
+    xml << "  <material id=\"" << m << "\" name=\"generated_" << m << "\" type=\"hydra_material\">\n";
+    xml << "    <diffuse brdf_type=\"lambert\">\n";
+    if(m < a_params.textures)
+    {
+      xml << "      <color val=\"1 1 1\" tex_apply_mode=\"multiply\">\n";
+      xml << "        <texture id=\"" << m << "\" type=\"texref\" matrix=\"1 0 0 0 0 1 0 0 0 0 1 0 0 0 0 1 \" addressing_mode_u=\"wrap\" addressing_mode_v=\"wrap\" />\n";
+      xml << "      </color>\n";
+    }
+    else
+      xml << "      <color val=\"" << r << " " << g << " " << b << "\" />\n";
+    xml << "    </diffuse>\n";
+    xml << "  </material>\n";
+  }
+  xml << "  <material id=\"" << materialsNum << "\" name=\"environment_material\" type=\"hydra_material\" light_id=\"0\" visible=\"1\">\n";
+  xml << "    <emission>\n      <color val=\"0.2 0.2 0.2\" />\n    </emission>\n  </material>\n";
+  for(uint32_t l = 0; l < a_params.lights; ++l)
+  {
+    xml << "  <material id=\"" << materialsNum + 1 + l << "\" name=\"point_light_" << l << "_material\" type=\"hydra_material\" light_id=\""
+        << l + 1 << "\" visible=\"1\">\n";
+    xml << "    <emission>\n      <color val=\"10 10 10\" />\n    </emission>\n  </material>\n";
+  }
+  xml << "</materials_lib>\n";
+
+  xml << "<geometry_lib total_chunks=\"" << meshesNum << "\">\n";
+  uint64_t totalTriangles = 0;
+  for(uint32_t m = 0; m < meshesNum; ++m)
+  {
+    const std::string loc = chunkName(chunkId++, "vsgf");
+    const uint32_t triangles = std::max(8u, uint32_t(float(a_params.trianglesPerMesh) * rnd.Uniform(0.5f, 1.5f)));
+    MeshInfo info;
+    if(!writeMesh(a_params.outDir + "/" + loc, triangles, m % materialsNum, rnd, info))
+      return false;
+    totalTriangles += info.triNum;
+
+    const uint64_t posSize = uint64_t(info.vertNum) * 16, texSize = uint64_t(info.vertNum) * 8;
+    const uint64_t indSize = uint64_t(info.triNum) * 12,  matSize = uint64_t(info.triNum) * 4;
+    uint64_t offset = sizeof(VSGFHeader);
+    xml << "  <mesh id=\"" << m << "\" name=\"generated_" << m << "\" type=\"vsgf\" bytesize=\"" << info.bytesize << "\" loc=\"" << loc
+        << "\" offset=\"0\" vertNum=\"" << info.vertNum << "\" triNum=\"" << info.triNum << "\" dl=\"0\" path=\"\" bbox=\""
+        << info.bboxMin.x << " " << info.bboxMax.x << " " << info.bboxMin.y << " " << info.bboxMax.y << " "
+        << info.bboxMin.z << " " << info.bboxMax.z << "\">\n";
+    xml << "    <positions type=\"array4f\" bytesize=\"" << posSize << "\" offset=\"" << offset << "\" apply=\"vertex\" />\n"; offset += posSize;
+    xml << "    <normals type=\"array4f\" bytesize=\""   << posSize << "\" offset=\"" << offset << "\" apply=\"vertex\" />\n"; offset += posSize;
+    xml << "    <tangents type=\"array4f\" bytesize=\""  << posSize << "\" offset=\"" << offset << "\" apply=\"vertex\" />\n"; offset += posSize;
+    xml << "    <texcoords type=\"array2f\" bytesize=\"" << texSize << "\" offset=\"" << offset << "\" apply=\"vertex\" />\n"; offset += texSize;
+    xml << "    <indices type=\"array1i\" bytesize=\""   << indSize << "\" offset=\"" << offset << "\" apply=\"tlist\" />\n"; offset += indSize;
+    xml << "    <matindices type=\"array1i\" bytesize=\"" << matSize << "\" offset=\"" << offset << "\" apply=\"primitive\" />\n";
+    xml << "  </mesh>\n";
+  }
+  xml << "</geometry_lib>\n";
+
+  std::vector<Float3> lightPositions(a_params.lights);
+  for(auto &pos : lightPositions)
+    pos = {rnd.Uniform(-extent, extent), rnd.Uniform(-extent, extent), rnd.Uniform(-extent, extent)};
+
+  xml << "<lights_lib>\n";
+  xml << "  <light id=\"0\" name=\"environment\" type=\"sky\" shape=\"point\" distribution=\"uniform\" visible=\"1\" mat_id=\"" << materialsNum << "\">\n";
+  xml << "    <intensity>\n      <color val=\"0.2 0.2 0.2\" />\n      <multiplier val=\"1\" />\n    </intensity>\n  </light>\n";
+  for(uint32_t l = 0; l < a_params.lights; ++l)
+  {
+    xml << "  <light id=\"" << l + 1 << "\" name=\"point_light_" << l << "\" type=\"point\" shape=\"point\" distribution=\"uniform\" visible=\"1\" mat_id=\""
+        << materialsNum + 1 + l << "\">\n";
+    xml << "    <intensity>\n      <color val=\"" << rnd.Uniform(0.5f, 1.0f) << " " << rnd.Uniform(0.5f, 1.0f) << " " << rnd.Uniform(0.5f, 1.0f)
+        << "\" />\n      <multiplier val=\"10\" />\n    </intensity>\n  </light>\n";
+  }
+  xml << "</lights_lib>\n";
+
+  xml << "<cam_lib>\n";
+  xml << "  <camera id=\"0\" name=\"Camera001\" type=\"uvn\">\n";
+  xml << "    <fov>45</fov>\n    <nearClipPlane>0.1</nearClipPlane>\n    <farClipPlane>" << extent * 10.0f << "</farClipPlane>\n";
+  xml << "    <up>0 1 0</up>\n    <position>0 " << extent * 0.5f << " " << extent * 2.5f << "</position>\n    <look_at>0 0 0</look_at>\n";
+  xml << "  </camera>\n";
+  xml << "</cam_lib>\n";
+
+  xml << "<render_lib>\n  <render_settings type=\"HydraModern\" id=\"0\">\n    <width>1024</width>\n    <height>1024</height>\n  </render_settings>\n</render_lib>\n";
+
+  xml << "<scenes>\n";
+  xml << "  <scene id=\"0\" name=\"generated\" discard=\"1\" bbox=\"" << -extent - 2 << " " << extent + 2 << " " << -extent - 2 << " "
+      << extent + 2 << " " << -extent - 2 << " " << extent + 2 << "\">\n";
+  for(uint64_t i = 0; i < a_params.instances; ++i)
+  {
+    const uint32_t meshId = rnd.Next() % meshesNum;
+    const Float3 pos = {rnd.Uniform(-extent, extent), rnd.Uniform(-extent, extent), rnd.Uniform(-extent, extent)};
+    xml << "    <instance id=\"" << i << "\" mesh_id=\"" << meshId << "\" rmap_id=\"-1\" scn_id=\"0\" scn_sid=\"0\" matrix=\"";
+    writeMatrix(xml, rnd.Uniform(0.3f, 1.0f), rnd.Uniform(0.0f, 2.0f * PI), pos);
+    xml << "\" />\n";
+  }
+  xml << "    <instance_light id=\"0\" light_id=\"0\" matrix=\"1 0 0 0 0 1 0 0 0 0 1 0 0 0 0 1 \" lgroup_id=\"-1\" />\n";
+  for(uint32_t l = 0; l < a_params.lights; ++l)
+  {
+    xml << "    <instance_light id=\"" << l + 1 << "\" light_id=\"" << l + 1 << "\" matrix=\"";
+    writeMatrix(xml, 1.0f, 0.0f, lightPositions[l]);
+    xml << "\" lgroup_id=\"-1\" />\n";
+  }
+  xml << "  </scene>\n";
+  xml << "</scenes>\n";
+
+  if(!xml)
+  {
+    std::cout << "[GenerateScene] failed to write " << a_params.outDir << "/statex_00001.xml" << std::endl;
+    return false;
+  }
+
+  std::cout << "[GenerateScene] " << a_params.outDir << ": " << meshesNum << " meshes (" << totalTriangles << " triangles), "
+            << a_params.instances << " instances, " << a_params.textures << " textures, " << materialsNum << " materials, "
+            << a_params.lights << " point lights" << std::endl;
+  return true;
+}
@@ -0,0 +1,30 @@
+#ifndef VK_GRAPHICS_BASIC_SCENE_GENERATOR_H
+#define VK_GRAPHICS_BASIC_SCENE_GENERATOR_H
+
+#include <cstdint>
+#include <string>
+
+/**
+\brief synthetic scene in Hydra format for stress tests of SceneManager and the loaders
+
+Writes a_outDir/statex_00001.xml, one VSGF chunk per mesh and one image4ub chunk per texture into a_outDir/data.
+Meshes are bumpy spheres with roughly trianglesPerMesh triangles, instances are scattered in a cube.
+The same parameters always produce the same files.
+*/
+struct SceneGenParams
+{
+  std::string outDir           = "../resources/scenes/generated";
+  uint32_t    meshes           = 16;
+  uint64_t    instances        = 10000;
+  uint32_t    trianglesPerMesh = 2000;
+  uint32_t    textures         = 4;
+  uint32_t    textureSize      = 256;
+  uint32_t    materials        = 8;    ///!< at least textures, first textures materials are textured
+  uint32_t    lights           = 0;    ///!< point lights scattered over the scene in addition to the environment light
+  float       extent           = 0.0f; ///!< half size of the cube with instances, 0 - chosen from instance count
+  uint32_t    seed             = 1;
+};
+
+bool GenerateScene(const SceneGenParams &a_params);
+
+#endif// VK_GRAPHICS_BASIC_SCENE_GENERATOR_H
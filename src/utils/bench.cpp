@@ -0,0 +1,247 @@
+#include "bench.h"
+#include "cpu_profiler.h"
+#include "../render/pipeline_stats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+std::vector<CameraKey> loadCameraPath(const std::string &a_path)
+{
+  std::vector<CameraKey> keys;
+  std::ifstream in(a_path);
+  if(!in.is_open())
+  {
+    std::cout << "[loadCameraPath] can't open " << a_path << std::endl;
+    return keys;
+  }
+
+  std::string line;
+  uint32_t lineNum = 0;
+  while(std::getline(in, line))
+  {
+    lineNum++;
+    line = line.substr(0, line.find('#'));
+
+    std::istringstream str(line);
+    CameraKey key;
+    if(!(str >> key.time))
+      continue;
+
+    if(!(str >> key.cam.pos.x >> key.cam.pos.y >> key.cam.pos.z >> key.cam.lookAt.x >> key.cam.lookAt.y >> key.cam.lookAt.z))
+    {
+      std::cout << "[loadCameraPath] " << a_path << ":" << lineNum << " expected time, position and look at point" << std::endl;
+      continue;
+    }
+    if(str >> key.cam.up.x >> key.cam.up.y >> key.cam.up.z)
+      str >> key.cam.fov;
+
+    if(!keys.empty() && key.time <= keys.back().time)
+    {
+      std::cout << "[loadCameraPath] " << a_path << ":" << lineNum << " time must increase, key is skipped" << std::endl;
+      continue;
+    }
+    keys.push_back(key);
+  }
+
+  return keys;
+}
+
+Camera sampleCameraPath(const std::vector<CameraKey> &a_path, float a_time)
+{
+  if(a_path.empty())
+    return {};
+  if(a_time <= a_path.front().time)
+    return a_path.front().cam;
+  if(a_time >= a_path.back().time)
+    return a_path.back().cam;
+
+  auto pNext = std::upper_bound(a_path.begin(), a_path.end(), a_time,
+                                [](float t, const CameraKey &key) { return t < key.time; });
+  const CameraKey &k0 = *(pNext - 1);
+  const CameraKey &k1 = *pNext;
+  const float t = (a_time - k0.time) / (k1.time - k0.time);
+
+  Camera cam;
+  cam.pos    = LiteMath::lerp(k0.cam.pos,    k1.cam.pos,    t);
+  cam.lookAt = LiteMath::lerp(k0.cam.lookAt, k1.cam.lookAt, t);
+  cam.up     = normalize(LiteMath::lerp(k0.cam.up, k1.cam.up, t));
+  cam.fov    = k0.cam.fov + (k1.cam.fov - k0.cam.fov) * t;
+  cam.tdist  = k0.cam.tdist;
+  return cam;
+}
+
+BenchParams readBenchParams(const std::unordered_map<std::string, std::string> &a_params, const std::string &a_scenePath)
+{
+  BenchParams res;
+  res.scenePath = a_scenePath;
+
+  auto pFound = a_params.find("camera-path");
+  if(pFound != a_params.end())
+    res.cameraPath = pFound->second;
+  pFound = a_params.find("out");
+  if(pFound != a_params.end() && !pFound->second.empty())
+    res.outPath = pFound->second;
+  pFound = a_params.find("frames");
+  if(pFound != a_params.end())
+    res.frames = std::max(uint32_t(std::strtoul(pFound->second.c_str(), nullptr, 10)), 1u);
+  pFound = a_params.find("warmup");
+  if(pFound != a_params.end())
+    res.warmup = uint32_t(std::strtoul(pFound->second.c_str(), nullptr, 10));
+  res.gui = a_params.count("gui") > 0;
+
+  return res;
+}
+
+static double percentile(const std::vector<double> &a_sorted, double a_p)
+{
+  const size_t rank = size_t(std::ceil(a_p * double(a_sorted.size())));
+  return a_sorted[std::min(std::max(rank, size_t(1)), a_sorted.size()) - 1];
+}
+
+FrameTimeStats computeFrameTimeStats(std::vector<double> a_frameMs)
+{
+  FrameTimeStats stats;
+  if(a_frameMs.empty())
+    return stats;
+
+  std::sort(a_frameMs.begin(), a_frameMs.end());
+  double sum = 0.0;
+  for(double ms : a_frameMs)
+    sum += ms;
+
+  stats.frames = uint32_t(a_frameMs.size());
+  stats.meanMs = sum / double(a_frameMs.size());
+  stats.minMs  = a_frameMs.front();
+  stats.maxMs  = a_frameMs.back();
+  stats.p50Ms  = percentile(a_frameMs, 0.50);
+  stats.p95Ms  = percentile(a_frameMs, 0.95);
+  stats.p99Ms  = percentile(a_frameMs, 0.99);
+  return stats;
+}
+
+static void writeJsonString(std::ostream &a_out, const std::string &a_str)
+{
+  a_out << '"';
+  for(char c : a_str)
+  {
+    if(c == '"' || c == '\\')
+      a_out << '\\';
+    a_out << c;
+  }
+  a_out << '"';
+}
+
+static bool writeBenchJSON(const BenchParams &a_params, const FrameTimeStats &a_stats,
+                           const std::vector<PipelineStatistics::ScopeStats> &a_passes)
+{
+  std::ofstream out(a_params.outPath);
+  if(!out.is_open())
+  {
+    std::cout << "[benchLoop] can't open " << a_params.outPath << std::endl;
+    return false;
+  }
+
+  out << std::fixed << std::setprecision(4);
+  out << "{\n";
+  out << "  \"scene\": ";       writeJsonString(out, a_params.scenePath);  out << ",\n";
+  out << "  \"camera_path\": "; writeJsonString(out, a_params.cameraPath); out << ",\n";
+  out << "  \"gui\": " << (a_params.gui ? "true" : "false") << ",\n";
+  out << "  \"warmup_frames\": " << a_params.warmup << ",\n";
+  out << "  \"frames\": " << a_stats.frames << ",\n";
+  out << "  \"fps\": " << (a_stats.meanMs > 0.0 ? 1000.0 / a_stats.meanMs : 0.0) << ",\n";
+  out << "  \"frame_ms\": {\n";
+  out << "    \"mean\": " << a_stats.meanMs << ",\n";
+  out << "    \"min\": "  << a_stats.minMs  << ",\n";
+  out << "    \"max\": "  << a_stats.maxMs  << ",\n";
+  out << "    \"p50\": "  << a_stats.p50Ms  << ",\n";
+  out << "    \"p95\": "  << a_stats.p95Ms  << ",\n";
+  out << "    \"p99\": "  << a_stats.p99Ms  << "\n";
+  out << "  },\n";
+  out << "  \"passes\": {";
+  for(size_t i = 0; i < a_passes.size(); ++i)
+  {
+    const auto &pass = a_passes[i];
+    out << (i == 0 ? "\n" : ",\n") << "    "; writeJsonString(out, pass.name); out << ": {\n";
+    out << "      \"frames\": " << pass.frames << ",\n";
+    out << "      \"vertex_invocations\": "   << pass.AvgVertexInvocations()   << ",\n";
+    out << "      \"clipping_primitives\": "  << pass.AvgClippingPrimitives()  << ",\n";
+    out << "      \"fragment_invocations\": " << pass.AvgFragmentInvocations() << "\n";
+    out << "    }";
+  }
+  out << (a_passes.empty() ? "}\n" : "\n  }\n");
+  out << "}\n";
+  return true;
+}
+
+bool benchLoop(std::shared_ptr<IRender> &app, GLFWwindow* window, const BenchParams &a_params)
+{
+  CPU_PROFILE_THREAD_NAME("main");
+
+  std::vector<CameraKey> path;
+  if(!a_params.cameraPath.empty())
+  {
+    path = loadCameraPath(a_params.cameraPath);
+    if(path.empty())
+    {
+      std::cout << "[benchLoop] camera path " << a_params.cameraPath << " has no keys" << std::endl;
+      return false;
+    }
+  }
+  else
+    path.push_back({0.0f, app->GetCurrentCamera()});
+
+  const float    duration  = path.back().time - path.front().time;
+  const DrawMode mode      = a_params.gui ? DrawMode::WITH_GUI : DrawMode::NO_GUI;
+  const uint32_t framesNum = a_params.warmup + a_params.frames;
+
+  std::vector<double> frameMs;
+  frameMs.reserve(a_params.frames);
+
+  PipelineStatistics* pStats = app->GetPipelineStatistics();
+  if(pStats != nullptr && a_params.warmup == 0)
+    pStats->ResetTotals();
+
+  AppInput input;
+  for(uint32_t i = 0; i < framesNum && !glfwWindowShouldClose(window); ++i)
+  {
+    CPU_PROFILE_SCOPE("frame");
+    glfwPollEvents();
+
+    // warmup frames stay at the start of the path, measured frames go through the whole path exactly once
+    const uint32_t measured = i < a_params.warmup ? 0 : i - a_params.warmup;
+    const float time = path.front().time + duration * float(measured) / float(std::max(a_params.frames - 1, 1u));
+
+    input.cams[0] = sampleCameraPath(path, time);
+    input.cams[1] = input.cams[0];
+
+    const auto start = std::chrono::steady_clock::now();
+    app->ProcessInput(input);
+    app->UpdateCamera(input.cams, 1);
+    app->DrawFrame(time, mode);
+    const auto end = std::chrono::steady_clock::now();
+
+    if(i >= a_params.warmup)
+      frameMs.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+
+    // statistics are read back frames in flight later, so the last warmup frames leak into the totals a little
+    if(i + 1 == a_params.warmup && pStats != nullptr)
+      pStats->ResetTotals();
+  }
+
+  if(frameMs.size() < a_params.frames)
+    std::cout << "[benchLoop] window was closed after " << frameMs.size() << " measured frames" << std::endl;
+
+  const FrameTimeStats stats = computeFrameTimeStats(frameMs);
+  std::cout << "[benchLoop] " << stats.frames << " frames, mean = " << stats.meanMs << " ms, p50 = " << stats.p50Ms
+            << " ms, p95 = " << stats.p95Ms << " ms, p99 = " << stats.p99Ms << " ms" << std::endl;
+
+  std::vector<PipelineStatistics::ScopeStats> passes;
+  if(pStats != nullptr)
+    passes = pStats->GetStats();
+  return writeBenchJSON(a_params, stats, passes);
+}
@@ -0,0 +1,61 @@
+#ifndef VK_GRAPHICS_BASIC_BENCH_H
+#define VK_GRAPHICS_BASIC_BENCH_H
+
+#include "../render/render_common.h"
+
+#include "GLFW/glfw3.h"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+\brief camera path for benchmarks, one key per line:
+
+  time  pos.x pos.y pos.z  lookAt.x lookAt.y lookAt.z  [up.x up.y up.z  [fov]]
+
+'#' starts a comment. Keys must go in increasing time order, the camera is linearly interpolated between keys.
+*/
+struct CameraKey
+{
+  float  time = 0.0f;
+  Camera cam;
+};
+
+std::vector<CameraKey> loadCameraPath(const std::string &a_path);
+Camera sampleCameraPath(const std::vector<CameraKey> &a_path, float a_time);
+
+struct BenchParams
+{
+  std::string scenePath;
+  std::string cameraPath;             ///!< empty - camera of the scene stays still
+  std::string outPath = "bench.json";
+  uint32_t    frames  = 1000;         ///!< measured frames
+  uint32_t    warmup  = 60;           ///!< frames rendered before measuring
+  bool        gui     = false;
+};
+
+/// reads --camera-path, --frames, --warmup, --out, --gui from parameters returned by readCommandLineParams
+BenchParams readBenchParams(const std::unordered_map<std::string, std::string> &a_params, const std::string &a_scenePath);
+
+struct FrameTimeStats
+{
+  uint32_t frames = 0;
+  double   meanMs = 0.0;
+  double   minMs  = 0.0;
+  double   maxMs  = 0.0;
+  double   p50Ms  = 0.0;
+  double   p95Ms  = 0.0;
+  double   p99Ms  = 0.0;
+};
+
+FrameTimeStats computeFrameTimeStats(std::vector<double> a_frameMs);
+
+/**
+\brief renders a fixed number of frames along the camera path and writes frame time statistics to a_params.outPath
+       camera and frame time don't depend on wall clock, so runs on the same machine are comparable across commits.
+       Frame time is measured on CPU around DrawFrame, which waits for the queue to become idle in every renderer.
+*/
+bool benchLoop(std::shared_ptr<IRender> &app, GLFWwindow* window, const BenchParams &a_params);
+
+#endif// VK_GRAPHICS_BASIC_BENCH_H
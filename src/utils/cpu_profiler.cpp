@@ -0,0 +1,154 @@
+#include "cpu_profiler.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace cpu_profiler
+{
+  /// ring slot, seq is 2*i+1 while event i is written into it and 2*i+2 when it is complete
+  struct Event
+  {
+    std::atomic<uint64_t>    seq   {0};
+    std::atomic<const char*> name  {nullptr};
+    std::atomic<int64_t>     start {0};     ///!< ns since profiler epoch
+    std::atomic<int64_t>     end   {0};
+  };
+
+  struct ThreadBuffer
+  {
+    std::vector<Event>    events = std::vector<Event>(EVENTS_PER_THREAD);
+    std::atomic<uint64_t> written {0};
+    std::string           name;
+    uint32_t              tid = 0;
+  };
+
+  struct Registry
+  {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> threads; // never freed, threads may exit before the dump
+    std::atomic<bool> enabled {true};
+    const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+  };
+
+  static Registry& registry()
+  {
+    static Registry reg;
+    return reg;
+  }
+
+  static ThreadBuffer& threadBuffer()
+  {
+    thread_local ThreadBuffer* pBuffer = nullptr;
+    if(pBuffer == nullptr)
+    {
+      auto& reg = registry();
+      std::lock_guard<std::mutex> lock(reg.mutex);
+      reg.threads.push_back(std::make_unique<ThreadBuffer>());
+      pBuffer       = reg.threads.back().get();
+      pBuffer->tid  = uint32_t(reg.threads.size() - 1);
+      pBuffer->name = "thread " + std::to_string(pBuffer->tid);
+    }
+    return *pBuffer;
+  }
+
+  int64_t Now()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - registry().epoch).count();
+  }
+
+  void Record(const char* a_name, int64_t a_start, int64_t a_end)
+  {
+    auto& buffer = threadBuffer();
+    const uint64_t idx = buffer.written.load(std::memory_order_relaxed);
+
+    auto& event = buffer.events[idx & (EVENTS_PER_THREAD - 1)];
+    event.seq.store(2 * idx + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    event.name.store(a_name, std::memory_order_relaxed);
+    event.start.store(a_start, std::memory_order_relaxed);
+    event.end.store(a_end, std::memory_order_relaxed);
+    event.seq.store(2 * idx + 2, std::memory_order_release);
+
+    buffer.written.store(idx + 1, std::memory_order_release);
+  }
+
+  void SetThreadName(const char* a_name)
+  {
+    auto& buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    buffer.name = a_name;
+  }
+
+  void SetEnabled(bool a_enabled) { registry().enabled.store(a_enabled, std::memory_order_relaxed); }
+  bool IsEnabled() { return registry().enabled.load(std::memory_order_relaxed); }
+
+  static void writeJsonString(std::ostream &a_out, const char* a_str)
+  {
+    a_out << '"';
+    for(const char* p = a_str; *p != '\0'; ++p)
+    {
+      if(*p == '"' || *p == '\\')
+        a_out << '\\';
+      a_out << *p;
+    }
+    a_out << '"';
+  }
+
+  bool DumpChromeTrace(const std::string &a_path)
+  {
+    std::ofstream out(a_path);
+    if(!out.is_open())
+    {
+      std::cout << "[cpu_profiler::DumpChromeTrace] can't open " << a_path << std::endl;
+      return false;
+    }
+
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    size_t eventsNum = 0;
+    for(const auto& pThread : reg.threads)
+    {
+      if(!first)
+        out << ",\n";
+      first = false;
+      out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,\"tid\":" << pThread->tid << ",\"args\":{\"name\":";
+      writeJsonString(out, pThread->name.c_str());
+      out << "}}";
+
+      const uint64_t written = pThread->written.load(std::memory_order_acquire);
+      const uint64_t begin   = written > EVENTS_PER_THREAD ? written - EVENTS_PER_THREAD : 0;
+      for(uint64_t i = begin; i < written; ++i)
+      {
+        const auto& slot = pThread->events[i & (EVENTS_PER_THREAD - 1)];
+        const uint64_t seqBefore = slot.seq.load(std::memory_order_acquire);
+        const char*    name      = slot.name.load(std::memory_order_relaxed);
+        const int64_t  start     = slot.start.load(std::memory_order_relaxed);
+        const int64_t  end       = slot.end.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t seqAfter  = slot.seq.load(std::memory_order_relaxed);
+        // the recording thread has already wrapped around and is rewriting or has rewritten this slot
+        if(seqBefore != 2 * i + 2 || seqAfter != seqBefore || name == nullptr)
+          continue;
+
+        // complete events, timestamps in microseconds
+        out << ",\n{\"ph\":\"X\",\"pid\":0,\"tid\":" << pThread->tid << ",\"name\":";
+        writeJsonString(out, name);
+        out << ",\"ts\":" << double(start) * 1e-3 << ",\"dur\":" << double(end - start) * 1e-3 << "}";
+        eventsNum++;
+      }
+    }
+    out << "\n]}\n";
+
+    std::cout << "[cpu_profiler] " << eventsNum << " events from " << reg.threads.size() << " threads written to "
+              << a_path << std::endl;
+    return true;
+  }
+}
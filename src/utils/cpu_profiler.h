@@ -0,0 +1,65 @@
+#ifndef VK_GRAPHICS_BASIC_CPU_PROFILER_H
+#define VK_GRAPHICS_BASIC_CPU_PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/**
+\brief scoped CPU time markers, dumped as Chrome trace (chrome://tracing, ui.perfetto.dev)
+
+Every thread writes its events into its own ring buffer, the first event of a thread registers the buffer under a
+mutex, after that recording is just two clock reads and a few relaxed stores. Every ring slot carries a sequence
+number (a per-event seqlock), so a dump running concurrently with recording drops slots that are being rewritten
+instead of reading torn events. Rings keep the latest EVENTS_PER_THREAD events,
+so a dump covers the last few hundred frames. Scope names must be string literals (only pointers are stored).
+Define DISABLE_CPU_PROFILER to compile all markers out.
+*/
+namespace cpu_profiler
+{
+  static constexpr uint32_t EVENTS_PER_THREAD = 1u << 16;
+
+  int64_t Now();
+
+  void Record(const char* a_name, int64_t a_start, int64_t a_end);
+
+  /// name shown for the calling thread in the trace
+  void SetThreadName(const char* a_name);
+
+  void SetEnabled(bool a_enabled);
+  bool IsEnabled();
+
+  /**
+  \brief write events of all threads to a_path in Chrome trace_event JSON format
+         may be called while other threads record, events they overwrite during the dump are skipped
+  */
+  bool DumpChromeTrace(const std::string &a_path);
+
+  class Scope
+  {
+  public:
+    explicit Scope(const char* a_name) : m_name(a_name), m_start(IsEnabled() ? Now() : -1) {}
+    ~Scope() { if(m_start >= 0) Record(m_name, m_start, Now()); }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+  private:
+    const char* m_name;
+    int64_t     m_start;
+  };
+}
+
+#define CPU_PROFILER_CONCAT_IMPL(a, b) a##b
+#define CPU_PROFILER_CONCAT(a, b) CPU_PROFILER_CONCAT_IMPL(a, b)
+
+#ifndef DISABLE_CPU_PROFILER
+  #define CPU_PROFILE_SCOPE(name) cpu_profiler::Scope CPU_PROFILER_CONCAT(cpuProfileScope, __LINE__)(name)
+  #define CPU_PROFILE_THREAD_NAME(name) cpu_profiler::SetThreadName(name)
+#else
+  #define CPU_PROFILE_SCOPE(name)
+  #define CPU_PROFILE_THREAD_NAME(name)
+#endif
+
+#endif// VK_GRAPHICS_BASIC_CPU_PROFILER_H
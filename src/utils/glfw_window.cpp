@@ -9,8 +9,10 @@
 #include <memory>
 #include <cstdint>
 #include <sstream>
+#include <string>
 
 #include "Camera.h"
+#include "cpu_profiler.h"
 
 #ifdef NDEBUG
 constexpr bool g_enableValidationLayers = false;
@@ -190,28 +192,41 @@ void mainLoop(std::shared_ptr<IRender> &app, GLFWwindow* window, bool displayGUI
   int avgCounter = 0;
   int currCam    = 0;
 
+  CPU_PROFILE_THREAD_NAME("main");
+
   g_appInput.cams[0] = app->GetCurrentCamera();
   double lastTime = glfwGetTime();
   while (!glfwWindowShouldClose(window))
   {
+    CPU_PROFILE_SCOPE("frame");
     double thisTime = glfwGetTime();
     double diffTime = thisTime - lastTime;
     lastTime        = thisTime;
     
     g_appInput.clearKeys();
-    glfwPollEvents();
+    {
+      CPU_PROFILE_SCOPE("glfwPollEvents");
+      glfwPollEvents();
+    }
     
     if(g_appInput.keyReleased[GLFW_KEY_L])
       currCam = 1 - currCam;
 
+    // F9 writes the recorded CPU scopes, open in chrome://tracing or ui.perfetto.dev
+    if(g_appInput.keyReleased[GLFW_KEY_F9])
+      cpu_profiler::DumpChromeTrace("cpu_trace.json");
+
     UpdateCamera(window, g_appInput.cams[currCam], static_cast<float>(diffTime));
     
     app->ProcessInput(g_appInput);
     app->UpdateCamera(g_appInput.cams, 2);
-    if(displayGUI)
-      app->DrawFrame(static_cast<float>(thisTime), DrawMode::WITH_GUI);
-    else
-      app->DrawFrame(static_cast<float>(thisTime), DrawMode::NO_GUI);
+    {
+      CPU_PROFILE_SCOPE("DrawFrame");
+      if(displayGUI)
+        app->DrawFrame(static_cast<float>(thisTime), DrawMode::WITH_GUI);
+      else
+        app->DrawFrame(static_cast<float>(thisTime), DrawMode::NO_GUI);
+    }
 
     // count and print FPS
     //
@@ -229,3 +244,26 @@ void mainLoop(std::shared_ptr<IRender> &app, GLFWwindow* window, bool displayGUI
     }
   }
 }
+
+// "--key value" and "-key value" pairs, a key without value (followed by another key or last) maps to an empty string
+std::unordered_map<std::string, std::string> readCommandLineParams(int argc, const char** argv)
+{
+  std::unordered_map<std::string, std::string> res;
+  for(int i = 1; i < argc; ++i)
+  {
+    std::string key = argv[i];
+    const size_t nameStart = key.find_first_not_of('-');
+    if(nameStart == 0 || nameStart == std::string::npos)
+    {
+      std::cout << "[readCommandLineParams] unexpected argument " << key << std::endl;
+      continue;
+    }
+    key = key.substr(nameStart);
+
+    if(i + 1 < argc && argv[i + 1][0] != '-')
+      res[key] = argv[++i];
+    else
+      res[key] = "";
+  }
+  return res;
+}